@@ -918,36 +918,7 @@ public:
     aed_node_(NULL),
     raw_edits_(NULL)
     {
-        shapeSet_ = other.shapeSet_;
-        rdlen_ = other.rdlen_;
-        rdid_ = other.rdid_;
-        rdrows_ = other.rdrows_;
-        score_ = other.score_;
-        oscore_ = other.oscore_;
-        refcoord_ = other.refcoord_;
-        reflen_ = other.reflen_;
-        refival_ = other.refival_;
-        rdextent_ = other.rdextent_;
-        rdexrows_ = other.rdexrows_;
-        rfextent_ = other.rfextent_;
-        seedmms_ = other.seedmms_;
-        seedlen_ = other.seedlen_;
-        minsc_ = other.minsc_;
-        nuc5p_ = other.nuc5p_;
-        nuc3p_ = other.nuc3p_;
-        refns_ = other.refns_;
-        type_ = other.type_;
-        fraglenSet_ = other.fraglenSet_;
-        fraglen_ = other.fraglen_;
-        pretrimSoft_ = other.pretrimSoft_;
-        pretrim5p_ = other.pretrim5p_;
-        pretrim3p_ = other.pretrim3p_;
-        trimSoft_ = other.trimSoft_;
-        trim5p_ = other.trim5p_;
-        trim3p_ = other.trim3p_;
-        repeat_ = other.repeat_;
-        
-        num_spliced_ = other.num_spliced_;
+        copyFields_(other);
         raw_edits_ = other.raw_edits_;
         if(raw_edits_ != NULL) {
             assert(ned_ == NULL && aed_ == NULL);
@@ -965,36 +936,7 @@ public:
     
     AlnRes& operator=(const AlnRes& other) {
         if(this == &other) return *this;
-        shapeSet_ = other.shapeSet_;
-        rdlen_ = other.rdlen_;
-        rdid_ = other.rdid_;
-        rdrows_ = other.rdrows_;
-        score_ = other.score_;
-        oscore_ = other.oscore_;
-        refcoord_ = other.refcoord_;
-        reflen_ = other.reflen_;
-        refival_ = other.refival_;
-        rdextent_ = other.rdextent_;
-        rdexrows_ = other.rdexrows_;
-        rfextent_ = other.rfextent_;
-        seedmms_ = other.seedmms_;
-        seedlen_ = other.seedlen_;
-        minsc_ = other.minsc_;
-        nuc5p_ = other.nuc5p_;
-        nuc3p_ = other.nuc3p_;
-        refns_ = other.refns_;
-        type_ = other.type_;
-        fraglenSet_ = other.fraglenSet_;
-        fraglen_ = other.fraglen_;
-        pretrimSoft_ = other.pretrimSoft_;
-        pretrim5p_ = other.pretrim5p_;
-        pretrim3p_ = other.pretrim3p_;
-        trimSoft_ = other.trimSoft_;
-        trim5p_ = other.trim5p_;
-        trim3p_ = other.trim3p_;
-        repeat_ = other.repeat_;
-        
-        num_spliced_ = other.num_spliced_;
+        copyFields_(other);
         assert(raw_edits_ == NULL || raw_edits_ == other.raw_edits_);
         raw_edits_ = other.raw_edits_;
         if(ned_ != NULL) {
@@ -1020,6 +962,35 @@ public:
         return *this;
     }
     
+    /**
+     * Make this a copy of 'other', taking the storage for the edit lists
+     * from 'raw_edits' rather than from the pool 'other' draws from.
+     * Used to move alignments between threads, which don't share pools.
+     */
+    void copyFrom(const AlnRes& other, LinkedEList<EList<Edit> >* raw_edits) {
+        assert(this != &other);
+        assert(raw_edits != NULL);
+        if(raw_edits_ != raw_edits) {
+            if(ned_ != NULL) {
+                ned_->clear(); aed_->clear();
+                raw_edits_->delete_node(ned_node_);
+                raw_edits_->delete_node(aed_node_);
+                ned_ = aed_ = NULL;
+                ned_node_ = aed_node_ = NULL;
+            }
+            raw_edits_ = NULL;
+            init_raw_edits(raw_edits);
+        }
+        copyFields_(other);
+        if(other.ned_ != NULL) {
+            *ned_ = *(other.ned_);
+            *aed_ = *(other.aed_);
+        } else {
+            ned_->clear();
+            aed_->clear();
+        }
+    }
+    
     ~AlnRes()
     {
 #ifndef NDEBUG
@@ -1284,6 +1255,7 @@ public:
 	size_t             readExtentRows() const { return rdexrows_; }
 	size_t             readLength()     const { return rdlen_;    }
     TReadId            readID()         const { return rdid_;     }
+    void               setReadID(TReadId rdid)  { rdid_ = rdid;      }
     bool               spliced()        const { return num_spliced_ > 0;  }
     size_t             num_spliced()    const { return num_spliced_; }
     uint8_t            spliced_whichsense_transcript() const {
@@ -1859,6 +1831,42 @@ public:
 
 protected:
 
+    /**
+     * Copy all members except the edit lists and the pool they come from.
+     */
+    void copyFields_(const AlnRes& other) {
+        shapeSet_ = other.shapeSet_;
+        rdlen_ = other.rdlen_;
+        rdid_ = other.rdid_;
+        rdrows_ = other.rdrows_;
+        score_ = other.score_;
+        oscore_ = other.oscore_;
+        refcoord_ = other.refcoord_;
+        reflen_ = other.reflen_;
+        refival_ = other.refival_;
+        rdextent_ = other.rdextent_;
+        rdexrows_ = other.rdexrows_;
+        rfextent_ = other.rfextent_;
+        seedmms_ = other.seedmms_;
+        seedlen_ = other.seedlen_;
+        minsc_ = other.minsc_;
+        nuc5p_ = other.nuc5p_;
+        nuc3p_ = other.nuc3p_;
+        refns_ = other.refns_;
+        type_ = other.type_;
+        fraglenSet_ = other.fraglenSet_;
+        fraglen_ = other.fraglen_;
+        pretrimSoft_ = other.pretrimSoft_;
+        pretrim5p_ = other.pretrim5p_;
+        pretrim3p_ = other.pretrim3p_;
+        trimSoft_ = other.trimSoft_;
+        trim5p_ = other.trim5p_;
+        trim3p_ = other.trim3p_;
+        repeat_ = other.repeat_;
+        
+        num_spliced_ = other.num_spliced_;
+    }
+
 	/**
 	 * Given that rdextent_ and ned_ are already set, calculate rfextent_.
 	 */
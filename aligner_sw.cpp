@@ -57,6 +57,8 @@ void SwAligner::initRead(
 	sseU8rcBuilt_  = false;  // built rc query profile, 8-bit score
 	sseI16fwBuilt_ = false;  // built fw query profile, 16-bit score
 	sseI16rcBuilt_ = false;  // built rc query profile, 16-bit score
+	avx2U8fwBuilt_ = false;  // built fw 256-bit query profile, 8-bit score
+	avx2U8rcBuilt_ = false;  // built rc 256-bit query profile, 8-bit score
 #endif
 }
 
@@ -501,6 +503,11 @@ bool SwAligner::align(
 					gathered = true;
 				}
 			} else {
+#ifdef AVX2_CAPABILITY
+				if(avx2_) {
+					best = alignNucleotidesEnd2EndAvx2U8(flag, false);
+				} else
+#endif
 				best = alignNucleotidesEnd2EndSseU8(flag, false);
 #ifndef NDEBUG
 				int flagtmp = 0;
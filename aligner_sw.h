@@ -83,6 +83,7 @@
 #include "dp_framer.h"
 #include "aligner_swsse.h"
 #include "aligner_bt.h"
+#include "processor_support.h"
 
 #define QUAL2(d, f) sc_->mm((int)(*rd_)[rdi_ + d], \
 							(int)  rf_ [rfi_ + f], \
@@ -228,9 +229,15 @@ public:
 		cperTri_(),
 		colstop_(0),
 		lastsolcol_(0),
-		cural_(0)
+		cural_(0),
+		avx2_(false)
 		ASSERT_ONLY(, cand_tmp_(DP_CAT))
-	{ }
+	{
+#ifdef AVX2_CAPABILITY
+		ProcessorSupport ps;
+		avx2_ = ps.AVX2enabled();
+#endif
+	}
 
 	/**
 	 * Prepare the dynamic programming driver with a new read and a new scoring
@@ -421,6 +428,15 @@ public:
 		nbtfiltst_ = nbtfiltsc_ = nbtfiltdo_ = 0;
 	}
 	
+	/**
+	 * Return the number of DP cells filled since the counters were last
+	 * reset.
+	 */
+	uint64_t dpCells() const {
+		return sseU8ExtendMet_.cell + sseU8MateMet_.cell +
+		       sseI16ExtendMet_.cell + sseI16MateMet_.cell;
+	}
+	
 	/**
 	 * Return the size of the DP problem.
 	 */
@@ -453,6 +469,10 @@ protected:
 		int& flag, bool debug);
 	TAlScore alignNucleotidesLocalSseI16(   // signed 16-bit elements
 		int& flag, bool debug);
+#ifdef AVX2_CAPABILITY
+	TAlScore alignNucleotidesEnd2EndAvx2U8( // unsigned 8-bit elements, 256-bit
+		int& flag, bool debug);
+#endif
 	
 	/**
 	 * Aligns by filling a dynamic programming matrix with the SSE-accelerated,
@@ -489,6 +509,9 @@ protected:
 	 */
 	void buildQueryProfileEnd2EndSseU8(bool fw);
 	void buildQueryProfileLocalSseU8(bool fw);
+#ifdef AVX2_CAPABILITY
+	void buildQueryProfileEnd2EndAvx2U8(bool fw);
+#endif
 
 	/**
 	 * Build query profile look up tables for the read.  The query profile look
@@ -603,6 +626,8 @@ protected:
 	bool                sseU8rcBuilt_;   // built rc query profile, 8-bit score
 	bool                sseI16fwBuilt_;  // built fw query profile, 16-bit score
 	bool                sseI16rcBuilt_;  // built rc query profile, 16-bit score
+	bool                avx2U8fwBuilt_;  // built fw 256-bit query profile, 8-bit score
+	bool                avx2U8rcBuilt_;  // built rc 256-bit query profile, 8-bit score
 
 	SSEMetrics			sseU8ExtendMet_;
 	SSEMetrics			sseU8MateMet_;
@@ -635,6 +660,7 @@ protected:
 	size_t              colstop_;      // bailed on DP loop after this many cols
 	size_t              lastsolcol_;   // last DP col with valid cell
 	size_t              cural_;        // index of next alignment to be given
+	bool                avx2_;         // use 256-bit AVX2 kernels where we have them?
 	
 	uint64_t nbtfiltst_; // # candidates filtered b/c starting cell was seen
 	uint64_t nbtfiltsc_; // # candidates filtered b/c score uninteresting
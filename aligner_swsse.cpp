@@ -34,12 +34,13 @@ void SSEMatrix::init(
 	nrow_ = nrow;
 	ncol_ = ncol;
 	wperv_ = wperv;
+	vecw_ = (wperv_ == 32) ? 2 : 1;
 	nvecPerCol_ = (nrow + (wperv-1)) / wperv;
 	// The +1 is so that we don't have to special-case the final column;
 	// instead, we just write off the end of the useful part of the table
 	// with pvEStore.
 	try {
-		matbuf_.resizeNoCopy((ncol+1) * nvecPerCell_ * nvecPerCol_);
+		matbuf_.resizeNoCopy((ncol+1) * nvecPerCell_ * nvecPerCol_ * vecw_);
 	} catch(exception& e) {
 		cerr << "Tried to allocate DP matrix with " << (ncol+1)
 		     << " columns, " << nvecPerCol_
@@ -47,12 +48,12 @@ void SSEMatrix::init(
 			 << " vectors per cell" << endl;
 		throw e;
 	}
-	assert(wperv_ == 8 || wperv_ == 16);
-	vecshift_ = (wperv_ == 8) ? 3 : 4;
+	assert(wperv_ == 8 || wperv_ == 16 || wperv_ == 32);
+	vecshift_ = (wperv_ == 8) ? 3 : ((wperv_ == 16) ? 4 : 5);
 	nvecrow_ = (nrow + (wperv_-1)) >> vecshift_;
 	nveccol_ = ncol;
-	colstride_ = nvecPerCol_ * nvecPerCell_;
-	rowstride_ = nvecPerCell_;
+	colstride_ = nvecPerCol_ * nvecPerCell_ * vecw_;
+	rowstride_ = nvecPerCell_ * vecw_;
 	inited_ = true;
 }
 
@@ -78,8 +79,8 @@ int SSEMatrix::eltSlow(size_t row, size_t col, size_t mat) const {
 	// Move to beginning of column/row
 	size_t rowelt = row / nvecrow_;
 	size_t rowvec = row % nvecrow_;
-	size_t eltvec = (col * colstride_) + (rowvec * rowstride_) + mat;
-	if(wperv_ == 16) {
+	size_t eltvec = (col * colstride_) + (rowvec * rowstride_) + mat * vecw_;
+	if(wperv_ == 16 || wperv_ == 32) {
 		return (int)((uint8_t*)(matbuf_.ptr() + eltvec))[rowelt];
 	} else {
 		assert_eq(8, wperv_);
@@ -90,6 +90,9 @@ struct SSEMetrics {
  *   determined by the number of query characters divided by the number of
  *   elements per vector
  *
+ * When the matrix is filled by the 256-bit AVX2 kernel, each vector spans two
+ * consecutive __m128i's (vecw_ == 2), so a quartet is eight __m128i's long.
+ *
  * Regarding the "reserved" element of the vector quartet: we use it for two
  * things.  First, we use the first column of reserved vectors to stage the
  * initial column of H vectors.  Second, we use the "reserved" vectors during
@@ -122,7 +125,7 @@ struct SSEMatrix {
 	inline __m128i* evec(size_t row, size_t col) {
 		assert_lt(row, nvecrow_);
 		assert_lt(col, nveccol_);
-		size_t elt = row * rowstride() + col * colstride() + E;
+		size_t elt = row * rowstride() + col * colstride() + E * vecw_;
 		assert_lt(elt, matbuf_.size());
 		return ptr() + elt;
 	}
@@ -134,7 +137,7 @@ struct SSEMatrix {
 	inline __m128i* evecUnsafe(size_t row, size_t col) {
 		assert_lt(row, nvecrow_);
 		assert_leq(col, nveccol_);
-		size_t elt = row * rowstride() + col * colstride() + E;
+		size_t elt = row * rowstride() + col * colstride() + E * vecw_;
 		assert_lt(elt, matbuf_.size());
 		return ptr() + elt;
 	}
@@ -146,7 +149,7 @@ struct SSEMatrix {
 	inline __m128i* fvec(size_t row, size_t col) {
 		assert_lt(row, nvecrow_);
 		assert_lt(col, nveccol_);
-		size_t elt = row * rowstride() + col * colstride() + F;
+		size_t elt = row * rowstride() + col * colstride() + F * vecw_;
 		assert_lt(elt, matbuf_.size());
 		return ptr() + elt;
 	}
@@ -158,7 +161,7 @@ struct SSEMatrix {
 	inline __m128i* hvec(size_t row, size_t col) {
 		assert_lt(row, nvecrow_);
 		assert_lt(col, nveccol_);
-		size_t elt = row * rowstride() + col * colstride() + H;
+		size_t elt = row * rowstride() + col * colstride() + H * vecw_;
 		assert_lt(elt, matbuf_.size());
 		return ptr() + elt;
 	}
@@ -170,7 +173,7 @@ struct SSEMatrix {
 	inline __m128i* tmpvec(size_t row, size_t col) {
 		assert_lt(row, nvecrow_);
 		assert_lt(col, nveccol_);
-		size_t elt = row * rowstride() + col * colstride() + TMP;
+		size_t elt = row * rowstride() + col * colstride() + TMP * vecw_;
 		assert_lt(elt, matbuf_.size());
 		return ptr() + elt;
 	}
@@ -182,15 +185,16 @@ struct SSEMatrix {
 	inline __m128i* tmpvecUnsafe(size_t row, size_t col) {
 		assert_lt(row, nvecrow_);
 		assert_leq(col, nveccol_);
-		size_t elt = row * rowstride() + col * colstride() + TMP;
+		size_t elt = row * rowstride() + col * colstride() + TMP * vecw_;
 		assert_lt(elt, matbuf_.size());
 		return ptr() + elt;
 	}
 	
 	/**
 	 * Given a number of rows (nrow), a number of columns (ncol), and the
-	 * number of words to fit inside a single __m128i vector, initialize the
-	 * matrix buffer to accomodate the needed configuration of vectors.
+	 * number of words to fit inside a single vector (32 for 8-bit words in a
+	 * 256-bit vector), initialize the matrix buffer to accomodate the needed
+	 * configuration of vectors.
 	 */
 	void init(
 		size_t nrow,
@@ -227,9 +231,9 @@ struct SSEMatrix {
 		// Move to beginning of column/row
 		size_t rowelt = row / nvecrow_;
 		size_t rowvec = row % nvecrow_;
-		size_t eltvec = (col * colstride_) + (rowvec * rowstride_) + mat;
+		size_t eltvec = (col * colstride_) + (rowvec * rowstride_) + mat * vecw_;
 		assert_lt(eltvec, matbuf_.size());
-		if(wperv_ == 16) {
+		if(wperv_ == 16 || wperv_ == 32) {
 			return (int)((uint8_t*)(matbuf_.ptr() + eltvec))[rowelt];
 		} else {
 			assert_eq(8, wperv_);
@@ -391,6 +395,7 @@ struct SSEMatrix {
 	size_t           nvecrow_;     // # vector rows (<= nrow_)
 	size_t           nveccol_;     // # vector columns (<= ncol_)
 	size_t           wperv_;       // # words per vector
+	size_t           vecw_;        // # __m128i's per vector (2 for 256-bit)
 	size_t           vecshift_;    // # bits to shift to divide by words per vec
 	size_t           nvecPerCol_;  // # vectors per column
 	size_t           nvecPerCell_; // # vectors per matrix cell (4)
@@ -406,8 +411,9 @@ struct SSEMatrix {
  * alignment of a query.
  */
 struct SSEData {
-	SSEData(int cat = 0) : profbuf_(cat), mat_(cat) { }
+	SSEData(int cat = 0) : profbuf_(cat), profbuf256_(cat), mat_(cat) { }
 	EList_m128i    profbuf_;     // buffer for query profile & temp vecs
+	EList_m128i    profbuf256_;  // buffer for 256-bit (AVX2) query profile
 	EList_m128i    vecbuf_;      // buffer for 2 column vectors (not using mat_)
 	size_t         qprofStride_; // stride for query profile
 	size_t         gbarStride_;  // gap barrier for query profile
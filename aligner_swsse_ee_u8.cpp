@@ -54,6 +54,9 @@
 
 #include <limits>
 #include "aligner_sw.h"
+#ifdef AVX2_CAPABILITY
+#include <immintrin.h>
+#endif
 
 static const size_t NBYTES_PER_REG  = 16;
 static const size_t NWORDS_PER_REG  = 16;
@@ -1171,6 +1174,386 @@ TAlScore SwAligner::alignNucleotidesEnd2EndSseU8(int& flag, bool debug) {
 	return score;
 }
 
+#ifdef AVX2_CAPABILITY
+
+// The 256-bit kernels are compiled for AVX2 regardless of the global -m flags
+// and are only ever called after ProcessorSupport::AVX2enabled() says so.
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+static const size_t NWORDS_PER_REG_256 = 32;
+
+/**
+ * Shift a 256-bit vector up by one byte across the lane boundary, shifting in
+ * a zero at the bottom; the 256-bit equivalent of
+ * _mm_slli_si128(v, NBYTES_PER_WORD).
+ */
+AVX2_TARGET static inline __m256i avx2SlliWord(__m256i v) {
+	return _mm256_alignr_epi8(v, _mm256_permute2x128_si256(v, v, 0x08), 15);
+}
+
+/**
+ * Build 256-bit query profile look up tables for the read.  Same as
+ * buildQueryProfileEnd2EndSseU8, but the query is striped across 32 words per
+ * vector and each vector spans two consecutive __m128i's of profbuf256_.
+ */
+void SwAligner::buildQueryProfileEnd2EndAvx2U8(bool fw) {
+	bool& done = fw ? avx2U8fwBuilt_ : avx2U8rcBuilt_;
+	if(done) {
+		return;
+	}
+	done = true;
+	const BTDnaString* rd = fw ? rdfw_ : rdrc_;
+	const BTString* qu = fw ? qufw_ : qurc_;
+	const size_t len = dpRows();
+	const size_t seglen = (len + (NWORDS_PER_REG_256-1)) / NWORDS_PER_REG_256;
+	// How many __m128i's are needed
+	size_t n128s =
+		64 +                    // slack bytes, for alignment?
+		(seglen * ALPHA_SIZE)   // query profile data
+		* 2                     // & gap barrier data
+		* 2;                    // two __m128i's per 256-bit vector
+	assert_gt(n128s, 0);
+	SSEData& d = fw ? sseU8fw_ : sseU8rc_;
+	d.profbuf256_.resizeNoCopy(n128s);
+	assert(!d.profbuf256_.empty());
+	// For each reference character A, C, G, T, N ...
+	for(size_t refc = 0; refc < ALPHA_SIZE; refc++) {
+		// For each segment ...
+		for(size_t i = 0; i < seglen; i++) {
+			size_t j = i;
+			uint8_t *qprofWords =
+				reinterpret_cast<uint8_t*>(d.profbuf256_.ptr() + ((refc * seglen * 2) + (i * 2)) * 2);
+			uint8_t *gbarWords =
+				reinterpret_cast<uint8_t*>(d.profbuf256_.ptr() + ((refc * seglen * 2) + (i * 2) + 1) * 2);
+			// For each sub-word (byte) ...
+			for(size_t k = 0; k < NWORDS_PER_REG_256; k++) {
+				int sc = 0;
+				*gbarWords = 0;
+				if(j < len) {
+					int readc = (*rd)[j];
+					int readq = (*qu)[j];
+					sc = sc_->score(readc, (int)(1 << refc), readq - 33);
+					// Make score positive, to fit in an unsigned
+					sc = -sc;
+					assert_range(0, 255, sc);
+					size_t j_from_end = len - j - 1;
+					if(j < (size_t)sc_->gapbar ||
+					   j_from_end < (size_t)sc_->gapbar)
+					{
+						// Inside the gap barrier
+						*gbarWords = 0xff;
+					}
+				}
+				*qprofWords = (uint8_t)sc;
+				gbarWords++;
+				qprofWords++;
+				j += seglen; // update offset into query
+			}
+		}
+	}
+}
+
+/**
+ * Solve the current alignment problem using AVX2 instructions that operate on
+ * 32 unsigned 8-bit values packed into a single 256-bit register.  This is a
+ * transliteration of alignNucleotidesEnd2EndSseU8; the E, F and H values it
+ * leaves in d.mat_ are identical, only striped 32 rather than 16 ways, so the
+ * same gather and backtrace routines work on either.
+ */
+AVX2_TARGET
+TAlScore SwAligner::alignNucleotidesEnd2EndAvx2U8(int& flag, bool debug) {
+	assert_leq(rdf_, rd_->length());
+	assert_leq(rdf_, qu_->length());
+	assert_lt(rfi_, rff_);
+	assert_lt(rdi_, rdf_);
+	assert_eq(rd_->length(), qu_->length());
+	assert_geq(sc_->gapbar, 1);
+	assert(repOk());
+#ifndef NDEBUG
+	for(size_t i = (size_t)rfi_; i < (size_t)rff_; i++) {
+		assert_range(0, 16, (int)rf_[i]);
+	}
+#endif
+
+	SSEData& d = fw_ ? sseU8fw_ : sseU8rc_;
+	SSEMetrics& met = extend_ ? sseU8ExtendMet_ : sseU8MateMet_;
+	if(!debug) met.dp++;
+	buildQueryProfileEnd2EndAvx2U8(fw_);
+	assert(!d.profbuf256_.empty());
+
+	size_t iter =
+		(dpRows() + (NWORDS_PER_REG_256-1)) / NWORDS_PER_REG_256; // iter = segLen
+
+	assert_gt(sc_->refGapOpen(), 0);
+	assert_leq(sc_->refGapOpen(), MAX_U8);
+	assert_gt(sc_->refGapExtend(), 0);
+	assert_leq(sc_->refGapExtend(), MAX_U8);
+	assert_leq(sc_->refGapExtend(), sc_->refGapOpen());
+	assert_gt(sc_->readGapOpen(), 0);
+	assert_leq(sc_->readGapOpen(), MAX_U8);
+	assert_gt(sc_->readGapExtend(), 0);
+	assert_leq(sc_->readGapExtend(), MAX_U8);
+	assert_leq(sc_->readGapExtend(), sc_->readGapOpen());
+	const __m256i rfgapo = _mm256_set1_epi8((char)sc_->refGapOpen());
+	const __m256i rfgape = _mm256_set1_epi8((char)sc_->refGapExtend());
+	const __m256i rdgapo = _mm256_set1_epi8((char)sc_->readGapOpen());
+	const __m256i rdgape = _mm256_set1_epi8((char)sc_->readGapExtend());
+	const __m256i vlo    = _mm256_setzero_si256();
+	const __m256i vzero  = _mm256_setzero_si256();
+	// vhilsw: topmost (least sig) word set to 0xff, all other words=0
+	const __m256i vhilsw = _mm256_set_epi64x(0, 0, 0, 0xff);
+	__m256i ve, vf, vh, vtmp;
+
+	// Each element of the profile is two __m128i's, so index it as __m256i's
+	const __m256i *pvScore; // points into the query profile
+	const __m256i *prof = reinterpret_cast<const __m256i*>(d.profbuf256_.ptr());
+
+	d.mat_.init(dpRows(), rff_ - rfi_, NWORDS_PER_REG_256);
+	// Strides in units of __m256i
+	const size_t colstride = d.mat_.colstride() / 2;
+	assert_eq(ROWSTRIDE, colstride / iter);
+
+	// Initialize the H and E vectors in the first matrix column
+	__m256i *pvHTmp = reinterpret_cast<__m256i*>(d.mat_.tmpvec(0, 0));
+	__m256i *pvETmp = reinterpret_cast<__m256i*>(d.mat_.evec(0, 0));
+
+	// Maximum score in final row
+	bool found = false;
+	TCScore lrmax = MIN_U8;
+	const size_t lastIter = (dpRows() - 1) % iter;
+	const size_t lastWord = (dpRows() - 1) / iter;
+
+	for(size_t i = 0; i < iter; i++) {
+		_mm256_store_si256(pvETmp, vlo);
+		_mm256_store_si256(pvHTmp, vlo); // start high in end-to-end mode
+		pvETmp += ROWSTRIDE;
+		pvHTmp += ROWSTRIDE;
+	}
+	// These are swapped just before the innermost loop
+	__m256i *pvHStore = reinterpret_cast<__m256i*>(d.mat_.hvec(0, 0));
+	__m256i *pvHLoad  = reinterpret_cast<__m256i*>(d.mat_.tmpvec(0, 0));
+	__m256i *pvELoad  = reinterpret_cast<__m256i*>(d.mat_.evec(0, 0));
+	__m256i *pvEStore = reinterpret_cast<__m256i*>(d.mat_.evecUnsafe(0, 1));
+	__m256i *pvFStore = reinterpret_cast<__m256i*>(d.mat_.fvec(0, 0));
+	__m256i *pvFTmp   = NULL;
+
+	assert_gt(sc_->gapbar, 0);
+	size_t nfixup = 0;
+
+	colstop_ = rff_ - 1;
+	lastsolcol_ = 0;
+
+	for(size_t i = (size_t)rfi_; i < (size_t)rff_; i++) {
+		assert(pvFStore == reinterpret_cast<__m256i*>(d.mat_.fvec(0, i - rfi_)));
+		assert(pvHStore == reinterpret_cast<__m256i*>(d.mat_.hvec(0, i - rfi_)));
+
+		// Fetch the appropriate query profile.  Note that elements of rf_ must
+		// be numbers, not masks.
+		const int refc = (int)rf_[i];
+		size_t off = (size_t)firsts5[refc] * iter * 2;
+		pvScore = prof + off; // even elts = query profile, odd = gap barrier
+
+		// Set all cells to low value
+		vf = _mm256_setzero_si256();
+
+		// Load H vector from the final row of the previous column
+		vh = _mm256_load_si256(pvHLoad + colstride - ROWSTRIDE);
+		// Shift 1 byte down so that topmost (least sig) cell gets 0
+		vh = avx2SlliWord(vh);
+		// Fill topmost (least sig) cell with high value
+		vh = _mm256_or_si256(vh, vhilsw);
+
+		// For each character in the reference text:
+		size_t j;
+		for(j = 0; j < iter; j++) {
+			// Load cells from E, calculated previously
+			ve = _mm256_load_si256(pvELoad);
+			pvELoad += ROWSTRIDE;
+
+			// Store cells in F, calculated previously
+			vf = _mm256_subs_epu8(vf, _mm256_load_si256(pvScore + 1)); // veto some ref gap extensions
+			_mm256_store_si256(pvFStore, vf);
+			pvFStore += ROWSTRIDE;
+
+			// Factor in query profile (matches and mismatches)
+			vh = _mm256_subs_epu8(vh, _mm256_load_si256(pvScore));
+
+			// Update H, factoring in E and F
+			vh = _mm256_max_epu8(vh, ve);
+			vh = _mm256_max_epu8(vh, vf);
+
+			// Save the new vH values
+			_mm256_store_si256(pvHStore, vh);
+			pvHStore += ROWSTRIDE;
+
+			// Update vE value
+			vtmp = vh;
+			vh = _mm256_subs_epu8(vh, rdgapo);
+			vh = _mm256_subs_epu8(vh, _mm256_load_si256(pvScore + 1)); // veto some read gap opens
+			ve = _mm256_subs_epu8(ve, rdgape);
+			ve = _mm256_max_epu8(ve, vh);
+
+			// Load the next h value
+			vh = _mm256_load_si256(pvHLoad);
+			pvHLoad += ROWSTRIDE;
+
+			// Save E values
+			_mm256_store_si256(pvEStore, ve);
+			pvEStore += ROWSTRIDE;
+
+			// Update vf value
+			vtmp = _mm256_subs_epu8(vtmp, rfgapo);
+			vf = _mm256_subs_epu8(vf, rfgape);
+			vf = _mm256_max_epu8(vf, vtmp);
+
+			pvScore += 2; // move on to next query profile / gap veto
+		}
+		// pvHStore, pvELoad, pvEStore have all rolled over to the next column
+		pvFTmp = pvFStore;
+		pvFStore -= colstride; // reset to start of column
+		vtmp = _mm256_load_si256(pvFStore);
+
+		pvHStore -= colstride; // reset to start of column
+		vh = _mm256_load_si256(pvHStore);
+
+		pvEStore -= colstride; // reset to start of column
+		ve = _mm256_load_si256(pvEStore);
+
+		pvHLoad = pvHStore;    // new pvHLoad = pvHStore
+		pvScore = prof + off + 1; // reset veto vector
+
+		// vf from last row gets shifted down by one to overlay the first row
+		// rfgape has already been subtracted from it.
+		vf = avx2SlliWord(vf);
+
+		vf = _mm256_subs_epu8(vf, _mm256_load_si256(pvScore)); // veto some ref gap extensions
+		vf = _mm256_max_epu8(vtmp, vf);
+		vtmp = _mm256_subs_epu8(vf, vtmp);
+		vtmp = _mm256_cmpeq_epi8(vtmp, vzero);
+		int cmp = _mm256_movemask_epi8(vtmp);
+
+		// If any element of vtmp is greater than H - gap-open...
+		j = 0;
+		while(cmp != -1) {
+			// Store this vf
+			_mm256_store_si256(pvFStore, vf);
+			pvFStore += ROWSTRIDE;
+
+			// Update vh w/r/t new vf
+			vh = _mm256_max_epu8(vh, vf);
+
+			// Save vH values
+			_mm256_store_si256(pvHStore, vh);
+			pvHStore += ROWSTRIDE;
+
+			// Update E in case it can be improved using our new vh
+			vh = _mm256_subs_epu8(vh, rdgapo);
+			vh = _mm256_subs_epu8(vh, _mm256_load_si256(pvScore)); // veto some read gap opens
+			ve = _mm256_max_epu8(ve, vh);
+			_mm256_store_si256(pvEStore, ve);
+			pvEStore += ROWSTRIDE;
+			pvScore += 2;
+
+			assert_lt(j, iter);
+			if(++j == iter) {
+				pvFStore -= colstride;
+				vtmp = _mm256_load_si256(pvFStore);   // load next vf ASAP
+				pvHStore -= colstride;
+				vh = _mm256_load_si256(pvHStore);     // load next vh ASAP
+				pvEStore -= colstride;
+				ve = _mm256_load_si256(pvEStore);     // load next ve ASAP
+				pvScore = prof + off + 1;
+				j = 0;
+				vf = avx2SlliWord(vf);
+			} else {
+				vtmp = _mm256_load_si256(pvFStore);   // load next vf ASAP
+				vh = _mm256_load_si256(pvHStore);     // load next vh ASAP
+				ve = _mm256_load_si256(pvEStore);     // load next ve ASAP
+			}
+
+			// Update F with another gap extension
+			vf = _mm256_subs_epu8(vf, rfgape);
+			vf = _mm256_subs_epu8(vf, _mm256_load_si256(pvScore)); // veto some ref gap extensions
+			vf = _mm256_max_epu8(vtmp, vf);
+			vtmp = _mm256_subs_epu8(vf, vtmp);
+			vtmp = _mm256_cmpeq_epi8(vtmp, vzero);
+			cmp = _mm256_movemask_epi8(vtmp);
+			nfixup++;
+		}
+
+#ifndef NDEBUG
+		if(true && (rand() & 15) == 0) {
+			// This is a work-intensive sanity check; each time we finish filling
+			// a column, we check that each H, E, and F is sensible.
+			for(size_t k = 0; k < dpRows(); k++) {
+				assert(cellOkEnd2EndU8(
+					d,
+					k,                   // row
+					i - rfi_,            // col
+					refc,                // reference mask
+					(int)(*rd_)[rdi_+k], // read char
+					(int)(*qu_)[rdi_+k], // read quality
+					*sc_));              // scoring scheme
+			}
+		}
+#endif
+
+		__m128i *vlast = d.mat_.hvec(lastIter, i-rfi_);
+		// Note: we may not want to extract from the final row
+		TCScore lr = ((TCScore*)(vlast))[lastWord];
+		found = true;
+		if(lr > lrmax) {
+			lrmax = lr;
+		}
+
+		// pvELoad and pvHLoad are already where they need to be
+
+		// Adjust the load and store vectors here.
+		pvHStore = pvHLoad + colstride;
+		pvEStore = pvELoad + colstride;
+		pvFStore = pvFTmp;
+	}
+
+	// Update metrics
+	if(!debug) {
+		size_t ninner = (rff_ - rfi_) * iter;
+		met.col   += (rff_ - rfi_);                 // DP columns
+		met.cell  += (ninner * NWORDS_PER_REG_256); // DP cells
+		met.inner += ninner;                        // DP inner loop iters
+		met.fixup += nfixup;                        // DP fixup loop iters
+	}
+
+	flag = 0;
+
+	// Did we find a solution?
+	TAlScore score = MIN_I64;
+	if(!found) {
+		flag = -1; // no
+		if(!debug) met.dpfail++;
+		return MIN_I64;
+	} else {
+		score = (TAlScore)(lrmax - 0xff);
+		if(score < minsc_) {
+			flag = -1; // no
+			if(!debug) met.dpfail++;
+			return score;
+		}
+	}
+
+	// Could we have saturated?
+	if(lrmax == MIN_U8) {
+		flag = -2; // yes
+		if(!debug) met.dpsat++;
+		return MIN_I64;
+	}
+
+	// Return largest score
+	if(!debug) met.dpsucc++;
+	return score;
+}
+
+#endif /*def AVX2_CAPABILITY*/
+
 /**
  * Given a filled-in DP table, populate the btncand_ list with candidate cells
  * that might be at the ends of valid alignments.  No need to do this unless
@@ -1213,9 +1596,13 @@ bool SwAligner::gatherCellsNucleotidesEnd2EndSseU8(TAlScore best) {
 	assert(!d.profbuf_.empty());
 	const size_t colstride = d.mat_.colstride();
 	ASSERT_ONLY(bool sawbest = false);
-	__m128i *pvH = d.mat_.hvec(d.lastIter_, 0);
+	// Locate the final row using the matrix's own striping, since the matrix
+	// may have been filled by either the 128-bit or the 256-bit kernel
+	const size_t lastIter = (nrow - 1) % d.mat_.nvecrow_;
+	const size_t lastWord = (nrow - 1) / d.mat_.nvecrow_;
+	__m128i *pvH = d.mat_.hvec(lastIter, 0);
 	for(size_t j = 0; j < ncol; j++) {
-		TAlScore sc = (TAlScore)(((TCScore*)pvH)[d.lastWord_] - 0xff);
+		TAlScore sc = (TAlScore)(((TCScore*)pvH)[lastWord] - 0xff);
 		assert_leq(sc, best);
 		ASSERT_ONLY(sawbest = (sawbest || sc == best));
 		if(sc >= minsc_) {
@@ -1240,7 +1627,7 @@ bool SwAligner::gatherCellsNucleotidesEnd2EndSseU8(TAlScore best) {
 		rowelt--; \
 	} \
 	rowvec--; \
-	vec -= ROWSTRIDE; \
+	vec -= d.mat_.rowstride_; \
 }
 
 #define MOVE_VEC_PTR_LEFT(vec, rowvec, rowelt) { vec -= d.mat_.colstride_; }
@@ -1274,7 +1661,7 @@ bool SwAligner::gatherCellsNucleotidesEnd2EndSseU8(TAlScore best) {
 #define NEW_ROW_COL(row, col) { \
 	rowelt = row / d.mat_.nvecrow_; \
 	rowvec = row % d.mat_.nvecrow_; \
-	eltvec = (col * d.mat_.colstride_) + (rowvec * ROWSTRIDE); \
+	eltvec = (col * d.mat_.colstride_) + (rowvec * d.mat_.rowstride_); \
 	cur_vec = d.mat_.matbuf_.ptr() + eltvec; \
 	left_vec = cur_vec; \
 	left_rowelt = rowelt; \
@@ -1340,6 +1727,7 @@ bool SwAligner::backtraceNucleotidesEnd2EndSseU8(
 	size_t left_rowelt, up_rowelt, upleft_rowelt;
 	size_t left_rowvec, up_rowvec, upleft_rowvec;
 	__m128i *cur_vec, *left_vec, *up_vec, *upleft_vec;
+	const size_t vecw = d.mat_.vecw_; // # __m128i's per vector
 	NEW_ROW_COL(row, col);
 	while((int)row >= 0) {
 		met.btcell++;
@@ -1374,7 +1762,7 @@ bool SwAligner::backtraceNucleotidesEnd2EndSseU8(
 				// Move to beginning of column/row
 				if(ct == SSEMatrix::E) { // AKA rdgap
 					assert_gt(col, 0);
-					TAlScore sc_cur = ((TCScore*)(cur_vec + SSEMatrix::E))[rowelt] + offsetsc;
+					TAlScore sc_cur = ((TCScore*)(cur_vec + SSEMatrix::E * vecw))[rowelt] + offsetsc;
 					assert(gapsAllowed);
 					// Currently in the E matrix; incoming transition must come from the
 					// left.  It's either a gap open from the H matrix or a gap extend from
@@ -1382,12 +1770,12 @@ bool SwAligner::backtraceNucleotidesEnd2EndSseU8(
 					// TODO: save and restore origMask as well as mask
 					int origMask = 0, mask = 0;
 					// Get H score of cell to the left
-					TAlScore sc_h_left = ((TCScore*)(left_vec + SSEMatrix::H))[left_rowelt] + offsetsc;
+					TAlScore sc_h_left = ((TCScore*)(left_vec + SSEMatrix::H * vecw))[left_rowelt] + offsetsc;
 					if(sc_h_left > floorsc && sc_h_left - sc_->readGapOpen() == sc_cur) {
 						mask |= (1 << 0);
 					}
 					// Get E score of cell to the left
-					TAlScore sc_e_left = ((TCScore*)(left_vec + SSEMatrix::E))[left_rowelt] + offsetsc;
+					TAlScore sc_e_left = ((TCScore*)(left_vec + SSEMatrix::E * vecw))[left_rowelt] + offsetsc;
 					if(sc_e_left > floorsc && sc_e_left - sc_->readGapExtend() == sc_cur) {
 						mask |= (1 << 1);
 					}
@@ -1433,9 +1821,9 @@ bool SwAligner::backtraceNucleotidesEnd2EndSseU8(
 				} else if(ct == SSEMatrix::F) { // AKA rfgap
 					assert_gt(row, 0);
 					assert(gapsAllowed);
-					TAlScore sc_h_up = ((TCScore*)(up_vec  + SSEMatrix::H))[up_rowelt] + offsetsc;
-					TAlScore sc_f_up = ((TCScore*)(up_vec  + SSEMatrix::F))[up_rowelt] + offsetsc;
-					TAlScore sc_cur  = ((TCScore*)(cur_vec + SSEMatrix::F))[rowelt] + offsetsc;
+					TAlScore sc_h_up = ((TCScore*)(up_vec  + SSEMatrix::H * vecw))[up_rowelt] + offsetsc;
+					TAlScore sc_f_up = ((TCScore*)(up_vec  + SSEMatrix::F * vecw))[up_rowelt] + offsetsc;
+					TAlScore sc_cur  = ((TCScore*)(cur_vec + SSEMatrix::F * vecw))[rowelt] + offsetsc;
 					// Currently in the F matrix; incoming transition must come from above.
 					// It's either a gap open from the H matrix or a gap extend from the F
 					// matrix.
@@ -1490,12 +1878,12 @@ bool SwAligner::backtraceNucleotidesEnd2EndSseU8(
 					assert(!empty || !canMoveThru);
 				} else {
 					assert_eq(SSEMatrix::H, ct);
-					TAlScore sc_cur      = ((TCScore*)(cur_vec + SSEMatrix::H))[rowelt]    + offsetsc;
-					TAlScore sc_f_up     = ((TCScore*)(up_vec  + SSEMatrix::F))[up_rowelt] + offsetsc;
-					TAlScore sc_h_up     = ((TCScore*)(up_vec  + SSEMatrix::H))[up_rowelt] + offsetsc;
-					TAlScore sc_h_left   = col > 0 ? (((TCScore*)(left_vec   + SSEMatrix::H))[left_rowelt]   + offsetsc) : floorsc;
-					TAlScore sc_e_left   = col > 0 ? (((TCScore*)(left_vec   + SSEMatrix::E))[left_rowelt]   + offsetsc) : floorsc;
-					TAlScore sc_h_upleft = col > 0 ? (((TCScore*)(upleft_vec + SSEMatrix::H))[upleft_rowelt] + offsetsc) : floorsc;
+					TAlScore sc_cur      = ((TCScore*)(cur_vec + SSEMatrix::H * vecw))[rowelt]    + offsetsc;
+					TAlScore sc_f_up     = ((TCScore*)(up_vec  + SSEMatrix::F * vecw))[up_rowelt] + offsetsc;
+					TAlScore sc_h_up     = ((TCScore*)(up_vec  + SSEMatrix::H * vecw))[up_rowelt] + offsetsc;
+					TAlScore sc_h_left   = col > 0 ? (((TCScore*)(left_vec   + SSEMatrix::H * vecw))[left_rowelt]   + offsetsc) : floorsc;
+					TAlScore sc_e_left   = col > 0 ? (((TCScore*)(left_vec   + SSEMatrix::E * vecw))[left_rowelt]   + offsetsc) : floorsc;
+					TAlScore sc_h_upleft = col > 0 ? (((TCScore*)(upleft_vec + SSEMatrix::H * vecw))[upleft_rowelt] + offsetsc) : floorsc;
 					TAlScore sc_diag     = sc_->score(readc, refm, readq - 33);
 					// TODO: save and restore origMask as well as mask
 					int origMask = 0, mask = 0;
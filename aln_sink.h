@@ -57,6 +57,9 @@ struct ReportingMetrics {
 
 	void reset() {
 		init(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+		nplan_a_first = nplan_b_first = 0;
+		nskip_b = nskip_a = 0;
+		nbudget = 0;
 	}
 
 	void init(
@@ -165,6 +168,13 @@ struct ReportingMetrics {
 		sum_best1     += met.sum_best1;
 		sum_best2     += met.sum_best2;
 		sum_best      += met.sum_best;
+
+		nplan_a_first += met.nplan_a_first;
+		nplan_b_first += met.nplan_b_first;
+		nskip_b       += met.nskip_b;
+		nskip_a       += met.nskip_a;
+
+		nbudget       += met.nbudget;
 	}
 
 	uint64_t  nread;         // # reads
@@ -209,6 +219,14 @@ struct ReportingMetrics {
 	uint64_t  sum_best2;     // Sum of all the second-best alignment scores
 	uint64_t  sum_best;      // Sum of all the best and second-best
 
+	// Plan scheduling (--plan-skip)
+	uint64_t  nplan_a_first; // # reads/pairs aligned with plan A first
+	uint64_t  nplan_b_first; // # reads/pairs aligned with plan B first
+	uint64_t  nskip_b;       // # of those where plan A made plan B unnecessary
+	uint64_t  nskip_a;       // # of those where plan B made plan A unnecessary
+
+	uint64_t  nbudget;       // # reads/pairs that ran out of work budget
+
 	MUTEX_T mutex_m;
 };
 
@@ -1395,6 +1413,18 @@ public:
     void getUnp2(const EList<AlnRes>*& rs) const { rs = &rs2u_; }
     void getPair(const EList<AlnRes>*& rs1, const EList<AlnRes>*& rs2) const { rs1 = &rs1_; rs2 = &rs2_; }
     
+    /**
+     * Return which list each report() call since nextRead() added to, in
+     * order: REPORTED_PAIR, REPORTED_UNP1 or REPORTED_UNP2.
+     */
+    const EList<int>& reportOrder() const { return reported_; }
+    
+    enum {
+        REPORTED_PAIR = 0,
+        REPORTED_UNP1,
+        REPORTED_UNP2
+    };
+    
     index_t numUnp1() const { return rs1u_.size(); }
     index_t numUnp2() const { return rs2u_.size(); }
     index_t numPair() const { assert_eq(rs1_.size(), rs2_.size()); return rs1_.size(); }
@@ -1607,6 +1637,7 @@ protected:
 	EList<size_t>     select1_; // parallel to rs1_/rs2_ - which to report
 	EList<size_t>     select2_; // parallel to rs1_/rs2_ - which to report
 	ReportingState    st_;      // reporting state - what's left to do?
+	EList<int>        reported_; // list each report() added to, in order
 	
 	EList<std::pair<TAlScore, size_t> > selectBuf_;
 	BTString obuf_;
@@ -1923,6 +1954,19 @@ void AlnSink<index_t>::printAlSumm(
         printPct(out, tot_al, tot_al_cand);
         out << " overall alignment rate" << endl;
     }
+    if(met.nplan_a_first + met.nplan_b_first > 0) {
+        out << met.nplan_a_first << " reads aligned with plan A first; of these:" << endl;
+        out << "  " << met.nskip_b << " (";
+        printPct(out, met.nskip_b, met.nplan_a_first);
+        out << ") skipped plan B" << endl;
+        out << met.nplan_b_first << " reads aligned with plan B first; of these:" << endl;
+        out << "  " << met.nskip_a << " (";
+        printPct(out, met.nskip_a, met.nplan_b_first);
+        out << ") skipped plan A" << endl;
+    }
+    if(met.nbudget > 0) {
+        out << met.nbudget << " reads ran out of their work budget" << endl;
+    }
 }
 
 /**
@@ -2015,6 +2059,7 @@ int AlnSinkWrap<index_t>::nextRead(
 	rs2_.clear();     // clear out paired-end alignments
 	rs1u_.clear();    // clear out unpaired alignments for mate #1
 	rs2u_.clear();    // clear out unpaired alignments for mate #2
+	reported_.clear();
 	st_.nextRead(readIsPair()); // reset state
 	assert(empty());
 	assert(!maxed());
@@ -2700,12 +2745,15 @@ bool AlnSinkWrap<index_t>::report(
 		st_.foundConcordant(score);
 		rs1_.push_back(*rs1);
 		rs2_.push_back(*rs2);
+		reported_.push_back(REPORTED_PAIR);
 	} else {
         st_.foundUnpaired(one, rsa->repeat());
 		if(one) {
 			rs1u_.push_back(*rs1);
+			reported_.push_back(REPORTED_UNP1);
   		} else {
 			rs2u_.push_back(*rs2);
+			reported_.push_back(REPORTED_UNP2);
 		}
 	}
 	
@@ -0,0 +1,365 @@
+/*
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of HISAT 2.
+ *
+ * HISAT 2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HISAT 2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HISAT 2.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ALT_READER_H_
+#define ALT_READER_H_
+
+#include <stdint.h>
+#include <sys/stat.h>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <limits>
+#include <map>
+#include "assert_helpers.h"
+#include "alphabet.h"
+#include "ds.h"
+#include "alt.h"
+#include "ref_read.h"
+#include "threading.h"
+
+using namespace std;
+
+/**
+ * Where the chromosomes of a reference lie in its joined string, for
+ * turning the chromosome:position of a variant into a joined offset.
+ */
+template <typename index_t>
+struct AltRefCoords {
+    const map<string, index_t>*           chr2idx;  // name up to the first space -> chr
+    const EList<pair<index_t, index_t> >* chr_szs;  // chr -> (joined offset, first szs record)
+    const EList<RefRecord>*               szs;
+    index_t                               jlen;
+};
+
+/**
+ * Parameters and results of one thread's share of a SNP file: the lines
+ * that start in bytes [from, to).
+ */
+template <typename index_t, typename TStr>
+struct SNPSliceParam {
+    const string*               fname;
+    uint64_t                    from;
+    uint64_t                    to;
+    const AltRefCoords<index_t>* coords;
+    const TStr*                 s;
+    EList<ALT<index_t> >        alts;
+    EList<string>               names;
+    string                      warnings;  // printed once all threads are done
+    string                      error;     // non-empty if the slice could not be parsed
+};
+
+/**
+ * Parse the SNPs of one slice of a SNP file, dropping those that fall in
+ * or next to stretches of Ns or that don't match the reference, exactly
+ * as a single pass over the whole file would.
+ */
+template <typename index_t, typename TStr>
+static void snpSlice_worker(void *vp) {
+    SNPSliceParam<index_t, TStr>* p = (SNPSliceParam<index_t, TStr>*)vp;
+    const map<string, index_t>& chr2idx = *p->coords->chr2idx;
+    const EList<pair<index_t, index_t> >& chr_szs = *p->coords->chr_szs;
+    const EList<RefRecord>& szs = *p->coords->szs;
+    const index_t jlen = p->coords->jlen;
+    const TStr& s = *p->s;
+    ifstream snp_file(p->fname->c_str(), ios::in);
+    if(!snp_file.is_open()) {
+        p->error = "Error: could not open " + *p->fname;
+        return;
+    }
+    uint64_t off = p->from;
+    string line;
+    if(off > 0) {
+        // Skip the rest of the line that straddles 'from'; its owner is
+        // the previous slice
+        snp_file.seekg((streamoff)(off - 1));
+        getline(snp_file, line);
+        off += line.length();
+    }
+    ostringstream warnings;
+    istringstream ls;
+    while(off < p->to && getline(snp_file, line)) {
+        off += line.length() + 1;
+        // rs73387790	single	22:20000001-21000000	145	A
+        ls.clear();
+        ls.str(line);
+        string snp_id;
+        ls >> snp_id;
+        if(snp_id.empty() || snp_id[0] == '#') {
+            continue;
+        }
+        string type, chr;
+        index_t genome_pos = 0;
+        char snp_ch = '\0';
+        string ins_seq;
+        index_t del_len = 0;
+        ls >> type >> chr >> genome_pos;
+        if(type == "single") {
+            ls >> snp_ch;
+        } else if(type == "deletion") {
+            ls >> del_len;
+        } else if(type == "insertion") {
+            ls >> ins_seq;
+        }
+        if(ls.fail()) {
+            continue;
+        }
+        typename map<string, index_t>::const_iterator chr_it = chr2idx.find(chr);
+        if(chr_it == chr2idx.end()) {
+            continue;
+        }
+        index_t chr_idx = chr_it->second;
+        assert_lt(chr_idx, chr_szs.size());
+        pair<index_t, index_t> tmp_pair = chr_szs[chr_idx];
+        const index_t sofar_len = tmp_pair.first;
+        const index_t szs_idx = tmp_pair.second;
+        bool involve_Ns = false;
+        index_t pos = genome_pos;
+        index_t add_pos = 0;
+        assert(szs[szs_idx].first);
+        for(index_t i = szs_idx; i < szs.size(); i++) {
+            if(i != szs_idx && szs[i].first) {
+                break;
+            }
+            if(pos < szs[i].off) {
+                involve_Ns = true;
+                break;
+            } else {
+                pos -= szs[i].off;
+                if(pos == 0) {
+                    if(type == "deletion" || type == "insertion") {
+                        involve_Ns = true;
+                        break;
+                    }
+                }
+                if(pos < szs[i].len) {
+                    break;
+                } else {
+                    pos -= szs[i].len;
+                    add_pos += szs[i].len;
+                }
+            }
+        }
+
+        if(involve_Ns) {
+            continue;
+        }
+        pos = sofar_len + add_pos + pos;
+        if(chr_idx + 1 < chr_szs.size()) {
+            if(pos >= chr_szs[chr_idx + 1].first) {
+                continue;
+            }
+        } else {
+            if(pos >= jlen){
+                continue;
+            }
+        }
+
+        ALT<index_t> snp;
+        snp.pos = pos;
+        if(type == "single") {
+            snp.type = ALT_SNP_SGL;
+            snp_ch = toupper(snp_ch);
+            if(snp_ch != 'A' && snp_ch != 'C' && snp_ch != 'G' && snp_ch != 'T') {
+                continue;
+            }
+            uint64_t bp = asc2dna[(int)snp_ch];
+            assert_lt(bp, 4);
+            if((int)bp == s[pos]) {
+                warnings << "Warning: single type should have a different base than " << "ACGTN"[(int)s[pos]]
+                         << " (" << snp_id << ") at " << genome_pos << " on " << chr << endl;
+                continue;
+            }
+            snp.len = 1;
+            snp.seq = bp;
+        } else if(type == "deletion") {
+            snp.type = ALT_SNP_DEL;
+            snp.len = del_len;
+            snp.seq = 0;
+            snp.reversed = false;
+        } else if(type == "insertion") {
+            snp.type = ALT_SNP_INS;
+            snp.len = (index_t)ins_seq.size();
+            if(snp.len > sizeof(snp.seq) * 4) {
+                continue;
+            }
+            snp.seq = 0;
+            bool failed = false;
+            for(size_t i = 0; i < ins_seq.size(); i++) {
+                char ch = toupper(ins_seq[i]);
+                if(ch != 'A' && ch != 'C' && ch != 'G' && ch != 'T') {
+                    failed = true;
+                    break;
+                }
+                uint64_t bp = asc2dna[(int)ch];
+                assert_lt(bp, 4);
+                snp.seq = (snp.seq << 2) | bp;
+            }
+            if(failed) {
+                continue;
+            }
+        } else {
+            p->error = "Error: unknown snp type " + type;
+            break;
+        }
+        p->alts.push_back(snp);
+        p->names.push_back(snp_id);
+    }
+    p->warnings = warnings.str();
+}
+
+/**
+ * Append the SNPs of 'fname' that can be placed on the reference to
+ * 'alts' and their IDs to 'names', in file order.  The file is cut into
+ * 'nthreads' byte ranges at line boundaries and the ranges are parsed and
+ * checked against the joined reference 's' concurrently.
+ */
+template <typename index_t, typename TStr>
+void readSNPs(
+    const string& fname,
+    const AltRefCoords<index_t>& coords,
+    const TStr& s,
+    int nthreads,
+    EList<ALT<index_t> >& alts,
+    EList<string>& names)
+{
+    struct stat st;
+    if(stat(fname.c_str(), &st) != 0) {
+        cerr << "Error: could not open " << fname.c_str() << endl;
+        throw 1;
+    }
+    // Not worth a thread for less than a megabyte or so
+    const uint64_t fsize = (uint64_t)st.st_size;
+    nthreads = (int)min<uint64_t>(max(nthreads, 1), fsize / (1 << 20) + 1);
+    EList<SNPSliceParam<index_t, TStr> > tparams;
+    tparams.resizeExact(nthreads);
+    for(int i = 0; i < nthreads; i++) {
+        SNPSliceParam<index_t, TStr>& p = tparams[i];
+        p.fname = &fname;
+        p.from = fsize * i / nthreads;
+        p.to = (i + 1 == nthreads ? std::numeric_limits<uint64_t>::max() : fsize * (i + 1) / nthreads);
+        p.coords = &coords;
+        p.s = &s;
+    }
+    if(nthreads == 1) {
+        snpSlice_worker<index_t, TStr>((void*)&tparams[0]);
+    } else {
+        AutoArray<tthread::thread*> threads(nthreads);
+        for(int i = 0; i < nthreads; i++) {
+            threads[i] = new tthread::thread(snpSlice_worker<index_t, TStr>, (void*)&tparams[i]);
+        }
+        for(int i = 0; i < nthreads; i++) {
+            threads[i]->join();
+            delete threads[i];
+        }
+    }
+    size_t total = alts.size();
+    for(int i = 0; i < nthreads; i++) {
+        const SNPSliceParam<index_t, TStr>& p = tparams[i];
+        cerr << p.warnings;
+        if(!p.error.empty()) {
+            cerr << p.error << endl;
+            throw 1;
+        }
+        total += p.alts.size();
+    }
+    alts.reserveExact(total);
+    names.reserveExact(total);
+    for(int i = 0; i < nthreads; i++) {
+        SNPSliceParam<index_t, TStr>& p = tparams[i];
+        for(size_t j = 0; j < p.alts.size(); j++) {
+            alts.push_back(p.alts[j]);
+            names.expand();
+            names.back().swap(p.names[j]);
+        }
+        p.alts.clear();
+        p.names.clear();
+    }
+    assert_eq(alts.size(), names.size());
+}
+
+template <typename T>
+struct SortRunParam {
+    T*     a;
+    size_t lo;
+    size_t mid;  // == lo: sort [lo, hi); otherwise merge [lo, mid) and [mid, hi)
+    size_t hi;
+};
+
+template <typename T>
+static void sortRun_worker(void *vp) {
+    SortRunParam<T>* p = (SortRunParam<T>*)vp;
+    if(p->mid == p->lo) {
+        std::sort(p->a + p->lo, p->a + p->hi);
+    } else {
+        std::inplace_merge(p->a + p->lo, p->a + p->mid, p->a + p->hi);
+    }
+}
+
+template <typename T>
+static void sortRuns(EList<SortRunParam<T> >& tparams) {
+    AutoArray<tthread::thread*> threads(tparams.size());
+    for(size_t i = 0; i < tparams.size(); i++) {
+        threads[i] = new tthread::thread(sortRun_worker<T>, (void*)&tparams[i]);
+    }
+    for(size_t i = 0; i < tparams.size(); i++) {
+        threads[i]->join();
+        delete threads[i];
+    }
+}
+
+/**
+ * Sort a[0, n) with 'nthreads' threads: each sorts a run of its own, then
+ * the runs are merged pairwise, the merges of a round again in parallel.
+ */
+template <typename T>
+void sortParallel(T* a, size_t n, int nthreads) {
+    nthreads = (int)min<size_t>(max(nthreads, 1), n / (1 << 16) + 1);
+    if(nthreads == 1) {
+        std::sort(a, a + n);
+        return;
+    }
+    EList<size_t> bounds;
+    for(int i = 0; i <= nthreads; i++) {
+        bounds.push_back(n * i / nthreads);
+    }
+    EList<SortRunParam<T> > tparams;
+    for(int i = 0; i < nthreads; i++) {
+        tparams.expand();
+        tparams.back().a = a;
+        tparams.back().lo = tparams.back().mid = bounds[i];
+        tparams.back().hi = bounds[i + 1];
+    }
+    sortRuns(tparams);
+    for(int step = 1; step < nthreads; step *= 2) {
+        tparams.clear();
+        for(int i = 0; i + step < nthreads; i += 2 * step) {
+            tparams.expand();
+            tparams.back().a = a;
+            tparams.back().lo = bounds[i];
+            tparams.back().mid = bounds[i + step];
+            tparams.back().hi = bounds[min(i + 2 * step, nthreads)];
+        }
+        sortRuns(tparams);
+    }
+}
+
+#endif /*ALT_READER_H_*/
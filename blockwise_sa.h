@@ -36,6 +36,7 @@
 #include "ds.h"
 #include "mem_ids.h"
 #include "word_io.h"
+#include "sais.h"
 
 using namespace std;
 
@@ -485,6 +486,76 @@ inline void KarkkainenBlockwiseSA<S2bDnaString>::qsort(
 	}
 }
 
+/**
+ * Build the whole suffix array at once with SA-IS (see sais.h) and dole
+ * it out as a single block.  Takes time linear in the text length and no
+ * tuning, at the cost of holding the entire suffix array in memory, plus
+ * up to half as much again for SA-IS's bucket arrays and 2 bits per
+ * character for its type arrays.  Produces the same order as
+ * KarkkainenBlockwiseSA.
+ */
+template<typename TStr>
+class SaisBlockwiseSA : public InorderBlockwiseSA<TStr> {
+public:
+	SaisBlockwiseSA(const TStr& __text,
+	                bool __sanityCheck = false,
+	                bool __passMemExc = false,
+	                bool __verbose = false,
+	                ostream& __logger = cout) :
+	InorderBlockwiseSA<TStr>(__text, (TIndexOffU)(__text.length() + 1), __sanityCheck, __passMemExc, __verbose, __logger),
+	_built(false)
+	{ }
+
+	/**
+	 * Allocate an amount of memory that simulates the peak memory usage
+	 * of building the suffix array of 'text'.  Throws bad_alloc if it's
+	 * not going to fit in memory.  Returns the number of bytes.
+	 */
+	static size_t simulateAllocs(const TStr& text) {
+		size_t len = text.length() + 1;
+		// Suffix array, worst-case bucket array of a reduced problem (see
+		// sais.h) and type bits of all levels
+		size_t words = len + len / 2 + len / (4 * sizeof(TIndexOffU)) + (1024 * 1024 /*out of caution*/);
+		AutoArray<TIndexOffU> tmp(words, EBWT_CAT);
+		return words * sizeof(TIndexOffU);
+	}
+
+	virtual TIndexOffU nextSuffix() {
+		if(this->_itrPushedBackSuffix != OFF_MASK) {
+			TIndexOffU tmp = this->_itrPushedBackSuffix;
+			this->_itrPushedBackSuffix = OFF_MASK;
+			return tmp;
+		}
+		while(this->_itrBucketPos >= this->_itrBucket.size() ||
+		      this->_itrBucket.size() == 0)
+		{
+			if(!hasMoreBlocks()) {
+				throw out_of_range("No more suffixes");
+			}
+			nextBlock(0);
+			this->_itrBucketPos = 0;
+		}
+		return this->_itrBucket[this->_itrBucketPos++];
+	}
+
+protected:
+	virtual void reset() { _built = false; }
+	virtual bool isReset() { return !_built; }
+
+	virtual void nextBlock(int cur_block, int tid = 0) {
+		VMSG_NL("Building suffix array with SA-IS");
+		saisSuffixArray(this->text(), this->_itrBucket);
+		assert_eq(this->_itrBucket.size(), this->size());
+		assert_eq(this->_itrBucket.back(), (TIndexOffU)this->text().length());
+		_built = true;
+	}
+
+	virtual bool hasMoreBlocks() const { return !_built; }
+
+private:
+	bool _built; /// whether the suffix array has been doled out
+};
+
 template<typename TStr>
 struct BinarySortingParam {
     const TStr*              t;
@@ -0,0 +1,299 @@
+/*
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of HISAT 2.
+ *
+ * HISAT 2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HISAT 2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HISAT 2.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include "build_report.h"
+
+BuildReport gBuildReport;
+
+static double wallSeconds() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static double cpuSeconds() {
+	struct rusage ru;
+	if(getrusage(RUSAGE_SELF, &ru) != 0) return 0.0;
+	return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+	       ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+/**
+ * Return the peak resident set size since the last call, in bytes, and
+ * start the next peak from the current size.  Linux keeps the peak in
+ * VmHWM and lets it be reset through clear_refs; elsewhere this is the
+ * peak over the life of the process.
+ */
+static uint64_t markPeakRss() {
+	uint64_t peak = 0;
+#ifdef __linux__
+	ifstream status("/proc/self/status");
+	string line;
+	while(getline(status, line)) {
+		if(line.compare(0, 6, "VmHWM:") == 0) {
+			istringstream is(line.substr(6));
+			is >> peak;
+			peak <<= 10; // kB
+			break;
+		}
+	}
+	FILE* f = fopen("/proc/self/clear_refs", "w");
+	if(f != NULL) {
+		fputs("5", f);
+		fclose(f);
+	}
+#endif
+	if(peak == 0) {
+		struct rusage ru;
+		if(getrusage(RUSAGE_SELF, &ru) == 0) {
+#ifdef __APPLE__
+			peak = (uint64_t)ru.ru_maxrss;
+#else
+			peak = (uint64_t)ru.ru_maxrss << 10;
+#endif
+		}
+	}
+	return peak;
+}
+
+static string jsonString(const string& s) {
+	ostringstream os;
+	os << '"';
+	for(size_t i = 0; i < s.length(); i++) {
+		unsigned char c = (unsigned char)s[i];
+		if(c == '"' || c == '\\') {
+			os << '\\' << c;
+		} else if(c < 0x20) {
+			os << "\\u" << hex << setw(4) << setfill('0') << (int)c << dec;
+		} else {
+			os << c;
+		}
+	}
+	os << '"';
+	return os.str();
+}
+
+void BuildReport::open(const string& fname, const string& program, const string& version) {
+	_enabled = true;
+	_owner = tthread::this_thread::get_id();
+	_fname = fname;
+	_program = program;
+	_version = version;
+	_inputs.clear();
+	_inputSizes.clear();
+	_settings.clear();
+	_phases.clear();
+	_stack.clear();
+	_hidden = 0;
+	_complete = false;
+	markPeakRss();
+	gMemTally.markPeak();
+	_peakRss = 0;
+	_startWall = _lastWrite = wallSeconds();
+	_startCpu = cpuSeconds();
+	write(true);
+}
+
+void BuildReport::close(bool complete) {
+	if(!_enabled) return;
+	sample();
+	_stack.clear();
+	_hidden = 0;
+	_complete = complete;
+	write(true);
+	_enabled = false;
+}
+
+bool BuildReport::owner() const {
+	return _enabled && tthread::this_thread::get_id() == _owner;
+}
+
+void BuildReport::input(const string& kind, const string& fname) {
+	if(!_enabled || fname.empty()) return;
+	struct stat st;
+	_inputs.push_back(make_pair(kind, fname));
+	_inputSizes.push_back(stat(fname.c_str(), &st) == 0 ? (uint64_t)st.st_size : 0);
+}
+
+void BuildReport::putSetting(const string& key, const string& json) {
+	for(size_t i = 0; i < _settings.size(); i++) {
+		if(_settings[i].first == key) {
+			_settings[i].second = json;
+			return;
+		}
+	}
+	_settings.push_back(make_pair(key, json));
+}
+
+void BuildReport::setting(const string& key, int64_t val) {
+	if(!owner()) return;
+	ostringstream os;
+	os << val;
+	putSetting(key, os.str());
+}
+
+void BuildReport::setting(const string& key, const string& val) {
+	if(!owner()) return;
+	putSetting(key, jsonString(val));
+}
+
+/**
+ * Fold the memory peaks since the last sample into every running phase.
+ */
+void BuildReport::sample() {
+	uint64_t rss = markPeakRss();
+	uint64_t tally = gMemTally.markPeak();
+	_peakRss = max(_peakRss, rss);
+	for(size_t i = 0; i < _stack.size(); i++) {
+		Phase& p = _phases[_stack[i]];
+		p.peakRss = max(p.peakRss, rss);
+		p.peakTally = max(p.peakTally, tally);
+	}
+}
+
+void BuildReport::begin(const char* name, int round, bool repeated) {
+	if(!owner()) return;
+	if(_hidden > 0 || (!_stack.empty() && _phases[_stack.back()].repeated)) {
+		_hidden++;
+		return;
+	}
+	sample();
+	size_t parent = _stack.empty() ? (size_t)-1 : _stack.back();
+	size_t idx = _phases.size();
+	if(repeated) {
+		for(size_t i = 0; i < _phases.size(); i++) {
+			if(_phases[i].repeated && _phases[i].parent == parent && _phases[i].name == name) {
+				idx = i;
+				break;
+			}
+		}
+	}
+	if(idx == _phases.size()) {
+		_phases.expand();
+		Phase& p = _phases.back();
+		p.name = name;
+		p.round = round;
+		p.depth = (int)_stack.size();
+		p.parent = parent;
+		p.repeated = repeated;
+		p.count = 0;
+		p.wall = p.cpu = p.maxWall = 0.0;
+		p.peakRss = p.peakTally = 0;
+	}
+	Phase& p = _phases[idx];
+	p.running = true;
+	p.count++;
+	p.startWall = wallSeconds();
+	p.startCpu = cpuSeconds();
+	_stack.push_back(idx);
+	write(!repeated);
+}
+
+void BuildReport::end() {
+	if(!owner() || _stack.empty()) return;
+	if(_hidden > 0) {
+		_hidden--;
+		return;
+	}
+	sample();
+	Phase& p = _phases[_stack.back()];
+	_stack.pop_back();
+	double wall = wallSeconds() - p.startWall;
+	p.wall += wall;
+	p.cpu += cpuSeconds() - p.startCpu;
+	p.maxWall = max(p.maxWall, wall);
+	p.running = false;
+	write(!p.repeated);
+}
+
+/**
+ * Rewrite the report; unless 'force', not more than once a second.
+ */
+void BuildReport::write(bool force) {
+	double now = wallSeconds();
+	if(!force && now - _lastWrite < 1.0) return;
+	_lastWrite = now;
+	ostringstream os;
+	os << fixed << setprecision(3);
+	os << "{" << endl
+	   << "  \"program\": " << jsonString(_program) << "," << endl
+	   << "  \"version\": " << jsonString(_version) << "," << endl
+	   << "  \"complete\": " << (_complete ? "true" : "false") << "," << endl
+	   << "  \"wall_seconds\": " << now - _startWall << "," << endl
+	   << "  \"cpu_seconds\": " << cpuSeconds() - _startCpu << "," << endl
+	   << "  \"peak_rss_bytes\": " << _peakRss << "," << endl
+	   << "  \"peak_tallied_bytes\": " << gMemTally.peak() << "," << endl
+	   << "  \"inputs\": [";
+	for(size_t i = 0; i < _inputs.size(); i++) {
+		os << (i == 0 ? "" : ",") << endl
+		   << "    {\"kind\": " << jsonString(_inputs[i].first)
+		   << ", \"file\": " << jsonString(_inputs[i].second)
+		   << ", \"bytes\": " << _inputSizes[i] << "}";
+	}
+	os << (_inputs.empty() ? "" : "\n  ") << "]," << endl
+	   << "  \"settings\": {";
+	for(size_t i = 0; i < _settings.size(); i++) {
+		os << (i == 0 ? "" : ",") << endl
+		   << "    " << jsonString(_settings[i].first) << ": " << _settings[i].second;
+	}
+	os << (_settings.size() == 0 ? "" : "\n  ") << "}," << endl
+	   << "  \"phases\": [";
+	for(size_t i = 0; i < _phases.size(); i++) {
+		const Phase& p = _phases[i];
+		double wall = p.wall, cpu = p.cpu;
+		if(p.running) {
+			wall += now - p.startWall;
+			cpu += cpuSeconds() - p.startCpu;
+		}
+		os << (i == 0 ? "" : ",") << endl
+		   << "    {\"name\": " << jsonString(p.name)
+		   << ", \"depth\": " << p.depth;
+		if(p.round >= 0) {
+			os << ", \"round\": " << p.round;
+		}
+		if(p.repeated) {
+			os << ", \"count\": " << p.count
+			   << ", \"max_wall_seconds\": " << p.maxWall;
+		}
+		os << ", \"running\": " << (p.running ? "true" : "false")
+		   << ", \"wall_seconds\": " << wall
+		   << ", \"cpu_seconds\": " << cpu
+		   << ", \"peak_rss_bytes\": " << p.peakRss
+		   << ", \"peak_tallied_bytes\": " << p.peakTally << "}";
+	}
+	os << (_phases.empty() ? "" : "\n  ") << "]" << endl
+	   << "}" << endl;
+
+	string tmp = _fname + ".tmp";
+	ofstream out(tmp.c_str());
+	out << os.str();
+	out.close();
+	if(out.fail() || std::rename(tmp.c_str(), _fname.c_str()) != 0) {
+		cerr << "Warning: could not write build report \"" << _fname << "\"" << endl;
+		std::remove(tmp.c_str());
+	}
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of HISAT 2.
+ *
+ * HISAT 2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HISAT 2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HISAT 2.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BUILD_REPORT_H_
+#define BUILD_REPORT_H_
+
+#include <stdint.h>
+#include <string>
+#include <sstream>
+#include "ds.h"
+#include "tinythread.h"
+
+using namespace std;
+
+/**
+ * Where the time and memory of an index build go, written as a JSON
+ * report (hisat2-build --report).  The build is cut into nested phases;
+ * for each one the report gives its wall-clock and CPU time, the peak
+ * resident set size of the process while it ran and the peak of the
+ * memory tallied by gMemTally.  The report also lists the input files
+ * with their sizes and the settings the build ended up using.
+ *
+ * The file is rewritten, under a temporary name and then renamed, as
+ * phases start and finish, so a build that is still running or that
+ * failed leaves a report of how far it got; "complete" is only true
+ * once the build is done.
+ *
+ * Only phases of the thread that opened the report are recorded.  A
+ * phase that recurs many times, e.g. one per batch of local indexes, is
+ * kept as one entry with a count, and phases inside it are left out.
+ */
+class BuildReport {
+
+public:
+
+	BuildReport() : _enabled(false), _complete(false) { }
+
+	/**
+	 * Start reporting to 'fname'.
+	 */
+	void open(const string& fname, const string& program, const string& version);
+
+	/**
+	 * Write the final report and stop reporting.
+	 */
+	void close(bool complete);
+
+	bool enabled() const { return _enabled; }
+
+	/**
+	 * Record an input file and its size.
+	 */
+	void input(const string& kind, const string& fname);
+
+	/**
+	 * Record a build setting; a later call with the same key replaces
+	 * the value.
+	 */
+	void setting(const string& key, int64_t val);
+	void setting(const string& key, const string& val);
+
+	/**
+	 * Start a phase inside the current one.  'round' numbers phases that
+	 * are repeated a known number of times and is left out if negative.
+	 */
+	void begin(const char* name, int round, bool repeated);
+
+	/**
+	 * Finish the innermost phase.
+	 */
+	void end();
+
+private:
+
+	struct Phase {
+		string   name;
+		int      round;
+		int      depth;
+		size_t   parent;
+		bool     repeated;
+		bool     running;
+		uint64_t count;
+		double   wall;
+		double   cpu;
+		double   maxWall;
+		uint64_t peakRss;
+		uint64_t peakTally;
+		double   startWall;
+		double   startCpu;
+	};
+
+	bool owner() const;
+	void sample();
+	void write(bool force);
+	void putSetting(const string& key, const string& json);
+
+	bool                         _enabled;
+	bool                         _complete;
+	tthread::thread::id          _owner;
+	string                       _fname;
+	string                       _program;
+	string                       _version;
+	double                       _startWall;
+	double                       _startCpu;
+	double                       _lastWrite;
+	uint64_t                     _peakRss;
+	EList<pair<string, string> > _inputs;   // kind, file
+	EList<uint64_t>              _inputSizes;
+	EList<pair<string, string> > _settings; // key, JSON value
+	EList<Phase>                 _phases;
+	EList<size_t>                _stack;    // running phases, innermost last
+	size_t                       _hidden;   // phases begun inside a repeated one
+};
+
+extern BuildReport gBuildReport;
+
+/**
+ * Scope of one build phase in gBuildReport; does nothing if no report
+ * was asked for.
+ */
+class BuildPhase {
+public:
+	BuildPhase(const char* name, int round = -1, bool repeated = false) :
+		_on(gBuildReport.enabled())
+	{
+		if(_on) gBuildReport.begin(name, round, repeated);
+	}
+
+	~BuildPhase() {
+		if(_on) gBuildReport.end();
+	}
+
+private:
+	bool _on;
+};
+
+#endif /*BUILD_REPORT_H_*/
@@ -0,0 +1,335 @@
+/*
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of HISAT 2.
+ *
+ * HISAT 2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HISAT 2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HISAT 2.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <string>
+#include <sstream>
+#include <set>
+#include <algorithm>
+#include <iostream>
+#include "ds.h"
+
+using namespace std;
+
+/**
+ * Checkpoints let an interrupted hisat2-build pick up where it stopped.
+ * Each build phase saves its result to its own file in the checkpoint
+ * directory:
+ *
+ *   magic | key | payload | checksum
+ *
+ * where the key fingerprints the build's inputs and options and the
+ * checksum covers the key and payload.  A file is written under a
+ * temporary name and renamed into place once complete, so a phase is
+ * either saved whole or not at all.  On --resume, a file with the wrong
+ * magic, key or checksum is ignored and its phase is redone.
+ */
+
+static const uint64_t CHECKPOINT_MAGIC = 0x31544b4332544849ull; // "HIT2CKT1"
+
+/**
+ * 64-bit FNV-1a taken a word, rather than a byte, at a time.  Bytes may
+ * be fed in pieces of any size; the sum only depends on their sequence.
+ */
+class CheckpointSum {
+public:
+    CheckpointSum() : _h(14695981039346656037ull), _word(0), _nbytes(0) {}
+
+    void update(const void* p, size_t len) {
+        const uint8_t* b = (const uint8_t*)p;
+        while(len > 0 && _nbytes > 0) {
+            _word |= (uint64_t)*b++ << (8 * _nbytes);
+            len--;
+            if(++_nbytes == 8) mix();
+        }
+        for(; len >= 8; b += 8, len -= 8) {
+            memcpy(&_word, b, 8);
+            mix();
+        }
+        // Fewer than 8 bytes are left and _nbytes is 0 here
+        for(; len > 0 && len < 8; len--) {
+            _word |= (uint64_t)*b++ << (8 * _nbytes++);
+        }
+    }
+
+    uint64_t value() const {
+        return _nbytes > 0 ? (_h ^ _word ^ ((uint64_t)_nbytes << 56)) * 1099511628211ull : _h;
+    }
+
+    static uint64_t of(const string& s) {
+        CheckpointSum sum;
+        sum.update(s.c_str(), s.length());
+        return sum.value();
+    }
+
+private:
+    void mix() {
+        _h = (_h ^ _word) * 1099511628211ull;
+        _word = 0;
+        _nbytes = 0;
+    }
+
+    uint64_t _h;
+    uint64_t _word;
+    unsigned _nbytes;
+};
+
+/**
+ * Where a build's checkpoints go and whether to reuse them.  Phase files
+ * are named <dir>/<prefix>.<phase>.ckpt, with the index basename as the
+ * prefix so that several builds can share a directory.
+ */
+class Checkpoint {
+public:
+    Checkpoint(const string& dir, const string& prefix, bool resume, uint64_t key) :
+    _dir(dir), _prefix(prefix), _resume(resume), _key(key)
+    {
+        if(mkdir(_dir.c_str(), 0777) != 0 && errno != EEXIST) {
+            cerr << "Could not create checkpoint directory: \"" << _dir << "\"" << endl;
+            throw 1;
+        }
+    }
+
+    bool resume() const { return _resume; }
+    uint64_t key() const { return _key; }
+
+    string fname(const string& phase) const {
+        _phases.insert(phase);
+        return _dir + "/" + _prefix + "." + phase + ".ckpt";
+    }
+
+    /**
+     * Remove the files of all phases saved or restored so far; called once
+     * the index is complete.
+     */
+    void clear() const {
+        for(set<string>::const_iterator it = _phases.begin(); it != _phases.end(); it++) {
+            std::remove((_dir + "/" + _prefix + "." + *it + ".ckpt").c_str());
+        }
+        _phases.clear();
+    }
+
+private:
+    string              _dir;
+    string              _prefix;
+    bool                _resume;
+    uint64_t            _key;
+    mutable set<string> _phases;
+};
+
+/**
+ * Writes one phase's checkpoint.  Nothing is visible under the phase's
+ * name until commit(); a writer destroyed before that removes its
+ * temporary file.
+ */
+class CheckpointWriter {
+public:
+    CheckpointWriter(const Checkpoint& ckpt, const string& phase) :
+    _fname(ckpt.fname(phase)), _tmp(_fname + ".tmp"), _fp(NULL)
+    {
+        _fp = fopen(_tmp.c_str(), "wb");
+        if(_fp == NULL) {
+            cerr << "Could not open checkpoint file for writing: \"" << _tmp << "\"" << endl;
+            throw 1;
+        }
+        write(&CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+        uint64_t key = ckpt.key();
+        put(key);
+    }
+
+    ~CheckpointWriter() {
+        if(_fp != NULL) {
+            fclose(_fp);
+            std::remove(_tmp.c_str());
+        }
+    }
+
+    void put(const void* p, size_t len) {
+        _sum.update(p, len);
+        write(p, len);
+    }
+
+    template <typename T>
+    void put(const T& t) { put(&t, sizeof(T)); }
+
+    template <typename T, int S>
+    void putList(const EList<T, S>& l) {
+        put<uint64_t>(l.size());
+        if(!l.empty()) put(l.ptr(), l.size() * sizeof(T));
+    }
+
+    void commit() {
+        uint64_t sum = _sum.value();
+        write(&sum, sizeof(sum));
+        FILE* fp = _fp;
+        _fp = NULL;
+        if(fclose(fp) != 0) {
+            std::remove(_tmp.c_str());
+            ioError();
+        }
+        if(std::rename(_tmp.c_str(), _fname.c_str()) != 0) {
+            cerr << "Could not rename checkpoint file \"" << _tmp << "\" to \"" << _fname << "\"" << endl;
+            throw 1;
+        }
+    }
+
+private:
+    void write(const void* p, size_t len) {
+        if(len > 0 && fwrite(p, 1, len, _fp) != len) ioError();
+    }
+
+    void ioError() {
+        cerr << "An error occurred writing checkpoint file \"" << _tmp << "\".  Please check if the disk is full." << endl;
+        throw 1;
+    }
+
+    string        _fname;
+    string        _tmp;
+    FILE*         _fp;
+    CheckpointSum _sum;
+};
+
+/**
+ * Reads back one phase's checkpoint.  open() checks the whole file
+ * before anything is read from it.
+ */
+class CheckpointReader {
+public:
+    CheckpointReader() : _fp(NULL) {}
+    ~CheckpointReader() { close(); }
+
+    /**
+     * Return true iff the phase has a complete checkpoint for this build;
+     * if so, position at the start of its payload.
+     */
+    bool open(const Checkpoint& ckpt, const string& phase) {
+        close();
+        _fname = ckpt.fname(phase);
+        _fp = fopen(_fname.c_str(), "rb");
+        if(_fp == NULL) return false;
+        uint64_t magic = 0, key = 0;
+        if(fread(&magic, sizeof(magic), 1, _fp) != 1 || magic != CHECKPOINT_MAGIC ||
+           fread(&key, sizeof(key), 1, _fp) != 1 || key != ckpt.key()) {
+            close();
+            return false;
+        }
+        // Sum everything after the magic; the last word read is the checksum
+        CheckpointSum sum;
+        sum.update(&key, sizeof(key));
+        EList<char> buf; buf.resizeExact(1 << 20);
+        size_t pending = 0;
+        while(true) {
+            size_t n = fread(buf.ptr() + pending, 1, buf.size() - pending, _fp);
+            if(n == 0) break;
+            pending += n;
+            if(pending > 8) {
+                sum.update(buf.ptr(), pending - 8);
+                memmove(buf.ptr(), buf.ptr() + pending - 8, 8);
+                pending = 8;
+            }
+        }
+        uint64_t stored = 0;
+        if(pending != 8) {
+            close();
+            return false;
+        }
+        memcpy(&stored, buf.ptr(), 8);
+        if(stored != sum.value() || fseeko(_fp, 2 * sizeof(uint64_t), SEEK_SET) != 0) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void get(void* p, size_t len) {
+        assert(_fp != NULL);
+        if(len > 0 && fread(p, 1, len, _fp) != len) {
+            cerr << "An error occurred reading checkpoint file \"" << _fname << "\"." << endl;
+            throw 1;
+        }
+    }
+
+    template <typename T>
+    T get() {
+        T t;
+        get(&t, sizeof(T));
+        return t;
+    }
+
+    template <typename T, int S>
+    void getList(EList<T, S>& l) {
+        uint64_t n = get<uint64_t>();
+        l.resizeNoCopyExact((size_t)n);
+        if(n > 0) get(l.ptr(), (size_t)n * sizeof(T));
+    }
+
+    void close() {
+        if(_fp != NULL) {
+            fclose(_fp);
+            _fp = NULL;
+        }
+    }
+
+private:
+    string _fname;
+    FILE*  _fp;
+};
+
+/**
+ * Add bytes [from, to) of a file to 'sum'; for checking that the part of
+ * an output file a checkpoint refers to is still what was written.
+ */
+static inline bool checkpointSumFile(const string& fname, uint64_t from, uint64_t to, CheckpointSum& sum) {
+    if(to <= from) return true;
+    FILE* fp = fopen(fname.c_str(), "rb");
+    if(fp == NULL) return false;
+    bool ok = fseeko(fp, (off_t)from, SEEK_SET) == 0;
+    EList<char> buf; buf.resizeExact((size_t)min<uint64_t>(to - from, 1 << 20));
+    while(ok && from < to) {
+        size_t n = (size_t)min<uint64_t>(to - from, buf.size());
+        ok = fread(buf.ptr(), 1, n, fp) == n;
+        sum.update(buf.ptr(), n);
+        from += n;
+    }
+    fclose(fp);
+    return ok;
+}
+
+/**
+ * Describe a file by name, size and modification time, for building a
+ * checkpoint key that changes when the file does.
+ */
+static inline string checkpointFileStamp(const string& fname) {
+    struct stat st;
+    ostringstream os;
+    os << fname;
+    if(stat(fname.c_str(), &st) == 0) {
+        os << ":" << st.st_size << ":" << st.st_mtime;
+    }
+    return os.str();
+}
+
+#endif /*CHECKPOINT_H_*/
@@ -21,10 +21,16 @@
 
 extern MemoryTally gMemTally;
 
+// per-thread allocation counts, for measuring per-read scratch growth
+static thread_local uint64_t threadAllocs_ = 0;
+static thread_local uint64_t threadBytes_ = 0;
+
 /**
  * Tally a memory allocation of size amt bytes.
  */
 void MemoryTally::add(int cat, uint64_t amt) {
+	threadAllocs_++;
+	threadBytes_ += amt;
 	ThreadSafe ts(&mutex_m);
 	tots_[cat] += amt;
 	tot_ += amt;
@@ -34,6 +40,9 @@ void MemoryTally::add(int cat, uint64_t amt) {
 	if(tot_ > peak_) {
 		peak_ = tot_;
 	}
+	if(tot_ > markPeak_) {
+		markPeak_ = tot_;
+	}
 }
 
 /**
@@ -46,6 +55,25 @@ void MemoryTally::del(int cat, uint64_t amt) {
 	tots_[cat] -= amt;
 	tot_ -= amt;
 }
+
+/**
+ * Return the peak amount of memory allocated since the previous call,
+ * and start the next such peak from the current total.
+ */
+uint64_t MemoryTally::markPeak() {
+	ThreadSafe ts(&mutex_m);
+	uint64_t ret = markPeak_;
+	markPeak_ = tot_;
+	return ret;
+}
+
+uint64_t MemoryTally::threadAllocs() {
+	return threadAllocs_;
+}
+
+uint64_t MemoryTally::threadBytes() {
+	return threadBytes_;
+}
 	
 #ifdef MAIN_DS
 
@@ -40,7 +40,7 @@ class MemoryTally {
 
 public:
 
-	MemoryTally() : tot_(0), peak_(0) {
+	MemoryTally() : tot_(0), peak_(0), markPeak_(0) {
 		memset(tots_,  0, 256 * sizeof(uint64_t));
 		memset(peaks_, 0, 256 * sizeof(uint64_t));
 	}
@@ -77,6 +77,24 @@ public:
 	 */
 	uint64_t peak(int cat) { return peaks_[cat]; }
 
+	/**
+	 * Return the peak amount of memory allocated since the previous
+	 * call, and start the next such peak from the current total.
+	 */
+	uint64_t markPeak();
+
+	/**
+	 * Return the number of allocations tallied by the calling thread so
+	 * far.  Differences between two calls tell how often the thread's
+	 * containers had to grow in between, e.g. while aligning one read.
+	 */
+	static uint64_t threadAllocs();
+
+	/**
+	 * Return the number of bytes tallied by the calling thread so far.
+	 */
+	static uint64_t threadBytes();
+
 #ifndef NDEBUG
 	/**
 	 * Check that memory tallies are internally consistent;
@@ -99,6 +117,7 @@ protected:
 	uint64_t tot_;
 	uint64_t peaks_[256];
 	uint64_t peak_;
+	uint64_t markPeak_;
 };
 
 extern MemoryTally gMemTally;
@@ -0,0 +1,301 @@
+/*
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of HISAT 2.
+ *
+ * HISAT 2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HISAT 2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HISAT 2.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EXT_SORT_H_
+#define EXT_SORT_H_
+
+#include <stdio.h>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <queue>
+#include <vector>
+#include "ds.h"
+
+using namespace std;
+
+/**
+ * A list of fixed-size (POD) records kept in a temporary file.  Records
+ * are appended through a buffer of a given number of records; once
+ * finish() is called the list can be read back in order by any number
+ * of ExtReaders.  The file is removed when the list is cleared or
+ * destroyed.
+ */
+template <typename T>
+class ExtList {
+public:
+    ExtList() : _fp(NULL), _nbuf(0), _len(0) {}
+    ~ExtList() { clear(); }
+
+    /**
+     * Start a new, empty list backed by 'fname'.
+     */
+    void create(const string& fname, size_t bufRecs) {
+        clear();
+        _fname = fname;
+        _fp = fopen(_fname.c_str(), "wb");
+        if(_fp == NULL) {
+            cerr << "Could not open temporary file for writing: \"" << _fname << "\"" << endl;
+            throw 1;
+        }
+        _buf.resizeNoCopyExact(max<size_t>(bufRecs, 1));
+        _nbuf = 0;
+        _len = 0;
+    }
+
+    void push_back(const T& t) {
+        assert(_fp != NULL);
+        _buf[_nbuf++] = t;
+        if(_nbuf == _buf.size()) flushBuf();
+    }
+
+    /**
+     * Flush and close the file; the list becomes read-only.
+     */
+    void finish() {
+        if(_fp == NULL) return;
+        flushBuf();
+        if(fclose(_fp) != 0) {
+            cerr << "An error occurred writing temporary file \"" << _fname << "\".  Please check if the disk is full." << endl;
+            throw 1;
+        }
+        _fp = NULL;
+        _buf.nullify();
+    }
+
+    /**
+     * Close and remove the backing file.
+     */
+    void clear() {
+        if(_fp != NULL) {
+            fclose(_fp);
+            _fp = NULL;
+        }
+        if(!_fname.empty()) {
+            std::remove(_fname.c_str());
+            _fname.clear();
+        }
+        _buf.nullify();
+        _nbuf = 0;
+        _len = 0;
+    }
+
+    void swap(ExtList<T>& o) {
+        std::swap(_fname, o._fname);
+        std::swap(_fp, o._fp);
+        _buf.swap(o._buf);
+        std::swap(_nbuf, o._nbuf);
+        std::swap(_len, o._len);
+    }
+
+    /**
+     * Move the backing file of a finished list to 'fname'.
+     */
+    void rename(const string& fname) {
+        assert(_fp == NULL);
+        if(std::rename(_fname.c_str(), fname.c_str()) != 0) {
+            cerr << "Could not rename temporary file \"" << _fname << "\" to \"" << fname << "\"" << endl;
+            throw 1;
+        }
+        _fname = fname;
+    }
+
+    size_t size() const { return _len; }
+    const string& name() const { return _fname; }
+
+private:
+    void flushBuf() {
+        if(_nbuf == 0) return;
+        if(fwrite(_buf.ptr(), sizeof(T), _nbuf, _fp) != _nbuf) {
+            cerr << "An error occurred writing temporary file \"" << _fname << "\".  Please check if the disk is full." << endl;
+            throw 1;
+        }
+        _len += _nbuf;
+        _nbuf = 0;
+    }
+
+    string   _fname;
+    FILE*    _fp;
+    EList<T> _buf;
+    size_t   _nbuf;
+    size_t   _len;
+};
+
+/**
+ * Sequential reader over a finished ExtList with its own buffer.
+ */
+template <typename T>
+class ExtReader {
+public:
+    ExtReader(const ExtList<T>& l, size_t bufRecs) :
+    _fname(l.name()), _fp(NULL), _cur(0), _nbuf(0), _left(l.size())
+    {
+        _fp = fopen(_fname.c_str(), "rb");
+        if(_fp == NULL) {
+            cerr << "Could not open temporary file for reading: \"" << _fname << "\"" << endl;
+            throw 1;
+        }
+        _buf.resizeNoCopyExact(max<size_t>(bufRecs, 1));
+        fill();
+    }
+
+    ~ExtReader() {
+        if(_fp != NULL) fclose(_fp);
+    }
+
+    bool done() const { return _cur >= _nbuf; }
+
+    const T& peek() const {
+        assert(!done());
+        return _buf[_cur];
+    }
+
+    void next() {
+        assert(!done());
+        if(++_cur == _nbuf) fill();
+    }
+
+private:
+    void fill() {
+        _cur = 0;
+        _nbuf = min(_left, _buf.size());
+        if(_nbuf > 0 && fread(_buf.ptr(), sizeof(T), _nbuf, _fp) != _nbuf) {
+            cerr << "An error occurred reading temporary file \"" << _fname << "\"." << endl;
+            throw 1;
+        }
+        _left -= _nbuf;
+    }
+
+    string   _fname;
+    FILE*    _fp;
+    EList<T> _buf;
+    size_t   _cur;
+    size_t   _nbuf;
+    size_t   _left;
+};
+
+/**
+ * Number of records buffered per open ExtList/ExtReader when about
+ * 'mem' bytes may be used in total.
+ */
+template <typename T>
+static inline size_t extBlockRecs(size_t mem) {
+    return max<size_t>(min<size_t>(mem / 16, 1 << 20) / sizeof(T), 1);
+}
+
+template <typename T>
+struct ExtMergeHead {
+    T      t;
+    size_t run;
+};
+
+template <typename T, typename CMP>
+struct ExtMergeHeadCmp {
+    bool operator() (const ExtMergeHead<T>& a, const ExtMergeHead<T>& b) const {
+        return CMP()(b.t, a.t);
+    }
+};
+
+/**
+ * Sort the records of 'in' by CMP into 'out', which ends up backed by
+ * 'outName'.  At most about 'mem' bytes of records are held at a time:
+ * runs of that size are sorted in memory and written out, then merged
+ * 'fanIn' at a time until one run remains.  Run files are named after
+ * 'outName' and removed as they are merged.  'in' is left untouched.
+ */
+template <typename T, typename CMP>
+void extSort(const ExtList<T>& in, ExtList<T>& out, const string& outName, size_t mem) {
+    const size_t blockRecs = extBlockRecs<T>(mem);
+    const size_t runRecs = max<size_t>(mem / sizeof(T), 2 * blockRecs) - blockRecs;
+    const size_t fanIn = max<size_t>(mem / (blockRecs * sizeof(T)), 3) - 1;
+    size_t numNames = 0;
+
+    // Form sorted runs
+    EList<ExtList<T>*> runs;
+    {
+        EList<T> buf;
+        buf.reserveExact(min(runRecs, max<size_t>(in.size(), 1)));
+        ExtReader<T> r(in, blockRecs);
+        while(!r.done()) {
+            buf.clear();
+            while(!r.done() && buf.size() < runRecs) {
+                buf.push_back(r.peek());
+                r.next();
+            }
+            std::sort(buf.begin(), buf.end(), CMP());
+            ostringstream name; name << outName << "." << numNames++;
+            runs.push_back(new ExtList<T>());
+            runs.back()->create(name.str(), blockRecs);
+            for(size_t i = 0; i < buf.size(); i++) {
+                runs.back()->push_back(buf[i]);
+            }
+            runs.back()->finish();
+        }
+    }
+
+    // Merge runs, 'fanIn' at a time
+    while(runs.size() > 1) {
+        EList<ExtList<T>*> merged;
+        for(size_t st = 0; st < runs.size(); st += fanIn) {
+            size_t en = min(st + fanIn, runs.size());
+            ExtList<T>* m = new ExtList<T>();
+            if(en - st == 1) {
+                m->swap(*runs[st]);
+            } else {
+                ostringstream name; name << outName << "." << numNames++;
+                m->create(name.str(), blockRecs);
+                EList<ExtReader<T>*> readers;
+                priority_queue<ExtMergeHead<T>, vector<ExtMergeHead<T> >, ExtMergeHeadCmp<T, CMP> > heap;
+                for(size_t i = st; i < en; i++) {
+                    readers.push_back(new ExtReader<T>(*runs[i], blockRecs));
+                    ExtMergeHead<T> h; h.t = readers.back()->peek(); h.run = readers.size() - 1;
+                    heap.push(h);
+                }
+                while(!heap.empty()) {
+                    ExtMergeHead<T> h = heap.top(); heap.pop();
+                    m->push_back(h.t);
+                    ExtReader<T>& r = *readers[h.run];
+                    r.next();
+                    if(!r.done()) {
+                        h.t = r.peek();
+                        heap.push(h);
+                    }
+                }
+                m->finish();
+                for(size_t i = 0; i < readers.size(); i++) delete readers[i];
+            }
+            merged.push_back(m);
+        }
+        for(size_t i = 0; i < runs.size(); i++) delete runs[i];
+        runs.swap(merged);
+    }
+
+    out.clear();
+    if(runs.empty()) {
+        out.create(outName, 1);
+        out.finish();
+    } else {
+        out.swap(*runs[0]);
+        delete runs[0];
+        out.rename(outName);
+    }
+}
+
+#endif /*EXT_SORT_H_*/
@@ -30,6 +30,9 @@
 #include <time.h>
 #include "alt.h"
 #include "radix_sort.h"
+#include "ext_sort.h"
+#include "checkpoint.h"
+#include "build_report.h"
 
 // Reference:
 // Jouni Sirén, Niko Välimäki, and Veli Mäkinen: Indexing Graphs for Path Queries with Applications in Genome Research.
@@ -143,6 +146,24 @@ public:
              int nthreads_,
              bool verbose);
 
+    // Restore a graph saved with saveCheckpoint
+    RefGraph(CheckpointReader& ckpt, int nthreads_) : nthreads(nthreads_) {
+        ckpt.getList(szs);
+        ckpt.getList(nodes);
+        ckpt.getList(edges);
+        lastNode = ckpt.get<index_t>();
+#ifndef NDEBUG
+        debug = false;
+#endif
+    }
+
+    void saveCheckpoint(CheckpointWriter& ckpt) const {
+        ckpt.putList(szs);
+        ckpt.putList(nodes);
+        ckpt.putList(edges);
+        ckpt.put(lastNode);
+    }
+
     bool repOk() { return true; }
 
     void write(const string& fname, bool bigEndian) {
@@ -1589,11 +1610,13 @@ public:
               const string& base_fname,
               size_t max_num_nodes_ = std::numeric_limits<size_t>::max(),
               int nthreads_ = 1,
-              bool verbose_ = false);
+              bool verbose_ = false,
+              size_t mem_limit_ = 0,
+              const Checkpoint* ckpt_ = NULL);
 
     ~PathGraph() {}
 
-    void printInfo();
+    void printInfo() { printInfo(nodes.size()); }
 
     bool generateEdges(RefGraph<index_t>& parent);
 
@@ -1645,6 +1668,9 @@ public:
     }
 
 private:
+    void printInfo(size_t num_nodes);
+    static index_t labelKey(char label);
+
     void makeFromRef(RefGraph<index_t>& base);
     void generationOne();
     void earlyGeneration();
@@ -1677,6 +1703,22 @@ private:
     static void generateEdgesCounter(void* vp);
     static void generateEdgesMaker(void* vp);
 
+    // External-memory construction, used instead of the generations
+    // above when mem_limit is set.  Nodes of each generation live in
+    // temporary files next to the index and are joined and merged
+    // with sequential passes over sorted copies.
+    void externalBuild(RefGraph<index_t>& base, const string& base_fname);
+    void externalGeneration(ExtList<PathNode>& past);
+    void externalMergeUpdateRank(const ExtList<PathNode>& made, ExtList<PathNode>& merged);
+    string tmpName();
+
+    // Save the nodes of the latest generation, in rank order, along with
+    // what the next generation needs; either 'mem' or 'ext' holds them.
+    // loadCheckpoint restores them into the same kind of list, which need
+    // not be the kind they were saved from.
+    void saveCheckpoint(const EList<PathNode>* mem, const ExtList<PathNode>* ext);
+    bool loadCheckpoint(EList<PathNode>* mem, ExtList<PathNode>* ext);
+
 private:
     int             nthreads;
     bool            verbose;
@@ -1699,6 +1741,10 @@ private:
     index_t                report_F_location;
     
     size_t          max_num_nodes;
+    size_t          mem_limit; // bytes of nodes held at a time; 0 = all in memory
+    string          tmp_base;
+    index_t         tmp_count;
+    const Checkpoint* ckpt; // save each generation here, if not NULL
 
     // following variables are for debugging purposes
 #ifndef NDEBUG
@@ -1756,19 +1802,30 @@ PathGraph<index_t>::PathGraph(
                               const string& base_fname,
                               size_t max_num_nodes_,
                               int nthreads_,
-                              bool verbose_) :
+                              bool verbose_,
+                              size_t mem_limit_,
+                              const Checkpoint* ckpt_) :
 nthreads(nthreads_), verbose(verbose_),
 ranks(0), temp_nodes(0), generation(0), sorted(false),
 report_node_idx(0), report_edge_range(pair<index_t, index_t>(0, 0)), report_M(pair<index_t, index_t>(0, 0)),
 report_F_node_idx(0), report_F_location(0),
-max_num_nodes(max_num_nodes_)
+max_num_nodes(max_num_nodes_),
+mem_limit(mem_limit_),
+tmp_count(0),
+ckpt(ckpt_)
 {
 #ifndef NDEBUG
     debug = base.nodes.size() <= 20;
 #endif
+    if(mem_limit > 0) {
+        externalBuild(base, base_fname);
+        return;
+    }
+    // Pick up from the last generation saved by an earlier run, if any
+    const bool resumed = loadCheckpoint(&past_nodes, NULL);
     // Fill nodes with a PathNode for each edge in base.edges.
     // Set max_from.
-    makeFromRef(base);
+    if(!resumed) makeFromRef(base);
     
     // Write RefGraph into a file
     const bool file_rf = base.nodes.size() > (1 << 22);
@@ -1779,24 +1836,28 @@ max_num_nodes(max_num_nodes_)
         base.nullify();
     }
     
-    // In the first generation the nodes enter, not quite sorted by from.
-    // We use a counting sort to sort the nodes, otherwise same as early generation.
-    generationOne();
-    // In early generations no nodes become sorted.
-    // Therefore, we skip the pruning step and leave the
-    //   nodes sorted by from.
-    while(generation < 3) {
-        earlyGeneration();
-    }
-    // On the first generation we perform a pruning step,
-    //   we are forced to sort the entire list of nodes by rank
-    //   in order to perform pruning step.
-    firstPruneGeneration();
+    if(!resumed) {
+        // In the first generation the nodes enter, not quite sorted by from.
+        // We use a counting sort to sort the nodes, otherwise same as early generation.
+        generationOne();
+        // In early generations no nodes become sorted.
+        // Therefore, we skip the pruning step and leave the
+        //   nodes sorted by from.
+        while(generation < 3) {
+            earlyGeneration();
+        }
+        // On the first generation we perform a pruning step,
+        //   we are forced to sort the entire list of nodes by rank
+        //   in order to perform pruning step.
+        firstPruneGeneration();
+        saveCheckpoint(&past_nodes, NULL);
+    }
     // In later generations, most nodes are already sorted, so we
     //   perform a more expensive random access join with nodes in rank order
     //   in return for avoiding having to sort by rank in order to prune nodes.
     while(!isSorted()) {
         lateGeneration();
+        saveCheckpoint(&past_nodes, NULL);
     }
     // In the generateEdges method it is convenient to begin with nodes sorted by from.
     // We perform this action here, while we still have past_nodes allocated to avoid
@@ -1826,27 +1887,7 @@ void PathGraph<index_t>::makeFromRef(RefGraph<index_t>& base) {
         nodes.back().from = e.from;
         if(e.from > max_from) max_from = e.from;
         nodes.back().to = e.to;
-
-        switch(base.nodes[e.from].label) {
-        case 'A':
-            nodes.back().key = pair<index_t, index_t>(0, 0);
-            break;
-        case 'C':
-            nodes.back().key = pair<index_t, index_t>(1, 0);
-            break;
-        case 'G':
-            nodes.back().key = pair<index_t, index_t>(2, 0);
-            break;
-        case 'T':
-            nodes.back().key = pair<index_t, index_t>(3, 0);
-            break;
-        case 'Y':
-            nodes.back().key = pair<index_t, index_t>(4, 0);
-            break;
-        default:
-            assert(false);
-            throw 1;
-        }
+        nodes.back().key = pair<index_t, index_t>(labelKey(base.nodes[e.from].label), 0);
     }
     // Final node.
     assert_lt(base.lastNode, base.nodes.size());
@@ -1858,12 +1899,27 @@ void PathGraph<index_t>::makeFromRef(RefGraph<index_t>& base) {
     printInfo();
 }
 
+template <typename index_t>
+index_t PathGraph<index_t>::labelKey(char label) {
+    switch(label) {
+    case 'A': return 0;
+    case 'C': return 1;
+    case 'G': return 2;
+    case 'T': return 3;
+    case 'Y': return 4;
+    default:
+        assert(false);
+        throw 1;
+    }
+}
+
 template <typename index_t>
 void PathGraph<index_t>::generationOne() {
     //nodes enter almost sorted by from
     //this is only generation method that whose
     // incoming nodes are in the nodes EList
     generation++;
+    BuildPhase phase("path_graph_generation", (int)generation);
     //Sort nodes by from using counting sort
     //Copy into past_nodes in the process
     //first count number with each from value
@@ -1898,6 +1954,7 @@ void PathGraph<index_t>::earlyGeneration() {
     //past_nodes enter sorted by from
     //do not yet need to perform pruning step
     generation++;
+    BuildPhase phase("path_graph_generation", (int)generation);
     for(index_t i = 0; i < past_nodes.size(); i++) {
         past_nodes[past_nodes[i].from + 1].key.second = i + 1;
     }
@@ -1912,6 +1969,7 @@ void PathGraph<index_t>::firstPruneGeneration() {
     //first generation where we need to perform pruning step
     // results in us needing to sort entirety of nodes after they are made
     generation++;
+    BuildPhase phase("path_graph_generation", (int)generation);
     //here past_nodes is already sorted by .from
     // first count where to start each from value
     time_t start = time(0);
@@ -1957,6 +2015,7 @@ void PathGraph<index_t>::lateGeneration() {
     // the nodes produced are automatically sorted by key.first
     // therefore we only need to sort clusters with same key.first
     generation++;
+    BuildPhase phase("path_graph_generation", (int)generation);
     time_t overall = time(0);
     time_t indiv = time(0);
     assert_gt(nthreads, 0);
@@ -2294,17 +2353,322 @@ pair<index_t, index_t> PathGraph<index_t>::nextMaximalSet(pair<index_t, index_t>
 //-----------------------------------------------------------------------------------------
 
 template <typename index_t>
-void PathGraph<index_t>::printInfo()
+void PathGraph<index_t>::printInfo(size_t num_nodes)
 {
     if(verbose) {
         cerr << "Generation " << generation
-        << " (" << temp_nodes << " -> " << nodes.size() << " nodes, "
+        << " (" << temp_nodes << " -> " << num_nodes << " nodes, "
         << ranks << " ranks)" << endl;
     }
 }
 
 //------------------------------------------------------------------------------------------
 
+template <typename index_t>
+string PathGraph<index_t>::tmpName() {
+    ostringstream name;
+    name << tmp_base << "." << tmp_count++ << ".tmp";
+    return name.str();
+}
+
+// Same generations as the in-memory path, but every generation is done with
+// sequential passes: the previous nodes sorted by from take the place of the
+// direct-access table, the unsorted ones sorted by to are merge-joined
+// against it, and the new nodes are sorted by key and merged in one scan.
+// Only the final, prefix-sorted nodes are loaded into memory, for generateEdges.
+template <typename index_t>
+void PathGraph<index_t>::externalBuild(RefGraph<index_t>& base, const string& base_fname) {
+    tmp_base = base_fname + ".pg";
+    const size_t blockRecs = extBlockRecs<PathNode>(mem_limit);
+
+    ExtList<PathNode> past;
+    if(!loadCheckpoint(NULL, &past)) {
+        // Same as makeFromRef, but written straight to a file
+        past.create(tmpName(), blockRecs);
+        max_from = 0;
+        PathNode node;
+        for(index_t i = 0; i < base.edges.size(); i++) {
+            const typename RefGraph<index_t>::Edge& e = base.edges[i];
+            node.from = e.from;
+            node.to = e.to;
+            node.key = pair<index_t, index_t>(labelKey(base.nodes[e.from].label), 0);
+            if(e.from > max_from) max_from = e.from;
+            past.push_back(node);
+        }
+        assert_lt(base.lastNode, base.nodes.size());
+        assert_eq(base.nodes[base.lastNode].label, 'Z');
+        node.from = node.to = base.lastNode;
+        node.key = pair<index_t, index_t>(5, 0);
+        if(base.lastNode > max_from) max_from = base.lastNode;
+        past.push_back(node);
+        past.finish();
+        temp_nodes = (index_t)past.size();
+        printInfo(past.size());
+    }
+
+    const bool bigEndian = false;
+    const string rf_fname = base_fname + ".rf";
+    base.write(rf_fname, bigEndian);
+    base.nullify();
+
+    while(generation < 4 || !isSorted()) {
+        externalGeneration(past);
+        if(generation >= 4) saveCheckpoint(NULL, &past);
+    }
+
+    ExtList<PathNode> by_from;
+    extSort<PathNode, PathNodeFromCmp>(past, by_from, tmpName(), mem_limit);
+    past.clear();
+    nodes.resizeNoCopyExact(by_from.size());
+    {
+        ExtReader<PathNode> r(by_from, blockRecs);
+        for(index_t i = 0; i < nodes.size(); i++, r.next()) {
+            nodes[i] = r.peek();
+        }
+    }
+    by_from.clear();
+
+    base.read(rf_fname, bigEndian);
+    std::remove(rf_fname.c_str());
+}
+
+template <typename index_t>
+void PathGraph<index_t>::externalGeneration(ExtList<PathNode>& past) {
+    generation++;
+    BuildPhase phase("path_graph_generation", (int)generation);
+    time_t start = time(0);
+    const size_t blockRecs = extBlockRecs<PathNode>(mem_limit);
+    ExtList<PathNode> table, queries, made;
+    extSort<PathNode, PathNodeFromCmp>(past, table, tmpName(), mem_limit);
+    // Sorted nodes have to == INDEX_MAX and so come last
+    extSort<PathNode, PathNodeToCmp>(past, queries, tmpName(), mem_limit);
+    past.clear();
+    if(verbose) cerr << "SORT TABLE AND QUERIES: " << time(0) - start << endl;
+    start = time(0);
+
+    // Join queries' to with table's from; see createNewNodesMaker
+    made.create(tmpName(), blockRecs);
+    {
+        index_t bit_shift = 1 << (generation - 1);
+        bit_shift = (bit_shift << 1) + bit_shift;
+        ExtReader<PathNode> q(queries, blockRecs), t(table, blockRecs);
+        EList<PathNode> matches;
+        index_t matches_from = (index_t)INDEX_MAX;
+        PathNode node;
+        for(; !q.done(); q.next()) {
+            const PathNode& query = q.peek();
+            if(query.isSorted()) {
+                made.push_back(query);
+                continue;
+            }
+            if(query.to != matches_from) {
+                matches.clear();
+                while(!t.done() && t.peek().from < query.to) t.next();
+                for(; !t.done() && t.peek().from == query.to; t.next()) {
+                    matches.push_back(t.peek());
+                }
+                matches_from = query.to;
+            }
+            for(index_t j = 0; j < matches.size(); j++) {
+                node.from = query.from;
+                node.to = matches[j].to;
+                if(generation >= 4) {
+                    node.key = pair<index_t, index_t>(query.key.first, matches[j].key.first);
+                } else {
+                    node.key = pair<index_t, index_t>((query.key.first << bit_shift) + matches[j].key.first, 0);
+                }
+                made.push_back(node);
+            }
+        }
+    }
+    made.finish();
+    queries.clear();
+    table.clear();
+    if(made.size() > (index_t)-1) {
+        cerr << "exceeded integer bounds, remove adjacent SNPs, use haplotypes, or switch to a large index (--large-index)" << endl;
+        throw 1;
+    }
+    temp_nodes = (index_t)made.size();
+    if(verbose) cerr << "MADE NEW NODES: " << time(0) - start << endl;
+    start = time(0);
+
+    if(generation < 4) {
+        // No node can be sorted yet
+        past.swap(made);
+    } else {
+        ExtList<PathNode> by_key;
+        extSort<PathNode, less<PathNode> >(made, by_key, tmpName(), mem_limit);
+        made.clear();
+        externalMergeUpdateRank(by_key, past);
+        if(verbose) cerr << "MERGEUPDATERANK: " << time(0) - start << endl;
+        if(generation > 4 && ranks >= (index_t)max_num_nodes) {
+            throw ExplosionException();
+        }
+    }
+    printInfo(past.size());
+}
+
+template <typename index_t>
+void PathGraph<index_t>::saveCheckpoint(const EList<PathNode>* mem, const ExtList<PathNode>* ext) {
+    if(ckpt == NULL) return;
+    time_t start = time(0);
+    CheckpointWriter w(*ckpt, "pathgraph");
+    w.put(generation);
+    w.put(ranks);
+    w.put(max_from);
+    w.put(temp_nodes);
+    w.put<uint8_t>(sorted ? 1 : 0);
+    if(mem != NULL) {
+        w.putList(*mem);
+    } else {
+        assert(ext != NULL);
+        w.put<uint64_t>(ext->size());
+        for(ExtReader<PathNode> r(*ext, extBlockRecs<PathNode>(mem_limit)); !r.done(); r.next()) {
+            w.put(r.peek());
+        }
+    }
+    w.commit();
+    if(verbose) cerr << "SAVE CHECKPOINT: " << time(0) - start << endl;
+}
+
+template <typename index_t>
+bool PathGraph<index_t>::loadCheckpoint(EList<PathNode>* mem, ExtList<PathNode>* ext) {
+    if(ckpt == NULL || !ckpt->resume()) return false;
+    CheckpointReader r;
+    if(!r.open(*ckpt, "pathgraph")) return false;
+    generation = r.get<index_t>();
+    ranks = r.get<index_t>();
+    max_from = r.get<index_t>();
+    temp_nodes = r.get<index_t>();
+    sorted = r.get<uint8_t>() != 0;
+    size_t num_nodes = 0;
+    if(mem != NULL) {
+        r.getList(*mem);
+        num_nodes = mem->size();
+    } else {
+        assert(ext != NULL);
+        const size_t blockRecs = extBlockRecs<PathNode>(mem_limit);
+        ext->create(tmpName(), blockRecs);
+        num_nodes = (size_t)r.get<uint64_t>();
+        for(size_t i = 0; i < num_nodes; i++) {
+            ext->push_back(r.get<PathNode>());
+        }
+        ext->finish();
+    }
+    if(verbose) cerr << "Resuming path graph construction after generation " << generation << endl;
+    printInfo(num_nodes);
+    return true;
+}
+
+// Streaming version of mergeUpdateRank over nodes sorted by key.  A second
+// reader runs ahead over each group of equal keys to find its size and
+// whether all of its nodes share .from, so no group is held in memory.
+template <typename index_t>
+void PathGraph<index_t>::externalMergeUpdateRank(const ExtList<PathNode>& made, ExtList<PathNode>& merged) {
+    const size_t blockRecs = extBlockRecs<PathNode>(mem_limit);
+    merged.create(tmpName(), blockRecs);
+    ExtReader<PathNode> ahead(made, blockRecs), lag(made, blockRecs);
+    ranks = 0;
+    PathNode first = PathNode(), last = PathNode();
+    bool have_last = false;
+    index_t num = 0;
+    bool same_from = true;
+    if(generation == 4) {
+        // Runs of groups that all share one .from collapse into the
+        // first node, which becomes sorted (see nextMaximalSet)
+        bool run_open = false;
+        PathNode run;
+        while(!ahead.done()) {
+            first = ahead.peek();
+            for(num = 0, same_from = true; !ahead.done() && ahead.peek().key == first.key; ahead.next(), num++) {
+                if(ahead.peek().from != first.from) same_from = false;
+            }
+            if(same_from) {
+                if(!run_open || run.from != first.from) {
+                    if(run_open) {
+                        run.setSorted();
+                        run.key = pair<index_t, index_t>(ranks++, 0);
+                        merged.push_back(run);
+                    }
+                    run = first;
+                    run_open = true;
+                }
+                for(; num > 0; num--) lag.next();
+            } else {
+                if(run_open) {
+                    run.setSorted();
+                    run.key = pair<index_t, index_t>(ranks++, 0);
+                    merged.push_back(run);
+                    run_open = false;
+                }
+                for(; num > 0; num--, lag.next()) {
+                    PathNode n = lag.peek();
+                    n.key = pair<index_t, index_t>(ranks, 0);
+                    merged.push_back(n);
+                }
+                ranks++;
+            }
+        }
+        if(run_open) {
+            run.setSorted();
+            run.key = pair<index_t, index_t>(ranks++, 0);
+            merged.push_back(run);
+        }
+    } else {
+        // A node that follows a block of several nodes and is alone in its
+        // own block is merged into the last node written if that one is
+        // sorted and shares .from
+        bool after_block = false;
+        while(!ahead.done()) {
+            first = ahead.peek();
+            const index_t block = first.key.first;
+            for(num = 0, same_from = true; !ahead.done() && ahead.peek().key == first.key; ahead.next(), num++) {
+                if(ahead.peek().from != first.from) same_from = false;
+            }
+            if(num == 1 && (ahead.done() || ahead.peek().key.first != block)) {
+                lag.next();
+                if(!after_block || !last.isSorted() || last.from != first.from) {
+                    first.key.first = ranks++;
+                    merged.push_back(first);
+                    last = first; have_last = true;
+                }
+                after_block = false;
+                continue;
+            }
+            while(true) {
+                if(!same_from) {
+                    for(; num > 0; num--, lag.next()) {
+                        last = lag.peek();
+                        last.key.first = ranks;
+                        merged.push_back(last);
+                    }
+                    have_last = true;
+                    ranks++;
+                } else {
+                    if(!have_last || !last.isSorted() || last.from != first.from) {
+                        first.setSorted();
+                        first.key.first = ranks++;
+                        merged.push_back(first);
+                        last = first; have_last = true;
+                    }
+                    for(; num > 0; num--) lag.next();
+                }
+                if(ahead.done() || ahead.peek().key.first != block) break;
+                first = ahead.peek();
+                for(num = 0, same_from = true; !ahead.done() && ahead.peek().key == first.key; ahead.next(), num++) {
+                    if(ahead.peek().from != first.from) same_from = false;
+                }
+            }
+            after_block = true;
+        }
+    }
+    merged.finish();
+    // if all nodes have unique rank we are done!
+    if(ranks == merged.size()) sorted = true;
+}
+
+//------------------------------------------------------------------------------------------
+
 template <typename index_t>
 void PathGraph<index_t>::generateEdgesCounter(void* vp) {
     GenEdgesParams* params = (GenEdgesParams*)vp;
@@ -46,25 +46,22 @@ string adjustEbwtBase(const string& cmdline,
                       bool verbose)
 {
     string str = gfmFileBase;
-    ifstream in;
     if(verbose) cout << "Trying " << str.c_str() << endl;
-    in.open((str + ".1." + gfm_ext).c_str(), ios_base::in | ios::binary);
-    if(!in.is_open()) {
+    bool found = indexFileExists(str + ".1." + gfm_ext);
+    if(!found) {
         if(verbose) cout << "  didn't work" << endl;
-        in.close();
         if(getenv("HISAT2_INDEXES") != NULL) {
             str = string(getenv("HISAT2_INDEXES")) + "/" + gfmFileBase;
             if(verbose) cout << "Trying " << str.c_str() << endl;
-            in.open((str + ".1." + gfm_ext).c_str(), ios_base::in | ios::binary);
-            if(!in.is_open()) {
+            found = indexFileExists(str + ".1." + gfm_ext);
+            if(!found) {
                 if(verbose) cout << "  didn't work" << endl;
-                in.close();
             } else {
                 if(verbose) cout << "  worked" << endl;
             }
         }
     }
-    if(!in.is_open()) {
+    if(!found) {
         cerr << "Could not locate a HISAT2 index corresponding to basename \"" << gfmFileBase.c_str() << "\"" << endl;
         throw 1;
     }
@@ -32,6 +32,7 @@
 #include <set>
 #include <stdexcept>
 #include <sys/stat.h>
+#include <unistd.h>
 #ifdef BOWTIE_MM
 #include <sys/mman.h>
 #include <sys/shm.h>
@@ -58,6 +59,9 @@
 #include "tokenize.h"
 #include "repeat.h"
 #include "repeat_kmer.h"
+#include "alt_reader.h"
+#include "build_report.h"
+#include "index_pack.h"
 
 #ifdef POPCNT_CAPABILITY
 #include "processor_support.h"
@@ -642,15 +646,21 @@ public:
 	    _ftab(EBWT_CAT), \
 	    _eftab(EBWT_CAT), \
 	    _offs(EBWT_CAT), \
+	    _offsBits(0), \
+	    _offsPacked(EBWT_CAT), \
+	    _packOffs(false), \
 	    _gfm(EBWT_CAT), \
 	    _useMm(false), \
 	    useShmem_(false), \
 	    _refnames(EBWT_CAT), \
         mmFile1_(NULL), \
 	    mmFile2_(NULL), \
-        _nthreads(1)
+        _nthreads(1), \
+	    _pathGraphMem(0), \
+	    _useSais(false), \
+	    _checkpoint(NULL)
 
-        GFM() {}
+        GFM() : _offsBits(0), _offsPacked(EBWT_CAT), _packOffs(false), _pathGraphMem(0), _useSais(false), _checkpoint(NULL) {}
 	/// Construct a GFM from the given input file
 	GFM(const string& in,
         ALTDB<index_t>* altdb,
@@ -688,6 +698,8 @@ public:
 		useShmem_ = useShmem;
 		_in1Str = in + ".1." + gfm_ext;
 		_in2Str = in + ".2." + gfm_ext;
+		_offsStr = in + ".offs." + gfm_ext;
+		_dftabStr = in + ".dftab." + gfm_ext;
         if(readLens != NULL) {
             _readLens.resizeExact(readLens->size());
             for(size_t i = 0; i < readLens->size(); i++) {
@@ -715,6 +727,23 @@ public:
             if(_overrideOffRate > _gh._offRate) {
                 _gh.setOffRate(_overrideOffRate);
                 assert_eq(_overrideOffRate, _gh._offRate);
+            } else if(_overrideOffRate >= 0 && _overrideOffRate < _gh._offRate) {
+                // A denser sample than the built one has to come from
+                // the companion .offs file
+                FILE *denseIn = NULL;
+                bool denseSwitchEndian = false;
+                index_t denseOffsLen = 0;
+                int32_t denseOffRate = openOffsCompanion(denseIn, denseSwitchEndian, denseOffsLen);
+                if(denseIn != NULL) fclose(denseIn);
+                if(denseOffRate >= 0 && denseOffRate <= _overrideOffRate) {
+                    _gh.setOffRate(_overrideOffRate);
+                    assert_eq(_overrideOffRate, _gh._offRate);
+                } else {
+                    cerr << "Warning: offrate " << _overrideOffRate << " is denser than the index's offrate "
+                         << _gh._offRate << " and no suitable " << _offsStr.c_str() << " was found; "
+                         << "using offrate " << _gh._offRate << endl;
+                    _overrideOffRate = -1;
+                }
             }
         }
 
@@ -728,8 +757,9 @@ public:
         
         // open alts
         if(verbose || startVerbose) cerr << "Opening \"" << in7Str.c_str() << "\"" << endl;
-        ifstream in7(in7Str.c_str(), ios::binary);
-        if(!in7.good()) {
+        ifstream in7;
+        IndexFileLoc loc7;
+        if(!openIndexFile(in7Str, in7, loc7)) {
             cerr << "Could not open index file " << in7Str.c_str() << endl;
         }
         
@@ -741,8 +771,9 @@ public:
 
         // open altnames
         if(verbose || startVerbose) cerr << "Opening \"" << in8Str.c_str() << "\"" << endl;
-        ifstream in8(in8Str.c_str(), ios::binary);
-        if(!in8.good()) {
+        ifstream in8;
+        IndexFileLoc loc8;
+        if(!openIndexFile(in8Str, in8, loc8)) {
             cerr << "Could not open index file " << in8Str.c_str() << endl;
         }
 
@@ -782,7 +813,7 @@ public:
         assert_eq(to_alti_far, numAlts);
         assert_eq(alts.size(), altnames.size());
         // Check if it hits the end of file, and this routine is needed for backward compatibility
-        if(in7.peek() != std::ifstream::traits_type::eof()) {
+        if((uint64_t)in7.tellg() < loc7.off + loc7.len) {
             index_t numHaplotypes = readIndex<index_t>(in7, this->toBe());
             if(numHaplotypes > 0) {
                 haplotypes.resizeExact(numHaplotypes);
@@ -839,12 +870,12 @@ public:
                 if(!_readIncluded[k])
                     continue;
                 if(k > 0) {
-                    in7.seekg(filePos[k-1]);
+                    in7.seekg((streamoff)loc7.off + filePos[k-1]);
                 }
                 _repeat_kmertables.expand();
                 _repeat_kmertables.back().read(in7, this->toBe());
             }
-            in7.seekg(filePos.back());
+            in7.seekg((streamoff)loc7.off + filePos.back());
         }
         
         in7.close();
@@ -983,7 +1014,10 @@ public:
 		int32_t overrideOffRate = -1,
 		bool verbose = false,
 		bool passMemExc = false,
-		bool sanityCheck = false) :
+		bool sanityCheck = false,
+		size_t pathGraphMem = 0,
+		bool useSais = false,
+		const Checkpoint* checkpoint = NULL) :
 		GFM_INITS,
 		_gh(
 			joinedLen(szs),
@@ -997,12 +1031,17 @@ public:
 	{
         assert_gt(nthreads, 0);
         _nthreads = nthreads;
+        _pathGraphMem = pathGraphMem;
+        _useSais = useSais;
+        _checkpoint = checkpoint;
 #ifdef POPCNT_CAPABILITY
         ProcessorSupport ps;
         _usePOPCNTinstruction = ps.POPCNTenabled();
 #endif
 		_in1Str = outfile + ".1." + gfm_ext;
 		_in2Str = outfile + ".2." + gfm_ext;
+		_offsStr = outfile + ".offs." + gfm_ext;
+		_dftabStr = outfile + ".dftab." + gfm_ext;
 		packed_ = packed;
 		// Open output files
 		ofstream fout1(_in1Str.c_str(), ios::binary);
@@ -1305,9 +1344,11 @@ public:
 			if(refparams.reverse == REF_READ_REVERSE) {
 				{
 					Timer timer(cerr, "  Time to join reference sequences: ", _verbose);
+					BuildPhase phase("join_reference");
 					joinToDisk(is, szs, sztot, refparams, s, out1, out2);
 				} {
 					Timer timer(cerr, "  Time to reverse reference sequence: ", _verbose);
+					BuildPhase phase("reverse_reference");
 					EList<RefRecord> tmp(EBWT_CAT);
 					s.reverse();
 					reverseRefRecords(szs, tmp, false, verbose);
@@ -1315,12 +1356,14 @@ public:
 				}
 			} else {
 				Timer timer(cerr, "  Time to join reference sequences: ", _verbose);
+				BuildPhase phase("join_reference");
 				joinToDisk(is, szs, sztot, refparams, s, out1, out2);
 				szsToDisk(szs, out1, refparams.reverse);
 			}
             
             {
                 Timer timer(cerr, "  Time to read SNPs and splice sites: ", _verbose);
+                BuildPhase phase("alts");
                 _alts.clear();
                 _altnames.clear();
                 EList<pair<index_t, index_t> > chr_szs;
@@ -1368,150 +1411,22 @@ public:
                     }
                 }
                 
+                map<string, index_t> chr2idx;
+                for(index_t i = 0; i < _refnames_nospace.size(); i++) {
+                    chr2idx.insert(make_pair(_refnames_nospace[i], i));
+                }
+                
                 map<string, index_t> snpID2num;
                 if(snpfile != "") {
-                    ifstream snp_file(snpfile.c_str(), ios::in);
-                    if(!snp_file.is_open()) {
-                        cerr << "Error: could not open " << snpfile.c_str() << endl;
-                        throw 1;
+                    AltRefCoords<index_t> coords;
+                    coords.chr2idx = &chr2idx;
+                    coords.chr_szs = &chr_szs;
+                    coords.szs = &szs;
+                    coords.jlen = jlen;
+                    readSNPs(snpfile, coords, s, _nthreads, _alts, _altnames);
+                    for(index_t i = 0; i < _altnames.size(); i++) {
+                        snpID2num[_altnames[i]] = i;
                     }
-                    
-                    while(!snp_file.eof()) {
-                        // rs73387790	single	22:20000001-21000000	145	A
-                        string snp_id;
-                        snp_file >> snp_id;
-                        if(snp_id.empty() || snp_id[0] == '#') {
-                            string line;
-                            getline(snp_file, line);
-                            continue;
-                        }
-                        string type, chr;
-                        index_t genome_pos;
-                        char snp_ch = '\0';
-                        string ins_seq;
-                        index_t del_len = 0;
-                        snp_file >> type >> chr >> genome_pos;
-                        if(type == "single") {
-                            snp_file >> snp_ch;
-                        } else if(type == "deletion") {
-                            snp_file >> del_len;
-                        } else if(type == "insertion") {
-                            snp_file >> ins_seq;
-                        }
-                        index_t chr_idx = 0;
-                        for(; chr_idx < _refnames_nospace.size(); chr_idx++) {
-                            if(chr == _refnames_nospace[chr_idx])
-                                break;
-                        }
-                        if(chr_idx >= _refnames_nospace.size()) {
-                            continue;
-                        }
-                        assert_eq(chr_szs.size(), _refnames_nospace.size());
-                        assert_lt(chr_idx, chr_szs.size());
-                        pair<index_t, index_t> tmp_pair = chr_szs[chr_idx];
-                        const index_t sofar_len = tmp_pair.first;
-                        const index_t szs_idx = tmp_pair.second;
-                        bool involve_Ns = false;
-                        index_t pos = genome_pos;
-                        index_t add_pos = 0;
-                        assert(szs[szs_idx].first);
-                        for(index_t i = szs_idx; i < szs.size(); i++) {
-                            if(i != szs_idx && szs[i].first) {
-                                break;
-                            }
-                            if(pos < szs[i].off) {
-                                involve_Ns = true;
-                                break;
-                            } else {
-                                pos -= szs[i].off;
-                                if(pos == 0) {
-                                   if(type == "deletion" || type == "insertion") {
-                                       involve_Ns = true;
-                                       break;
-                                   }
-                                }
-                                if(pos < szs[i].len) {
-                                    break;
-                                } else {
-                                    pos -= szs[i].len;
-                                    add_pos += szs[i].len;
-                                }
-                            }
-                        }
-                        
-                        if(involve_Ns) {
-                            continue;
-                        }
-                        pos = sofar_len + add_pos + pos;
-                        if(chr_idx + 1 < chr_szs.size()) {
-                            if(pos >= chr_szs[chr_idx + 1].first) {
-                                continue;
-                            }
-                        } else {
-                            if(pos >= jlen){
-                                continue;
-                            }
-                        }
-                        
-                        _alts.expand();
-                        ALT<index_t>& snp = _alts.back();
-                        snp.pos = pos;
-                        if(type == "single") {
-                            snp.type = ALT_SNP_SGL;
-                            snp_ch = toupper(snp_ch);
-                            if(snp_ch != 'A' && snp_ch != 'C' && snp_ch != 'G' && snp_ch != 'T') {
-                                _alts.pop_back();
-                                continue;
-                            }
-                            uint64_t bp = asc2dna[(int)snp_ch];
-                            assert_lt(bp, 4);
-                            if((int)bp == s[pos]) {
-                                cerr << "Warning: single type should have a different base than " << "ACGTN"[(int)s[pos]]
-                                     << " (" << snp_id << ") at " << genome_pos << " on " << chr << endl;
-                                _alts.pop_back();
-                                continue;
-                                // throw 1;
-                            }
-                            snp.len = 1;
-                            snp.seq = bp;
-                        } else if(type == "deletion") {
-                            snp.type = ALT_SNP_DEL;
-                            snp.len = del_len;
-                            snp.seq = 0;
-                            snp.reversed = false;
-                        } else if(type == "insertion") {
-                            snp.type = ALT_SNP_INS;
-                            snp.len = (index_t)ins_seq.size();
-                            if(snp.len > sizeof(snp.seq) * 4) {
-                                _alts.pop_back();
-                                continue;
-                            }
-                            snp.seq = 0;
-                            bool failed = false;
-                            for(size_t i = 0; i < ins_seq.size(); i++) {
-                                char ch = toupper(ins_seq[i]);
-                                if(ch != 'A' && ch != 'C' && ch != 'G' && ch != 'T') {
-                                    failed = true;
-                                    break;
-                                }
-                                uint64_t bp = asc2dna[(int)ch];
-                                assert_lt(bp, 4);
-                                snp.seq = (snp.seq << 2) | bp;
-                            }
-                            if(failed) {
-                                _alts.pop_back();
-                                continue;
-                            }
-                        } else {
-                            cerr << "Error: unknown snp type " << type << endl;
-                            throw 1;
-                        }
-                        _altnames.push_back(snp_id);
-                        assert_eq(_alts.size(), _altnames.size());
-                        snpID2num[snp_id] = (index_t)_alts.size() - 1;
-                    }
-                    snp_file.close();
-                    assert_eq(_alts.size(), _altnames.size());
                 }
                 
                 _haplotypes.clear();
@@ -1535,11 +1450,8 @@ public:
                         index_t left, right;  // inclusive [left, right]
                         ht_file >> chr >> left >> right >> alt_list;
                         assert_leq(left, right);
-                        index_t chr_idx = 0;
-                        for(; chr_idx < _refnames_nospace.size(); chr_idx++) {
-                            if(chr == _refnames_nospace[chr_idx])
-                                break;
-                        }
+                        typename map<string, index_t>::const_iterator chr_it = chr2idx.find(chr);
+                        index_t chr_idx = (chr_it == chr2idx.end() ? (index_t)_refnames_nospace.size() : chr_it->second);
                         if(chr_idx >= _refnames_nospace.size()) {
                             continue;
                         }
@@ -1642,11 +1554,8 @@ public:
                         // Convert exonic position to intronic position
                         left += 1; right -= 1;
                         if(left >= right) continue;
-                        index_t chr_idx = 0;
-                        for(; chr_idx < _refnames_nospace.size(); chr_idx++) {
-                            if(chr == _refnames_nospace[chr_idx])
-                                break;
-                        }
+                        typename map<string, index_t>::const_iterator chr_it = chr2idx.find(chr);
+                        index_t chr_idx = (chr_it == chr2idx.end() ? (index_t)_refnames_nospace.size() : chr_it->second);
                         if(chr_idx >= _refnames_nospace.size()) continue;
                         assert_eq(chr_szs.size(), _refnames_nospace.size());
                         assert_lt(chr_idx, chr_szs.size());
@@ -1755,11 +1664,8 @@ public:
                         // Convert exonic position to intronic position
                         left += 1; right -= 1;
                         if(left >= right) continue;
-                        index_t chr_idx = 0;
-                        for(; chr_idx < _refnames_nospace.size(); chr_idx++) {
-                            if(chr == _refnames_nospace[chr_idx])
-                                break;
-                        }
+                        typename map<string, index_t>::const_iterator chr_it = chr2idx.find(chr);
+                        index_t chr_idx = (chr_it == chr2idx.end() ? (index_t)_refnames_nospace.size() : chr_it->second);
                         if(chr_idx >= _refnames_nospace.size()) continue;
                         assert_eq(chr_szs.size(), _refnames_nospace.size());
                         assert_lt(chr_idx, chr_szs.size());
@@ -1822,12 +1728,12 @@ public:
                     for(size_t i = 0; i < _alts.size(); i++) {
                         buf[i].first = _alts[i];
                         buf[i].second = (index_t)i;
-                        buf2[i] = _altnames[i];
+                        buf2[i].swap(_altnames[i]);
                     }
-                    buf.sort();
+                    sortParallel(buf.ptr(), buf.size(), _nthreads);
                     for(size_t i = 0; i < _alts.size(); i++) {
                         _alts[i] = buf[i].first;
-                        _altnames[i] = buf2[buf[i].second];
+                        _altnames[i].swap(buf2[buf[i].second]);
                     }
                     
                     EList<index_t> buf3; buf3.resize(_alts.size());
@@ -2211,6 +2117,9 @@ public:
 		streampos out2pos = out2.tellp();
         
         if(!_repeat) {
+            gBuildReport.setting("joined_length", (int64_t)jlen);
+            gBuildReport.setting("alts", (int64_t)_alts.size());
+            gBuildReport.setting("haplotypes", (int64_t)_haplotypes.size());
             // Look for bmax/dcv parameters that work.
             while(true) {
                 if(!first && bmax < 40 && _passMemExc) {
@@ -2241,7 +2150,22 @@ public:
                 }
                 iter++;
                 try {
-                    if(_alts.empty()) {
+                    if(_alts.empty() && _useSais) {
+                        {
+                            VMSG_NL("  Doing ahead-of-time memory usage test");
+                            AutoArray<uint8_t> tmp(SaisBlockwiseSA<TStr>::simulateAllocs(s), EBWT_CAT);
+                            AutoArray<index_t> ftab(_gh._ftabLen * 2, EBWT_CAT);
+                            AutoArray<uint8_t> side(_gh._sideSz, EBWT_CAT);
+                            AutoArray<uint32_t> extra(20*1024*1024, EBWT_CAT);
+                            VMSG_NL("  Passed!  Constructing with SA-IS");
+                        }
+                        BuildPhase phase("suffix_array_bwt");
+                        SaisBlockwiseSA<TStr> bsa(s, _sanity, _passMemExc, _verbose);
+                        assert(bsa.suffixItrIsReset());
+                        assert_eq(bsa.size(), s.length()+1);
+                        VMSG_NL("Converting suffix-array elements to index image");
+                        buildToDisk(bsa, s, out1, out2);
+                    } else if(_alts.empty()) {
                         VMSG("Using parameters --bmax " << bmax);
                         if(dcv == 0) {
                             VMSG_NL(" and *no difference cover*");
@@ -2276,29 +2200,54 @@ public:
                             VMSG_NL("");
                         }
                         VMSG_NL("Constructing suffix-array element generator");
+                        BuildPhase phase("suffix_array_bwt");
                         KarkkainenBlockwiseSA<TStr> bsa(s, bmax, _nthreads, dcv, seed, _sanity, _passMemExc, _verbose, outfile);
                         assert(bsa.suffixItrIsReset());
                         assert_eq(bsa.size(), s.length()+1);
                         VMSG_NL("Converting suffix-array elements to index image");
                         buildToDisk(bsa, s, out1, out2);
                     } else {
-                        RefGraph<index_t>* graph = new RefGraph<index_t>(
-                                                                         s,
-                                                                         szs,
-                                                                         _alts,
-                                                                         _haplotypes,
-                                                                         outfile,
-                                                                         _nthreads,
-                                                                         verbose);
-                        PathGraph<index_t>* pg = new PathGraph<index_t>(
-                                                                        *graph,
-                                                                        outfile,
-                                                                        std::numeric_limits<index_t>::max(),
-                                                                        _nthreads,
-                                                                        verbose);
-                        
-                        if(verbose) { cerr << "Generating edges... " << endl; }
-                        if(!pg->generateEdges(*graph)) { return; }
+                        RefGraph<index_t>* graph = NULL;
+                        {
+                            BuildPhase phase("ref_graph");
+                            CheckpointReader ckpt;
+                            if(_checkpoint != NULL && _checkpoint->resume() && ckpt.open(*_checkpoint, "refgraph")) {
+                                VMSG_NL("Restoring reference graph from checkpoint");
+                                graph = new RefGraph<index_t>(ckpt, _nthreads);
+                                ckpt.close();
+                            } else {
+                                graph = new RefGraph<index_t>(
+                                                              s,
+                                                              szs,
+                                                              _alts,
+                                                              _haplotypes,
+                                                              outfile,
+                                                              _nthreads,
+                                                              verbose);
+                                if(_checkpoint != NULL) {
+                                    CheckpointWriter w(*_checkpoint, "refgraph");
+                                    graph->saveCheckpoint(w);
+                                    w.commit();
+                                }
+                            }
+                        }
+                        PathGraph<index_t>* pg = NULL;
+                        {
+                            BuildPhase phase("path_graph");
+                            pg = new PathGraph<index_t>(
+                                                        *graph,
+                                                        outfile,
+                                                        std::numeric_limits<index_t>::max(),
+                                                        _nthreads,
+                                                        verbose,
+                                                        _pathGraphMem,
+                                                        _checkpoint);
+                        }
+                        {
+                            BuildPhase phase("path_graph_edges");
+                            if(verbose) { cerr << "Generating edges... " << endl; }
+                            if(!pg->generateEdges(*graph)) { return; }
+                        }
                         // Re-initialize GFM parameters to reflect real number of edges (gbwt string)
                         _gh.init(
                                  _gh.len(),
@@ -2309,7 +2258,10 @@ public:
                                  _gh.ftabChars(),
                                  0,
                                  _gh.entireReverse());
-                        buildToDisk(*pg, s, out1, out2);
+                        {
+                            BuildPhase phase("gbwt");
+                            buildToDisk(*pg, s, out1, out2);
+                        }
                         delete pg; pg = NULL;
                         delete graph; graph = NULL;
                     }
@@ -2318,9 +2270,18 @@ public:
                         cerr << "An error occurred writing the index to disk.  Please check if the disk is full." << endl;
                         throw 1;
                     }
+                    if(_alts.empty() && !_useSais) {
+                        gBuildReport.setting("bmax", (int64_t)bmax);
+                        gBuildReport.setting("dcv", dcv);
+                    }
+                    gBuildReport.setting("sa_attempts", iter);
                     break;
                 } catch(bad_alloc& e) {
-                    if(_passMemExc) {
+                    if(_alts.empty() && _useSais) {
+                        cerr << "Out of memory while constructing suffix array with SA-IS; falling back to" << endl
+                        << "the blockwise builder." << endl;
+                        _useSais = false;
+                    } else if(_passMemExc) {
                         VMSG_NL("  Ran out of memory; automatically trying more memory-economical parameters.");
                     } else {
                         cerr << "Out of memory while constructing suffix array.  Please try using a smaller" << endl
@@ -2506,6 +2467,8 @@ public:
 		_eftab.free();
 		_rstarts.free();
 		_offs.free(); // might not be under control of APtrWrap
+		_offsPacked.free();
+		_offsBits = 0;
 		_gfm.free(); // might not be under control of APtrWrap
 		// Keep plen; it's small and the client may want to seq it
 		// even when the others are evicted.
@@ -2515,6 +2478,117 @@ public:
         _zGbwtBpOffs.clear();
 	}
 
+	/**
+	 * Hold the SA sample bit-packed, at just enough bits per sample for
+	 * the largest offset, when it is next loaded.  Ignored for samples
+	 * placed in shared memory and on big-endian hosts.
+	 */
+	void setPackedOffs(bool pack) {
+		_packOffs = pack;
+	}
+	
+	/// Return true iff the SA sample is loaded, packed or not
+	bool hasOffs() const {
+		return offs() != NULL || _offsBits > 0;
+	}
+	
+	/// Return the # of bits per packed SA sample, or 0 if not packed
+	int offsBits() const {
+		return _offsBits;
+	}
+	
+	/**
+	 * Return SA sample i, whether or not the sample is packed.
+	 */
+	inline index_t offAt(index_t i) const {
+		assert_lt(i, _gh._offsLen);
+		if(_offsBits == 0) return offs()[i];
+		const uint64_t bit = (uint64_t)i * (uint64_t)_offsBits;
+		const uint64_t mask = (1ULL << _offsBits) - 1;
+		uint64_t w;
+		memcpy(&w, _offsPacked.get() + (bit >> 3), sizeof(w));
+		w = (w >> (bit & 7)) & mask;
+		return w == mask ? (index_t)INDEX_MAX : (index_t)w;
+	}
+	
+	/**
+	 * Return the # of bits needed for packed samples of an index whose
+	 * offsets are below 'gbwtLen', or 0 if they can't be packed.  Each
+	 * sample must fit in a 64-bit load starting at its first byte.
+	 */
+	static int packedOffsBits(index_t gbwtLen) {
+		int bits = 1;
+		while(bits < 64 && ((1ULL << bits) - 1) <= (uint64_t)gbwtLen) bits++;
+		return (bits <= 57 && bits < (int)(sizeof(index_t) * 8)) ? bits : 0;
+	}
+	
+	/**
+	 * Store 'val' as packed sample i of 'buf', which must be zeroed.
+	 */
+	static inline void putPackedOff(uint8_t* buf, int bits, uint64_t i, index_t val) {
+		const uint64_t bit = i * (uint64_t)bits;
+		const uint64_t mask = (1ULL << bits) - 1;
+		uint64_t v = (val == (index_t)INDEX_MAX) ? mask : (uint64_t)val;
+		assert_leq(v, mask);
+		uint64_t w;
+		memcpy(&w, buf + (bit >> 3), sizeof(w));
+		w |= v << (bit & 7);
+		memcpy(buf + (bit >> 3), &w, sizeof(w));
+	}
+	
+	/**
+	 * Set the # of threads that read the large arrays (BWT, SA sample
+	 * and, for hierarchical indexes, the local indexes) in parallel
+	 * when the index is loaded.
+	 */
+	void setThreads(int nthreads) {
+		_nthreads = max(nthreads, 1);
+	}
+
+	// Layout of a deep ftab aux byte: the similar_range and same_range
+	// counters HI_Aligner::partialSearch would hold after consuming the
+	// k-mer; DFTAB_SAME_CLEARED means anchorStop_ was dropped on the way
+	static const uint8_t DFTAB_SIMILAR_MASK = 0x7;
+	static const int     DFTAB_SAME_SHIFT = 3;
+	static const uint8_t DFTAB_SAME_CLEARED = 5;
+
+	/**
+	 * Return the # of characters consumed by the deep ftab, or 0 if
+	 * none is loaded.
+	 */
+	int32_t dftabChars() const {
+		return _dftab.empty() ? 0 : _dftabChars;
+	}
+
+	/**
+	 * Look up the BWT range of the dftabChars() characters of 'seq'
+	 * starting at 'off' in the deep ftab.  Returns false if any of them
+	 * is an N or a base absent from the reference, in which case the
+	 * caller has to fall back on the regular ftab.
+	 */
+	bool dftabLoHi(
+		const BTDnaString& seq,
+		index_t off,
+		index_t& top,
+		index_t& bot,
+		uint8_t& aux) const
+	{
+		assert(!_dftab.empty());
+		assert_leq(off + _dftabChars, seq.length());
+		index_t di = 0;
+		for(int32_t i = 0; i < _dftabChars; i++) {
+			int c = seq[off + i];
+			if(c > 3 || _dftabDigit[c] < 0) {
+				return false;
+			}
+			di = di * _dftabAlpha + (index_t)_dftabDigit[c];
+		}
+		top = _dftab[di*2];
+		bot = _dftab[di*2+1];
+		aux = _dftabAux[di];
+		return true;
+	}
+
 	/**
 	 * Turn a substring of 'seq' starting at offset 'off' and having
 	 * length equal to the index's 'ftabChars' into an int that can be
@@ -2671,14 +2745,14 @@ public:
 	 * it cannot be resolved immediately, return 0xffffffff.
 	 */
 	index_t tryOffset(index_t elt, index_t node) const {
-		assert(offs() != NULL);
+		assert(hasOffs());
         for(index_t i = 0; i < _zOffs.size(); i++) {
             if(elt == _zOffs[i]) return 0;
         }
 		if((node & _gh._offMask) == node) {
 			index_t nodeOff = node >> _gh._offRate;
 			assert_lt(nodeOff, _gh._offsLen);
-			index_t off = offs()[nodeOff];
+			index_t off = offAt(nodeOff);
 			return off;
 		} else {
 			// Try looking at zoff
@@ -2852,10 +2926,12 @@ public:
 			out << "non-NULL, [0] = " << eftab()[0] << endl;
 		}
 		out << "    offs: ";
-		if(offs() == NULL) {
+		if(!hasOffs()) {
 			out << "NULL" << endl;
 		} else {
-			out << "non-NULL, [0] = " << offs()[0] << endl;
+			out << "non-NULL, [0] = " << offAt(0);
+			if(_offsBits > 0) out << " (" << _offsBits << "-bit packed)";
+			out << endl;
 		}
 	}
 
@@ -2870,6 +2946,14 @@ public:
 	void readIntoMemory(int needEntireRev, bool loadSASamp, bool loadFtab, bool loadRstarts, bool justHeader, GFMParams<index_t> *params, bool mmSweep, bool loadNames, bool startVerbose, bool subIndex = false);
 	void writeFromMemory(bool justHeader, ostream& out1, ostream& out2) const;
 	void writeFromMemory(bool justHeader, const string& out1, const string& out2) const;
+	int32_t openOffsCompanion(FILE*& in, bool& switchEndian, index_t& offsLen) const;
+	void writeOffsCompanion(int32_t denseOffRate, bool verbose = false) const;
+	bool loadDeepFtab(bool verbose = false);
+	void writeDeepFtab(int32_t dftabChars, bool verbose = false) const;
+	void fillDeepFtab(int32_t dftabChars, const int *digit, index_t alpha, int32_t dep,
+	                  index_t top, index_t bot, index_t key, index_t weight,
+	                  uint8_t similar, uint8_t same,
+	                  EList<index_t>& dftab, EList<uint8_t>& aux) const;
 
 	// Sanity checking
 	void sanityCheckUpToSide(int upToSide) const;
@@ -4216,6 +4300,10 @@ public:
 	FILE       *_in2;   // input fd for secondary index file
 	string     _in1Str; // filename for primary index file
 	string     _in2Str; // filename for secondary index file
+	IndexFileLoc _in1Loc; // where the primary index file's bytes are
+	IndexFileLoc _in2Loc; // where the secondary index file's bytes are
+	string     _offsStr; // filename for optional denser SA sample
+	string     _dftabStr; // filename for optional deep ftab
     EList<index_t> _zOffs;
 	EList<index_t> _zGbwtByteOffs;
 	EList<int>     _zGbwtBpOffs;
@@ -4234,6 +4322,20 @@ public:
 	// offset every 16 rows), the total size of _offs is the same as
 	// the total size of the input sequence
     APtrWrap<index_t> _offs;
+	// Bit-packed alternative to _offs (see setPackedOffs()): sample i
+	// occupies bits [i*_offsBits, (i+1)*_offsBits) of _offsPacked, and
+	// the all-ones value stands for INDEX_MAX.  _offsBits is 0 when the
+	// samples are held in _offs
+	int               _offsBits;
+	APtrWrap<uint8_t> _offsPacked;
+	bool              _packOffs; // pack the SA sample when it's loaded
+	// Optional deep ftab (see loadDeepFtab()): BWT ranges of every
+	// _dftabChars-mer over the bases actually present in the reference
+	int32_t        _dftabChars;
+	index_t        _dftabAlpha;    // # of bases present in the reference
+	int            _dftabDigit[4]; // base -> digit, or -1 if absent
+	EList<index_t> _dftab;         // [top, bot) pairs
+	EList<uint8_t> _dftabAux;      // partialSearch counters, see DFTAB_*
 
     // _ebwt is the Extended Burrows-Wheeler Transform itself, and thus
 	// is at least as large as the input sequence.
@@ -4245,6 +4347,9 @@ public:
     char *mmFile1_;
 	char *mmFile2_;
     int _nthreads;
+    size_t _pathGraphMem; /// bytes of path nodes held while building the graph; 0 = no limit
+    bool _useSais;        /// build suffix arrays of linear indexes with SA-IS
+    const Checkpoint* _checkpoint; /// save/restore build phases here, if not NULL
 	GFMParams<index_t> _gh;
 	bool packed_;
 
@@ -4387,14 +4492,14 @@ void readEbwtRefnames(istream& in, EList<string>& refnames) {
 template <typename index_t>
 void readEbwtRefnames(const string& instr, EList<string>& refnames) {
     ifstream in;
+    IndexFileLoc loc;
     // Initialize our primary and secondary input-stream fields
-    in.open((instr + ".1." + gfm_ext).c_str(), ios_base::in | ios::binary);
-    if(!in.is_open()) {
+    if(!openIndexFile(instr + ".1." + gfm_ext, in, loc)) {
         throw GFMFileOpenException("Cannot open file " + instr);
     }
     assert(in.is_open());
     assert(in.good());
-    assert_eq((streamoff)in.tellg(), ios::beg);
+    assert_eq((uint64_t)in.tellg(), loc.off);
     readEbwtRefnames<index_t>(in, refnames);
 }
 
@@ -5463,6 +5568,120 @@ inline bool is_fread_err(FILE* file_hd, size_t ret, size_t count) {
     return false;
 }
 
+struct ReadSliceParam {
+    int            fd;
+    char           *dst;
+    uint64_t       fileOff;  // file offset of dst[0]
+    uint64_t       len;
+    uint64_t       sliceSz;
+    int            tid;
+    int            nthreads;
+    uint64_t       *done;    // bytes read so far by all threads
+    MUTEX_T        *mutex;
+    const char     *what;
+    bool           verbose;
+    bool           ok;
+    int            err;      // errno of the failed pread(), 0 at end of file
+};
+
+/**
+ * Read every nthreads-th slice of a large array, starting with slice
+ * 'tid', and report progress in quarters if asked to.
+ */
+static inline void readSlice_worker(void *vp) {
+    ReadSliceParam *p = (ReadSliceParam*)vp;
+    p->ok = true;
+    p->err = 0;
+    for(uint64_t lo = p->tid * p->sliceSz; lo < p->len; lo += p->nthreads * p->sliceSz) {
+        uint64_t bytesLeft = min<uint64_t>(p->sliceSz, p->len - lo);
+        char *dst = p->dst + lo;
+        off_t off = (off_t)(p->fileOff + lo);
+        while(bytesLeft > 0) {
+            ssize_t r = pread(p->fd, dst, bytesLeft, off);
+            if(r <= 0) {
+                p->ok = false;
+                p->err = (r < 0 ? errno : 0);
+                return;
+            }
+            dst += r; off += r;
+            bytesLeft -= r;
+        }
+        uint64_t sz = min<uint64_t>(p->sliceSz, p->len - lo);
+        uint64_t before = __atomic_fetch_add(p->done, sz, __ATOMIC_RELAXED);
+        if(p->verbose && (before * 4 / p->len) != ((before + sz) * 4 / p->len)) {
+            ThreadSafe t(p->mutex);
+            cerr << "  Read " << ((before + sz) * 4 / p->len) * 25 << "% of " << p->what << ": ";
+            logTime(cerr);
+        }
+    }
+}
+
+/**
+ * Read 'len' bytes at the current position of 'in' into 'dst', with
+ * 'nthreads' threads each pread()ing their share of 64MB slices, and
+ * leave 'in' positioned just past them.  Returns false on an I/O error.
+ */
+static inline bool readParallel(
+    FILE *in,
+    char *dst,
+    uint64_t len,
+    int nthreads,
+    const char *what,
+    bool verbose)
+{
+    const uint64_t sliceSz = 64 << 20;
+    off_t start = ftello(in);
+    if(start < 0) return false;
+    if(nthreads > (int)((len + sliceSz - 1) / sliceSz)) {
+        nthreads = (int)((len + sliceSz - 1) / sliceSz);
+    }
+    uint64_t done = 0;
+    MUTEX_T mutex;
+    EList<ReadSliceParam> tparams;
+    tparams.resizeExact(max(nthreads, 1));
+    for(int i = 0; i < (int)tparams.size(); i++) {
+        ReadSliceParam& p = tparams[i];
+        p.fd = fileno(in);
+        p.dst = dst;
+        p.fileOff = (uint64_t)start;
+        p.len = len;
+        p.sliceSz = sliceSz;
+        p.tid = i;
+        p.nthreads = (int)tparams.size();
+        p.done = &done;
+        p.mutex = &mutex;
+        p.what = what;
+        p.verbose = verbose;
+        p.ok = false;
+        p.err = 0;
+    }
+    if(tparams.size() == 1) {
+        readSlice_worker((void*)&tparams[0]);
+    } else {
+        AutoArray<tthread::thread*> threads(tparams.size());
+        for(size_t i = 0; i < tparams.size(); i++) {
+            threads[i] = new tthread::thread(readSlice_worker, (void*)&tparams[i]);
+        }
+        for(size_t i = 0; i < tparams.size(); i++) {
+            threads[i]->join();
+            delete threads[i];
+        }
+    }
+    for(size_t i = 0; i < tparams.size(); i++) {
+        if(tparams[i].ok) continue;
+        // errno belongs to the thread that failed, so report its own
+        std::stringstream sstm;
+        if(tparams[i].err != 0) {
+            sstm << " ERRNO: " << tparams[i].err << " ERR Msg:" << strerror(tparams[i].err);
+        } else {
+            sstm << " ERR Msg: unexpected end of file";
+        }
+        gLastIOErrMsg = sstm.str();
+        return false;
+    }
+    return fseeko(in, start + (off_t)len, SEEK_SET) == 0;
+}
+
 
 ///////////////////////////////////////////////////////////////////////
 //
@@ -5610,7 +5829,7 @@ bool GFM<index_t>::textOffToJoined(
  */
 template <typename index_t>
 index_t GFM<index_t>::walkLeft(index_t row, index_t steps) const {
-	assert(offs() != NULL);
+	assert(hasOffs());
 	assert_neq((index_t)INDEX_MAX, row);
 	SideLocus<index_t> l;
 	if(steps > 0) l.initFromRow(row, _gh, gfm());
@@ -5634,13 +5853,13 @@ index_t GFM<index_t>::walkLeft(index_t row, index_t steps) const {
  */
 template <typename index_t>
 index_t GFM<index_t>::getOffset(index_t row, index_t node) const {
-	assert(offs() != NULL);
+	assert(hasOffs());
 	assert_neq((index_t)INDEX_MAX, row);
     for(index_t i = 0; i < _zOffs.size(); i++) {
         if(row == _zOffs[i]) return 0;
     }
     if((node & _gh._offMask) == node) {
-        index_t off = this->offs()[node >> _gh._offRate];
+        index_t off = this->offAt(node >> _gh._offRate);
         if(off != (index_t)INDEX_MAX)
             return off;
     }
@@ -5660,7 +5879,7 @@ index_t GFM<index_t>::getOffset(index_t row, index_t node) const {
         }
         
         if((node_range.first & _gh._offMask) == node_range.first) {
-            index_t off = this->offs()[node_range.first >> _gh._offRate];
+            index_t off = this->offAt(node_range.first >> _gh._offRate);
             if(off != (index_t)INDEX_MAX)
                 return jumps + off;
 		}
@@ -5798,13 +6017,13 @@ void GFM<index_t>::readIntoMemory(
         // Initialize our primary and secondary input-stream fields
         if(_in1 != NULL) fclose(_in1);
         if(_verbose || startVerbose) cerr << "Opening \"" << _in1Str.c_str() << "\"" << endl;
-        if((_in1 = fopen(_in1Str.c_str(), "rb")) == NULL) {
+        if((_in1 = openIndexFile(_in1Str, _in1Loc)) == NULL) {
             cerr << "Could not open index file " << _in1Str.c_str() << endl;
         }
         if(loadSASamp) {
             if(_in2 != NULL) fclose(_in2);
             if(_verbose || startVerbose) cerr << "Opening \"" << _in2Str.c_str() << "\"" << endl;
-            if((_in2 = fopen(_in2Str.c_str(), "rb")) == NULL) {
+            if((_in2 = openIndexFile(_in2Str, _in2Loc)) == NULL) {
                 cerr << "Could not open index file " << _in2Str.c_str() << endl;
             }
         }
@@ -5816,20 +6035,14 @@ void GFM<index_t>::readIntoMemory(
 #ifdef BOWTIE_MM
         if(_useMm /*&& !justHeader*/) {
             const char *names[] = {_in1Str.c_str(), _in2Str.c_str()};
+            const IndexFileLoc *locs[] = {&_in1Loc, &_in2Loc};
             int fds[] = { fileno(_in1), fileno(_in2) };
             for(int i = 0; i < (loadSASamp ? 2 : 1); i++) {
                 if(_verbose || startVerbose) {
                     cerr << "  Memory-mapping input file " << (i+1) << ": ";
                     logTime(cerr);
                 }
-                struct stat sbuf;
-                if (stat(names[i], &sbuf) == -1) {
-                    perror("stat");
-                    cerr << "Error: Could not stat index file " << names[i] << " prior to memory-mapping" << endl;
-                    throw 1;
-                }
-                mmFile[i] = (char*)mmap((void *)0, (size_t)sbuf.st_size,
-                                        PROT_READ, MAP_SHARED, fds[(size_t)i], 0);
+                mmFile[i] = mmapIndexFile(*locs[i], fds[(size_t)i]);
                 if(mmFile[i] == (void *)(-1)) {
                     perror("mmap");
                     cerr << "Error: Could not memory-map the index file " << names[i] << endl;
@@ -5837,7 +6050,7 @@ void GFM<index_t>::readIntoMemory(
                 }
                 if(mmSweep) {
                     int sum = 0;
-                    for(off_t j = 0; j < sbuf.st_size; j += 1024) {
+                    for(uint64_t j = 0; j < locs[i]->len; j += 1024) {
                         sum += (int) mmFile[i][j];
                     }
                     if(startVerbose) {
@@ -5965,13 +6178,30 @@ void GFM<index_t>::readIntoMemory(
         deleteGh = true;
     }
     
-    // Set up overridden suffix-array-sample parameters
+    // Set up overridden suffix-array-sample parameters.  A rate sparser
+    // than the built one is obtained by keeping every 2^k-th sample; a
+    // denser one is read (and possibly subsampled) from the companion
+    // .offs file written by writeOffsCompanion().
     index_t offsLen = gh->_offsLen;
     index_t offRateDiff = 0;
-    index_t offsLenSampled = offsLen;
-    if(_overrideOffRate > offRate) {
+    FILE *offsIn = _in2;
+    bool offsSwitchEndian = switchEndian;
+    if(loadSASamp && !justHeader && _overrideOffRate >= 0 && _overrideOffRate < offRate) {
+        index_t denseOffsLen = 0;
+        offsIn = NULL;
+        int32_t denseOffRate = openOffsCompanion(offsIn, offsSwitchEndian, denseOffsLen);
+        if(denseOffRate < 0 || denseOffRate > _overrideOffRate) {
+            cerr << "Error: offrate " << _overrideOffRate << " requires " << _offsStr.c_str()
+                 << " built with offrate <= " << _overrideOffRate << endl;
+            if(offsIn != NULL) fclose(offsIn);
+            throw 1;
+        }
+        offsLen = denseOffsLen;
+        offRateDiff = _overrideOffRate - denseOffRate;
+    } else if(_overrideOffRate > offRate) {
         offRateDiff = _overrideOffRate - offRate;
     }
+    index_t offsLenSampled = offsLen;
     if(offRateDiff > 0) {
         offsLenSampled >>= offRateDiff;
         if((offsLen & ~(((index_t)INDEX_MAX) << offRateDiff)) != 0) {
@@ -6032,13 +6262,8 @@ void GFM<index_t>::readIntoMemory(
     if(justHeader) {
         // Be kind
         if(deleteGh) delete gh;
-#ifdef BOWTIE_MM
-        fseek(_in1, 0, SEEK_SET);
-        if(loadSASamp) fseek(_in2, 0, SEEK_SET);
-#else
-        rewind(_in1);
-        if(loadSASamp) rewind(_in2);
-#endif
+        fseeko(_in1, (off_t)_in1Loc.off, SEEK_SET);
+        if(loadSASamp) fseeko(_in2, (off_t)_in2Loc.off, SEEK_SET);
         return;
     }
     
@@ -6121,6 +6346,13 @@ void GFM<index_t>::readIntoMemory(
             // Read ebwt from primary stream
             uint64_t bytesLeft = gh->_gbwtTotLen;
             char *pgbwt = (char*)this->gfm();
+            if(_nthreads > 1) {
+                if(!readParallel(_in1, pgbwt, bytesLeft, _nthreads, "ebwt", _verbose || startVerbose)) {
+                    cerr << "Error reading _ebwt[] array: " << gLastIOErrMsg << endl;
+                    throw 1;
+                }
+                bytesLeft = 0;
+            }
             while (bytesLeft>0){
                 size_t r = MM_READ(this->_in1, (void *)pgbwt, bytesLeft);
                 if(MM_IS_IO_ERR(this->_in1, r, bytesLeft)) {
@@ -6286,16 +6518,41 @@ void GFM<index_t>::readIntoMemory(
     }
     
     _offs.reset();
+    _offsPacked.reset();
+    _offsBits = 0;
     if(loadSASamp) {
         bytesRead = 4; // reset for secondary index file (already read 1-sentinel)
         
+        // A packed sample is private to this process, so it can't go
+        // in shared memory; packing is done with little-endian loads
+        int packBits = 0;
+        if(_packOffs) {
+            if(useShmem_ || currentlyBigEndian()) {
+                cerr << "Warning: SA sample can't be packed with shared memory or on big-endian hosts; storing it unpacked" << endl;
+            } else {
+                packBits = packedOffsBits(gh->_gbwtLen);
+            }
+        }
+        
         shmemLeader = true;
         if(_verbose || startVerbose) {
-            cerr << "Reading offs (" << offsLenSampled << " " << std::setw(2) << sizeof(index_t)*8 << "-bit words): ";
+            cerr << "Reading offs (" << offsLenSampled << " " << std::setw(2) << (packBits > 0 ? packBits : (int)sizeof(index_t)*8) << "-bit words): ";
             logTime(cerr);
         }
         
-        if(!_useMm) {
+        // Only a sample used verbatim from the .2 file can stay mapped
+        bool offsMapped = _useMm && offsIn == _in2 && offRateDiff == 0 && packBits == 0;
+        if(packBits > 0) {
+            // Padded so that the last sample can be read with a 64-bit load
+            const size_t packedSz = (size_t)(((uint64_t)offsLenSampled * packBits + 7) >> 3) + 8;
+            try {
+                _offsPacked.init(new uint8_t[packedSz](), packedSz, true);
+            } catch(bad_alloc& e) {
+                cerr << "Out of memory allocating the packed offs[] array  for the Bowtie index." << endl
+                << "Please try again on a computer with more memory." << endl;
+                throw 1;
+            }
+        } else if(!offsMapped) {
             if(!useShmem_) {
                 // Allocate offs_
                 try {
@@ -6308,7 +6565,7 @@ void GFM<index_t>::readIntoMemory(
             } else {
                 index_t *tmp = NULL;
                 shmemLeader = ALLOC_SHARED_U32(
-                                               (_in2Str + "[offs]"), offsLenSampled*sizeof(index_t), &tmp,
+                                               ((offsIn == _in2 ? _in2Str : _offsStr) + "[offs]"), offsLenSampled*sizeof(index_t), &tmp,
                                                "offs", (_verbose || startVerbose));
                 _offs.init((index_t*)tmp, offsLenSampled, false);
             }
@@ -6317,8 +6574,8 @@ void GFM<index_t>::readIntoMemory(
         if(_overrideOffRate < 32) {
             if(shmemLeader) {
                 // Allocate offs (big allocation)
-                if(switchEndian || offRateDiff > 0) {
-                    assert(!_useMm);
+                if(offsSwitchEndian || offRateDiff > 0 || packBits > 0) {
+                    assert(!offsMapped);
                     const index_t blockMaxSz = (index_t)(2 * 1024 * 1024); // 2 MB block size
                     const index_t blockMaxSzU = (blockMaxSz / sizeof(index_t)); // # U32s per block
                     char *buf;
@@ -6330,7 +6587,7 @@ void GFM<index_t>::readIntoMemory(
                     }
                     for(index_t i = 0; i < offsLen; i += blockMaxSzU) {
                         index_t block = min<index_t>((index_t)blockMaxSzU, (index_t)(offsLen - i));
-                        size_t r = MM_READ(_in2, (void *)buf, block * sizeof(index_t));
+                        size_t r = MM_READ(offsIn, (void *)buf, block * sizeof(index_t));
                         if(r != (size_t)(block * sizeof(index_t))) {
                             cerr << "Error reading block of _offs[] array: " << r << ", " << (block * sizeof(index_t)) << endl;
                             throw 1;
@@ -6338,16 +6595,22 @@ void GFM<index_t>::readIntoMemory(
                         index_t idx = i >> offRateDiff;
                         for(index_t j = 0; j < block; j += (1 << offRateDiff)) {
                             assert_lt(idx, offsLenSampled);
-                            this->offs()[idx] = ((index_t*)buf)[j];
-                            if(switchEndian) {
-                                this->offs()[idx] = endianSwapIndex(this->offs()[idx]);
+                            index_t off = ((index_t*)buf)[j];
+                            if(offsSwitchEndian) {
+                                off = endianSwapIndex(off);
+                            }
+                            if(packBits > 0) {
+                                putPackedOff(_offsPacked.get(), packBits, idx, off);
+                            } else {
+                                this->offs()[idx] = off;
                             }
                             idx++;
                         }
                     }
                     delete[] buf;
+                    _offsBits = packBits;
                 } else {
-                    if(_useMm) {
+                    if(offsMapped) {
 #ifdef BOWTIE_MM
                         _offs.init((index_t*)(mmFile[1] + bytesRead), offsLen, false);
                         bytesRead += (offsLen * sizeof(index_t));
@@ -6359,10 +6622,17 @@ void GFM<index_t>::readIntoMemory(
                         // bytes.
                         uint64_t bytesLeft = (offsLen * sizeof(index_t));
                         char *offs = (char *)this->offs();
+                        if(_nthreads > 1) {
+                            if(!readParallel(offsIn, offs, bytesLeft, _nthreads, "offs", _verbose || startVerbose)) {
+                                cerr << "Error reading block of _offs[] array: " << gLastIOErrMsg << endl;
+                                throw 1;
+                            }
+                            bytesLeft = 0;
+                        }
                         
                         while(bytesLeft > 0) {
-                            size_t r = MM_READ(_in2, (void*)offs, bytesLeft);
-                            if(MM_IS_IO_ERR(_in2,r,bytesLeft)) {
+                            size_t r = MM_READ(offsIn, (void*)offs, bytesLeft);
+                            if(MM_IS_IO_ERR(offsIn,r,bytesLeft)) {
                                 cerr << "Error reading block of _offs[] array: "
                                 << r << ", " << bytesLeft << gLastIOErrMsg << endl;
                                 throw 1;
@@ -6377,12 +6647,13 @@ void GFM<index_t>::readIntoMemory(
 #endif
             } else {
                 // Not the shmem leader
-                fseek(_in2, offsLenSampled*sizeof(index_t), SEEK_CUR);
+                fseek(offsIn, offsLenSampled*sizeof(index_t), SEEK_CUR);
 #ifdef BOWTIE_SHARED_MEM
                 if(useShmem_) WAIT_SHARED(offs(), offsLenSampled*sizeof(index_t));
 #endif
             }
         }
+        if(offsIn != _in2) fclose(offsIn);
     }
     
     this->postReadInit(*gh); // Initialize fields of Ebwt not read from file
@@ -6396,13 +6667,310 @@ void GFM<index_t>::readIntoMemory(
     if(deleteGh) delete gh;
     
     if(!subIndex) {
-#ifdef BOWTIE_MM
-        fseek(_in1, 0, SEEK_SET);
-        if(loadSASamp) fseek(_in2, 0, SEEK_SET);
-#else
-        rewind(_in1);
-        if(loadSASamp) rewind(_in2);
-#endif
+        fseeko(_in1, (off_t)_in1Loc.off, SEEK_SET);
+        if(loadSASamp) fseeko(_in2, (off_t)_in2Loc.off, SEEK_SET);
+    }
+}
+
+/**
+ * Open the optional companion SA sample (<base>.offs.ht2) and read its
+ * header, leaving 'in' positioned at the first sample.  Returns the
+ * companion's offRate, or -1 if it is missing or does not belong to
+ * this index.  The caller owns 'in' (if non-NULL) and must close it.
+ */
+template <typename index_t>
+int32_t GFM<index_t>::openOffsCompanion(
+                                        FILE*& in,
+                                        bool& switchEndian,
+                                        index_t& offsLen) const
+{
+    in = NULL;
+    if(_offsStr.empty()) return -1;
+    IndexFileLoc loc;
+    if((in = openIndexFile(_offsStr, loc)) == NULL) return -1;
+    switchEndian = false;
+    uint32_t one = readU32(in, switchEndian);
+    if(one != 1) {
+        assert_eq(1, endianSwapU32(one));
+        switchEndian = true;
+    }
+    int32_t denseOffRate = readI32(in, switchEndian);
+    offsLen = readIndex<index_t>(in, switchEndian);
+    index_t gbwtLen = readIndex<index_t>(in, switchEndian);
+    if(denseOffRate < 0 ||
+       gbwtLen != _gh._gbwtLen ||
+       offsLen != ((gbwtLen + (1 << denseOffRate) - 1) >> denseOffRate)) {
+        cerr << "Warning: " << _offsStr.c_str() << " does not match " << _in1Str.c_str() << "; ignoring it" << endl;
+        return -1;
+    }
+    return denseOffRate;
+}
+
+/**
+ * Write a companion SA sample with rate 'denseOffRate' (denser than the
+ * index's own) to <base>.offs.ht2, resolving every sampled row by
+ * walking the in-memory index.  Only linear (non-graph) indexes are
+ * supported since there every BWT row is its own node.
+ */
+template <typename index_t>
+void GFM<index_t>::writeOffsCompanion(int32_t denseOffRate, bool verbose) const
+{
+    assert(isInMemory());
+    assert(hasOffs());
+    if(!_gh.linearFM()) {
+        cerr << "Error: a denser SA sample can only be built for indexes without SNPs or splice sites" << endl;
+        throw 1;
+    }
+    if(denseOffRate < 0 || denseOffRate >= _gh._offRate) {
+        cerr << "Error: the SA sample rate must be less than the index's offrate (" << _gh._offRate << ")" << endl;
+        throw 1;
+    }
+    ofstream fout(_offsStr.c_str(), ios::binary);
+    if(!fout.good()) {
+        cerr << "Could not open index file for writing: \"" << _offsStr.c_str() << "\"" << endl;
+        throw 1;
+    }
+    bool be = this->toBe();
+    index_t gbwtLen = _gh._gbwtLen;
+    index_t denseOffsLen = (gbwtLen + (1 << denseOffRate) - 1) >> denseOffRate;
+    writeI32(fout, 1, be); // endian hint
+    writeI32(fout, denseOffRate, be);
+    writeIndex<index_t>(fout, denseOffsLen, be);
+    writeIndex<index_t>(fout, gbwtLen, be);
+    if(verbose) {
+        cerr << "Writing " << denseOffsLen << " SA samples (1 in " << (1 << denseOffRate)
+             << ") to " << _offsStr.c_str() << endl;
+    }
+    for(index_t i = 0; i < denseOffsLen; i++) {
+        index_t row = i << denseOffRate;
+        writeIndex<index_t>(fout, getOffset(row, row), be);
+    }
+    fout.close();
+    if(fout.fail()) {
+        cerr << "An error occurred writing " << _offsStr.c_str() << ".  Please check if the disk is full." << endl;
+        throw 1;
+    }
+}
+
+/**
+ * Load <base>.dftab.ht2, written by writeDeepFtab(), so that seed
+ * searches can start dftabChars() characters deep instead of
+ * _ftabChars.  Returns false (leaving the regular ftab in charge) if
+ * the file is missing or was built from a different index.
+ */
+template <typename index_t>
+bool GFM<index_t>::loadDeepFtab(bool verbose)
+{
+    IndexFileLoc loc;
+    FILE *in = openIndexFile(_dftabStr, loc);
+    if(in == NULL) {
+        cerr << "Warning: could not open deep ftab " << _dftabStr.c_str() << "; using the regular ftab" << endl;
+        return false;
+    }
+    bool switchEndian = false;
+    uint32_t one = readU32(in, switchEndian);
+    if(one != 1) {
+        assert_eq(1, endianSwapU32(one));
+        switchEndian = true;
+    }
+    int32_t dftabChars = readI32(in, switchEndian);
+    int32_t ftabChars = readI32(in, switchEndian);
+    index_t gbwtLen = readIndex<index_t>(in, switchEndian);
+    index_t alpha = 0;
+    for(int c = 0; c < 4; c++) {
+        _dftabDigit[c] = readI32(in, switchEndian);
+        if(_dftabDigit[c] >= 0) alpha++;
+    }
+    index_t nent = readIndex<index_t>(in, switchEndian);
+    index_t expected = 1;
+    for(int32_t i = 0; i < dftabChars; i++) expected *= alpha;
+    if(ftabChars != _gh._ftabChars || gbwtLen != _gh._gbwtLen || nent != expected) {
+        cerr << "Warning: " << _dftabStr.c_str() << " does not match " << _in1Str.c_str() << "; using the regular ftab" << endl;
+        fclose(in);
+        return false;
+    }
+    if(verbose) {
+        cerr << "Reading deep ftab (" << dftabChars << " chars, " << nent << " entries) from "
+             << _dftabStr.c_str() << endl;
+    }
+    try {
+        _dftab.resizeExact(nent * 2);
+        _dftabAux.resizeExact(nent);
+    } catch(bad_alloc& e) {
+        cerr << "Out of memory allocating the deep ftab[] in Ebwt::loadDeepFtab()"
+             << " at " << __FILE__ << ":" << __LINE__ << endl;
+        fclose(in);
+        throw e;
+    }
+    if(fread(_dftab.ptr(), sizeof(index_t), nent * 2, in) != nent * 2 ||
+       fread(_dftabAux.ptr(), 1, nent, in) != nent) {
+        cerr << "Error reading deep ftab from " << _dftabStr.c_str() << endl;
+        fclose(in);
+        throw 1;
+    }
+    fclose(in);
+    if(switchEndian) {
+        for(index_t i = 0; i < nent * 2; i++) {
+            _dftab[i] = endianSwapIndex(_dftab[i]);
+        }
+    }
+    _dftabChars = dftabChars;
+    _dftabAlpha = alpha;
+    return true;
+}
+
+/**
+ * Extend the BWT range [top, bot) of a 'dep'-character suffix one
+ * character to the left at a time, the same way
+ * HI_Aligner::partialSearch does, and record the range and the
+ * partialSearch counters for every 'dftabChars'-mer reached.
+ */
+template <typename index_t>
+void GFM<index_t>::fillDeepFtab(
+                                 int32_t dftabChars,
+                                 const int *digit,
+                                 index_t alpha,
+                                 int32_t dep,
+                                 index_t top,
+                                 index_t bot,
+                                 index_t key,
+                                 index_t weight,
+                                 uint8_t similar,
+                                 uint8_t same,
+                                 EList<index_t>& dftab,
+                                 EList<uint8_t>& aux) const
+{
+    if(dep == dftabChars) {
+        dftab[key*2] = top;
+        dftab[key*2+1] = bot;
+        aux[key] = (uint8_t)(similar | (same << DFTAB_SAME_SHIFT));
+        return;
+    }
+    // partialSearch starts with an empty node range after the ftab lookup
+    index_t prev = (dep == _gh._ftabChars ? 0 : bot - top);
+    for(int c = 0; c < 4; c++) {
+        if(digit[c] < 0) continue;
+        SideLocus<index_t> tloc, bloc;
+        pair<index_t, index_t> range;
+        if(bot - top == 1) {
+            tloc.initFromRow(top, gh(), gfm());
+            range = mapGLF1(top, tloc, c);
+        } else {
+            SideLocus<index_t>::initFromTopBot(top, bot, gh(), gfm(), tloc, bloc);
+            range = mapLF(tloc, bloc, c);
+        }
+        if(range.first >= range.second) continue;
+        index_t cur = range.second - range.first;
+        uint8_t nsimilar = similar, nsame = same;
+        // pseudogeneStop_ bookkeeping; it stops once the range is unique
+        if(cur != 1) {
+            if(cur + 2 >= prev) {
+                if(nsimilar < DFTAB_SIMILAR_MASK) nsimilar++;
+            } else if(cur + 4 < prev) {
+                nsimilar = 0;
+            }
+        }
+        // anchorStop_ bookkeeping
+        if(nsame != DFTAB_SAME_CLEARED) {
+            if(cur != 1 && prev == cur) {
+                nsame++;
+            } else {
+                nsame = 0;
+            }
+        }
+        fillDeepFtab(dftabChars, digit, alpha, dep + 1, range.first, range.second,
+                     key + (index_t)digit[c] * weight, weight * alpha, nsimilar, nsame, dftab, aux);
+    }
+}
+
+/**
+ * Write a deep ftab for 'dftabChars'-mers to <base>.dftab.ht2.  Only
+ * bases that occur in the reference are given a digit, so for a
+ * three-letter (base-converted) index the table has 3^dftabChars
+ * entries rather than 4^dftabChars.  Only linear (non-graph) indexes
+ * are supported.
+ */
+template <typename index_t>
+void GFM<index_t>::writeDeepFtab(int32_t dftabChars, bool verbose) const
+{
+    assert(isInMemory());
+    if(!_gh.linearFM()) {
+        cerr << "Error: a deep ftab can only be built for indexes without SNPs or splice sites" << endl;
+        throw 1;
+    }
+    if(dftabChars <= _gh._ftabChars || dftabChars > 16) {
+        cerr << "Error: the deep ftab must consume more characters than the index's ftab ("
+             << _gh._ftabChars << ") and at most 16" << endl;
+        throw 1;
+    }
+    int digit[4];
+    index_t alpha = 0;
+    for(int c = 0; c < 4; c++) {
+        digit[c] = (fchr()[c+1] > fchr()[c] ? (int)(alpha++) : -1);
+    }
+    index_t nent = 1;
+    for(int32_t i = 0; i < dftabChars; i++) {
+        if(nent > (index_t)INDEX_MAX / (alpha * 2)) {
+            cerr << "Error: a " << dftabChars << "-character deep ftab over " << alpha
+                 << " bases is too large for this index" << endl;
+            throw 1;
+        }
+        nent *= alpha;
+    }
+    EList<index_t> dftab(EBWT_CAT);
+    EList<uint8_t> aux(EBWT_CAT);
+    dftab.resizeExact(nent * 2);
+    dftab.fillZero();
+    aux.resizeExact(nent);
+    aux.fillZero();
+    if(verbose) {
+        cerr << "Building deep ftab (" << dftabChars << " chars over " << alpha
+             << " bases, " << nent << " entries)" << endl;
+    }
+    // Seed the extension with the regular ftab, exactly as the aligner does
+    int32_t fc = _gh._ftabChars;
+    index_t nfmer = 1;
+    for(int32_t i = 0; i < fc; i++) nfmer *= alpha;
+    int bases[4];
+    for(int c = 0; c < 4; c++) {
+        if(digit[c] >= 0) bases[digit[c]] = c;
+    }
+    for(index_t k = 0; k < nfmer; k++) {
+        // Both the ftab and the deep ftab put the leftmost (last
+        // consumed) character in the most significant position
+        index_t fi = 0, rest = k, weight = 1;
+        for(int32_t i = 0; i < fc; i++) {
+            fi |= ((index_t)bases[rest % alpha] << (2 * i));
+            rest /= alpha;
+            weight *= alpha;
+        }
+        index_t top = ftabHi(fi);
+        index_t bot = ftabLo(fi+1);
+        if(top >= bot) continue;
+        fillDeepFtab(dftabChars, digit, alpha, fc, top, bot, k, weight, 0, 0, dftab, aux);
+    }
+    ofstream fout(_dftabStr.c_str(), ios::binary);
+    if(!fout.good()) {
+        cerr << "Could not open index file for writing: \"" << _dftabStr.c_str() << "\"" << endl;
+        throw 1;
+    }
+    bool be = this->toBe();
+    writeI32(fout, 1, be); // endian hint
+    writeI32(fout, dftabChars, be);
+    writeI32(fout, fc, be);
+    writeIndex<index_t>(fout, _gh._gbwtLen, be);
+    for(int c = 0; c < 4; c++) {
+        writeI32(fout, digit[c], be);
+    }
+    writeIndex<index_t>(fout, nent, be);
+    for(index_t i = 0; i < nent * 2; i++) {
+        writeIndex<index_t>(fout, dftab[i], be);
+    }
+    fout.write((const char*)aux.ptr(), nent);
+    fout.close();
+    if(fout.fail()) {
+        cerr << "An error occurred writing " << _dftabStr.c_str() << ".  Please check if the disk is full." << endl;
+        throw 1;
     }
 }
 
@@ -6499,14 +7067,14 @@ void readGFMRefnames(istream& in, EList<string>& refnames) {
 template <typename index_t>
 void readGFMRefnames(const string& instr, EList<string>& refnames) {
     ifstream in;
+    IndexFileLoc loc;
     // Initialize our primary and secondary input-stream fields
-    in.open((instr + ".1." + gfm_ext).c_str(), ios_base::in | ios::binary);
-    if(!in.is_open()) {
+    if(!openIndexFile(instr + ".1." + gfm_ext, in, loc)) {
         throw GFMFileOpenException("Cannot open file " + instr);
     }
     assert(in.is_open());
     assert(in.good());
-    assert_eq((streamoff)in.tellg(), ios::beg);
+    assert_eq((uint64_t)in.tellg(), loc.off);
     readGFMRefnames<index_t>(in, refnames);
 }
 
@@ -6516,9 +7084,9 @@ void readGFMRefnames(const string& instr, EList<string>& refnames) {
 template <typename index_t>
 int32_t GFM<index_t>::readVersionFlags(const string& instr, int& major, int& minor, string& extra_version) {
     ifstream in;
+    IndexFileLoc loc;
     // Initialize our primary and secondary input-stream fields
-    in.open((instr + ".1." + gfm_ext).c_str(), ios_base::in | ios::binary);
-    if(!in.is_open()) {
+    if(!openIndexFile(instr + ".1." + gfm_ext, in, loc)) {
         throw GFMFileOpenException("Cannot open file " + instr);
     }
     assert(in.is_open());
@@ -6586,7 +7154,7 @@ void GFM<index_t>::writeFromMemory(bool justHeader,
     
     if(!justHeader) {
         assert(rstarts() != NULL);
-        assert(offs() != NULL);
+        assert(hasOffs());
         assert(ftab() != NULL);
         assert(eftab() != NULL);
         assert(isInMemory());
@@ -6613,7 +7181,7 @@ void GFM<index_t>::writeFromMemory(bool justHeader,
             writeIndex<index_t>(out1, _zOffs[i], be);
         index_t offsLen = gh._offsLen;
         for(index_t i = 0; i < offsLen; i++)
-            writeIndex<index_t>(out2, this->offs()[i], be);
+            writeIndex<index_t>(out2, this->offAt(i), be);
         
         // 'fchr', 'ftab' and 'eftab' are not fully determined until the
         // loop is finished, so they are written to the primary file after
@@ -6683,7 +7251,7 @@ void GFM<index_t>::writeFromMemory(bool justHeader,
         for(size_t i = 0; i < eh._eftabLen; i++)
             assert_eq(this->eftab()[i], copy.eftab()[i]);
         for(index_t i = 0; i < eh._offsLen; i++)
-            assert_eq(this->_offs[i], copy.offs()[i]);
+            assert_eq(this->offAt(i), copy.offAt(i));
         for(index_t i = 0; i < eh._ebwtTotLen; i++)
             assert_eq(this->ebwt()[i], copy.ebwt()[i]);
         copy.sanityCheckAll();
@@ -6804,9 +7372,10 @@ void GFM<index_t>::sanityCheckAll(int reverse) const {
     memset(seen, 0, 4 * seenLen);
     index_t offsLen = gh._offsLen;
     for(index_t i = 0; i < offsLen; i++) {
-        assert_lt(this->offs()[i], gh._gbwtLen);
-        int w = this->offs()[i] >> 5;
-        int r = this->offs()[i] & 31;
+        const index_t off = this->offAt(i);
+        assert_lt(off, gh._gbwtLen);
+        int w = off >> 5;
+        int r = off & 31;
         assert_eq(0, (seen[w] >> r) & 1); // shouldn't have been seen before
         seen[w] |= (1 << r);
     }
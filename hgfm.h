@@ -1601,7 +1601,9 @@ public:
                  useHaplotype,
                  skipLoading),
     _in5(NULL),
-    _in6(NULL)
+    _in6(NULL),
+    _lazyLocal(false),
+    _localMemBudget(0)
     {
         _in5Str = in + ".5." + gfm_ext;
         _in6Str = in + ".6." + gfm_ext;
@@ -1646,9 +1648,13 @@ public:
          int32_t overrideOffRate = -1,
          bool verbose = false,
          bool passMemExc = false,
-         bool sanityCheck = false);
+         bool sanityCheck = false,
+         size_t pathGraphMem = 0,
+         bool useSais = false,
+         const Checkpoint* checkpoint = NULL,
+         const string& oldIndex = "");
 
-	HGFM() {}
+	HGFM() : _lazyLocal(false), _localMemBudget(0) {}
 
 	~HGFM() {
         clearLocalGFMs();
@@ -1706,7 +1712,8 @@ public:
 		PARENT_CLASS::sanityCheckAll(reverse);
 		for(size_t tidx = 0; tidx < _localGFMs.size(); tidx++) {
 			for(size_t local_idx = 0; local_idx < _localGFMs[tidx].size(); local_idx++) {
-				assert(_localGFMs[tidx][local_idx] != NULL);
+				assert(_lazyLocal || _localGFMs[tidx][local_idx] != NULL);
+				if(_localGFMs[tidx][local_idx] == NULL) continue;
 				_localGFMs[tidx][local_idx]->sanityCheckAll(reverse);
 			}
 		}
@@ -1718,6 +1725,8 @@ public:
         index_t offsetidx = offset / local_index_interval;
         if(offsetidx >= localGFMs.size()) {
             return NULL;
+        } else if(_lazyLocal) {
+            return lazyLocalGFM(tidx, offsetidx);
         } else {
             return localGFMs[offsetidx];
         }
@@ -1744,7 +1753,7 @@ public:
 	void clearLocalGFMs() {
 		for(size_t tidx = 0; tidx < _localGFMs.size(); tidx++) {
 			for(size_t local_idx = 0; local_idx < _localGFMs[tidx].size(); local_idx++) {
-				assert(_localGFMs[tidx][local_idx] != NULL);
+				assert(_lazyLocal || _localGFMs[tidx][local_idx] != NULL);
 				delete _localGFMs[tidx][local_idx];
 			}
 			
@@ -1752,14 +1761,38 @@ public:
 		}
 		
 		_localGFMs.clear();
+		_localLocs.clear();
+		_localFirst.clear();
+		_localState.clear();
+		_localLastUse.clear();
 	}
 	
+	/**
+	 * Construct local indexes only when getLocalGFM() first asks for
+	 * them instead of reading all of them in readIntoMemory().  Their
+	 * data stays in the memory-mapped .5/.6 files; once the local
+	 * indexes in use span more than 'memBudget' bytes (0 = no limit),
+	 * the pages of the least recently used ones are handed back to
+	 * the OS.  Must be called before loadIntoMemory().
+	 */
+	void setLazyLocalGFMs(size_t memBudget) {
+#ifdef BOWTIE_MM
+		_lazyLocal = true;
+		_localMemBudget = memBudget;
+#else
+		cerr << "Warning: lazy loading of local indexes requires memory-mapped I/O support; ignoring it" << endl;
+#endif
+	}
+	
+	const LocalGFM<local_index_t, index_t>* lazyLocalGFM(index_t tidx, index_t offsetidx) const;
+	void trimLocalGFMs() const;
+	
 
 public:
 	index_t                                  _nrefs;      /// the number of reference sequences
 	EList<index_t>                           _refLens;    /// approx lens of ref seqs (excludes trailing ambig chars)
 	
-	EList<EList<LocalGFM<local_index_t, index_t>*> > _localGFMs;
+	mutable EList<EList<LocalGFM<local_index_t, index_t>*> > _localGFMs;
 	index_t                                  _nlocalGFMs;
     //index_t                                  _local_index_interval;
 	
@@ -1767,9 +1800,42 @@ public:
 	FILE                                     *_in6;    // input fd for secondary index file
 	string                                   _in5Str;
 	string                                   _in6Str;
+	IndexFileLoc                             _in5Loc;
+	IndexFileLoc                             _in6Loc;
 	
 	char                                     *mmFile5_;
 	char                                     *mmFile6_;
+	
+	// Lazily constructed local indexes (see setLazyLocalGFMs())
+	enum {
+		LOCAL_GFM_UNLOADED = 0,
+		LOCAL_GFM_HOT,      // constructed, pages counted as resident
+		LOCAL_GFM_DROPPED   // constructed, pages handed back to the OS
+	};
+	struct LocalGFMLoc {
+		size_t off5;  // where the local index starts in the .5 file
+		size_t len5;
+		size_t off6;  // where its SA sample starts in the .6 file
+		size_t len6;
+	};
+	bool                                     _lazyLocal;
+	size_t                                   _localMemBudget; // bytes; 0 = no limit
+	EList<LocalGFMLoc>                       _localLocs;      // in file order
+	EList<index_t>                           _localFirst;     // first _localLocs entry of each text
+	mutable EList<uint8_t>                   _localState;
+	mutable EList<uint32_t>                  _localLastUse;
+	mutable uint32_t                         _localEpoch;
+	mutable size_t                           _localResident;  // bytes of HOT local indexes
+	mutable MUTEX_T                          _localMutex;
+	// How to construct a local index on first use
+	int32_t                                  _localLineRate;
+	int32_t                                  _localOffRate;
+	int32_t                                  _localFtabChars;
+	int                                      _localNeedEntireRev;
+	bool                                     _localLoadSASamp;
+	bool                                     _localLoadFtab;
+	bool                                     _localLoadRstarts;
+	bool                                     _localLoadNames;
     
 private:
     struct ThreadParam {
@@ -1787,6 +1853,9 @@ private:
         EList<index_t>               sa;
         index_t                      dcv;
         index_t                      seed;
+        bool                         sais;
+        uint64_t                     key;   // see localGFMKey()
+        index_t                      reuse; // old local index to copy instead, or INDEX_MAX
         
         // output
         RefGraph<index_t>*           rg;
@@ -1798,6 +1867,30 @@ private:
         bool                         mainThread;
     };
     static void gbwt_worker(void* vp);
+    
+    // A local index's fingerprint and where it was written.  These go to
+    // the .lfp file so that a later build can copy the local indexes
+    // whose inputs haven't changed instead of building them again.
+    struct LocalGFMPrint {
+        uint64_t key;
+        uint64_t off5, len5;
+        uint64_t off6, len6;
+    };
+    static uint64_t localGFMKey(const ThreadParam& tParam, index_t tidx);
+    static bool readLocalGFMPrints(const string& base, uint64_t paramsKey, EList<LocalGFMPrint>& prints);
+    static void copyLocalGFMBytes(ifstream& in, uint64_t off, uint64_t len, ofstream& out);
+    
+    struct LocalLoadParam {
+        HGFM<index_t, local_index_t>* gfm;
+        size_t                       lo;     // first local index to read
+        size_t                       hi;     // one past the last
+        size_t*                      done;   // # read by all threads
+        MUTEX_T*                     mutex;
+        bool                         verbose;
+        bool                         ok;
+    };
+    static void localLoad_worker(void* vp);
+    void loadLocalGFMsParallel(bool verbose);
 };
 
     
@@ -1828,7 +1921,9 @@ void HGFM<index_t, local_index_t>::gbwt_worker(void* vp)
             }
         }
         while(true) {
-            if(tParam.alts.empty()) {
+            if(tParam.alts.empty() && tParam.sais) {
+                saisSuffixArray(tParam.s, tParam.sa);
+            } else if(tParam.alts.empty()) {
                 KarkkainenBlockwiseSA<SString<char> > bsa(
                                                           tParam.s,
                                                           (index_t)(tParam.s.length()+1),
@@ -1914,6 +2009,94 @@ void HGFM<index_t, local_index_t>::gbwt_worker(void* vp)
         if(tParam.mainThread) break;
     }
 }
+
+/**
+ * Fingerprint everything a local index is built from: its place in the
+ * genome, its sequence, and the ALTs and haplotypes that fall in it.
+ */
+template <typename index_t, typename local_index_t>
+uint64_t HGFM<index_t, local_index_t>::localGFMKey(const ThreadParam& tParam, index_t tidx)
+{
+    CheckpointSum sum;
+    uint64_t head[] = { tidx, tParam.local_offset, tParam.curr_sztot, tParam.local_sztot, tParam.index_size,
+                        tParam.s.length(), tParam.conv_local_szs.size(), tParam.alts.size(), tParam.haplotypes.size() };
+    sum.update(head, sizeof(head));
+    sum.update(tParam.s.buf(), tParam.s.length());
+    for(size_t i = 0; i < tParam.conv_local_szs.size(); i++) {
+        const RefRecord& r = tParam.conv_local_szs[i];
+        uint64_t rec[] = { r.off, r.len, r.first };
+        sum.update(rec, sizeof(rec));
+    }
+    for(size_t i = 0; i < tParam.alts.size(); i++) {
+        const ALT<index_t>& alt = tParam.alts[i];
+        uint64_t rec[] = { (uint64_t)alt.type, alt.pos, alt.len, 0 };
+        if(alt.splicesite()) {
+            rec[3] = (alt.fw ? 1 : 0) | (alt.excluded ? 2 : 0);
+        } else if(alt.snp()) {
+            rec[3] = alt.seq;
+        }
+        sum.update(rec, sizeof(rec));
+    }
+    for(size_t i = 0; i < tParam.haplotypes.size(); i++) {
+        const Haplotype<index_t>& ht = tParam.haplotypes[i];
+        uint64_t rec[] = { ht.left, ht.right, ht.alts.size() };
+        sum.update(rec, sizeof(rec));
+        for(size_t a = 0; a < ht.alts.size(); a++) {
+            uint64_t alt = ht.alts[a];
+            sum.update(&alt, sizeof(alt));
+        }
+    }
+    return sum.value();
+}
+
+/**
+ * Read the local index fingerprints of the index with basename 'base';
+ * return false if it has none or they were made with other parameters.
+ */
+template <typename index_t, typename local_index_t>
+bool HGFM<index_t, local_index_t>::readLocalGFMPrints(
+                                                      const string& base,
+                                                      uint64_t paramsKey,
+                                                      EList<LocalGFMPrint>& prints)
+{
+    prints.clear();
+    ifstream in((base + ".lfp." + gfm_ext).c_str(), ios::binary);
+    if(!in.good()) return false;
+    if(readI32(in, false) != 1) return false; // other endianness
+    if(readIndex<uint64_t>(in, false) != paramsKey) return false;
+    uint64_t n = readIndex<uint64_t>(in, false);
+    prints.resizeExact((size_t)n);
+    for(size_t i = 0; i < prints.size(); i++) {
+        LocalGFMPrint& p = prints[i];
+        p.key = readIndex<uint64_t>(in, false);
+        p.off5 = readIndex<uint64_t>(in, false);
+        p.len5 = readIndex<uint64_t>(in, false);
+        p.off6 = readIndex<uint64_t>(in, false);
+        p.len6 = readIndex<uint64_t>(in, false);
+    }
+    if(!in.good()) {
+        prints.clear();
+        return false;
+    }
+    return true;
+}
+
+template <typename index_t, typename local_index_t>
+void HGFM<index_t, local_index_t>::copyLocalGFMBytes(ifstream& in, uint64_t off, uint64_t len, ofstream& out)
+{
+    char buf[1 << 16];
+    in.seekg((streamoff)off);
+    while(len > 0 && in.good()) {
+        size_t n = (size_t)std::min<uint64_t>(len, sizeof(buf));
+        in.read(buf, n);
+        out.write(buf, n);
+        len -= n;
+    }
+    if(!in.good()) {
+        cerr << "An error occurred reading a local index of the earlier index." << endl;
+        throw 1;
+    }
+}
     
 /// Construct a GFM from the given header parameters and string
 /// vector, optionally using a blockwise suffix sorter with the
@@ -1955,7 +2138,11 @@ HGFM<index_t, local_index_t>::HGFM(
                                    int32_t overrideOffRate,
                                    bool verbose,
                                    bool passMemExc,
-                                   bool sanityCheck) :
+                                   bool sanityCheck,
+                                   size_t pathGraphMem,
+                                   bool useSais,
+                                   const Checkpoint* checkpoint,
+                                   const string& oldIndex) :
     GFM<index_t>(s,
                  packed,
                  needEntireReverse,
@@ -1986,9 +2173,14 @@ HGFM<index_t, local_index_t>::HGFM(
                  overrideOffRate,
                  verbose,
                  passMemExc,
-                 sanityCheck),
+                 sanityCheck,
+                 pathGraphMem,
+                 useSais,
+                 checkpoint),
     _in5(NULL),
-    _in6(NULL)
+    _in6(NULL),
+    _lazyLocal(false),
+    _localMemBudget(0)
 {
     _in5Str = outfile + ".5." + gfm_ext;
     _in6Str = outfile + ".6." + gfm_ext;
@@ -2002,15 +2194,69 @@ HGFM<index_t, local_index_t>::HGFM(
         local_lineRate = local_lineRate_gfm;
     }
     
-    // Open output files
-    ofstream fout5(_in5Str.c_str(), ios::binary);
+    // Local indexes of an earlier build whose inputs are unchanged are
+    // copied from it rather than built again
+    uint64_t paramsKey = 0;
+    {
+        ostringstream os;
+        os << HISAT2_VERSION << " " << sizeof(index_t) << " " << sizeof(local_index_t) << " "
+           << local_index_size << " " << local_index_interval << " " << local_max_gbwt << " "
+           << local_lineRate << " " << localOffRate << " " << localFtabChars << " "
+           << needEntireReverse << " " << fw << " " << packed << " " << seed;
+        paramsKey = CheckpointSum::of(os.str());
+    }
+    EList<LocalGFMPrint> old_prints, prints;
+    ifstream old5, old6;
+    if(localIndex && !oldIndex.empty()) {
+        string old5Str = oldIndex + ".5." + gfm_ext, old6Str = oldIndex + ".6." + gfm_ext;
+        if(readLocalGFMPrints(oldIndex, paramsKey, old_prints)) {
+            old5.open(old5Str.c_str(), ios::binary);
+            old6.open(old6Str.c_str(), ios::binary);
+            if(!old5.good() || !old6.good()) old_prints.clear();
+        }
+        if(old_prints.empty()) {
+            cerr << "Warning: \"" << oldIndex << "\" has no local indexes that can be reused; building all of them" << endl;
+        }
+    }
+    index_t num_reused = 0;
+    
+    // Local indexes already written by an earlier run: their number, where
+    // they end in the .5 and .6 files, and the sums of the files up to there
+    index_t resume_locals = 0;
+    uint64_t pos5 = 0, pos6 = 0;
+    CheckpointSum sum5, sum6;
+    if(localIndex && checkpoint != NULL && checkpoint->resume()) {
+        CheckpointReader ckpt;
+        if(ckpt.open(*checkpoint, "locals")) {
+            resume_locals = ckpt.get<index_t>();
+            pos5 = ckpt.get<uint64_t>();
+            uint64_t saved_sum5 = ckpt.get<uint64_t>();
+            pos6 = ckpt.get<uint64_t>();
+            uint64_t saved_sum6 = ckpt.get<uint64_t>();
+            ckpt.getList(prints);
+            if(!checkpointSumFile(_in5Str, 0, pos5, sum5) || sum5.value() != saved_sum5 ||
+               !checkpointSumFile(_in6Str, 0, pos6, sum6) || sum6.value() != saved_sum6 ||
+               truncate(_in5Str.c_str(), (off_t)pos5) != 0 ||
+               truncate(_in6Str.c_str(), (off_t)pos6) != 0) {
+                resume_locals = 0;
+                pos5 = pos6 = 0;
+                sum5 = sum6 = CheckpointSum();
+                prints.clear();
+            }
+        }
+    }
+    
+    // Open output files, keeping what's there if resuming
+    ios_base::openmode mode = ios::binary;
+    if(resume_locals > 0) mode |= ios::in | ios::out;
+    ofstream fout5(_in5Str.c_str(), mode);
     if(!fout5.good()) {
         cerr << "Could not open index file for writing: \"" << _in5Str.c_str() << "\"" << endl
         << "Please make sure the directory exists and that permissions allow writing by" << endl
         << "HISAT2." << endl;
         throw 1;
     }
-    ofstream fout6(_in6Str.c_str(), ios::binary);
+    ofstream fout6(_in6Str.c_str(), mode);
     if(!fout6.good()) {
         cerr << "Could not open index file for writing: \"" << _in6Str.c_str() << "\"" << endl
         << "Please make sure the directory exists and that permissions allow writing by" << endl
@@ -2190,8 +2436,15 @@ HGFM<index_t, local_index_t>::HGFM(
     int32_t flags = 1;
     if(this->_gh._entireReverse) flags |= GFM_ENTIRE_REV;
     writeI32(fout5, -flags, be); // BTL: chunkRate is now deprecated
+    if(resume_locals > 0) {
+        VMSG_NL("Resuming after " << resume_locals << " of " << _nlocalGFMs << " local indexes");
+        fout5.seekp((streamoff)pos5);
+        fout6.seekp((streamoff)pos6);
+    }
     
     if(localIndex) {
+        BuildPhase phase("local_indexes");
+        gBuildReport.setting("local_indexes", (int64_t)_nlocalGFMs);
         assert_gt(this->_nthreads, 0);
         AutoArray<tthread::thread*> threads(this->_nthreads - 1);
         EList<ThreadParam> tParams; tParams.reserveExact((size_t)this->_nthreads);
@@ -2205,6 +2458,7 @@ HGFM<index_t, local_index_t>::HGFM(
             tParams.back().last = false;
             tParams.back().dcv = 1024;
             tParams.back().seed = seed;
+            tParams.back().sais = this->_useSais;
             if(t + 1 < (index_t)this->_nthreads) {
                 tParams.back().mainThread = false;
                 threads[t] = new tthread::thread(gbwt_worker, (void*)&tParams.back());
@@ -2215,6 +2469,7 @@ HGFM<index_t, local_index_t>::HGFM(
         
         // build local FM indexes
         index_t curr_sztot = 0;
+        index_t local_count = 0;
         EList<ALT<index_t> > alts;
         for(size_t tidx = 0; tidx < _refLens.size(); tidx++) {
             index_t refLen = _refLens[tidx];
@@ -2222,6 +2477,7 @@ HGFM<index_t, local_index_t>::HGFM(
             _localGFMs.expand();
             assert_lt(tidx, _localGFMs.size());
             while(local_offset < refLen) {
+                BuildPhase batch("local_index_batch", -1, true);
                 index_t t = 0;
                 while(local_offset < refLen && t < (index_t)this->_nthreads) {
                     assert_lt(t, tParams.size());
@@ -2250,6 +2506,13 @@ HGFM<index_t, local_index_t>::HGFM(
                         local_len += local_szs[i].len;
                     }
                     
+                    if(local_count < resume_locals) {
+                        curr_sztot += local_sztot_interval;
+                        local_offset += local_index_interval;
+                        local_count++;
+                        continue;
+                    }
+                    
                     // Extract sequence corresponding to this local index
                     tParam.s.resize(local_sztot);
                     if(refparams.reverse == REF_READ_REVERSE) {
@@ -2320,12 +2583,18 @@ HGFM<index_t, local_index_t>::HGFM(
                     tParam.local_offset = local_offset;
                     tParam.curr_sztot = curr_sztot;
                     tParam.local_sztot = local_sztot;
+                    tParam.key = localGFMKey(tParam, (index_t)tidx);
+                    tParam.reuse = (index_t)INDEX_MAX;
+                    if(local_count < old_prints.size() && old_prints[local_count].key == tParam.key) {
+                        tParam.reuse = local_count;
+                    }
                     
                     assert(tParam.rg == NULL);
                     assert(tParam.pg == NULL);
-                    tParam.done = false;
+                    tParam.done = (tParam.reuse != (index_t)INDEX_MAX);
                     curr_sztot += local_sztot_interval;
                     local_offset += local_index_interval;
+                    local_count++;
                     
                     t++;
                 }
@@ -2345,33 +2614,47 @@ HGFM<index_t, local_index_t>::HGFM(
 #endif
                     }
                     
-                    LocalGFM<local_index_t, index_t>(
-                                                     tParam.s,
-                                                     tParam.sa,
-                                                     tParam.pg,
-                                                     (index_t)tidx,
-                                                     tParam.local_offset,
-                                                     tParam.curr_sztot,
-                                                     tParam.alts,
-                                                     tParam.index_size,
-                                                     packed,
-                                                     needEntireReverse,
-                                                     local_lineRate,
-                                                     localOffRate,          // suffix-array sampling rate
-                                                     new_localFtabChars,    // number of chars in initial arrow-pair calc
-                                                     outfile,               // basename for .?.ebwt files
-                                                     fw,                    // fw
-                                                     dcv,                   // difference-cover period
-                                                     tParam.conv_local_szs, // list of reference sizes
-                                                     tParam.local_sztot,    // total size of all unambiguous ref chars
-                                                     refparams,             // reference read-in parameters
-                                                     seed,                  // pseudo-random number generator seed
-                                                     fout5,
-                                                     fout6,
-                                                     -1,                    // override offRate
-                                                     false,                 // be silent
-                                                     passMemExc,            // pass exceptions up to the toplevel so that we can adjust memory settings automatically
-                                                     sanityCheck);          // verify results and internal consistency
+                    LocalGFMPrint print;
+                    print.key = tParam.key;
+                    print.off5 = (uint64_t)fout5.tellp();
+                    print.off6 = (uint64_t)fout6.tellp();
+                    if(tParam.reuse != (index_t)INDEX_MAX) {
+                        const LocalGFMPrint& old = old_prints[tParam.reuse];
+                        copyLocalGFMBytes(old5, old.off5, old.len5, fout5);
+                        copyLocalGFMBytes(old6, old.off6, old.len6, fout6);
+                        num_reused++;
+                    } else {
+                        LocalGFM<local_index_t, index_t>(
+                                                         tParam.s,
+                                                         tParam.sa,
+                                                         tParam.pg,
+                                                         (index_t)tidx,
+                                                         tParam.local_offset,
+                                                         tParam.curr_sztot,
+                                                         tParam.alts,
+                                                         tParam.index_size,
+                                                         packed,
+                                                         needEntireReverse,
+                                                         local_lineRate,
+                                                         localOffRate,          // suffix-array sampling rate
+                                                         new_localFtabChars,    // number of chars in initial arrow-pair calc
+                                                         outfile,               // basename for .?.ebwt files
+                                                         fw,                    // fw
+                                                         dcv,                   // difference-cover period
+                                                         tParam.conv_local_szs, // list of reference sizes
+                                                         tParam.local_sztot,    // total size of all unambiguous ref chars
+                                                         refparams,             // reference read-in parameters
+                                                         seed,                  // pseudo-random number generator seed
+                                                         fout5,
+                                                         fout6,
+                                                         -1,                    // override offRate
+                                                         false,                 // be silent
+                                                         passMemExc,            // pass exceptions up to the toplevel so that we can adjust memory settings automatically
+                                                         sanityCheck);          // verify results and internal consistency
+                    }
+                    print.len5 = (uint64_t)fout5.tellp() - print.off5;
+                    print.len6 = (uint64_t)fout6.tellp() - print.off6;
+                    prints.push_back(print);
                     tParam.s.clear();
                     if(tParam.rg != NULL) {
                         assert(tParam.pg != NULL);
@@ -2379,6 +2662,27 @@ HGFM<index_t, local_index_t>::HGFM(
                         delete tParam.pg; tParam.pg = NULL;
                     }
                 }
+                
+                // Save progress once the batch is on disk
+                if(checkpoint != NULL && t > 0) {
+                    fout5.flush(); fout6.flush();
+                    uint64_t end5 = (uint64_t)fout5.tellp(), end6 = (uint64_t)fout6.tellp();
+                    if(fout5.fail() || fout6.fail() ||
+                       !checkpointSumFile(_in5Str, pos5, end5, sum5) ||
+                       !checkpointSumFile(_in6Str, pos6, end6, sum6)) {
+                        cerr << "An error occurred writing the index to disk.  Please check if the disk is full." << endl;
+                        throw 1;
+                    }
+                    pos5 = end5; pos6 = end6;
+                    CheckpointWriter w(*checkpoint, "locals");
+                    w.put(local_count);
+                    w.put(pos5);
+                    w.put(sum5.value());
+                    w.put(pos6);
+                    w.put(sum6.value());
+                    w.putList(prints);
+                    w.commit();
+                }
             }
         }
         assert_eq(curr_sztot, sztot);
@@ -2388,6 +2692,28 @@ HGFM<index_t, local_index_t>::HGFM(
                 threads[i]->join();
             }
         }
+        if(!oldIndex.empty()) {
+            VMSG_NL("Copied " << num_reused << " of " << _nlocalGFMs << " local indexes from \"" << oldIndex << "\"");
+        }
+        
+        // Fingerprints of the local indexes, for later --incremental builds
+        string lfpStr = outfile + ".lfp." + gfm_ext;
+        ofstream foutp(lfpStr.c_str(), ios::binary);
+        writeI32(foutp, 1, be);
+        writeIndex<uint64_t>(foutp, paramsKey, be);
+        writeIndex<uint64_t>(foutp, prints.size(), be);
+        for(size_t i = 0; i < prints.size(); i++) {
+            writeIndex<uint64_t>(foutp, prints[i].key, be);
+            writeIndex<uint64_t>(foutp, prints[i].off5, be);
+            writeIndex<uint64_t>(foutp, prints[i].len5, be);
+            writeIndex<uint64_t>(foutp, prints[i].off6, be);
+            writeIndex<uint64_t>(foutp, prints[i].len6, be);
+        }
+        foutp.close();
+        if(foutp.fail()) {
+            cerr << "An error occurred writing \"" << lfpStr << "\".  Please check if the disk is full." << endl;
+            throw 1;
+        }
     }
     
     fout5 << '\0';
@@ -2482,13 +2808,13 @@ void HGFM<index_t, local_index_t>::readIntoMemory(
         // Initialize our primary and secondary input-stream fields
 		if(_in5 != NULL) fclose(_in5);
 		if(this->_verbose || startVerbose) cerr << "Opening \"" << _in5Str.c_str() << "\"" << endl;
-		if((_in5 = fopen(_in5Str.c_str(), "rb")) == NULL) {
+		if((_in5 = openIndexFile(_in5Str, _in5Loc)) == NULL) {
 			cerr << "Could not open index file " << _in5Str.c_str() << endl;
 		}
 		if(loadSASamp) {
 			if(_in6 != NULL) fclose(_in6);
 			if(this->_verbose || startVerbose) cerr << "Opening \"" << _in6Str.c_str() << "\"" << endl;
-			if((_in6 = fopen(_in6Str.c_str(), "rb")) == NULL) {
+			if((_in6 = openIndexFile(_in6Str, _in6Loc)) == NULL) {
 				cerr << "Could not open index file " << _in6Str.c_str() << endl;
 			}
 		}
@@ -2498,22 +2824,16 @@ void HGFM<index_t, local_index_t>::readIntoMemory(
 		}
 		
 #ifdef BOWTIE_MM
-		if(this->_useMm /*&& !justHeader*/) {
+		if(this->_useMm || _lazyLocal /*&& !justHeader*/) {
 			const char *names[] = {_in5Str.c_str(), _in6Str.c_str()};
+			const IndexFileLoc *locs[] = {&_in5Loc, &_in6Loc};
             int fds[] = { fileno(_in5), fileno(_in6) };
 			for(int i = 0; i < (loadSASamp ? 2 : 1); i++) {
 				if(this->_verbose || startVerbose) {
 					cerr << "  ¯ " << (i+1) << ": ";
 					logTime(cerr);
 				}
-				struct stat sbuf;
-				if (stat(names[i], &sbuf) == -1) {
-					perror("stat");
-					cerr << "Error: Could not stat index file " << names[i] << " prior to memory-mapping" << endl;
-					throw 1;
-				}
-                mmFile[i] = (char*)mmap((void *)0, (size_t)sbuf.st_size,
-										PROT_READ, MAP_SHARED, fds[(size_t)i], 0);
+                mmFile[i] = mmapIndexFile(*locs[i], fds[(size_t)i]);
 				if(mmFile[i] == (void *)(-1)) {
 					perror("mmap");
 					cerr << "Error: Could not memory-map the index file " << names[i] << endl;
@@ -2521,7 +2841,7 @@ void HGFM<index_t, local_index_t>::readIntoMemory(
 				}
 				if(mmSweep) {
 					int sum = 0;
-					for(off_t j = 0; j < sbuf.st_size; j += 1024) {
+					for(uint64_t j = 0; j < locs[i]->len; j += 1024) {
 						sum += (int) mmFile[i][j];
 					}
 					if(startVerbose) {
@@ -2573,7 +2893,7 @@ void HGFM<index_t, local_index_t>::readIntoMemory(
 	// support this, someone has to modify the file to switch
 	// endiannesses appropriately, and we can't do this inside Bowtie
 	// or we might be setting up a race condition with other processes.
-	if(switchEndian && this->_useMm) {
+	if(switchEndian && (this->_useMm || _lazyLocal)) {
 		cerr << "Error: Can't use memory-mapped files when the index is the opposite endianness" << endl;
 		throw 1;
 	}	
@@ -2598,9 +2918,72 @@ void HGFM<index_t, local_index_t>::readIntoMemory(
 	
 	clearLocalGFMs();
 	
+	// With several threads and plain file I/O, find where each local
+	// index lives first and then read them in parallel
+	bool parallelLocal = !_lazyLocal && this->_nthreads > 1 && _nlocalGFMs > 1 &&
+	                     !this->_useMm && !this->useShmem_ && !switchEndian;
+	if(_lazyLocal || parallelLocal) {
+		// Only record where each local index lives; getLocalGFM()
+		// constructs it from the mapped files on first use
+		_localLineRate = lineRate;
+		_localOffRate = offRate;
+		_localFtabChars = ftabChars;
+		_localNeedEntireRev = needEntireRev;
+		_localLoadSASamp = loadSASamp;
+		_localLoadFtab = loadFtab;
+		_localLoadRstarts = loadRstarts;
+		_localLoadNames = loadNames;
+		_localEpoch = 0;
+		_localResident = 0;
+		for(size_t i = 0; i < _nlocalGFMs; i++) {
+			LocalGFMLoc loc;
+			loc.off5 = bytesRead;
+			loc.off6 = bytesRead2;
+			index_t tidx = readIndex<index_t>(_in5, switchEndian);
+			readIndex<index_t>(_in5, switchEndian); // localOffset
+			readIndex<index_t>(_in5, switchEndian); // joinedOffset
+			local_index_t len      = readIndex<local_index_t>(_in5, switchEndian);
+			local_index_t gbwtLen  = readIndex<local_index_t>(_in5, switchEndian);
+			local_index_t numNodes = readIndex<local_index_t>(_in5, switchEndian);
+			local_index_t eftabLen = readIndex<local_index_t>(_in5, switchEndian);
+			bytesRead += 3 * sizeof(index_t) + 4 * sizeof(local_index_t);
+			if(len > 0) {
+				GFMParams<local_index_t> gh(len, gbwtLen, numNodes, lineRate, offRate, ftabChars, eftabLen, needEntireRev);
+				local_index_t nPat = readIndex<local_index_t>(_in5, switchEndian);
+				fseek(_in5, nPat * sizeof(local_index_t), SEEK_CUR);
+				local_index_t nFrag = readIndex<local_index_t>(_in5, switchEndian);
+				fseek(_in5, nFrag * 3 * sizeof(local_index_t) + gh._gbwtTotLen, SEEK_CUR);
+				local_index_t num_zOffs = readIndex<local_index_t>(_in5, switchEndian);
+				fseek(_in5, (num_zOffs + 5 + gh._ftabLen + gh._eftabLen) * sizeof(local_index_t), SEEK_CUR);
+				bytesRead += (2 + nPat + nFrag * 3 + 1 + num_zOffs + 5 + gh._ftabLen + gh._eftabLen) * sizeof(local_index_t) + gh._gbwtTotLen;
+				if(loadSASamp) {
+					bytesRead2 += gh._offsLen * sizeof(local_index_t);
+				}
+			}
+			loc.len5 = bytesRead - loc.off5;
+			loc.len6 = bytesRead2 - loc.off6;
+			if(tidx >= _localGFMs.size()) {
+				assert_eq(tidx, _localGFMs.size());
+				_localGFMs.expand();
+				_localFirst.push_back((index_t)i);
+			}
+			assert_eq(tidx + 1, _localGFMs.size());
+			_localGFMs.back().push_back(NULL);
+			_localLocs.push_back(loc);
+			_localState.push_back(LOCAL_GFM_UNLOADED);
+			_localLastUse.push_back(0);
+		}
+		if(_lazyLocal && (this->_verbose || startVerbose)) {
+			cerr << "    local indexes will be loaded on first use" << endl;
+		}
+	}
+	if(parallelLocal) {
+		loadLocalGFMsParallel(this->_verbose || startVerbose);
+	}
+	
     index_t tidx = 0, localOffset = 0, joinedOffset = 0;
     string base = "";
-	for(size_t i = 0; i < _nlocalGFMs; i++) {
+	for(size_t i = 0; i < (_lazyLocal || parallelLocal ? 0 : _nlocalGFMs); i++) {
 		LocalGFM<local_index_t, index_t> *localGFM = new LocalGFM<local_index_t, index_t>(base,
                                                                                           NULL,
                                                                                           _in5,
@@ -2642,11 +3025,238 @@ void HGFM<index_t, local_index_t>::readIntoMemory(
 	}	
 
 
+    fseeko(_in5, (off_t)_in5Loc.off, SEEK_SET);
+	fseeko(_in6, (off_t)_in6Loc.off, SEEK_SET);
+}
+
+/**
+ * Return local index 'offsetidx' of text 'tidx', constructing it from
+ * the memory-mapped .5/.6 files if this is its first use.  Safe to
+ * call from several threads at once.
+ */
+template <typename index_t, typename local_index_t>
+const LocalGFM<local_index_t, index_t>* HGFM<index_t, local_index_t>::lazyLocalGFM(
+                                                                                   index_t tidx,
+                                                                                   index_t offsetidx) const
+{
+    assert(_lazyLocal);
+    assert_lt(tidx, _localFirst.size());
+    index_t i = _localFirst[tidx] + offsetidx;
+    assert_lt(i, _localLocs.size());
+    LocalGFM<local_index_t, index_t> *&slot = _localGFMs[tidx][offsetidx];
+    LocalGFM<local_index_t, index_t> *localGFM = __atomic_load_n(&slot, __ATOMIC_ACQUIRE);
+    if(localGFM != NULL && __atomic_load_n(&_localState[i], __ATOMIC_RELAXED) == LOCAL_GFM_HOT) {
+        uint32_t epoch = __atomic_load_n(&_localEpoch, __ATOMIC_RELAXED);
+        if(_localLastUse[i] != epoch) {
+            __atomic_store_n(&_localLastUse[i], epoch, __ATOMIC_RELAXED);
+        }
+        return localGFM;
+    }
+    
+    ThreadSafe t(&_localMutex);
+    localGFM = slot;
+    if(localGFM == NULL) {
+        const LocalGFMLoc& loc = _localLocs[i];
+        fseeko(_in5, (off_t)(_in5Loc.off + loc.off5), SEEK_SET);
+        if(_in6 != NULL) fseeko(_in6, (off_t)(_in6Loc.off + loc.off6), SEEK_SET);
+        size_t bytesRead = loc.off5, bytesRead2 = loc.off6;
+        index_t ltidx = 0, localOffset = 0, joinedOffset = 0;
+        localGFM = new LocalGFM<local_index_t, index_t>("",
+                                                        NULL,
+                                                        _in5,
+                                                        _in6,
+                                                        mmFile5_,
+                                                        mmFile6_,
+                                                        ltidx,
+                                                        localOffset,
+                                                        joinedOffset,
+                                                        false,  // switchEndian
+                                                        bytesRead,
+                                                        bytesRead2,
+                                                        _localNeedEntireRev,
+                                                        this->fw_,
+                                                        -1, // overrideOffRate
+                                                        -1, // offRatePlus
+                                                        (uint32_t)_localLineRate,
+                                                        (uint32_t)_localOffRate,
+                                                        (uint32_t)_localFtabChars,
+                                                        true,   // data stays in the mapped files
+                                                        false,  // useShmem
+                                                        false,  // mmSweep
+                                                        _localLoadNames,
+                                                        _localLoadSASamp,
+                                                        _localLoadFtab,
+                                                        _localLoadRstarts,
+                                                        false,  // _verbose
+                                                        false,
+                                                        this->_passMemExc,
+                                                        this->_sanity,
+                                                        false); // use haplotypes?
+        assert_eq(ltidx, tidx);
+        assert_eq(bytesRead, loc.off5 + loc.len5);
+        __atomic_store_n(&slot, localGFM, __ATOMIC_RELEASE);
+    }
+    if(_localState[i] != LOCAL_GFM_HOT) {
+        _localResident += _localLocs[i].len5 + _localLocs[i].len6;
+        __atomic_store_n(&_localState[i], (uint8_t)LOCAL_GFM_HOT, __ATOMIC_RELAXED);
+        _localEpoch++;
+        if(_localMemBudget > 0 && _localResident > _localMemBudget) {
+            trimLocalGFMs();
+        }
+    }
+    _localLastUse[i] = _localEpoch;
+    return localGFM;
+}
+
+/**
+ * Read local indexes [lo, hi) through file handles of the thread's own.
+ */
+template <typename index_t, typename local_index_t>
+void HGFM<index_t, local_index_t>::localLoad_worker(void* vp)
+{
+    LocalLoadParam& p = *(LocalLoadParam*)vp;
+    HGFM<index_t, local_index_t>& gfm = *p.gfm;
+    p.ok = false;
+    IndexFileLoc loc5, loc6;
+    FILE *in5 = openIndexFile(gfm._in5Str, loc5);
+    FILE *in6 = gfm._localLoadSASamp ? openIndexFile(gfm._in6Str, loc6) : NULL;
+    if(in5 == NULL || (gfm._localLoadSASamp && in6 == NULL)) {
+        cerr << "Could not open index file " << (in5 == NULL ? gfm._in5Str : gfm._in6Str) << endl;
+        if(in5 != NULL) fclose(in5);
+        return;
+    }
+    try {
+        for(size_t i = p.lo; i < p.hi; i++) {
+            const LocalGFMLoc& loc = gfm._localLocs[i];
+            fseeko(in5, (off_t)(loc5.off + loc.off5), SEEK_SET);
+            if(in6 != NULL) fseeko(in6, (off_t)(loc6.off + loc.off6), SEEK_SET);
+            size_t bytesRead = loc.off5, bytesRead2 = loc.off6;
+            index_t tidx = 0, localOffset = 0, joinedOffset = 0;
+            LocalGFM<local_index_t, index_t> *localGFM = new LocalGFM<local_index_t, index_t>("",
+                                                                                              NULL,
+                                                                                              in5,
+                                                                                              in6,
+                                                                                              NULL,
+                                                                                              NULL,
+                                                                                              tidx,
+                                                                                              localOffset,
+                                                                                              joinedOffset,
+                                                                                              false,  // switchEndian
+                                                                                              bytesRead,
+                                                                                              bytesRead2,
+                                                                                              gfm._localNeedEntireRev,
+                                                                                              gfm.fw_,
+                                                                                              -1, // overrideOffRate
+                                                                                              -1, // offRatePlus
+                                                                                              (uint32_t)gfm._localLineRate,
+                                                                                              (uint32_t)gfm._localOffRate,
+                                                                                              (uint32_t)gfm._localFtabChars,
+                                                                                              false,  // useMm
+                                                                                              false,  // useShmem
+                                                                                              false,  // mmSweep
+                                                                                              gfm._localLoadNames,
+                                                                                              gfm._localLoadSASamp,
+                                                                                              gfm._localLoadFtab,
+                                                                                              gfm._localLoadRstarts,
+                                                                                              false,  // _verbose
+                                                                                              false,
+                                                                                              gfm._passMemExc,
+                                                                                              gfm._sanity,
+                                                                                              false); // use haplotypes?
+            assert_lt(tidx, gfm._localFirst.size());
+            assert_eq(bytesRead, loc.off5 + loc.len5);
+            gfm._localGFMs[tidx][i - gfm._localFirst[tidx]] = localGFM;
+            size_t n = gfm._nlocalGFMs;
+            size_t before = __atomic_fetch_add(p.done, 1, __ATOMIC_RELAXED);
+            if(p.verbose && (before * 4 / n) != ((before + 1) * 4 / n)) {
+                ThreadSafe t(p.mutex);
+                cerr << "    Read " << ((before + 1) * 4 / n) * 25 << "% of local indexes: ";
+                logTime(cerr);
+            }
+        }
+        p.ok = true;
+    } catch(int e) {
+    } catch(std::bad_alloc& e) {
+        cerr << "Out of memory allocating a local index" << endl;
+    }
+    fclose(in5);
+    if(in6 != NULL) fclose(in6);
+}
+
+/**
+ * Read all local indexes found by readIntoMemory(), splitting them
+ * into _nthreads contiguous runs so each thread reads sequentially.
+ */
+template <typename index_t, typename local_index_t>
+void HGFM<index_t, local_index_t>::loadLocalGFMsParallel(bool verbose)
+{
+    size_t nthreads = min<size_t>((size_t)this->_nthreads, _localLocs.size());
+    size_t done = 0;
+    MUTEX_T mutex;
+    EList<LocalLoadParam> tParams;
+    for(size_t t = 0; t < nthreads; t++) {
+        tParams.expand();
+        tParams.back().gfm = this;
+        tParams.back().lo = _localLocs.size() * t / nthreads;
+        tParams.back().hi = _localLocs.size() * (t + 1) / nthreads;
+        tParams.back().done = &done;
+        tParams.back().mutex = &mutex;
+        tParams.back().verbose = verbose;
+        tParams.back().ok = false;
+    }
+    AutoArray<tthread::thread*> threads(nthreads);
+    for(size_t t = 0; t < nthreads; t++) {
+        threads[t] = new tthread::thread(localLoad_worker, (void*)&tParams[t]);
+    }
+    bool ok = true;
+    for(size_t t = 0; t < nthreads; t++) {
+        threads[t]->join();
+        delete threads[t];
+        ok = ok && tParams[t].ok;
+    }
+    if(!ok) {
+        cerr << "Error reading local indexes from " << _in5Str << endl;
+        throw 1;
+    }
+}
+
+/**
+ * Hand the pages of the least recently used local indexes back to the
+ * OS until the ones in use fit in 3/4 of the budget.  The LocalGFM
+ * objects stay valid; their pages are read back from the files if they
+ * are touched again.  Caller must hold _localMutex.
+ */
+template <typename index_t, typename local_index_t>
+void HGFM<index_t, local_index_t>::trimLocalGFMs() const
+{
 #ifdef BOWTIE_MM
-    fseek(_in5, 0, SEEK_SET);
-	fseek(_in6, 0, SEEK_SET);
-#else
-	rewind(_in5); rewind(_in6);
+    EList<pair<uint32_t, index_t> > hot;
+    for(index_t i = 0; i < _localState.size(); i++) {
+        if(_localState[i] == LOCAL_GFM_HOT) {
+            hot.push_back(make_pair(_localLastUse[i], i));
+        }
+    }
+    hot.sort();
+    const size_t target = _localMemBudget - (_localMemBudget >> 2);
+    const size_t pageSz = (size_t)sysconf(_SC_PAGESIZE);
+    for(index_t h = 0; h < hot.size() && _localResident > target; h++) {
+        index_t i = hot[h].second;
+        const LocalGFMLoc& loc = _localLocs[i];
+        // Only drop pages that lie entirely within this local index
+        const size_t offs[] = { loc.off5, loc.off6 };
+        const size_t lens[] = { loc.len5, loc.len6 };
+        char *mm[] = { mmFile5_, mmFile6_ };
+        for(int f = 0; f < 2; f++) {
+            if(mm[f] == NULL) continue;
+            // The mapping may start part way into a page of the pack
+            uintptr_t start = (uintptr_t)(mm[f] + offs[f]);
+            uintptr_t lo = (start + pageSz - 1) / pageSz * pageSz;
+            uintptr_t hi = (start + lens[f]) / pageSz * pageSz;
+            if(hi > lo) madvise((void*)lo, hi - lo, MADV_DONTNEED);
+        }
+        __atomic_store_n(&_localState[i], (uint8_t)LOCAL_GFM_DROPPED, __ATOMIC_RELAXED);
+        _localResident -= loc.len5 + loc.len6;
+    }
 #endif
 }
 
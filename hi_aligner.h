@@ -43,6 +43,7 @@
 #include "group_walk.h"
 #include "tp.h"
 #include "gp.h"
+#include "match_run.h"
 
 // Allow longer introns for long anchored reads involving canonical splice sites
 inline uint32_t MaxIntronLen(uint32_t anchor, uint32_t minAnchorLen) {
@@ -389,6 +390,165 @@ struct ReadBWTHit {
 };
 
 
+struct HIMetrics;
+
+/**
+ * Bounded memo of the states of GenomeHit::alignWithALTs_recur whose
+ * search ended without a full-length alignment and without running into
+ * the ALT budget.  A state is the position
+ * reached in the read and the reference together with the haplotype
+ * context, which entries keep in full (a copy of the haplotype list) so a
+ * hash collision can't prune a subtree that was never searched.
+ * Reaching it again through another combination of ALTs
+ * searches the same subtree, or less of it since the ALT budget only
+ * shrinks, so it can neither extend further than the first time nor
+ * find a full-length alignment; the search stops there instead.  Entries
+ * are dropped wholesale by bumping the generation number at the start of
+ * each alignWithALTs call.
+ */
+template <typename index_t>
+struct ALTSearchMemo {
+    
+    struct Entry {
+        uint32_t gen;
+        uint32_t ctx;    // hash of the context, to skip most comparisons
+        bool     splice; // entered through a splice site
+        size_t   htOff;  // haplotype list is hts[htOff, htOff + htLen)
+        size_t   htLen;
+        index_t  joinedOff;
+        index_t  rdoff;
+        int      rfpos;  // reference position the search continues from
+        index_t  span;   // # reference characters the search may walk
+    };
+    
+    ALTSearchMemo() : gen(0), used(0), completions(0), cutoffs(0), him(NULL) {}
+    
+    /**
+     * Forget all states; called once per alignWithALTs call.
+     */
+    void reset() {
+        if(table.empty()) {
+            table.resize(ALT_MEMO_SIZE);
+            for(size_t i = 0; i < table.size(); i++) table[i].gen = 0;
+        }
+        gen++;
+        if(gen == 0) {
+            for(size_t i = 0; i < table.size(); i++) table[i].gen = 0;
+            gen = 1;
+        }
+        used = 0;
+        hts.clear();
+        completions = 0;
+        cutoffs = 0;
+    }
+    
+    /**
+     * Return true iff the given state was already searched without
+     * success; otherwise leave 'slot' at the entry it would go into.
+     */
+    bool find(
+              index_t joinedOff,
+              index_t rdoff,
+              int rfpos,
+              index_t span,
+              ALT_TYPE prev_alt_type,
+              const EList<pair<index_t, index_t> >& ht_list,
+              size_t& slot) const
+    {
+        const uint32_t ctx = context(prev_alt_type, ht_list);
+        uint64_t h = (uint64_t)joinedOff * 0x9E3779B97F4A7C15ULL;
+        h ^= ((uint64_t)rdoff << 32) ^ (uint64_t)(uint32_t)rfpos;
+        h ^= ((uint64_t)span << 16) ^ ((uint64_t)ctx * 0xC2B2AE3D27D4EB4FULL);
+        h ^= h >> 29;
+        slot = (size_t)h & (ALT_MEMO_SIZE - 1);
+        while(table[slot].gen == gen) {
+            const Entry& e = table[slot];
+            if(e.joinedOff == joinedOff && e.rdoff == rdoff && e.rfpos == rfpos &&
+               e.span == span && e.ctx == ctx && sameContext(e, prev_alt_type, ht_list)) {
+                return true;
+            }
+            slot = (slot + 1) & (ALT_MEMO_SIZE - 1);
+        }
+        return false;
+    }
+    
+    /**
+     * Hash what, besides the position, decides how the search continues
+     * from a state: the haplotypes still being followed and whether the
+     * state was entered through a splice site.
+     */
+    static uint32_t context(
+                            ALT_TYPE                              prev_alt_type,
+                            const EList<pair<index_t, index_t> >& ht_list)
+    {
+        uint32_t ctx = (prev_alt_type == ALT_SPLICESITE ? 1 : 0);
+        for(size_t h = 0; h < ht_list.size(); h++) {
+            ctx = ctx * 31 + (uint32_t)ht_list[h].first * 7 + (uint32_t)ht_list[h].second;
+        }
+        return ctx;
+    }
+    
+    /**
+     * Return true iff entry 'e' was stored with exactly this context.
+     */
+    bool sameContext(
+                     const Entry& e,
+                     ALT_TYPE prev_alt_type,
+                     const EList<pair<index_t, index_t> >& ht_list) const
+    {
+        if(e.splice != (prev_alt_type == ALT_SPLICESITE) || e.htLen != ht_list.size()) {
+            return false;
+        }
+        for(size_t h = 0; h < e.htLen; h++) {
+            if(hts[e.htOff + h] != ht_list[h]) return false;
+        }
+        return true;
+    }
+    
+    /**
+     * Remember a state at the slot find() returned for it, unless the
+     * table is already three quarters full or there's no room left for
+     * its haplotype list.
+     */
+    void insert(
+                size_t slot,
+                index_t joinedOff,
+                index_t rdoff,
+                int rfpos,
+                index_t span,
+                ALT_TYPE prev_alt_type,
+                const EList<pair<index_t, index_t> >& ht_list)
+    {
+        if(used >= ALT_MEMO_SIZE / 4 * 3) return;
+        if(hts.size() + ht_list.size() > ALT_MEMO_HTS) return;
+        // another state may have taken the slot in the meantime
+        while(table[slot].gen == gen) slot = (slot + 1) & (ALT_MEMO_SIZE - 1);
+        Entry& e = table[slot];
+        e.gen = gen;
+        e.ctx = context(prev_alt_type, ht_list);
+        e.splice = (prev_alt_type == ALT_SPLICESITE);
+        e.htOff = hts.size();
+        e.htLen = ht_list.size();
+        for(size_t h = 0; h < ht_list.size(); h++) hts.push_back(ht_list[h]);
+        e.joinedOff = joinedOff;
+        e.rdoff = rdoff;
+        e.rfpos = rfpos;
+        e.span = span;
+        used++;
+    }
+    
+    static const size_t ALT_MEMO_SIZE = 4096;     // power of 2
+    static const size_t ALT_MEMO_HTS  = 64 * 1024; // haplotype list elements kept
+    
+    EList<Entry> table;
+    EList<pair<index_t, index_t> > hts; // haplotype lists of the entries
+    uint32_t     gen;
+    size_t       used;
+    uint64_t     completions; // # full-length alignments found
+    uint64_t     cutoffs;     // # times the ALT budget cut the search short
+    HIMetrics*   him;     // per-thread counters of states searched and reused
+};
+
 /**
  * this is per-thread data, which are shared by GenomeHit classes
  * the main purpose of this struct is to avoid extensive use of memory related functions
@@ -409,6 +569,7 @@ struct SharedTempVars {
     ELList<Edit, 128, 4>            candidate_edits;
     ELList<pair<index_t, index_t> > ht_llist;
     Haplotype<index_t>              cmp_ht;
+    ALTSearchMemo<index_t>          alt_memo;
     
     ASSERT_ONLY(SStringExpandable<uint32_t> destU32);
     
@@ -712,6 +873,13 @@ struct GenomeHit {
         index_t nedits = (index_t)edits.size();
         if(candidate_edits != NULL) candidate_edits->clear();
         ht_llist.clear();
+        // Skipping a revisited state would also drop the equally good
+        // edit sets it yields, so only memoize when they are not wanted
+        ALTSearchMemo<index_t>* memo = NULL;
+        if(candidate_edits == NULL) {
+            memo = &sharedVar.alt_memo;
+            memo->reset();
+        }
         // ht_llist.expand();
         // ht_llist[0] = ht_list;
         alignWithALTs_recur(
@@ -742,7 +910,8 @@ struct GenomeHit {
                             numNs,
                             0,    /* dep */
                             gpol,
-                            numALTsTried);
+                            numALTsTried,
+                            memo);
         index_t extlen = 0;
         if(left) {
             assert_geq(best_rdoff, -1);
@@ -815,6 +984,7 @@ struct GenomeHit {
                                        index_t                           dep,
                                        const GraphPolicy&                gpol,
                                        index_t&                          numALTsTried,
+                                       ALTSearchMemo<index_t>*           memo,
                                        ALT_TYPE                          prev_alt_type = ALT_NONE);
     
     /**
@@ -1605,6 +1775,12 @@ bool GenomeHit<index_t>::combineWith(
                 if(temp_scores[i] < remainsc) {
                     break;
                 }
+                // the score carries over unchanged up to the next mismatch
+                int run = (int)matchRunFw(refbuf + i + 1, seq.buf() + this_rdoff + i + 1, len - i - 1);
+                for(int j = i + 1; j <= i + run; j++) {
+                    temp_scores[j] = temp_scores[i];
+                }
+                i += run;
             }
             int i_limit = min<int>(i, len);
             int i2;
@@ -1621,6 +1797,11 @@ bool GenomeHit<index_t>::combineWith(
                 if(temp_scores2[i2] < remainsc) {
                     break;
                 }
+                int run = (int)matchRunBw(refbuf2 + i2 - 1, seq.buf() + this_rdoff + i2 - 1, i2);
+                for(int j = i2 - 1; j >= i2 - run; j--) {
+                    temp_scores2[j] = temp_scores2[i2];
+                }
+                i2 -= run;
             }
             int i2_limit = max<int>(i2, 0);
             if(spliceSite != NULL){
@@ -1764,6 +1945,12 @@ bool GenomeHit<index_t>::combineWith(
                 if(temp_scores[i] + gap_penalty < remainsc) {
                     break;
                 }
+                // the score carries over unchanged up to the next mismatch
+                int run = (int)matchRunFw(refbuf + i + 1, seq.buf() + this_rdoff + i + 1, len - i - 1);
+                for(int j = i + 1; j <= i + run; j++) {
+                    temp_scores[j] = temp_scores[i];
+                }
+                i += run;
             }
             int i_limit = min<int>(i, len);
             int i2;
@@ -1780,6 +1967,11 @@ bool GenomeHit<index_t>::combineWith(
                 if(temp_scores2[i2] + gap_penalty < remainsc) {
                     break;
                 }
+                int run = (int)matchRunBw(refbuf2 + i2 - 1, seq.buf() + this_rdoff + i2 - 1, i2);
+                for(int j = i2 - 1; j >= i2 - run; j--) {
+                    temp_scores2[j] = temp_scores2[i2];
+                }
+                i2 -= run;
             }
             int i2_limit = (i2 < inslen ? 0 : i2 - inslen);
             for(i = i2_limit, i2 = i2_limit + 1 + inslen;
@@ -2789,9 +2981,13 @@ index_t GenomeHit<index_t>::alignWithALTs_recur(
                                                 index_t                           dep,
                                                 const GraphPolicy&                gpol,
                                                 index_t&                          numALTsTried,
+                                                ALTSearchMemo<index_t>*           memo,
                                                 ALT_TYPE                          prev_alt_type)
 {
-    if(numALTsTried > gpol.maxAltsTried() + dep) return 0;
+    if(numALTsTried > gpol.maxAltsTried() + dep) {
+        if(memo != NULL) memo->cutoffs++;
+        return 0;
+    }
     assert_gt(rdlen, 0);
     assert_gt(rflen, 0);
     if(ht_llist.size() <= dep) ht_llist.expand();
@@ -2825,6 +3021,11 @@ index_t GenomeHit<index_t>::alignWithALTs_recur(
         int mm_min_rd_i = (int)rdoff;
         index_t mm_tmp_numNs = 0;
         for(int rf_i = (int)rflen - 1; rf_i >= 0 && mm_min_rd_i >= 0; rf_i--, mm_min_rd_i--) {
+            // skip over matching bases in vector-sized steps
+            int run = (int)matchRunBw(rfseq + rf_i, rdseq.buf() + mm_min_rd_i, min<int>(rf_i, mm_min_rd_i) + 1);
+            rf_i -= run;
+            mm_min_rd_i -= run;
+            if(rf_i < 0 || mm_min_rd_i < 0) break;
             int rf_bp = rfseq[rf_i];
             int rd_bp = rdseq[mm_min_rd_i];
             if(rf_bp != rd_bp || rd_bp == 4) {
@@ -2937,6 +3138,23 @@ index_t GenomeHit<index_t>::alignWithALTs_recur(
             }
         }
         
+        // Stop here if this state was already searched through another
+        // combination of ALTs; the walk continues leftward from the end
+        // of the reference window and stops at whichever runs out first
+        const int memo_rfpos = rfoff + (int)rflen;
+        const index_t memo_span = min<index_t>(rflen, rdoff + 1);
+        size_t memo_slot = 0;
+        uint64_t memo_completions = 0, memo_cutoffs = 0;
+        if(memo != NULL) {
+            if(memo->find(joinedOff, rdoff, memo_rfpos, memo_span, prev_alt_type, ht_list, memo_slot)) {
+                if(memo->him != NULL) memo->him->altreused++;
+                return 0;
+            }
+            if(memo->him != NULL) memo->him->altstates++;
+            memo_completions = memo->completions;
+            memo_cutoffs = memo->cutoffs;
+        }
+        
         assert_geq(rdoff, 0);
         const index_t orig_nedits = (index_t)tmp_edits.size();
         for(; alt_range.second > alt_range.first; alt_range.second--) {
@@ -3107,6 +3325,7 @@ index_t GenomeHit<index_t>::alignWithALTs_recur(
                 if(rd_i < 0) {
                     best_rdoff = rd_i;
                     edits = tmp_edits;
+                    if(memo != NULL) memo->completions++;
                     return rdlen;
                 }
                 index_t next_joinedOff = alt.pos;
@@ -3157,6 +3376,7 @@ index_t GenomeHit<index_t>::alignWithALTs_recur(
                                                          dep + 1,
                                                          gpol,
                                                          numALTsTried,
+                                                         memo,
                                                          alt.type);
                 if(alignedLen == next_rdlen) return rdlen;
             }
@@ -3164,6 +3384,11 @@ index_t GenomeHit<index_t>::alignWithALTs_recur(
             assert_leq(orig_nedits, tmp_edits.size());
             if(orig_nedits < tmp_edits.size()) tmp_edits.erase(0, tmp_edits.size() - orig_nedits);
         }
+        if(memo != NULL &&
+           memo->completions == memo_completions &&
+           memo->cutoffs == memo_cutoffs) {
+            memo->insert(memo_slot, joinedOff, rdoff, memo_rfpos, memo_span, prev_alt_type, ht_list);
+        }
         return 0;
     } else {
         index_t tmp_mm = 0;
@@ -3171,6 +3396,11 @@ index_t GenomeHit<index_t>::alignWithALTs_recur(
         index_t mm_max_rd_i = 0;
         index_t mm_tmp_numNs = 0;
         for(index_t rf_i = 0; rf_i < rflen && mm_max_rd_i < rdlen; rf_i++, mm_max_rd_i++) {
+            // skip over matching bases in vector-sized steps
+            index_t run = (index_t)matchRunFw(rfseq + rf_i, rdseq.buf() + rdoff + mm_max_rd_i, min<index_t>(rflen - rf_i, rdlen - mm_max_rd_i));
+            rf_i += run;
+            mm_max_rd_i += run;
+            if(rf_i >= rflen || mm_max_rd_i >= rdlen) break;
             int rf_bp = rfseq[rf_i];
             int rd_bp = rdseq[rdoff + mm_max_rd_i];
             if(rf_bp != rd_bp || rd_bp == 4) {
@@ -3292,6 +3522,23 @@ index_t GenomeHit<index_t>::alignWithALTs_recur(
             }
         }
         
+        // Stop here if this state was already searched through another
+        // combination of ALTs; running out of reference before the read
+        // ends is handled differently, hence the +1
+        const int memo_rfpos = rfoff;
+        const index_t memo_span = min<index_t>(rflen, rdlen + 1);
+        size_t memo_slot = 0;
+        uint64_t memo_completions = 0, memo_cutoffs = 0;
+        if(memo != NULL) {
+            if(memo->find(joinedOff, rdoff, memo_rfpos, memo_span, prev_alt_type, ht_list, memo_slot)) {
+                if(memo->him != NULL) memo->him->altreused++;
+                return 0;
+            }
+            if(memo->him != NULL) memo->him->altstates++;
+            memo_completions = memo->completions;
+            memo_cutoffs = memo->cutoffs;
+        }
+        
         const index_t orig_nedits = (index_t)tmp_edits.size();
         for(; alt_range.first < alt_range.second; alt_range.first++) {
             const ALT<index_t>& alt = alts[alt_range.first];
@@ -3460,6 +3707,7 @@ index_t GenomeHit<index_t>::alignWithALTs_recur(
                     }
                     best_rdoff = rdoff + rd_i;
                     edits = tmp_edits;
+                    if(memo != NULL) memo->completions++;
                     return rd_i;
                 }
                 index_t next_joinedOff = 0;
@@ -3516,6 +3764,7 @@ index_t GenomeHit<index_t>::alignWithALTs_recur(
                                                          dep + 1,
                                                          gpol,
                                                          numALTsTried,
+                                                         memo,
                                                          alt.type);
                 if(alignedLen > 0) {
                     assert_leq(rdoff + rd_i + alignedLen, best_rdoff);
@@ -3541,6 +3790,11 @@ index_t GenomeHit<index_t>::alignWithALTs_recur(
             assert_leq(orig_nedits, tmp_edits.size());
             if(orig_nedits < tmp_edits.size()) tmp_edits.resize(orig_nedits);
         }
+        if(memo != NULL &&
+           memo->completions == memo_completions &&
+           memo->cutoffs == memo_cutoffs) {
+            memo->insert(memo_slot, joinedOff, rdoff, memo_rfpos, memo_span, prev_alt_type, ht_list);
+        }
         return 0;
     }
 }
@@ -3908,6 +4162,10 @@ struct HIMetrics {
         localsearchrecur = 0;
         globalgenomecoords = 0;
         localgenomecoords = 0;
+        dpextatts = 0;
+        dpextdups = 0;
+        altstates = 0;
+        altreused = 0;
 	}
 	
 	void init(
@@ -3942,6 +4200,10 @@ struct HIMetrics {
         localsearchrecur += r.localsearchrecur;
         globalgenomecoords += r.globalgenomecoords;
         localgenomecoords += r.localgenomecoords;
+        dpextatts += r.dpextatts;
+        dpextdups += r.dpextdups;
+        altstates += r.altstates;
+        altreused += r.altreused;
     }
 	   
     uint64_t localatts;      // # attempts of local search
@@ -3951,6 +4213,10 @@ struct HIMetrics {
     uint64_t localsearchrecur;
     uint64_t globalgenomecoords;
     uint64_t localgenomecoords;
+    uint64_t dpextatts;      // # seed-extension DP problems filled
+    uint64_t dpextdups;      // # seed-extension DP problems skipped as duplicates
+    uint64_t altstates;      // # states searched when aligning with ALTs
+    uint64_t altreused;      // # states skipped as already searched
 	
 	MUTEX_T mutex_m;
 };
@@ -3983,11 +4249,40 @@ public:
             _minK++;
         }
         _minK_local = 8;
+        bwops_ = bwedits_ = 0;
+        _workBudget = _workBase = _workUsed = 0;
+        _workExceeded = false;
     }
     
     HI_Aligner() {
+        bwops_ = bwedits_ = 0;
+        _workBudget = _workBase = _workUsed = 0;
+        _workExceeded = false;
     }
     
+    /**
+     * Pool the edit lists of the alignments this aligner reports come from.
+     */
+    LinkedEList<EList<Edit> >& rawEdits() { return _rawEdits; }
+    
+    /**
+     * Limit the work done by each go() call to 'budget' units (0 = no
+     * limit).  A unit is one FM index operation, one state searched when
+     * aligning with ALTs, or 16 DP cells.
+     */
+    void setWorkBudget(uint64_t budget) { _workBudget = budget; }
+    
+    /**
+     * Return true iff the last go() call stopped searching because it ran
+     * out of its work budget.
+     */
+    bool workExceeded() const { return _workExceeded; }
+    
+    /**
+     * Return the # of work units spent by the last go() call.
+     */
+    uint64_t workUsed() const { return _workUsed; }
+    
     /**
      */
     void initRead(Read *rd, bool nofw, bool norc, TAlScore minsc, TAlScore maxpen, bool rightendonly = false) {
@@ -4067,6 +4362,9 @@ public:
            AlnSinkWrap<index_t>&      sink)
     {
         const ReportingParams& rp = sink.reportingParams();
+        _sharedVars.alt_memo.him = &him;
+        _workBase = workDone(swa, him);
+        _workExceeded = false;
         
         index_t rdi;
         bool fw;
@@ -4088,6 +4386,7 @@ public:
                 pairReads(sc, pepol, tpol, gpol, gfm, altdb, repeatdb, ref, wlm, prm, him, rnd, sink);
                 // if(sink.bestPair() >= _minsc[0] + _minsc[1]) break;
             }
+            if(overBudget(swa, him)) break;
         }
 
         //vector<index_t> rmVector; // this vector contine all the coordinate (hi in next loop) of bad candidates.
@@ -4175,6 +4474,7 @@ public:
                 index_t rs_size[2] = {(index_t)rs[0]->size(), (index_t)rs[1]->size()};
                 for(index_t i = 0; i < 2; i++) {
                     for(index_t j = 0; j < rs_size[i]; j++) {
+                        if(overBudget(swa, him)) break;
                         const AlnRes& res = (*rs[i])[j];
                         bool fw = (res.orient() == 1);
                         mate_found |= alignMate(
@@ -4221,6 +4521,12 @@ public:
         }
         
         
+        // Report what was found so far if the search ran out of budget
+        if(overBudget(swa, him)) {
+            _workUsed = workDone(swa, him) - _workBase;
+            return EXTEND_EXCEEDED_HARD_LIMIT;
+        }
+        
         // Determine whether reads map to repetitive sequences
         bool repeat[2][2] = {{false, false}, {false, false}};
         bool perform_repeat_alignment = false;
@@ -4706,7 +5012,8 @@ public:
             } // for(size_t rdi = 0
         } // repeat
         
-        return EXTEND_POLICY_FULFILLED;
+        _workUsed = workDone(swa, him) - _workBase;
+        return _workExceeded ? EXTEND_EXCEEDED_HARD_LIMIT : EXTEND_POLICY_FULFILLED;
     }
     
     /**
@@ -5447,6 +5754,25 @@ public:
      **/
     void addSearched(const GenomeHit<index_t>&       hit,
                      index_t                         rdi);
+    
+    /**
+     * Work units done so far; see setWorkBudget()
+     */
+    uint64_t workDone(const SwAligner& swa, const HIMetrics& him) const {
+        return bwops_ + him.altstates + swa.dpCells() / 16;
+    }
+    
+    /**
+     * Return true iff the current go() call has run out of its work
+     * budget; the search should then wrap up with what it has found.
+     */
+    bool overBudget(const SwAligner& swa, const HIMetrics& him) {
+        if(_workBudget > 0 && !_workExceeded &&
+           workDone(swa, him) - _workBase > _workBudget) {
+            _workExceeded = true;
+        }
+        return _workExceeded;
+    }
 
 protected:
   
@@ -5502,6 +5828,11 @@ protected:
 	uint64_t bwops_;                    // Burrows-Wheeler operations
 	uint64_t bwedits_;                  // Burrows-Wheeler edits
     
+    uint64_t _workBudget;   // max work units per go() call (0 = no limit)
+    uint64_t _workBase;     // work units done before the current go() call
+    uint64_t _workUsed;     // work units spent by the last go() call
+    bool     _workExceeded; // current go() call ran out of its budget
+    
     //
     EList<GenomeHit<index_t> >     _hits_searched[2];
 
@@ -6510,9 +6841,33 @@ index_t HI_Aligner<index_t, local_index_t>::partialSearch(
         }
     }
     
-    // Use ftab
-    gfm.ftabLoHi(seq, len - dep - ftabLen, false, range.first, range.second);
-    dep += ftabLen;
+    index_t same_range = 0, similar_range = 0;
+    // Use the deep ftab if the counters it carries are the only state
+    // the skipped steps could have changed (no stop is possible before
+    // _minK + 7 characters)
+    const index_t dftabLen = (index_t)gfm.dftabChars();
+    uint8_t dftabAux = 0;
+    if(dftabLen > 0 &&
+       linearFM &&
+       dftabLen <= left &&
+       dftabLen <= maxHitLen &&
+       dftabLen <= _minK + 6 &&
+       gfm.dftabLoHi(seq, len - dep - dftabLen, range.first, range.second, dftabAux) &&
+       range.first < range.second) {
+        dep += dftabLen;
+        node_range = range;
+        similar_range = dftabAux & GFM<index_t>::DFTAB_SIMILAR_MASK;
+        same_range = dftabAux >> GFM<index_t>::DFTAB_SAME_SHIFT;
+        if(range.second - range.first == 1) pseudogeneStop_ = false;
+        if(same_range == GFM<index_t>::DFTAB_SAME_CLEARED) {
+            anchorStop_ = false;
+            same_range = 0;
+        }
+    } else {
+        // Use ftab
+        gfm.ftabLoHi(seq, len - dep - ftabLen, false, range.first, range.second);
+        dep += ftabLen;
+    }
     if(range.first >= range.second) {
         cur = dep;
         partialHits.expand();
@@ -6529,7 +6884,6 @@ index_t HI_Aligner<index_t, local_index_t>::partialSearch(
         }
         return 0;
     }
-    index_t same_range = 0, similar_range = 0;
     HIER_INIT_LOCS(range.first, range.second, tloc, bloc, gfm);
     // Keep going
     while(dep < len && dep - offset < maxHitLen) {
@@ -6731,12 +7085,26 @@ index_t HI_Aligner<index_t, local_index_t>::globalGFMSearch(
         }
     }
     
-    // Use ftab
-    gfm.ftabLoHi(seq, len - dep - ftabLen, false, range.first, range.second);
-    dep += ftabLen;
-    if(range.first >= range.second) {
-        hitlen = ftabLen;
-        return 0;
+    // Use the deep ftab unless a unique range might have stopped the
+    // search before its depth
+    const index_t dftabLen = (index_t)gfm.dftabChars();
+    uint8_t dftabAux = 0;
+    if(dftabLen > 0 &&
+       linearFM &&
+       dftabLen <= left &&
+       gfm.dftabLoHi(seq, len - dep - dftabLen, range.first, range.second, dftabAux) &&
+       range.first < range.second &&
+       !(uniqueStop_ && range.second - range.first == 1 && dftabLen >= _minK)) {
+        dep += dftabLen;
+        node_range = range;
+    } else {
+        // Use ftab
+        gfm.ftabLoHi(seq, len - dep - ftabLen, false, range.first, range.second);
+        dep += ftabLen;
+        if(range.first >= range.second) {
+            hitlen = ftabLen;
+            return 0;
+        }
     }
     
     HIER_INIT_LOCS(range.first, range.second, tloc, bloc, gfm);
@@ -27,6 +27,12 @@
 #include <math.h>
 #include <utility>
 #include <limits>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
 #include "alphabet.h"
 #include "assert_helpers.h"
 #include "endian_swap.h"
@@ -57,6 +63,8 @@
 #include "opts.h"
 #include "outq.h"
 #include "repeat_kmer.h"
+#include "read_cache.h"
+#include "numa.h"
 
 using namespace std;
 
@@ -100,6 +108,22 @@ static bool fileParallel; // separate threads read separate input files in paral
 static bool useShmem;     // use shared memory to hold the index
 static bool useMm;        // use memory-mapped files to hold the index
 static bool mmSweep;      // sweep through memory-mapped files immediately after mapping
+static bool deepFtab;     // load <idx>.dftab.ht2 to start seed searches deeper
+static bool packedOffs;   // hold the SA sample bit-packed in memory
+static bool lazyLocalIndex; // construct local indexes on first use
+static size_t localIndexMem; // MB of local indexes to keep resident with lazyLocalIndex (0 = no limit)
+static string serverSocket; // keep the indexes loaded and take alignment jobs on this Unix socket
+static size_t dupCacheMem;   // MB of alignment results kept for exact-duplicate reads (0 = off)
+static int planSkip;         // skip 2nd plan if 1st is within this of a perfect score (-1 = off)
+static int tlaFromCode;      // DNA code of the base converted by --base-change (-1 = none)
+static size_t readBudget;    // work units each plan may spend on a read (0 = no limit)
+static string slowReadsFile; // write reads that ran out of budget here
+static size_t repeatCacheMem; // MB of repeat instance selections kept for reuse (0 = off)
+static bool numa;            // interleave the index over NUMA nodes and bind threads to nodes
+static EList<NumaNode> numaNodeList; // nodes alignment threads are spread over (empty = no binding)
+static OutFileBuf* slowReadsOfb;
+static MUTEX_T slowReadsMutex;
+static EList<string> serverArgs; // options the server was started with; jobs are parsed on top of them
 int gMinInsert;           // minimum insert size
 int gMaxInsert;           // maximum insert size
 bool gMate1fw;            // -1 mate aligns in fw orientation on fw strand
@@ -278,6 +302,8 @@ static size_t extra_opts_cur;
 static EList<uint64_t> thread_rids;
 static MUTEX_T         thread_rids_mutex;
 static uint64_t        thread_rids_mindist;
+static EList<uint64_t> thread_nreads;    // reads aligned by each thread, for --numa
+static double          search_seconds;   // wall-clock time of the last multiseedSearch()
 
 static bool rmChrName;  // remove "chr" from reference names (e.g., chr18 to 18)
 static bool addChrName; // add "chr" to reference names (e.g., 18 to chr18)
@@ -347,6 +373,18 @@ static void resetOptions() {
 	useShmem				= false; // use shared memory to hold the index
 	useMm					= false; // use memory-mapped files to hold the index
 	mmSweep					= false; // sweep through memory-mapped files immediately after mapping
+	deepFtab				= false; // load <idx>.dftab.ht2 to start seed searches deeper
+	packedOffs				= false; // SA sample in full index_t words
+	lazyLocalIndex			= false; // construct local indexes on first use
+	localIndexMem			= 0;     // no limit on resident local indexes
+	serverSocket			= "";    // align the reads given on the command line and quit
+	dupCacheMem				= 0;     // no duplicate-read cache
+	planSkip				= -1;    // always run both plans, plan A first
+	tlaFromCode				= -1;    // no base change
+	readBudget				= 0;     // no limit on the work spent per read
+	slowReadsFile			= "";    // don't write out reads that ran out of budget
+	repeatCacheMem			= 0;     // no repeat position cache
+	numa					= false; // leave placement to the kernel
 	gMinInsert				= 0;     // minimum insert size
 	gMaxInsert				= 1000;   // maximum insert size
 	gMate1fw				= true;  // -1 mate aligns in fw orientation on fw strand
@@ -543,7 +581,7 @@ static void resetOptions() {
     readLens.clear();
 }
 
-static const char *short_options = "fF:qbzhcu:rv:s:aP:t3:5:w:p:k:M:1:2:I:X:CQ:N:i:L:U:x:S:g:O:D:R:";
+static const char *short_options = "fF:qbzhcu:rv:s:aP:t3:5:w:o:p:k:M:1:2:I:X:CQ:N:i:L:U:x:S:g:O:D:R:";
 
 static struct option long_options[] = {
 	{(char*)"verbose",      no_argument,       0,            ARG_VERBOSE},
@@ -567,6 +605,7 @@ static struct option long_options[] = {
 	{(char*)"time",         no_argument,       0,            't'},
 	{(char*)"trim3",        required_argument, 0,            '3'},
 	{(char*)"trim5",        required_argument, 0,            '5'},
+	{(char*)"offrate",      required_argument, 0,            'o'},
 	{(char*)"seed",         required_argument, 0,            ARG_SEED},
 	{(char*)"qupto",        required_argument, 0,            'u'},
 	{(char*)"upto",         required_argument, 0,            'u'},
@@ -601,6 +640,18 @@ static struct option long_options[] = {
 	{(char*)"mm",           no_argument,       0,            ARG_MM},
 	{(char*)"shmem",        no_argument,       0,            ARG_SHMEM},
 	{(char*)"mmsweep",      no_argument,       0,            ARG_MMSWEEP},
+	{(char*)"deep-ftab",    no_argument,       0,            ARG_DEEP_FTAB},
+	{(char*)"packed-offs",  no_argument,       0,            ARG_PACKED_OFFS},
+	{(char*)"lazy-local-index", no_argument,   0,            ARG_LAZY_LOCAL_INDEX},
+	{(char*)"local-index-mem", required_argument, 0,         ARG_LOCAL_INDEX_MEM},
+	{(char*)"server",       required_argument, 0,            ARG_SERVER},
+	{(char*)"connect",      required_argument, 0,            ARG_CONNECT},
+	{(char*)"dup-cache",    required_argument, 0,            ARG_DUP_CACHE},
+	{(char*)"plan-skip",    required_argument, 0,            ARG_PLAN_SKIP},
+	{(char*)"read-budget",  required_argument, 0,            ARG_READ_BUDGET},
+	{(char*)"slow-reads",   required_argument, 0,            ARG_SLOW_READS},
+	{(char*)"repeat-cache", required_argument, 0,            ARG_REPEAT_CACHE},
+	{(char*)"numa",         no_argument,       0,            ARG_NUMA},
 	{(char*)"hadoopout",    no_argument,       0,            ARG_HADOOPOUT},
 	{(char*)"fuzzy",        no_argument,       0,            ARG_FUZZY},
 	{(char*)"fullref",      no_argument,       0,            ARG_FULLREF},
@@ -966,7 +1017,9 @@ static void printUsage(ostream& out) {
 	    << "  --omit-sec-seq        put '*' in SEQ and QUAL fields for secondary alignments." << endl
 		<< endl
 	    << " Performance:" << endl
-	    << "  -o/--offrate <int> override offrate of index; must be >= index's offrate" << endl
+	    << "  -o/--offrate <int> override offrate of index; a denser rate needs <idx>.offs.ht2" << endl
+	    << "                     (see hisat2-inspect --build-offs)" << endl
+	    << "  --packed-offs      hold the SA sample bit-packed (less memory for a given -o)" << endl
 	    << "  -p/--threads <int> number of alignment threads to launch (1)" << endl
 	    << "  --reorder          force SAM output order to match order of input reads" << endl
 #ifdef BOWTIE_MM
@@ -975,6 +1028,24 @@ static void printUsage(ostream& out) {
 #ifdef BOWTIE_SHARED_MEM
 		//<< "  --shmem            use shared mem for index; many 'hisat2's can share" << endl
 #endif
+	    << "  --deep-ftab        start seed searches from <idx>.dftab.ht2" << endl
+	    << "                     (see hisat2-inspect --build-deep-ftab)" << endl
+#ifdef BOWTIE_MM
+	    << "  --lazy-local-index load local indexes on first use (faster start-up)" << endl
+	    << "  --local-index-mem <int> MB of local indexes kept resident with --lazy-local-index (0: no limit)" << endl
+#endif
+	    << "  --server <path>    load the index once, then align jobs sent to Unix socket <path>," << endl
+	    << "                     one job at a time on the server's -p threads" << endl
+	    << "  --connect <path>   send this command's reads/options as a job to a --server; the job" << endl
+	    << "                     can't change the server's -p, index or index-loading options" << endl
+	    << "  --dup-cache <int>  MB of alignments kept for reuse by exact-duplicate reads (0: off)" << endl
+	    << "  --plan-skip <int>  run the likelier plan first; skip the other if the best score is" << endl
+	    << "                     within <int> of perfect (off)" << endl
+	    << "  --read-budget <int> work units a plan may spend on a read before it reports" << endl
+	    << "                     what it found, tagged ZW:i (0: no limit)" << endl
+	    << "  --slow-reads <path> write reads that ran out of --read-budget to <path>" << endl
+	    << "  --repeat-cache <int> MB of repeat instance lists kept for reuse across reads (0: off)" << endl
+	    << "  --numa             spread the index over all NUMA nodes and bind threads to nodes" << endl
 		<< endl
 	    << " Other:" << endl
 		<< "  --qc-filter        filter out reads that are bad according to QSEQ filter" << endl
@@ -1153,6 +1224,28 @@ static void parseOption(int next_option, const char *arg) {
 		case ARG_RF: gMate1fw = false; gMate2fw = true;  break;
 		case ARG_FR: gMate1fw = true;  gMate2fw = false; break;
 		case ARG_SHMEM: useShmem = true; break;
+		case ARG_DEEP_FTAB: deepFtab = true; break;
+		case ARG_PACKED_OFFS: packedOffs = true; break;
+		case ARG_LAZY_LOCAL_INDEX: lazyLocalIndex = true; break;
+		case ARG_LOCAL_INDEX_MEM:
+			localIndexMem = (size_t)parseInt(0, "--local-index-mem arg must be at least 0", arg);
+			break;
+		case ARG_SERVER: serverSocket = arg; break;
+		case ARG_CONNECT: break; // handled in hisat2() before option parsing
+		case ARG_DUP_CACHE:
+			dupCacheMem = (size_t)parseInt(0, "--dup-cache arg must be at least 0", arg);
+			break;
+		case ARG_PLAN_SKIP:
+			planSkip = parseInt(0, "--plan-skip arg must be at least 0", arg);
+			break;
+		case ARG_READ_BUDGET:
+			readBudget = (size_t)parseInt(0, "--read-budget arg must be at least 0", arg);
+			break;
+		case ARG_SLOW_READS: slowReadsFile = arg; break;
+		case ARG_REPEAT_CACHE:
+			repeatCacheMem = (size_t)parseInt(0, "--repeat-cache arg must be at least 0", arg);
+			break;
+		case ARG_NUMA: numa = true; break;
 		case ARG_SEED_SUMM: seedSumm = true; break;
 		case ARG_MM: {
 #ifdef BOWTIE_MM
@@ -1224,6 +1317,7 @@ static void parseOption(int next_option, const char *arg) {
 			break;
 		case '3': gTrim3 = parseInt(0, "-3/--trim3 arg must be at least 0", arg); break;
 		case '5': gTrim5 = parseInt(0, "-5/--trim5 arg must be at least 0", arg); break;
+		case 'o': offRate = parseInt(0, "-o/--offrate arg must be at least 0", arg); break;
 		case 'h': printUsage(cout); throw 0; break;
 		case ARG_USAGE: printUsage(cout); throw 0; break;
 		//
@@ -1791,6 +1885,7 @@ static void parseOption(int next_option, const char *arg) {
             dna5Code = distance(dna5CodeString.begin(), findIt);
 
             asc2dna_1[int(fromBase)] = dna5Code;
+            tlaFromCode = asc2dna[int(fromBase)];
             asc2dna_2[int(asc2dnacomp[int(fromBase)])] = 3 - dna5Code;
 
             break;
@@ -2027,6 +2122,7 @@ static Scoring*                          multiseed_sc;
 static AlnSink<index_t>*                 multiseed_msink;
 static OutFileBuf*                       multiseed_metricsOfb;
 static SpliceSiteDB*                     ssdb;
+static ReadResultCache*                  readCache;
 //static ALTDB<index_t>*                   altdb;
 //static RepeatDB<index_t>*                repeatdb;
 //static ALTDB<index_t>*                   raltdb;
@@ -2037,6 +2133,38 @@ static ALTDB<index_t> *raltdbs[2];
 static TranscriptomePolicy*              multiseed_tpol;
 static GraphPolicy*                      gpol;
 
+/**
+ * Print the hit rates of the repeat position caches, if enabled.
+ */
+static void printRepeatCacheSumm(ostream& out) {
+    for(int j = 0; j < 2; j++) {
+        if(repeatdbs[j] == NULL || repeatdbs[j]->positionCache() == NULL) continue;
+        repeatdbs[j]->positionCache()->printSumm(out, j == 0 ? "Repeat position cache (index 1)" : "Repeat position cache (index 2)");
+    }
+}
+
+/**
+ * With --numa, print how many threads ran on each node and how many
+ * reads they aligned per second.
+ */
+static void printNumaSumm(ostream& out) {
+    if(numaNodeList.empty()) return;
+    for(size_t n = 0; n < numaNodeList.size(); n++) {
+        size_t nthr = 0;
+        uint64_t nrd = 0;
+        for(size_t t = n; t < thread_nreads.size(); t += numaNodeList.size()) {
+            nthr++;
+            nrd += thread_nreads[t];
+        }
+        out << "NUMA node " << numaNodeList[n].id << ": " << nthr << " threads on "
+            << numaNodeList[n].cpus.size() << " CPUs, " << nrd << " reads";
+        if(search_seconds > 0) {
+            out << ", " << (uint64_t)(nrd / search_seconds + 0.5) << " reads/s";
+        }
+        out << endl;
+    }
+}
+
 
 class referenceTLA {
 public:
@@ -2065,7 +2193,7 @@ public:
         multiseed_gfm_B = gfms[1];
 
         multiseed_rgfm_A = rgfms[0];
-        multiseed_rgfm_A = rgfms[1];
+        multiseed_rgfm_B = rgfms[1];
 
         multiseed_refs_A = refss[0].get();
         multiseed_refs_B = refss[1].get();
@@ -2094,7 +2222,8 @@ struct OuterLoopMetrics {
 	 */
 	void reset() {
 		reads = bases = srreads = srbases =
-		freads = fbases = ureads = ubases = 0;
+		freads = fbases = ureads = ubases =
+		scratchallocs = scratchpeak = 0;
 	}
 
 	/**
@@ -2115,6 +2244,17 @@ struct OuterLoopMetrics {
 		fbases += m.fbases;
 		ureads += m.ureads;
 		ubases += m.ubases;
+		scratchallocs += m.scratchallocs;
+		scratchpeak = max<uint64_t>(scratchpeak, m.scratchpeak);
+	}
+
+	/**
+	 * Account for the scratch containers that had to grow while aligning
+	 * one read.
+	 */
+	void scratch(uint64_t allocs, uint64_t bytes) {
+		scratchallocs += allocs;
+		if(bytes > scratchpeak) scratchpeak = bytes;
 	}
 
 	uint64_t reads;   // total reads
@@ -2125,6 +2265,8 @@ struct OuterLoopMetrics {
 	uint64_t fbases;  // filtered bases
 	uint64_t ureads;  // unfiltered reads
 	uint64_t ubases;  // unfiltered bases
+	uint64_t scratchallocs; // # scratch container allocations while aligning reads
+	uint64_t scratchpeak;   // most scratch bytes allocated while aligning one read
 	MUTEX_T mutex_m;
 };
 
@@ -2397,6 +2539,12 @@ struct PerfMetrics {
                 /* 134 */ "LocalSearchRecur"    "\t"
                 /* 135 */ "GlobalGenomeCoords"  "\t"
                 /* 136 */ "LocalGenomeCoords"   "\t"
+                /* 137 */ "DPExtSearch"         "\t"
+                /* 138 */ "DPExtDups"           "\t"
+                /* 139 */ "ReadScratchAllocs"   "\t"
+                /* 140 */ "ReadScratchPeak"     "\t"
+                /* 141 */ "ALTStates"           "\t"
+                /* 142 */ "ALTStatesReused"     "\t"
             
             
 				"\n";
@@ -2992,6 +3140,30 @@ struct PerfMetrics {
 		if(o != NULL) { o->writeChars(buf); o->write('\t'); }
         // 136
         itoa10<size_t>(him.localgenomecoords, buf);
+        if(metricsStderr) stderrSs << buf << '\t';
+		if(o != NULL) { o->writeChars(buf); o->write('\t'); }
+        // 137
+        itoa10<size_t>(him.dpextatts, buf);
+        if(metricsStderr) stderrSs << buf << '\t';
+		if(o != NULL) { o->writeChars(buf); o->write('\t'); }
+        // 138
+        itoa10<size_t>(him.dpextdups, buf);
+        if(metricsStderr) stderrSs << buf << '\t';
+		if(o != NULL) { o->writeChars(buf); o->write('\t'); }
+        // 139
+        itoa10<uint64_t>(ol.scratchallocs, buf);
+        if(metricsStderr) stderrSs << buf << '\t';
+		if(o != NULL) { o->writeChars(buf); o->write('\t'); }
+        // 140
+        itoa10<uint64_t>(ol.scratchpeak, buf);
+        if(metricsStderr) stderrSs << buf << '\t';
+		if(o != NULL) { o->writeChars(buf); o->write('\t'); }
+        // 141
+        itoa10<size_t>(him.altstates, buf);
+        if(metricsStderr) stderrSs << buf << '\t';
+		if(o != NULL) { o->writeChars(buf); o->write('\t'); }
+        // 142
+        itoa10<size_t>(him.altreused, buf);
         if(metricsStderr) stderrSs << buf;
 		if(o != NULL) { o->writeChars(buf); }
 
@@ -3192,7 +3364,24 @@ static inline void printEEScoreMsg(
 	x.resetCounters(); \
 }
 
-
+/**
+ * Guess from the composition of mate 1 whether plan B is likelier to
+ * align it than plan A.  A read sequenced from a converted strand is
+ * depleted of the base --base-change converts; one from the opposite
+ * strand is depleted of its complement.  Each plan leaves the other base
+ * untouched, so count it there.
+ */
+static bool planBFirst(const Read& rd) {
+	if(tlaFromCode < 0 || tlaFromCode > 3) return false;
+	size_t nfrom = 0, ncomp = 0;
+	for(size_t i = 0; i < rd.patFw1.length(); i++) {
+		if((int)rd.patFw1[i] == tlaFromCode) nfrom++;
+	}
+	for(size_t i = 0; i < rd.patFw.length(); i++) {
+		if((int)rd.patFw[i] == 3 - tlaFromCode) ncomp++;
+	}
+	return nfrom > ncomp;
+}
 
 
 
@@ -3213,6 +3402,12 @@ static inline void printEEScoreMsg(
  */
 static void multiseedSearchWorker_hisat2(void *vp) {
 	int tid = *((int*)vp);
+	// Bind before allocating anything so that this thread's own memory
+	// is local to the node it runs on
+	if(!numaNodeList.empty()) {
+		numaBindThread(numaNodeList[(tid - 1) % numaNodeList.size()]);
+	}
+	uint64_t nreads = 0;
 
 
 
@@ -3280,6 +3475,8 @@ static void multiseedSearchWorker_hisat2(void *vp) {
     SplicedAligner<index_t, local_index_t> splicedAligner(gfm_A,
                                                           anchorStop,
                                                           thread_rids_mindist);
+	splicedAligner.setWorkBudget(readBudget);
+	ReadResultCache::Scratch cacheScratch;
 	SwAligner sw;
 	OuterLoopMetrics olm;
 	SeedSearchMetrics sdm;
@@ -3392,8 +3589,8 @@ static void multiseedSearchWorker_hisat2(void *vp) {
 			sample = rnd.nextFloat() < sampleFrac;
 		}
 		if(rdid >= skipReads && rdid < qUpto && sample) {
+			nreads++;
 			// Align this read/pair
-			bool retry = true;
 			//
 			// Check if there is metrics reporting for us to do.
 			//
@@ -3421,13 +3618,26 @@ static void multiseedSearchWorker_hisat2(void *vp) {
 			if(sam_print_xt) {
 				gettimeofday(&prm.tv_beg, &prm.tz_beg);
 			}
+			// Heap growth of this thread's containers while aligning the read
+			const uint64_t scratchAllocs = MemoryTally::threadAllocs();
+			const uint64_t scratchBytes = MemoryTally::threadBytes();
+			// With --plan-skip, start with the plan the read's composition
+			// favors and stop early if that plan aligns it well enough
+			const bool bFirst = planSkip >= 0 && planBFirst(ps->bufa());
+			if(planSkip >= 0) {
+				if(bFirst) rpm.nplan_b_first++;
+				else       rpm.nplan_a_first++;
+			}
+			if(bFirst) ps->planB();
+			bool slow = false; // a plan ran out of --read-budget
 			// Try to align this read
-			while(retry || ps->isPlanA) {
+			for(int planRun = 0; planRun < 2; planRun++) {
                 //
                 msinkwrap.resetInit_();
-                if (!retry)
+                if (planRun > 0)
                 {
-                    ps->planB(); // use patFW1 for alignment
+                    if(bFirst) ps->planA(); // back to patFw for alignment
+                    else       ps->planB(); // use patFW1 for alignment
 
 
                     if(metricsIval > 0 &&
@@ -3457,8 +3667,6 @@ static void multiseedSearchWorker_hisat2(void *vp) {
                 }
 
 
-				retry = false;
-
 				assert_eq(ps->bufa().color, false);
 				olm.reads++;
 				bool pair = paired;
@@ -3646,8 +3854,28 @@ static void multiseedSearchWorker_hisat2(void *vp) {
                 } else if(filt[1]) {
                     splicedAligner.initRead(rds[1], nofw[1], norc[1], minsc[1], maxpen[1], true);
                 }
-                if(filt[0] || filt[1]) {
+                // An exact duplicate of a read already aligned with this
+                // plan gets that read's alignments without a search
+                // and the same splice sites to work with
+                const Read* cacheRds[2] = { rds[0], pair ? rds[1] : NULL };
+                const uint64_t ssChanges = ssdb->numChanges();
+                bool cached = false;
+                if(readCache != NULL && (filt[0] || filt[1])) {
+                    cached = readCache->replay(
+                            cacheRds[0],
+                            cacheRds[1],
+                            filt[0],
+                            filt[1],
+                            sc.qualitiesMatter(),
+                            ssChanges,
+                            rdid,
+                            msinkwrap,
+                            splicedAligner.rawEdits(),
+                            cacheScratch);
+                }
+                if(!cached && (filt[0] || filt[1])) {
                     int ret;
+                    const uint64_t draws = rnd.draws();
 
                     if (ps->isPlanA) {
                         ret = splicedAligner.go(
@@ -3671,6 +3899,11 @@ static void multiseedSearchWorker_hisat2(void *vp) {
                                 rnd,
                                 msinkwrap);
                     } else {
+                        // Plan B can't start from plan A's BWT ranges, even
+                        // for stretches of the read that neither plan
+                        // converts: gfm_B indexes another text (the genome
+                        // with the complementary conversion), so the ranges
+                        // and their offsets are unrelated
                         ret = splicedAligner.go(
                                 sc,
                                 pepol,
@@ -3692,6 +3925,9 @@ static void multiseedSearchWorker_hisat2(void *vp) {
                                 rnd,
                                 msinkwrap);
                     }
+                    prm.nWork = splicedAligner.workUsed();
+                    prm.workExceeded = splicedAligner.workExceeded();
+                    slow |= prm.workExceeded;
 
                     MERGE_SW(sw);
                     // daehwan
@@ -3729,6 +3965,23 @@ static void multiseedSearchWorker_hisat2(void *vp) {
                             done[mate] = true;
                         }
                     }
+                    // Splice sites found by reads less than
+                    // thread_rids_mindist before this one were hidden from
+                    // the search but may not be from a later duplicate.
+                    // rnd is seeded from the read's name and qualities, so
+                    // a search that drew from it may go differently for a
+                    // duplicate and would leave rnd elsewhere for the sink
+                    if(readCache != NULL && !prm.workExceeded && rnd.draws() == draws &&
+                       (ssChanges == 0 || ssdb->lastChangeReadId() + thread_rids_mindist <= rdid)) {
+                        readCache->insert(
+                                cacheRds[0],
+                                cacheRds[1],
+                                filt[0],
+                                filt[1],
+                                sc.qualitiesMatter(),
+                                ssChanges,
+                                msinkwrap);
+                    }
                 }
 
                 for(size_t i = 0; i < 2; i++) {
@@ -3765,8 +4018,38 @@ static void multiseedSearchWorker_hisat2(void *vp) {
                         templateLenAdjustment);
                 //msinkwraps.push_back(msinkwrap);
 
+                // The other plan can't beat a (near-)perfect alignment of
+                // every mate it would be tried for
+                if(planRun == 0 && planSkip >= 0 && (filt[0] || filt[1])) {
+                    bool decisive = pair && filt[0] && filt[1] &&
+                        msinkwrap.bestPair() >= sc.perfectScore(rdlens[0]) + sc.perfectScore(rdlens[1]) - 2 * planSkip;
+                    if(!decisive) {
+                        decisive = (!filt[0] || msinkwrap.bestUnp1() >= sc.perfectScore(rdlens[0]) - planSkip) &&
+                                   (!filt[1] || msinkwrap.bestUnp2() >= sc.perfectScore(rdlens[1]) - planSkip);
+                    }
+                    if(decisive) {
+                        if(bFirst) rpm.nskip_a++;
+                        else       rpm.nskip_b++;
+                        break;
+                    }
+                }
                 //assert(!retry || msinkwrap.empty());
-			} // while(retry)
+			} // for(planRun)
+			olm.scratch(MemoryTally::threadAllocs() - scratchAllocs,
+			            MemoryTally::threadBytes() - scratchBytes);
+			if(slow) {
+				rpm.nbudget++;
+				if(slowReadsOfb != NULL) {
+					// Write the read as it appeared in the input
+					ThreadSafe ts(&slowReadsMutex, nthreads > 1);
+					const Read& ra = ps->bufa();
+					const Read& rb = ps->bufb();
+					slowReadsOfb->writeChars(ra.readOrigBuf.buf(), ra.readOrigBuf.length());
+					if(paired) {
+						slowReadsOfb->writeChars(rb.readOrigBuf.buf(), rb.readOrigBuf.length());
+					}
+				}
+			}
 			//int bestScore = numeric_limits<int>::min();
 
             /*for (int i  = 1; i < msinkwraps.size(); i++) {
@@ -3834,6 +4117,7 @@ static void multiseedSearchWorker_hisat2(void *vp) {
 			metricsPt.reset();
 		}
 	} // while(true)
+	thread_nreads[tid - 1] = nreads;
 	
 	// One last metrics merge
 	MERGE_METRICS(metrics, nthreads > 1);
@@ -3877,6 +4161,10 @@ static void multiseedSearch(
         thread_rids.resize(nthreads);
         thread_rids.fill(0);
         thread_rids_mindist = (nthreads == 1 || !useTempSpliceSite ? 0 : 1000 * nthreads);
+        thread_nreads.resize(nthreads);
+        thread_nreads.fill(0);
+        struct timeval tv_start, tv_end;
+        gettimeofday(&tv_start, NULL);
 		for(int i = 0; i < nthreads; i++) {
 			// Thread IDs start at 1
 			tids[i] = i+1;
@@ -3885,6 +4173,8 @@ static void multiseedSearch(
 
         for (int i = 0; i < nthreads; i++)
             threads[i]->join();
+        gettimeofday(&tv_end, NULL);
+        search_seconds = (tv_end.tv_sec - tv_start.tv_sec) + (tv_end.tv_usec - tv_start.tv_usec) / 1e6;
 
 	}
 	if(!metricsPerRead && (metricsOfb != NULL || metricsStderr)) {
@@ -3892,104 +4182,37 @@ static void multiseedSearch(
 	}
 }
 
-static string argstr;
-
-extern void initializeCntLut();
-extern void initializeCntBit();
-
-template<typename TStr>
-static void driver(
-	const char * type,
-	const string bt2indexBases[2],
-	const string& outfile)
-{
-	if(gVerbose || startVerbose)  {
-		cerr << "Entered driver(): "; logTime(cerr, true);
-	}
-    
-    initializeCntLut();
-    initializeCntBit();
-    
-	// Vector of the reference sequences; used for sanity-checking
-	EList<SString<char> > names, os;
-	EList<size_t> nameLens, seqLens;
-	// Read reference sequences from the command-line or from a FASTA file
-	if(!origString.empty()) {
-		// Read fasta file(s)
-		EList<string> origFiles;
-		tokenize(origString, ",", origFiles);
-		parseFastas(origFiles, names, nameLens, os, seqLens);
-	}
-	PatternParams pp(
-		format,        // file format
-		fileParallel,  // true -> wrap files with separate PairedPatternSources
-		seed,          // pseudo-random seed
-		useSpinlock,   // use spin locks instead of pthreads
-		solexaQuals,   // true -> qualities are on solexa64 scale
-		phred64Quals,  // true -> qualities are on phred64 scale
-		integerQuals,  // true -> qualities are space-separated numbers
-		fuzzy,         // true -> try to parse fuzzy fastq
-		fastaContLen,  // length of sampled reads for FastaContinuous...
-		fastaContFreq, // frequency of sampled reads for FastaContinuous...
-		skipReads      // skip the first 'skip' patterns
-	);
-	if(gVerbose || startVerbose) {
-		cerr << "Creating PatternSource: "; logTime(cerr, true);
-	}
-	PairedPatternSource *patsrc = PairedPatternSource::setupPatternSources(
-		queries,     // singles, from argv
-		mates1,      // mate1's, from -1 arg
-		mates2,      // mate2's, from -2 arg
-		mates12,     // both mates on each line, from --12 arg
-#ifdef USE_SRA
-        sra_accs,    // SRA accessions
-#endif
-		qualities,   // qualities associated with singles
-		qualities1,  // qualities associated with m1
-		qualities2,  // qualities associated with m2
-		pp,          // read read-in parameters
-        nthreads,
-		gVerbose || startVerbose); // be talkative
-	// Open hit output file
-	if(gVerbose || startVerbose) {
-		cerr << "Opening hit output file: "; logTime(cerr, true);
-	}
-	OutFileBuf *fout;
-	if(!outfile.empty()) {
-		fout = new OutFileBuf(outfile.c_str(), false);
-	} else {
-		fout = new OutFileBuf();
-	}
-	// Initialize GFM object and read in header
-	if(gVerbose || startVerbose) {
-		cerr << "About to initialize fw GFM: "; logTime(cerr, true);
-	}
-
-    //ALTDB<index_t> *altdbs[2];
-    //RepeatDB<index_t> *repeatdbs[2];
-    //ALTDB<index_t> *raltdbs[2];
-
-    for (int i = 0; i < 2; i++) {
-        altdbs[i] = new ALTDB<index_t>();
-        repeatdbs[i] = new RepeatDB<index_t>();
-        raltdbs[i] = new ALTDB<index_t>();
-    }
-
-    vector<HGFM<index_t>* >gfms;
-    RFM<index_t>* rgfms[2];
-    for (int i = 0; i < 2; i++) {
-        rgfms[i] = NULL;
-    }
-    bool rep_index_exists[2]{false};
-    string rep_adjIdxBases[2];
-
-    /*altdb = new ALTDB<index_t>();
-    repeatdb = new RepeatDB<index_t>();
-    raltdb = new ALTDB<index_t>();*/
-
-//    gfms.resize(2);
+/**
+ * Everything needed to load one of the two base-converted indexes.
+ */
+struct IndexLoadParam {
+    int j;                                // which index (0 or 1)
+    int nthreads;                         // threads for reading its arrays
+    const string *bt2indexBases;
+    const EList<SString<char> > *os;      // for sanity checking
+    vector<HGFM<index_t>* > *gfms;
+    RFM<index_t> **rgfms;
+    bool *rep_index_exists;
+    string *rep_adjIdxBases;
+    BitPairReference **refs;
+    BitPairReference **rrefs;
+    bool failed;
+};
 
-    for (int j = 0; j < 2; j++) {
+/**
+ * Load index 'j', its repeat index and their references.  The two
+ * indexes share no state, so driver() can run this for both at once.
+ */
+static void loadIndexes_worker(void *vp) {
+    IndexLoadParam *p = (IndexLoadParam*)vp;
+    const int j = p->j;
+    const string *bt2indexBases = p->bt2indexBases;
+    const EList<SString<char> >& os = *p->os;
+    vector<HGFM<index_t>* >& gfms = *p->gfms;
+    RFM<index_t> **rgfms = p->rgfms;
+    bool *rep_index_exists = p->rep_index_exists;
+    string *rep_adjIdxBases = p->rep_adjIdxBases;
+    try {
         adjIdxBase[j] = adjustEbwtBase(argv0, bt2indexBases[j], gVerbose);
         HGFM<index_t, local_index_t> *tmp_gfm = new HGFM<index_t, local_index_t>(
                 adjIdxBase[j],
@@ -4014,7 +4237,12 @@ static void driver(
                 sanityCheck,
                 use_haplotype); //use haplotypes?
 
-        gfms.push_back(tmp_gfm);
+        if(lazyLocalIndex) {
+            tmp_gfm->setLazyLocalGFMs(localIndexMem << 20);
+        }
+        tmp_gfm->setThreads(p->nthreads);
+        tmp_gfm->setPackedOffs(packedOffs);
+        gfms[j] = tmp_gfm;
 
         if(sanityCheck && !os.empty()) {
             // Sanity check number of patterns and pattern lengths in GFM
@@ -4048,14 +4276,14 @@ static void driver(
                     true,         // load rstarts (in forward index)
                     !noRefNames,  // load names?
                     startVerbose);
+            if(deepFtab) {
+                gfms[j]->loadDeepFtab(startVerbose);
+            }
         }
 
         rep_adjIdxBases[j] = adjIdxBase[j] + ".rep";
         //bool rep_index_exists = false;
-        {
-            std::ifstream infile((rep_adjIdxBases[j] + ".1." + gfm_ext.c_str()).c_str());
-            rep_index_exists[j] = infile.good();
-        }
+        rep_index_exists[j] = indexFileExists(rep_adjIdxBases[j] + ".1." + gfm_ext);
 
         if(rep_index_exists[j] && use_repeat_index) {
             rgfms[j] = new RFM<index_t>(
@@ -4080,6 +4308,7 @@ static void driver(
                     false /*passMemExc*/,
                     sanityCheck,
                     false); //use haplotypes?
+            rgfms[j]->setThreads(p->nthreads);
 
             // CP to do
 #if 0
@@ -4117,146 +4346,119 @@ static void driver(
                         startVerbose);
 
                 repeatdbs[j]->construct(gfms[j]->rstarts(), gfms[j]->nFrag());
+                if(repeatCacheMem > 0) {
+                    repeatdbs[j]->enablePositionCache((uint64_t)repeatCacheMem << 19); // half per index
+                }
             }
         }
 
-        if(!saw_k) {
-            if(gfms[j]->gh().linearFM()) khits = 5;
-            else                    khits = 10;
+
+        {
+            Timer _tRef(cerr, "Time loading reference: ", timing);
+            p->refs[j] = new BitPairReference(
+                    adjIdxBase[j],
+                    NULL,
+                    false,
+                    sanityCheck,
+                    NULL,
+                    NULL,
+                    false,
+                    useMm,
+                    useShmem,
+                    mmSweep,
+                    gVerbose,
+                    startVerbose);
+        }
+        if(!p->refs[j]->loaded()) throw 1;
+        if(rep_index_exists[j] && use_repeat_index) {
+            const EList<uint8_t> &included = rgfms[j]->getReadIncluded();
+            p->rrefs[j] = new BitPairReference(
+                    rep_adjIdxBases[j],
+                    &included,
+                    false,
+                    sanityCheck,
+                    NULL,
+                    NULL,
+                    false,
+                    useMm,
+                    useShmem,
+                    mmSweep,
+                    gVerbose,
+                    startVerbose);
+            if(!p->rrefs[j]->loaded()) throw 1;
         }
+    } catch(int e) {
+        p->failed = true;
+    } catch(std::bad_alloc& e) {
+        cerr << "Error: Out of memory loading index " << bt2indexBases[j] << endl;
+        p->failed = true;
     }
+}
 
+static string argstr;
 
+extern void initializeCntLut();
+extern void initializeCntBit();
 
-
-/*	HGFM<index_t, local_index_t> gfm(
-                                     adjIdxBase,
-                                     altdb,
-                                     NULL,
-                                     NULL,
-                                     -1,       // fw index
-                                     true,     // index is for the forward direction
-                                     *//* overriding: *//* offRate,
-                                     0, // amount to add to index offrate or <= 0 to do nothing
-                                     useMm,    // whether to use memory-mapped files
-                                     useShmem, // whether to use shared memory
-                                     mmSweep,  // sweep memory-mapped files
-                                     !noRefNames, // load names?
-                                     true,        // load SA sample?
-                                     true,        // load ftab?
-                                     true,        // load rstarts?
-                                     !no_spliced_alignment, // load splice sites?
-                                     gVerbose, // whether to be talkative
-                                     startVerbose, // talkative during initialization
-                                     false *//*passMemExc*//*,
-                                     sanityCheck,
-                                     use_haplotype); //use haplotypes?
-	if(sanityCheck && !os.empty()) {
-		// Sanity check number of patterns and pattern lengths in GFM
-		// against original strings
-		assert_eq(os.size(), gfm.nPat());
-		for(size_t i = 0; i < os.size(); i++) {
-			assert_eq(os[i].length(), gfm.plen()[i]);
-		}
-	}
-	// Sanity-check the restored version of the GFM
-	if(sanityCheck && !os.empty()) {
-		gfm.loadIntoMemory(
-			-1, // fw index
-			true, // load SA sample
-			true, // load ftab
-			true, // load rstarts
-			!noRefNames,
-			startVerbose);
-		gfm.checkOrigs(os, false);
-		gfm.evictFromMemory();
+/**
+ * Align the reads named by the current options against the loaded
+ * indexes and write them to 'outfile' (stdout if empty), with the
+ * alignment summary going to 'sumOut'.
+ */
+static void alignReads(
+    const string& outfile,
+    ostream& sumOut,
+    vector<HGFM<index_t>* >& gfms,
+    RFM<index_t>* rgfms[2],
+    auto_ptr<BitPairReference> refss[2],
+    BitPairReference* rrefss[2],
+    const bool rep_index_exists[2])
+{
+	PatternParams pp(
+		format,        // file format
+		fileParallel,  // true -> wrap files with separate PairedPatternSources
+		seed,          // pseudo-random seed
+		useSpinlock,   // use spin locks instead of pthreads
+		solexaQuals,   // true -> qualities are on solexa64 scale
+		phred64Quals,  // true -> qualities are on phred64 scale
+		integerQuals,  // true -> qualities are space-separated numbers
+		fuzzy,         // true -> try to parse fuzzy fastq
+		fastaContLen,  // length of sampled reads for FastaContinuous...
+		fastaContFreq, // frequency of sampled reads for FastaContinuous...
+		skipReads      // skip the first 'skip' patterns
+	);
+	if(gVerbose || startVerbose) {
+		cerr << "Creating PatternSource: "; logTime(cerr, true);
 	}
-    {
-        // Load the other half of the index into memory
-        assert(!gfm.isInMemory());
-        Timer _t(cerr, "Time loading forward index: ", timing);
-        gfm.loadIntoMemory(
-                           -1, // not the reverse index
-                           true,         // load SA samp? (yes, need forward index's SA samp)
-                           true,         // load ftab (in forward index)
-                           true,         // load rstarts (in forward index)
-                           !noRefNames,  // load names?
-                           startVerbose);
-    }
-    RFM<index_t>* rgfm = NULL;
-    string rep_adjIdxBase = adjIdxBase + ".rep";
-    bool rep_index_exists = false;
-    {
-        std::ifstream infile((rep_adjIdxBase + ".1." + gfm_ext.c_str()).c_str());
-        rep_index_exists = infile.good();
-    }
-    if(rep_index_exists && use_repeat_index) {
-        rgfm = new RFM<index_t>(
-                                rep_adjIdxBase,
-                                raltdb,
-                                repeatdb,
-                                &readLens,
-                                -1,       // fw index
-                                true,     // index is for the forward direction
-                                *//* overriding: *//* offRate,
-                                0, // amount to add to index offrate or <= 0 to do nothing
-                                useMm,    // whether to use memory-mapped files
-                                useShmem, // whether to use shared memory
-                                mmSweep,  // sweep memory-mapped files
-                                !noRefNames, // load names?
-                                true,        // load SA sample?
-                                true,        // load ftab?
-                                true,        // load rstarts?
-                                !no_spliced_alignment, // load splice sites?
-                                gVerbose, // whether to be talkative
-                                startVerbose, // talkative during initialization
-                                false *//*passMemExc*//*,
-                                sanityCheck,
-                                false); //use haplotypes?
-
-        // CP to do
-#if 0
-        if(sanityCheck && !os.empty()) {
-            // Sanity check number of patterns and pattern lengths in GFM
-            // against original strings
-            assert_eq(os.size(), gfm.nPat());
-            for(size_t i = 0; i < os.size(); i++) {
-                assert_eq(os[i].length(), rgfm->plen()[i]);
-            }
-        }
-        // Sanity-check the restored version of the GFM
-        if(sanityCheck && !os.empty()) {
-            rgfm->loadIntoMemory(
-                               -1, // fw index
-                               true, // load SA sample
-                               true, // load ftab
-                               true, // load rstarts
-                               !noRefNames,
-                               startVerbose);
-            rgfm->checkOrigs(os, false);
-            rgfm->evictFromMemory();
-        }
+	PairedPatternSource *patsrc = PairedPatternSource::setupPatternSources(
+		queries,     // singles, from argv
+		mates1,      // mate1's, from -1 arg
+		mates2,      // mate2's, from -2 arg
+		mates12,     // both mates on each line, from --12 arg
+#ifdef USE_SRA
+        sra_accs,    // SRA accessions
 #endif
-        {
-            // Load the other half of the index into memory
-            assert(!rgfm->isInMemory());
-            Timer _t(cerr, "Time loading forward index: ", timing);
-            rgfm->loadIntoMemory(
-                                 -1, // not the reverse index
-                                 true,         // load SA samp? (yes, need forward index's SA samp)
-                                 true,         // load ftab (in forward index)
-                                 true,         // load rstarts (in forward index)
-                                 !noRefNames,  // load names?
-                                 startVerbose);
-            
-            repeatdb->construct(gfm.rstarts(), gfm.nFrag());
-        }
-    }
-    
+		qualities,   // qualities associated with singles
+		qualities1,  // qualities associated with m1
+		qualities2,  // qualities associated with m2
+		pp,          // read read-in parameters
+        nthreads,
+		gVerbose || startVerbose); // be talkative
+	// Open hit output file
+	if(gVerbose || startVerbose) {
+		cerr << "Opening hit output file: "; logTime(cerr, true);
+	}
+	OutFileBuf *fout;
+	if(!outfile.empty()) {
+		fout = new OutFileBuf(outfile.c_str(), false);
+	} else {
+		fout = new OutFileBuf();
+	}
+
     if(!saw_k) {
-        if(gfm.gh().linearFM()) khits = 5;
+        if(gfms[1]->gh().linearFM()) khits = 5;
         else                    khits = 10;
-    }*/
+    }
 	OutputQueue oq(
 		*fout,                   // out file buffer
 		reorder && nthreads > 1, // whether to reorder when there's >1 thread
@@ -4400,52 +4602,6 @@ static void driver(
 
 
 
-        auto_ptr<BitPairReference>  refss[2];
-        for (int j = 0; j < 2; j++) {
-            Timer *_tRef = new Timer(cerr, "Time loading reference: ", timing);
-            refss[j] = auto_ptr<BitPairReference> (
-                                                        new BitPairReference(
-                                                                adjIdxBase[j],
-                                                                NULL,
-                                                                false,
-                                                                sanityCheck,
-                                                                NULL,
-                                                                NULL,
-                                                                false,
-                                                                useMm,
-                                                                useShmem,
-                                                                mmSweep,
-                                                                gVerbose,
-                                                                startVerbose)
-                                                                );
-            delete _tRef;
-            if(!refss[j]->loaded()) throw 1;
-
-        }
-
-        
-        BitPairReference* rrefss[2]{NULL};
-
-        for (int j = 0; j < 2; j++) {
-            if (rep_index_exists[j] && use_repeat_index) {
-                const EList<uint8_t> &included = rgfms[j]->getReadIncluded();
-                rrefss[j] = new BitPairReference(
-                        rep_adjIdxBases[j],
-                        &included,
-                        false,
-                        sanityCheck,
-                        NULL,
-                        NULL,
-                        false,
-                        useMm,
-                        useShmem,
-                        mmSweep,
-                        gVerbose,
-                        startVerbose);
-                if (!rrefss[j]->loaded()) throw 1;
-            }
-        }
-        
         bool xsOnly = (tranAssm_program == "cufflinks");
         TranscriptomePolicy tpol(minIntronLen,
                                  maxIntronLen,
@@ -4462,7 +4618,6 @@ static void driver(
                          altdbs[0]->haplotypes().size() > 0 && use_haplotype,
                          enable_codis);
         
-        init_junction_prob();
         bool write = novelSpliceSiteOutfile != "" || useTempSpliceSite;
         bool read = knownSpliceSiteInfile != "" || novelSpliceSiteInfile != "" || useTempSpliceSite || altdbs[0]->hasSpliceSites();
         ssdb = new SpliceSiteDB(
@@ -4472,6 +4627,9 @@ static void driver(
                                 write, // write?
                                 read);  // read?
         ssdb->read(*gfms[0], altdbs[0]->alts());
+        if(dupCacheMem > 0) {
+            readCache = new ReadResultCache((uint64_t)dupCacheMem << 20);
+        }
         if(knownSpliceSiteInfile != "") {
             ifstream ssdb_file(knownSpliceSiteInfile.c_str(), ios::in);
             if(ssdb_file.is_open()) {
@@ -4518,6 +4676,9 @@ static void driver(
 		if(!metricsFile.empty() && metricsIval > 0) {
 			metricsOfb = new OutFileBuf(metricsFile);
 		}
+		if(!slowReadsFile.empty()) {
+			slowReadsOfb = new OutFileBuf(slowReadsFile);
+		}
 		// Do the search for all input reads
 		assert(patsrc != NULL);
 		assert(mssink != NULL);
@@ -4532,24 +4693,20 @@ static void driver(
                         refss,
                         rrefss,
                         metricsOfb);
-		// Evict any loaded indexes from memory
-		for (int j = 0; j < 2; j++) {
-            if(gfms[j]->isInMemory()) {
-                gfms[j]->evictFromMemory();
-            }
-		}
-
 		if(!gQuiet && !seedSumm) {
 			size_t repThresh = mhits;
 			if(repThresh == 0) {
 				repThresh = std::numeric_limits<size_t>::max();
 			}
-			mssink->finish(cerr,
+			mssink->finish(sumOut,
                            repThresh,
                            gReportDiscordant,
                            gReportMixed,
                            newAlignSummary,
                            hadoopOut);
+            if(readCache != NULL) readCache->printSumm(sumOut);
+            printRepeatCacheSumm(sumOut);
+            printNumaSumm(sumOut);
             if(alignSumFile != "") {
                 ofstream sumfile(alignSumFile.c_str(), ios::out);
                 if(sumfile.is_open()) {
@@ -4559,6 +4716,9 @@ static void driver(
                                    gReportMixed,
                                    newAlignSummary,
                                    false); // hadoopOut
+                    if(readCache != NULL) readCache->printSumm(sumfile);
+                    printRepeatCacheSumm(sumfile);
+                    printNumaSumm(sumfile);
                     sumfile.close();
                 }
             }
@@ -4581,24 +4741,501 @@ static void driver(
         //delete repeatdb;
         //delete raltdb;
         delete ssdb;
+        ssdb = NULL;
+        delete readCache;
+        readCache = NULL;
 		delete metricsOfb;
-        for (int i = 0; i < 2; i++) {
-            if(rep_index_exists[i] && use_repeat_index) {
-                delete rgfms[i];
-            }
-            delete rrefss[i];
-            delete altdbs[i];
-            delete repeatdbs[i];
-            delete raltdbs[i];
-        }
-        //delete rgfm;
-        //delete rrefs;
+		delete slowReadsOfb;
+		slowReadsOfb = NULL;
 		if(fout != NULL) {
 			delete fout;
 		}
 	}
 }
 
+/**
+ * Stream buffer that appends to a job's report under a lock, so that
+ * what the search threads print to cerr reaches the job's client.
+ */
+class JobReportBuf : public std::streambuf {
+public:
+	JobReportBuf(ostringstream& report) : report_(report) { }
+protected:
+	virtual int overflow(int c) {
+		if(c != EOF) {
+			ThreadSafe ts(&lock_);
+			report_.put((char)c);
+		}
+		return c;
+	}
+	virtual std::streamsize xsputn(const char *s, std::streamsize n) {
+		ThreadSafe ts(&lock_);
+		report_.write(s, n);
+		return n;
+	}
+private:
+	ostringstream& report_;
+	MUTEX_T        lock_;
+};
+
+/**
+ * Read one NUL-terminated string from socket 'fd' into 's'.  Returns
+ * false if the peer hung up first.
+ */
+static bool readSocketString(int fd, string& s) {
+	s.clear();
+	char c;
+	while(true) {
+		ssize_t r = read(fd, &c, 1);
+		if(r < 0 && errno == EINTR) continue;
+		if(r <= 0) return false;
+		if(c == '\0') return true;
+		s.push_back(c);
+	}
+}
+
+/**
+ * Write 's' and a terminating NUL to socket 'fd'.
+ */
+static bool writeSocketString(int fd, const string& s) {
+	const char *p = s.c_str();
+	size_t left = s.length() + 1;
+	while(left > 0) {
+		ssize_t r = write(fd, p, left);
+		if(r < 0 && errno == EINTR) continue;
+		if(r <= 0) return false;
+		p += r; left -= r;
+	}
+	return true;
+}
+
+/**
+ * Append the options that decide how the indexes are loaded, and the
+ * number of threads, to 'opts' as name/value pairs.  A --server job runs
+ * on the server's loaded indexes and threads and can't change these.
+ */
+template<typename T>
+static void addServerOption(EList<pair<string, string> >& opts, const char *name, const T& val) {
+	ostringstream ss;
+	ss << val;
+	opts.push_back(make_pair(string(name), ss.str()));
+}
+
+static void serverOptions(EList<pair<string, string> >& opts) {
+	opts.clear();
+	addServerOption(opts, "-p/--threads", nthreads);
+	addServerOption(opts, "-o/--offrate", offRate);
+	addServerOption(opts, "--packed-offs", packedOffs);
+	addServerOption(opts, "--mm", useMm);
+	addServerOption(opts, "--shmem", useShmem);
+	addServerOption(opts, "--mmsweep", mmSweep);
+	addServerOption(opts, "--deep-ftab", deepFtab);
+	addServerOption(opts, "--lazy-local-index", lazyLocalIndex);
+	addServerOption(opts, "--local-index-mem", localIndexMem);
+	addServerOption(opts, "--repeat-cache", repeatCacheMem);
+	addServerOption(opts, "--numa", numa);
+	addServerOption(opts, "--no-spliced-alignment", no_spliced_alignment);
+	addServerOption(opts, "--haplotype", use_haplotype);
+	addServerOption(opts, "--no-repeat-index/--fast", !use_repeat_index);
+	addServerOption(opts, "--refidx", noRefNames);
+}
+
+/**
+ * Return path 'p' as seen from directory 'dir'.
+ */
+static string pathFrom(const string& dir, const string& p) {
+	if(p.empty() || p[0] == '/') return p;
+	return dir + "/" + p;
+}
+
+/**
+ * Keep the loaded indexes and align the jobs that 'hisat2 --connect'
+ * sends to the Unix socket serverSocket, one after another on the
+ * server's -p threads.  A job that gives other index, loading or thread
+ * options than the server's fails with an error naming them.  A job is the client's working directory and its
+ * command-line arguments, each NUL-terminated, followed by an empty
+ * string.  The arguments are parsed on top of the server's own options,
+ * so index and loading options always come from the server.  The reply
+ * is the job's report (alignment summary, everything the job printed to
+ * stderr, including errors, and timing) and its exit status, again as
+ * NUL-terminated strings.
+ */
+static void serveAlignmentJobs(
+	vector<HGFM<index_t>* >& gfms,
+	RFM<index_t>* rgfms[2],
+	auto_ptr<BitPairReference> refss[2],
+	BitPairReference* rrefss[2],
+	const bool rep_index_exists[2])
+{
+	// Option parsing resets these; every job has to see the server's
+	const string sock = serverSocket;
+	const int serverThreads = nthreads;
+	const string indexes[2] = { bt2indexs[0], bt2indexs[1] };
+	EList<pair<string, string> > serverOpts, jobOpts;
+	serverOptions(serverOpts);
+	char serverDir[PATH_MAX];
+	if(getcwd(serverDir, PATH_MAX) == NULL) {
+		perror("getcwd");
+		throw 1;
+	}
+	// Jobs run in the client's directory
+	string adjIndexes[2];
+	for(int j = 0; j < 2; j++) {
+		adjIndexes[j] = adjIdxBase[j];
+		if(!adjIndexes[j].empty() && adjIndexes[j][0] != '/') {
+			adjIndexes[j] = string(serverDir) + "/" + adjIndexes[j];
+		}
+	}
+	
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(sock.length() >= sizeof(addr.sun_path)) {
+		cerr << "Error: --server socket path is too long: " << sock << endl;
+		throw 1;
+	}
+	strcpy(addr.sun_path, sock.c_str());
+	unlink(sock.c_str());
+	int sfd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(sfd < 0 || bind(sfd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(sfd, 64) < 0) {
+		perror("socket");
+		cerr << "Error: could not listen on " << sock << endl;
+		throw 1;
+	}
+	// A client that goes away mid-reply must not take the server down
+	signal(SIGPIPE, SIG_IGN);
+	cerr << "Waiting for alignment jobs on " << sock << ": "; logTime(cerr, true);
+	
+	uint64_t njobs = 0;
+	while(true) {
+		int cfd = accept(sfd, NULL, NULL);
+		if(cfd < 0) {
+			if(errno == EINTR) continue;
+			perror("accept");
+			break;
+		}
+		string dir, arg;
+		EList<string> args;
+		args.push_back(argv0);
+		for(size_t i = 0; i < serverArgs.size(); i++) {
+			args.push_back(serverArgs[i]);
+		}
+		bool ok = readSocketString(cfd, dir);
+		while(ok) {
+			ok = readSocketString(cfd, arg);
+			if(!ok || arg.empty()) break;
+			args.push_back(arg);
+		}
+		if(!ok) {
+			close(cfd);
+			continue;
+		}
+		njobs++;
+		
+		ostringstream report;
+		int status = 0;
+		struct timeval tv_start, tv_end;
+		gettimeofday(&tv_start, NULL);
+		metrics.reset();
+		try {
+			if(chdir(dir.c_str()) != 0) {
+				report << "Error: server could not change to directory " << dir << endl;
+				throw 1;
+			}
+			EList<const char*> argv;
+			for(size_t i = 0; i < args.size(); i++) {
+				argv.push_back(args[i].c_str());
+			}
+			opterr = optind = 1;
+			resetOptions();
+			// Send complaints about the job's options back to the client
+			streambuf *errbuf = cerr.rdbuf(report.rdbuf());
+			try {
+				parseOptions((int)argv.size(), argv.ptr());
+			} catch(...) {
+				cerr.rdbuf(errbuf);
+				throw;
+			}
+			cerr.rdbuf(errbuf);
+			// The indexes are loaded and the threads fixed; refuse a job
+			// that asks for others rather than quietly ignore it
+			bool fixedOk = true;
+			const char *indexOpts[2] = { "--index1", "--index2" };
+			for(int j = 0; j < 2; j++) {
+				if(bt2indexs[j] != indexes[j] &&
+				   pathFrom(dir, bt2indexs[j]) != pathFrom(serverDir, indexes[j])) {
+					report << "Error: a --server job can't change " << indexOpts[j] << " (server: "
+					       << indexes[j] << ", job: " << bt2indexs[j] << ")" << endl;
+					fixedOk = false;
+				}
+			}
+			serverOptions(jobOpts);
+			for(size_t i = 0; i < jobOpts.size(); i++) {
+				if(jobOpts[i].second != serverOpts[i].second) {
+					report << "Error: a --server job can't change " << jobOpts[i].first << " (server: "
+					       << serverOpts[i].second << ", job: " << jobOpts[i].second << ")" << endl;
+					fixedOk = false;
+				}
+			}
+			if(!fixedOk) {
+				report << "Error: the server's index, loading and thread options apply to every job; leave them out" << endl;
+				throw 1;
+			}
+			if(optind < (int)argv.size()) {
+				report << "Error: extra parameter \"" << argv[optind] << "\"; give reads with -U/-1/-2/--12 and the output with -S" << endl;
+				throw 1;
+			}
+			if(queries.empty() && mates1.empty() && mates12.empty()) {
+				report << "Error: Must specify at least one read input with -U/-1/-2" << endl;
+				throw 1;
+			}
+			if(outfile.empty()) {
+				report << "Error: a job must write its alignments to a file with -S" << endl;
+				throw 1;
+			}
+			// The read parsers exit() on unreadable input; check it here
+			const EList<string>* readFiles[] = { &queries, &mates1, &mates2, &mates12 };
+			for(size_t i = 0; i < 4 && format != CMDLINE; i++) {
+				for(size_t j = 0; j < readFiles[i]->size(); j++) {
+					const string& f = (*readFiles[i])[j];
+					if(f == "-" || access(f.c_str(), R_OK) != 0) {
+						report << "Error: could not open read file \"" << f << "\" for reading" << endl;
+						throw 1;
+					}
+				}
+			}
+			nthreads = serverThreads;
+			serverSocket = sock;
+			for(int j = 0; j < 2; j++) {
+				bt2indexs[j] = indexes[j];
+				adjIdxBase[j] = adjIndexes[j];
+			}
+			argstr.clear();
+			for(size_t i = 0; i < args.size(); i++) {
+				argstr += args[i];
+				if(i + 1 < args.size()) argstr += " ";
+			}
+			// Errors and warnings from the search go back to the client
+			// too, along with its exit status
+			JobReportBuf jobBuf(report);
+			ostream jobOut(&jobBuf);
+			errbuf = cerr.rdbuf(&jobBuf);
+			try {
+				alignReads(outfile, jobOut, gfms, rgfms, refss, rrefss, rep_index_exists);
+			} catch(...) {
+				cerr.rdbuf(errbuf);
+				throw;
+			}
+			cerr.rdbuf(errbuf);
+		} catch(int e) {
+			status = (e == 0 ? 1 : e);
+		} catch(std::exception& e) {
+			report << "Error: Encountered exception: '" << e.what() << "'" << endl;
+			status = 1;
+		}
+		if(chdir(serverDir) != 0) {
+			perror("chdir");
+		}
+		gettimeofday(&tv_end, NULL);
+		double secs = (tv_end.tv_sec - tv_start.tv_sec) + (tv_end.tv_usec - tv_start.tv_usec) / 1e6;
+		const uint64_t nreads = metrics.olm.reads + metrics.olmu.reads;
+		report << "Job " << njobs << ": " << nreads << " reads, "
+		       << (metrics.olm.bases + metrics.olmu.bases) << " bases in " << secs << " s";
+		if(secs > 0) {
+			report << " (" << (uint64_t)(nreads / secs) << " reads/s)";
+		}
+		report << endl;
+		ostringstream st;
+		st << status;
+		writeSocketString(cfd, report.str());
+		writeSocketString(cfd, st.str());
+		close(cfd);
+		if(gVerbose || startVerbose) {
+			cerr << "Job " << njobs << " in " << dir << " finished with status " << status << ": "; logTime(cerr, true);
+		}
+	}
+	close(sfd);
+	unlink(sock.c_str());
+}
+
+/**
+ * Send this command line, minus --connect, as a job to the server on
+ * socket 'path'.  Relays the job's report to stderr and returns its
+ * exit status.
+ */
+static int submitAlignmentJob(const char *path, int argc, const char **argv) {
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(strlen(path) >= sizeof(addr.sun_path)) {
+		cerr << "Error: --connect socket path is too long: " << path << endl;
+		return 1;
+	}
+	strcpy(addr.sun_path, path);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+		perror("connect");
+		cerr << "Error: could not connect to a hisat2 server on " << path << endl;
+		return 1;
+	}
+	char dir[PATH_MAX];
+	if(getcwd(dir, PATH_MAX) == NULL) {
+		perror("getcwd");
+		close(fd);
+		return 1;
+	}
+	bool ok = writeSocketString(fd, dir);
+	for(int i = 1; i < argc && ok; i++) {
+		if(strcmp(argv[i], "--connect") == 0) {
+			i++;
+			continue;
+		}
+		if(strncmp(argv[i], "--connect=", 10) == 0) continue;
+		ok = writeSocketString(fd, argv[i]);
+	}
+	ok = ok && writeSocketString(fd, "");
+	string report, status;
+	ok = ok && readSocketString(fd, report) && readSocketString(fd, status);
+	close(fd);
+	if(!ok) {
+		cerr << "Error: lost the connection to the hisat2 server on " << path << endl;
+		return 1;
+	}
+	cerr << report;
+	return atoi(status.c_str());
+}
+
+template<typename TStr>
+static void driver(
+	const char * type,
+	const string bt2indexBases[2],
+	const string& outfile)
+{
+	if(gVerbose || startVerbose)  {
+		cerr << "Entered driver(): "; logTime(cerr, true);
+	}
+    
+    initializeCntLut();
+    initializeCntBit();
+    
+	// Vector of the reference sequences; used for sanity-checking
+	EList<SString<char> > names, os;
+	EList<size_t> nameLens, seqLens;
+	// Read reference sequences from the command-line or from a FASTA file
+	if(!origString.empty()) {
+		// Read fasta file(s)
+		EList<string> origFiles;
+		tokenize(origString, ",", origFiles);
+		parseFastas(origFiles, names, nameLens, os, seqLens);
+	}
+	// Initialize GFM object and read in header
+	if(gVerbose || startVerbose) {
+		cerr << "About to initialize fw GFM: "; logTime(cerr, true);
+	}
+
+    //ALTDB<index_t> *altdbs[2];
+    //RepeatDB<index_t> *repeatdbs[2];
+    //ALTDB<index_t> *raltdbs[2];
+
+    for (int i = 0; i < 2; i++) {
+        altdbs[i] = new ALTDB<index_t>();
+        repeatdbs[i] = new RepeatDB<index_t>();
+        raltdbs[i] = new ALTDB<index_t>();
+    }
+
+    vector<HGFM<index_t>* >gfms(2, (HGFM<index_t>*)NULL);
+    RFM<index_t>* rgfms[2];
+    for (int i = 0; i < 2; i++) {
+        rgfms[i] = NULL;
+    }
+    bool rep_index_exists[2]{false};
+    string rep_adjIdxBases[2];
+    BitPairReference* loadedRefs[2]{NULL};
+    BitPairReference* loadedRRefs[2]{NULL};
+
+    /*altdb = new ALTDB<index_t>();
+    repeatdb = new RepeatDB<index_t>();
+    raltdb = new ALTDB<index_t>();*/
+
+    // With --numa, the pages of the index go round-robin over the nodes
+    // rather than all on the loading thread's; the loader threads
+    // inherit the policy
+    numaNodeList.clear();
+    if(numa) {
+        if(!numaNodes(numaNodeList) || !numaInterleave(numaNodeList)) {
+            cerr << "Warning: could not read the NUMA topology or set the memory policy; ignoring --numa" << endl;
+            numaNodeList.clear();
+        } else if(gVerbose || startVerbose) {
+            cerr << "Interleaving the index over " << numaNodeList.size() << " NUMA node(s)" << endl;
+        }
+    }
+    {
+        // With -p > 1, read both indexes at once and split each index's
+        // big arrays among the remaining threads
+        const int nloaders = (nthreads > 1 ? 2 : 1);
+        EList<IndexLoadParam> tparams;
+        for (int j = 0; j < 2; j++) {
+            tparams.expand();
+            IndexLoadParam& p = tparams.back();
+            p.j = j;
+            p.nthreads = max(nthreads / nloaders, 1);
+            p.bt2indexBases = bt2indexBases;
+            p.os = &os;
+            p.gfms = &gfms;
+            p.rgfms = rgfms;
+            p.rep_index_exists = rep_index_exists;
+            p.rep_adjIdxBases = rep_adjIdxBases;
+            p.refs = loadedRefs;
+            p.rrefs = loadedRRefs;
+            p.failed = false;
+        }
+        if(nloaders == 1) {
+            for (int j = 0; j < 2; j++) {
+                loadIndexes_worker((void*)&tparams[j]);
+                if(tparams[j].failed) throw 1;
+            }
+        } else {
+            AutoArray<tthread::thread*> threads(2);
+            for (int j = 0; j < 2; j++) {
+                threads[j] = new tthread::thread(loadIndexes_worker, (void*)&tparams[j]);
+            }
+            for (int j = 0; j < 2; j++) {
+                threads[j]->join();
+                delete threads[j];
+            }
+            if(tparams[0].failed || tparams[1].failed) throw 1;
+        }
+    }
+    if(!numaNodeList.empty()) numaLocal();
+    auto_ptr<BitPairReference>  refss[2];
+    BitPairReference* rrefss[2]{NULL};
+    for (int j = 0; j < 2; j++) {
+        refss[j] = auto_ptr<BitPairReference>(loadedRefs[j]);
+        rrefss[j] = loadedRRefs[j];
+    }
+    init_junction_prob();
+    if(serverSocket.empty()) {
+        alignReads(outfile, cerr, gfms, rgfms, refss, rrefss, rep_index_exists);
+    } else {
+        serveAlignmentJobs(gfms, rgfms, refss, rrefss, rep_index_exists);
+    }
+    // Evict any loaded indexes from memory
+    for (int j = 0; j < 2; j++) {
+        if(gfms[j]->isInMemory()) {
+            gfms[j]->evictFromMemory();
+        }
+    }
+    for (int i = 0; i < 2; i++) {
+        if(rep_index_exists[i] && use_repeat_index) {
+            delete rgfms[i];
+        }
+        delete rrefss[i];
+        delete altdbs[i];
+        delete repeatdbs[i];
+        delete raltdbs[i];
+    }
+}
+
 // C++ name mangling is disabled for the bowtie() function to make it
 // easier to use Bowtie as a library.
 extern "C" {
@@ -4609,6 +5246,14 @@ extern "C" {
  * function.
  */
 int hisat2(int argc, const char **argv) {
+	// Hand the whole job to a running server?
+	for(int i = 1; i < argc; i++) {
+		if(strcmp(argv[i], "--connect") == 0 && i + 1 < argc) {
+			return submitAlignmentJob(argv[i + 1], argc, argv);
+		} else if(strncmp(argv[i], "--connect=", 10) == 0) {
+			return submitAlignmentJob(argv[i] + 10, argc, argv);
+		}
+	}
 	try {
 		// Reset all global state, including getopt state
 		opterr = optind = 1;
@@ -4620,6 +5265,14 @@ int hisat2(int argc, const char **argv) {
 		if(startVerbose) { cerr << "Entered main(): "; logTime(cerr, true); }
 		parseOptions(argc, argv);
 		argv0 = argv[0];
+		if(!serverSocket.empty()) {
+			// getopt_long() has moved the options in front of the
+			// positional arguments
+			serverArgs.clear();
+			for(int i = 1; i < optind; i++) {
+				serverArgs.push_back(argv[i]);
+			}
+		}
 		if(showVersion) {
 			cout << argv0 << " version " << HISAT2_VERSION << endl;
 			if(sizeof(void*) == 4) {
@@ -4676,7 +5329,7 @@ int hisat2(int argc, const char **argv) {
                 return 1;
             }
 			if(optind >= argc) {
-				if(!got_reads) {
+				if(!got_reads && serverSocket.empty()) {
 					printUsage(cerr);
 					cerr << "***" << endl
 #ifdef USE_SRA
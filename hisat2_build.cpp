@@ -35,6 +35,7 @@
 #include "gfm.h"
 #include "hgfm.h"
 #include "rfm.h"
+#include "build_report.h"
 
 /**
  * \file Driver for the bowtie-build indexing tool.
@@ -67,6 +68,14 @@ static int32_t offRate;
 static int32_t ftabChars;
 static int32_t localOffRate;
 static int32_t localFtabChars;
+static int32_t deepFtabChars;
+static size_t pathGraphMem; // MB of path nodes held while building a graph index; 0 = no limit
+static bool useSais;        // build suffix arrays with SA-IS instead of the blockwise builder
+static string checkpointDir; // save build phases here so an interrupted build can resume
+static bool resume;          // reuse phases saved in checkpointDir by an earlier run
+static Checkpoint* checkpoint;
+static string incrementalBase; // earlier index to copy unchanged local indexes from
+static string reportFile;      // write a JSON report of build phases here
 static int  bigEndian;
 static bool nsToAs;
 static bool autoMem;
@@ -107,6 +116,14 @@ static void resetOptions() {
 	ftabChars      = 10; // 10 chars in initial lookup table
     localOffRate   = 3;
     localFtabChars = 6;
+    deepFtabChars  = 0;  // no deep ftab
+    pathGraphMem   = 0;  // build the path graph in memory
+    useSais        = false; // blockwise suffix-array builder
+    checkpointDir  = "";    // no checkpoints
+    resume         = false; // start from scratch
+    checkpoint     = NULL;
+    incrementalBase = "";   // build every local index
+    reportFile     = "";    // no build report
 	bigEndian      = 0;  // little endian
 	nsToAs         = false; // convert reference Ns to As prior to indexing
 	autoMem        = true;  // automatically adjust memory usage parameters
@@ -152,6 +169,13 @@ enum {
     ARG_REPEAT_INFO,
     ARG_REPEAT_SNP,
     ARG_REPEAT_HAPLOTYPE,
+    ARG_DEEP_FTAB,
+    ARG_PATHGRAPH_MEM,
+    ARG_SAIS,
+    ARG_CHECKPOINT_DIR,
+    ARG_RESUME,
+    ARG_INCREMENTAL,
+    ARG_REPORT,
     //BASE_CHANGE,
 };
 
@@ -186,12 +210,22 @@ static void printUsage(ostream& out) {
 	    << "    --bmaxdivn <int>        max bucket sz as divisor of ref len (default: 4)" << endl
 	    << "    --dcv <int>             diff-cover period for blockwise (default: 1024)" << endl
 	    << "    --nodc                  disable diff-cover (algorithm becomes quadratic)" << endl
+	    << "    --sais                  build suffix arrays in linear time with SA-IS; more memory," << endl
+	    << "                            no --bmax/--dcv tuning (default: blockwise)" << endl
 	    << "    -r/--noref              don't build .3/.4.ht2 (packed reference) portion" << endl
 	    << "    -3/--justref            just build .3/.4.ht2 (packed reference) portion" << endl
 	    << "    -o/--offrate <int>      SA is sampled every 2^offRate BWT chars (default: 5)" << endl
 	    << "    -t/--ftabchars <int>    # of chars consumed in initial lookup (default: 10)" << endl
         << "    --localoffrate <int>    SA (local) is sampled every 2^offRate BWT chars (default: 3)" << endl
         << "    --localftabchars <int>  # of chars consumed in initial lookup in a local index (default: 6)" << endl
+        << "    --deep-ftab <int>       also write a deep ftab consuming <int> chars (.dftab." << gfm_ext << ")" << endl
+        << "    --pathgraph-mem <int>   build the graph in temp files using ~<int> MB (default: in memory)" << endl
+        << "    --checkpoint-dir <path> save progress in <path> so an interrupted build can resume" << endl
+        << "    --resume                skip phases already saved in --checkpoint-dir" << endl
+        << "    --incremental <ht2_base> copy local indexes whose variants are unchanged from an" << endl
+        << "                            earlier build of the same reference" << endl
+        << "    --report <path>         write time and memory used by each build phase to <path>" << endl
+        << "                            as JSON" << endl
         << "    --snp <path>            SNP file name" << endl
         << "    --haplotype <path>      haplotype file name" << endl
         << "    --ss <path>             Splice site file name" << endl
@@ -240,6 +274,13 @@ static struct option long_options[] = {
 	{(char*)"ftabchars",      required_argument, 0,            't'},
     {(char*)"localoffrate",   required_argument, 0,            ARG_LOCAL_OFFRATE},
 	{(char*)"localftabchars", required_argument, 0,            ARG_LOCAL_FTABCHARS},
+	{(char*)"deep-ftab",      required_argument, 0,            ARG_DEEP_FTAB},
+	{(char*)"pathgraph-mem",  required_argument, 0,            ARG_PATHGRAPH_MEM},
+	{(char*)"sais",           no_argument,       0,            ARG_SAIS},
+	{(char*)"checkpoint-dir", required_argument, 0,            ARG_CHECKPOINT_DIR},
+	{(char*)"resume",         no_argument,       0,            ARG_RESUME},
+	{(char*)"incremental",    required_argument, 0,            ARG_INCREMENTAL},
+	{(char*)"report",         required_argument, 0,            ARG_REPORT},
     {(char*)"snp",            required_argument, 0,            ARG_SNP},
     {(char*)"haplotype",      required_argument, 0,            ARG_HAPLOTYPE},
     {(char*)"ss",             required_argument, 0,            ARG_SPLICESITE},
@@ -327,6 +368,17 @@ static void parseOptions(int argc, const char **argv) {
             case ARG_LOCAL_FTABCHARS:
 				localFtabChars = parseNumber<int>(1, "-t/--localftabchars arg must be at least 1");
 				break;
+            case ARG_DEEP_FTAB:
+                deepFtabChars = parseNumber<int>(1, "--deep-ftab arg must be at least 1");
+                break;
+            case ARG_PATHGRAPH_MEM:
+                pathGraphMem = parseNumber<size_t>(1, "--pathgraph-mem arg must be at least 1");
+                break;
+            case ARG_SAIS: useSais = true; break;
+            case ARG_CHECKPOINT_DIR: checkpointDir = optarg; break;
+            case ARG_RESUME: resume = true; break;
+            case ARG_INCREMENTAL: incrementalBase = optarg; break;
+            case ARG_REPORT: reportFile = optarg; break;
 			case 'n':
 				// all f-s is used to mean "not set", so put 'e' on end
 				bmax = 0xfffffffe;
@@ -410,6 +462,30 @@ static void parseOptions(int argc, const char **argv) {
 		     << "extremely slow performance and memory exhaustion.  Perhaps you meant to specify" << endl
 		     << "a small --bmaxdivn?" << endl;
 	}
+	if(resume && checkpointDir.empty()) {
+		cerr << "--resume requires --checkpoint-dir" << endl;
+		throw 1;
+	}
+}
+
+/**
+ * Fingerprint the inputs and the options that shape the index, so that
+ * checkpoints saved by a build of something else are never reused.
+ */
+static uint64_t checkpointKey(const EList<string>& infiles) {
+	ostringstream os;
+	os << HISAT2_VERSION << " " << sizeof(TIndexOffU) << " " << format << " "
+	   << lineRate << " " << offRate << " " << ftabChars << " "
+	   << localOffRate << " " << localFtabChars << " "
+	   << bigEndian << " " << nsToAs << " " << seed << endl;
+	for(size_t i = 0; i < infiles.size(); i++) {
+		os << (format == CMDLINE ? infiles[i] : checkpointFileStamp(infiles[i])) << endl;
+	}
+	const string* aux[] = { &snp_fname, &ht_fname, &ss_fname, &exon_fname, &sv_fname };
+	for(size_t i = 0; i < sizeof(aux) / sizeof(aux[0]); i++) {
+		os << (aux[i]->empty() ? string() : checkpointFileStamp(*aux[i])) << endl;
+	}
+	return CheckpointSum::of(os.str());
 }
 
 EList<string> filesWritten;
@@ -423,7 +499,10 @@ static void deleteIdxFiles(
 	bool doRef,
 	bool justRef)
 {
-	
+	if(checkpoint != NULL) {
+		cerr << "Keeping files written so far; rerun with --resume to continue." << endl;
+		return;
+	}
 	for(size_t i = 0; i < filesWritten.size(); i++) {
 		cerr << "Deleting \"" << filesWritten[i].c_str()
 		     << "\" file written during aborted indexing attempt." << endl;
@@ -512,6 +591,7 @@ static void driver(
 	{
 		if(verbose) cerr << "Reading reference sizes" << endl;
 		Timer _t(cerr, "  Time reading reference sizes: ", verbose);
+		BuildPhase phase("read_reference");
 		if(!reverse && (writeRef || justRef)) {
 			filesWritten.push_back(outfile + ".3." + gfm_ext);
 			filesWritten.push_back(outfile + ".4." + gfm_ext);
@@ -531,6 +611,9 @@ static void driver(
     filesWritten.push_back(outfile + ".6." + gfm_ext);
     filesWritten.push_back(outfile + ".7." + gfm_ext);
     filesWritten.push_back(outfile + ".8." + gfm_ext);
+    if(!repeat) {
+        filesWritten.push_back(outfile + ".lfp." + gfm_ext);
+    }
 	TStr s;
     GFM<TIndexOffU>* gfm = NULL;
     if(!repeat) { // base index
@@ -568,7 +651,11 @@ static void driver(
                                    -1,           // override offRate
                                    verbose,      // be talkative
                                    autoMem,      // pass exceptions up to the toplevel so that we can adjust memory settings automatically
-                                   sanityCheck); // verify results and internal consistency
+                                   sanityCheck,  // verify results and internal consistency
+                                   pathGraphMem << 20, // memory cap for path graph construction
+                                   useSais,      // SA-IS instead of the blockwise SA builder
+                                   checkpoint,   // where to save/restore build phases
+                                   incrementalBase); // earlier index to copy unchanged local indexes from
     } else { // repeat index
         gfm = new RFM<TIndexOffU>(
                                   s,
@@ -604,7 +691,8 @@ static void driver(
                                   -1,           // override offRate
                                   verbose,      // be talkative
                                   autoMem,      // pass exceptions up to the toplevel so that we can adjust memory settings automatically
-                                  sanityCheck); // verify results and internal consistency
+                                  sanityCheck,  // verify results and internal consistency
+                                  pathGraphMem << 20); // memory cap for path graph construction
     }
     
     if(output_szs != NULL) {
@@ -657,6 +745,23 @@ static void driver(
 			}
 		}
 	}
+    if(deepFtabChars > 0 && !repeat) {
+        if(gfm->gh().linearFM()) {
+            filesWritten.push_back(outfile + ".dftab." + gfm_ext);
+            gfm->loadIntoMemory(
+                                0,     // no entire reverse
+                                false, // load SA sample?
+                                true,  // load ftab?
+                                false, // load rstarts?
+                                false, // load names?
+                                false);
+            BuildPhase phase("deep_ftab");
+            gfm->writeDeepFtab(deepFtabChars, verbose);
+            gfm->evictFromMemory();
+        } else {
+            cerr << "Warning: --deep-ftab is ignored for indexes with SNPs or splice sites" << endl;
+        }
+    }
     
     delete gfm;
 }
@@ -777,6 +882,52 @@ int hisat2_build(int argc, const char **argv) {
 				cerr << "  " << infiles[i].c_str() << endl;
 			}
 		}
+		if(!incrementalBase.empty()) {
+			// The earlier index is read while this one is written
+			struct stat st_old, st_new;
+			if(stat((incrementalBase + ".5." + gfm_ext).c_str(), &st_old) == 0 &&
+			   stat((outfile + ".5." + gfm_ext).c_str(), &st_new) == 0 &&
+			   st_old.st_dev == st_new.st_dev && st_old.st_ino == st_new.st_ino) {
+				cerr << "The --incremental index must be different from the one being built" << endl;
+				return 1;
+			}
+		}
+		if(!checkpointDir.empty()) {
+			string prefix = outfile.substr(outfile.find_last_of('/') + 1);
+			checkpoint = new Checkpoint(checkpointDir, prefix, resume, checkpointKey(infiles));
+		}
+		if(!reportFile.empty()) {
+			gBuildReport.open(reportFile, "hisat2-build", HISAT2_VERSION);
+			if(format != CMDLINE) {
+				for(size_t i = 0; i < infiles.size(); i++) {
+					gBuildReport.input("reference", infiles[i]);
+				}
+			}
+			gBuildReport.input("snp", snp_fname);
+			gBuildReport.input("haplotype", ht_fname);
+			gBuildReport.input("splice_sites", ss_fname);
+			gBuildReport.input("exons", exon_fname);
+			gBuildReport.input("sv", sv_fname);
+			if(repeat_ref_fname.length() > 0) {
+				EList<string> repeat_infiles(MISC_CAT);
+				tokenize(repeat_ref_fname, ",", repeat_infiles);
+				for(size_t i = 0; i < repeat_infiles.size(); i++) {
+					gBuildReport.input("repeat_reference", repeat_infiles[i]);
+				}
+				gBuildReport.input("repeat_info", repeat_info_fname);
+				gBuildReport.input("repeat_snp", repeat_snp_fname);
+				gBuildReport.input("repeat_haplotype", repeat_haplotype_fname);
+			}
+			gBuildReport.setting("threads", nthreads);
+			gBuildReport.setting("index_width", (int64_t)sizeof(TIndexOffU) * 8);
+			gBuildReport.setting("offrate", offRate);
+			gBuildReport.setting("ftabchars", ftabChars);
+			gBuildReport.setting("localoffrate", localOffRate);
+			gBuildReport.setting("localftabchars", localFtabChars);
+			gBuildReport.setting("sa_builder", useSais ? "sais" : (entireSA ? "entire" : "blockwise"));
+			gBuildReport.setting("pathgraph_mem_mb", (int64_t)pathGraphMem);
+			gBuildReport.setting("seed", seed);
+		}
 		// Seed random number generator
         srand(seed);
         {
@@ -785,26 +936,30 @@ int hisat2_build(int argc, const char **argv) {
                 EList<RefRecord> parent_szs(MISC_CAT);
                 EList<string> parent_refnames;
                 string dummy_fname = "";
-                driver<SString<char> >(infile,
-                                       infiles,
-                                       snp_fname,
-                                       ht_fname,
-                                       ss_fname,
-                                       exon_fname,
-                                       sv_fname,
-                                       dummy_fname,
-                                       outfile,
-                                       false,
-                                       REF_READ_FORWARD,
-                                       true, // create local indexes
-                                       NULL, // no parent szs
-                                       NULL, // no parent refnames
-                                       &parent_szs, // get parent szs
-                                       &parent_refnames); // get parent refnames
+                {
+                    BuildPhase phase("index");
+                    driver<SString<char> >(infile,
+                                           infiles,
+                                           snp_fname,
+                                           ht_fname,
+                                           ss_fname,
+                                           exon_fname,
+                                           sv_fname,
+                                           dummy_fname,
+                                           outfile,
+                                           false,
+                                           REF_READ_FORWARD,
+                                           true, // create local indexes
+                                           NULL, // no parent szs
+                                           NULL, // no parent refnames
+                                           &parent_szs, // get parent szs
+                                           &parent_refnames); // get parent refnames
+                }
                 
                 if(repeat_ref_fname.length() > 0) {
                     EList<string> repeat_infiles(MISC_CAT);
                     tokenize(repeat_ref_fname, ",", repeat_infiles);
+                    BuildPhase phase("repeat_index");
                     driver<SString<char> >(repeat_ref_fname,
                                            repeat_infiles,
                                            repeat_snp_fname,
@@ -829,6 +984,12 @@ int hisat2_build(int argc, const char **argv) {
                 }
             }
         }
+        if(checkpoint != NULL) {
+            // The index is complete; its checkpoints are no longer needed
+            checkpoint->clear();
+            delete checkpoint; checkpoint = NULL;
+        }
+        gBuildReport.close(true);
         return 0;
     } catch(std::exception& e) {
 		cerr << "Error: Encountered exception: '" << e.what() << "'" << endl;
@@ -836,6 +997,8 @@ int hisat2_build(int argc, const char **argv) {
 		for(int i = 0; i < argc; i++) cerr << argv[i] << " ";
 		cerr << endl;
 		deleteIdxFiles(outfile, writeRef || justRef, justRef);
+		delete checkpoint; checkpoint = NULL;
+		gBuildReport.close(false);
 		return 1;
 	} catch(int e) {
 		if(e != 0) {
@@ -845,6 +1008,8 @@ int hisat2_build(int argc, const char **argv) {
 			cerr << endl;
 		}
 		deleteIdxFiles(outfile, writeRef || justRef, justRef);
+		delete checkpoint; checkpoint = NULL;
+		gBuildReport.close(false);
 		return e;
 	}
 }
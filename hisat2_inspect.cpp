@@ -28,6 +28,7 @@
 #include "reference.h"
 #include "ds.h"
 #include "alt.h"
+#include "index_pack.h"
 
 using namespace std;
 
@@ -43,6 +44,10 @@ static int exon_only = 0;
 static int summarize_only = 0; // just print summary of index and quit
 static int across       = 60; // number of characters across in FASTA output
 static bool refFromGFM  = false; // true -> when printing reference, decode it from Gbwt instead of reading it from BitPairReference
+static int build_offs   = -1; // >= 0 -> write a companion SA sample with this offrate and quit
+static int build_dftab  = -1; // > 0 -> write a deep ftab consuming this many chars and quit
+static string pack_base;       // non-empty -> pack the index into <pack_base>.ht2 and quit
+static bool check_pack  = false; // verify the checksums of <ht2_base>.ht2 and quit
 static string wrapper;
 static const char *short_options = "vhnsea:";
 
@@ -54,6 +59,10 @@ enum {
     ARG_SPLICESITE,
     ARG_SPLICESITE_ALL,
     ARG_EXON,
+    ARG_BUILD_OFFS,
+    ARG_BUILD_DFTAB,
+    ARG_PACK,
+    ARG_CHECK_PACK,
 };
 
 static struct option long_options[] = {
@@ -65,6 +74,10 @@ static struct option long_options[] = {
     {(char*)"ss",       no_argument,        0, ARG_SPLICESITE},
     {(char*)"ss-all",   no_argument,        0, ARG_SPLICESITE_ALL},
     {(char*)"exon",     no_argument,        0, ARG_EXON},
+    {(char*)"build-offs", required_argument, 0, ARG_BUILD_OFFS},
+    {(char*)"build-deep-ftab", required_argument, 0, ARG_BUILD_DFTAB},
+    {(char*)"pack",     required_argument,  0, ARG_PACK},
+    {(char*)"check-pack", no_argument,      0, ARG_CHECK_PACK},
 	{(char*)"summary",  no_argument,        0, 's'},
 	{(char*)"help",     no_argument,        0, 'h'},
 	{(char*)"across",   required_argument,  0, 'a'},
@@ -98,6 +111,12 @@ static void printUsage(ostream& out) {
     << "  --ss               Print splice sites" << endl
     << "  --ss-all           Print splice sites including those not in the global index" << endl
     << "  --exon             Print exons" << endl
+    << "  --build-offs <int> Write a denser SA sample (offrate <int>) to <ht2_base>.offs." << gfm_ext << endl
+    << "                     for use with hisat2 -o/--offrate <int>" << endl
+    << "  --build-deep-ftab <int> Write a deep ftab (<int> chars) to <ht2_base>.dftab." << gfm_ext << endl
+    << "                     for use with hisat2 --deep-ftab" << endl
+    << "  --pack <base>      Pack all files of the index into the one file <base>." << gfm_ext << endl
+    << "  --check-pack       Verify the checksums of the index pack <ht2_base>." << gfm_ext << endl
 	<< "  -e/--ht2-ref       Reconstruct reference from ." << gfm_ext << " (slow, preserves colors)" << endl
 	<< "  -v/--verbose       Verbose output (for debugging)" << endl
 	<< "  -h/--help          print detailed description of tool and its options" << endl
@@ -160,6 +179,10 @@ static void parseOptions(int argc, char **argv) {
             case ARG_SPLICESITE: splicesite_only = true; break;
             case ARG_SPLICESITE_ALL: splicesite_all_only = true; break;
             case ARG_EXON: exon_only = true; break;
+            case ARG_BUILD_OFFS: build_offs = parseInt(0, "--build-offs arg must be at least 0"); break;
+            case ARG_BUILD_DFTAB: build_dftab = parseInt(1, "--build-deep-ftab arg must be at least 1"); break;
+            case ARG_PACK: pack_base = optarg; break;
+            case ARG_CHECK_PACK: check_pack = true; break;
 			case 's': summarize_only = true; break;
 			case 'a': across = parseInt(-1, "-a/--across arg must be at least 1"); break;
 			case -1: break; /* Done with options. */
@@ -571,6 +594,53 @@ static void print_exons(
     }
 }
 
+/**
+ * Load the index with its SA sample and write the requested companion
+ * files: a denser SA sample that hisat2 picks up when run with a smaller
+ * -o/--offrate, and/or a deep ftab for hisat2 --deep-ftab.
+ */
+template <typename index_t>
+static void write_companion_files(const string& fname)
+{
+    ALTDB<index_t> altdb;
+    GFM<index_t> gfm(
+                     fname,
+                     &altdb,
+                     NULL,
+                     NULL,
+                     -1,                   // don't require entire reverse
+                     true,                 // index is for the forward direction
+                     -1,                   // offrate (-1 = index default)
+                     0,                    // offrate-plus (0 = index default)
+                     false,                // use memory-mapped IO
+                     false,                // use shared memory
+                     false,                // sweep memory-mapped memory
+                     false,                // load names?
+                     true,                 // load SA sample?
+                     true,                 // load ftab?
+                     false,                // load rstarts?
+                     false,                // load splice sites?
+                     verbose,              // be talkative?
+                     verbose,              // be talkative at startup?
+                     false,                // pass up memory exceptions?
+                     false,                // sanity check?
+                     false);               // use haplotypes?
+    gfm.loadIntoMemory(
+                       -1,     // need entire reverse
+                       true,   // load SA sample
+                       true,   // load ftab
+                       false,  // load rstarts
+                       false,  // load names
+                       verbose);  // verbose
+    if(build_offs >= 0) {
+        gfm.writeOffsCompanion(build_offs, verbose);
+    }
+    if(build_dftab > 0) {
+        gfm.writeDeepFtab(build_dftab, verbose);
+    }
+    gfm.evictFromMemory();
+}
+
 /**
  * Print a short summary of what's in the index and its flags.
  */
@@ -656,7 +726,16 @@ static void driver(
 	// Adjust
 	string adjustedEbwtFileBase = adjustEbwtBase(argv0, ebwtFileBase, verbose);
 
-	if (names_only) {
+	if(!pack_base.empty()) {
+		writeIndexPack(adjustedEbwtFileBase, pack_base + "." + gfm_ext, verbose);
+	} else if(check_pack) {
+		if(!checkIndexPack(adjustedEbwtFileBase + "." + gfm_ext, verbose)) {
+			throw 1;
+		}
+		cout << adjustedEbwtFileBase << "." << gfm_ext << ": OK" << endl;
+	} else if(build_offs >= 0 || build_dftab > 0) {
+		write_companion_files<TIndexOffU>(adjustedEbwtFileBase);
+	} else if (names_only) {
 		print_index_sequence_names<TIndexOffU>(adjustedEbwtFileBase, cout);
 	} else if(summarize_only) {
 		print_index_summary<TIndexOffU>(adjustedEbwtFileBase, cout);
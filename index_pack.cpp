@@ -0,0 +1,260 @@
+/*
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of HISAT 2.
+ *
+ * HISAT 2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HISAT 2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HISAT 2.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef BOWTIE_MM
+#include <sys/mman.h>
+#endif
+#include <iostream>
+#include "btypes.h"
+#include "checkpoint.h"
+#include "index_pack.h"
+
+// Files of an index that go in its pack, by section name
+static const char* index_pack_names[] = {
+    "1", "2", "3", "4", "5", "6", "7", "8", "offs", "dftab",
+    "rep.1", "rep.2", "rep.3", "rep.4", "rep.5", "rep.6", "rep.7", "rep.8", "rep.offs", "rep.dftab",
+    NULL
+};
+
+static inline uint64_t indexPackAlign(uint64_t off, uint64_t len) {
+    const uint64_t align = (len >= INDEX_PACK_HUGEPAGE ? INDEX_PACK_HUGEPAGE : INDEX_PACK_PAGE);
+    return (off + align - 1) / align * align;
+}
+
+bool readIndexPack(const string& pack, EList<IndexPackSection>& sections) {
+    sections.clear();
+    FILE* f = fopen(pack.c_str(), "rb");
+    if(f == NULL) return false;
+    uint64_t magic = 0;
+    uint32_t version = 0, nsections = 0;
+    bool ok = fread(&magic, sizeof(magic), 1, f) == 1 && magic == INDEX_PACK_MAGIC &&
+              fread(&version, sizeof(version), 1, f) == 1 && version == INDEX_PACK_VERSION &&
+              fread(&nsections, sizeof(nsections), 1, f) == 1;
+    if(ok) {
+        sections.resizeExact(nsections);
+        uint64_t stored = 0;
+        ok = (nsections == 0 || fread(sections.ptr(), sizeof(IndexPackSection), nsections, f) == nsections) &&
+             fread(&stored, sizeof(stored), 1, f) == 1;
+        for(size_t i = 0; ok && i < sections.size(); i++) {
+            sections[i].name[sizeof(sections[i].name) - 1] = '\0';
+        }
+        if(ok) {
+            CheckpointSum sum;
+            sum.update(&version, sizeof(version));
+            sum.update(&nsections, sizeof(nsections));
+            if(nsections > 0) sum.update(sections.ptr(), nsections * sizeof(IndexPackSection));
+            ok = sum.value() == stored;
+        }
+    }
+    fclose(f);
+    if(!ok) sections.clear();
+    return ok;
+}
+
+bool locateIndexFile(const string& fname, IndexFileLoc& loc) {
+    struct stat st;
+    if(stat(fname.c_str(), &st) == 0) {
+        loc.path = fname;
+        loc.off = 0;
+        loc.len = (uint64_t)st.st_size;
+        loc.packed = false;
+        return true;
+    }
+    // <base>.<name>.<ext> may be section <name> of <base>.<ext>; try each
+    // way of splitting the middle, longest base first
+    size_t ext = fname.find_last_of('.');
+    if(ext == string::npos || ext == 0) return false;
+    const string suffix = fname.substr(ext);
+    size_t dot = ext;
+    while(dot > 0 && (dot = fname.find_last_of('.', dot - 1)) != string::npos) {
+        const string pack = fname.substr(0, dot) + suffix;
+        const string name = fname.substr(dot + 1, ext - dot - 1);
+        EList<IndexPackSection> sections;
+        if(stat(pack.c_str(), &st) == 0 && readIndexPack(pack, sections)) {
+            for(size_t i = 0; i < sections.size(); i++) {
+                if(name == sections[i].name) {
+                    loc.path = pack;
+                    loc.off = sections[i].off;
+                    loc.len = sections[i].len;
+                    loc.packed = true;
+                    return true;
+                }
+            }
+        }
+        if(dot == 0) break;
+    }
+    return false;
+}
+
+FILE* openIndexFile(const string& fname, IndexFileLoc& loc) {
+    if(!locateIndexFile(fname, loc)) return NULL;
+    FILE* f = fopen(loc.path.c_str(), "rb");
+    if(f != NULL && loc.off > 0 && fseeko(f, (off_t)loc.off, SEEK_SET) != 0) {
+        fclose(f);
+        f = NULL;
+    }
+    return f;
+}
+
+bool openIndexFile(const string& fname, ifstream& in, IndexFileLoc& loc) {
+    if(!locateIndexFile(fname, loc)) return false;
+    in.open(loc.path.c_str(), ios::binary);
+    if(in.good() && loc.off > 0) in.seekg((streamoff)loc.off);
+    return in.good();
+}
+
+#ifdef BOWTIE_MM
+char* mmapIndexFile(const IndexFileLoc& loc, int fd) {
+    // Sections are page-aligned for 4 KiB pages; allow for bigger ones
+    const uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+    const uint64_t start = loc.off / page * page;
+    char* p = (char*)mmap((void *)0, (size_t)(loc.len + loc.off - start),
+                          PROT_READ, MAP_SHARED, fd, (off_t)start);
+    if(p == (void *)(-1)) return p;
+    return p + (loc.off - start);
+}
+#endif
+
+static void indexPackError(const string& pack) {
+    cerr << "An error occurred writing index pack \"" << pack << "\".  Please check if the disk is full." << endl;
+    throw 1;
+}
+
+void writeIndexPack(const string& base, const string& pack, bool verbose) {
+    EList<IndexPackSection> sections;
+    EList<string> files;
+    for(size_t i = 0; index_pack_names[i] != NULL; i++) {
+        string fname = base + "." + index_pack_names[i] + "." + gfm_ext;
+        struct stat st;
+        if(stat(fname.c_str(), &st) != 0) continue;
+        sections.expand();
+        IndexPackSection& sec = sections.back();
+        memset(&sec, 0, sizeof(sec));
+        strncpy(sec.name, index_pack_names[i], sizeof(sec.name) - 1);
+        sec.len = (uint64_t)st.st_size;
+        files.push_back(fname);
+    }
+    if(sections.empty()) {
+        cerr << "Could not find any index files with basename \"" << base << "\"" << endl;
+        throw 1;
+    }
+    uint32_t version = INDEX_PACK_VERSION, nsections = (uint32_t)sections.size();
+    uint64_t off = sizeof(INDEX_PACK_MAGIC) + sizeof(version) + sizeof(nsections) +
+                   nsections * sizeof(IndexPackSection) + sizeof(uint64_t);
+    for(size_t i = 0; i < sections.size(); i++) {
+        off = sections[i].off = indexPackAlign(off, sections[i].len);
+        off += sections[i].len;
+    }
+
+    // Copy the files in, summing them on the way
+    const string tmp = pack + ".tmp";
+    FILE* out = fopen(tmp.c_str(), "wb");
+    if(out == NULL) {
+        cerr << "Could not open index pack for writing: \"" << tmp << "\"" << endl;
+        throw 1;
+    }
+    EList<char> buf; buf.resizeExact(1 << 20);
+    for(size_t i = 0; i < sections.size(); i++) {
+        IndexPackSection& sec = sections[i];
+        if(verbose) cerr << "Packing " << files[i] << " (" << sec.len << " bytes)" << endl;
+        FILE* in = fopen(files[i].c_str(), "rb");
+        if(in == NULL) {
+            fclose(out);
+            std::remove(tmp.c_str());
+            cerr << "Could not open index file " << files[i] << endl;
+            throw 1;
+        }
+        if(fseeko(out, (off_t)sec.off, SEEK_SET) != 0) indexPackError(pack);
+        CheckpointSum sum;
+        uint64_t left = sec.len;
+        while(left > 0) {
+            size_t n = (size_t)min<uint64_t>(left, buf.size());
+            if(fread(buf.ptr(), 1, n, in) != n) {
+                fclose(in); fclose(out);
+                std::remove(tmp.c_str());
+                cerr << "An error occurred reading index file " << files[i] << endl;
+                throw 1;
+            }
+            sum.update(buf.ptr(), n);
+            if(fwrite(buf.ptr(), 1, n, out) != n) indexPackError(pack);
+            left -= n;
+        }
+        fclose(in);
+        sec.sum = sum.value();
+    }
+    // Pad the last section out to a whole page
+    if(off % INDEX_PACK_PAGE != 0) {
+        if(fseeko(out, (off_t)(indexPackAlign(off, 0) - 1), SEEK_SET) != 0 || fputc(0, out) == EOF) {
+            indexPackError(pack);
+        }
+    }
+
+    CheckpointSum sum;
+    sum.update(&version, sizeof(version));
+    sum.update(&nsections, sizeof(nsections));
+    sum.update(sections.ptr(), nsections * sizeof(IndexPackSection));
+    uint64_t tableSum = sum.value();
+    if(fseeko(out, 0, SEEK_SET) != 0 ||
+       fwrite(&INDEX_PACK_MAGIC, sizeof(INDEX_PACK_MAGIC), 1, out) != 1 ||
+       fwrite(&version, sizeof(version), 1, out) != 1 ||
+       fwrite(&nsections, sizeof(nsections), 1, out) != 1 ||
+       fwrite(sections.ptr(), sizeof(IndexPackSection), nsections, out) != nsections ||
+       fwrite(&tableSum, sizeof(tableSum), 1, out) != 1) {
+        indexPackError(pack);
+    }
+    if(fclose(out) != 0) indexPackError(pack);
+    if(std::rename(tmp.c_str(), pack.c_str()) != 0) {
+        cerr << "Could not rename index pack \"" << tmp << "\" to \"" << pack << "\"" << endl;
+        throw 1;
+    }
+}
+
+bool checkIndexPack(const string& pack, bool verbose) {
+    EList<IndexPackSection> sections;
+    if(!readIndexPack(pack, sections)) {
+        cerr << "\"" << pack << "\" is not an index pack or its section table is damaged" << endl;
+        return false;
+    }
+    FILE* in = fopen(pack.c_str(), "rb");
+    if(in == NULL) return false;
+    bool ok = true;
+    EList<char> buf; buf.resizeExact(1 << 20);
+    for(size_t i = 0; i < sections.size(); i++) {
+        const IndexPackSection& sec = sections[i];
+        CheckpointSum sum;
+        bool read = fseeko(in, (off_t)sec.off, SEEK_SET) == 0;
+        for(uint64_t left = sec.len; read && left > 0;) {
+            size_t n = (size_t)min<uint64_t>(left, buf.size());
+            read = fread(buf.ptr(), 1, n, in) == n;
+            sum.update(buf.ptr(), n);
+            left -= n;
+        }
+        if(!read || sum.value() != sec.sum) {
+            cerr << "Section " << sec.name << " of \"" << pack << "\" is damaged" << endl;
+            ok = false;
+        } else if(verbose) {
+            cerr << "Section " << sec.name << ": " << sec.len << " bytes at " << sec.off << ", OK" << endl;
+        }
+    }
+    fclose(in);
+    return ok;
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of HISAT 2.
+ *
+ * HISAT 2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HISAT 2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HISAT 2.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INDEX_PACK_H_
+#define INDEX_PACK_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <fstream>
+#include "ds.h"
+
+using namespace std;
+
+/**
+ * An index pack holds all the files of an index, <base>.1.ht2 to
+ * <base>.8.ht2 along with the optional .offs/.dftab companions and the
+ * repeat index <base>.rep.*.ht2, in the one file <base>.ht2:
+ *
+ *   header | section table | table checksum | sections
+ *
+ * A section is the unchanged image of one file, named by what its file
+ * name has between <base>. and .ht2 ("1", "rep.5", "dftab", ...), and
+ * starts on a 4 KiB boundary, or on a 2 MiB one if it is at least that
+ * big, so that it can be memory-mapped by itself and the arrays in it
+ * are used in place with --mm.  Each section table entry has a checksum
+ * of its section; hisat2-inspect --check-pack verifies them.
+ *
+ * Index files are looked up with locateIndexFile(): a file that exists
+ * is used as is, otherwise its section is looked for in the pack of the
+ * base it belongs to.  Readers must treat the offset it gives as the
+ * start of the file, and its length as where the file ends.
+ */
+
+static const uint64_t INDEX_PACK_MAGIC    = 0x314b434150325448ull; // "HT2PACK1"
+static const uint32_t INDEX_PACK_VERSION  = 1;
+static const uint64_t INDEX_PACK_PAGE     = 4096;
+static const uint64_t INDEX_PACK_HUGEPAGE = 2 << 20;
+
+struct IndexPackSection {
+    char     name[32];
+    uint64_t off;
+    uint64_t len;
+    uint64_t sum;
+    uint64_t reserved;
+};
+
+/**
+ * Where the bytes of an index file are: 'len' bytes at 'off' in 'path',
+ * which is either the file itself (off == 0) or the pack holding it.
+ */
+struct IndexFileLoc {
+    IndexFileLoc() : off(0), len(0), packed(false) {}
+    string   path;
+    uint64_t off;
+    uint64_t len;
+    bool     packed;
+};
+
+/**
+ * Read the section table of the pack 'pack'; return false if it isn't
+ * a readable pack.
+ */
+extern bool readIndexPack(const string& pack, EList<IndexPackSection>& sections);
+
+/**
+ * Find index file 'fname', on its own or in a pack.
+ */
+extern bool locateIndexFile(const string& fname, IndexFileLoc& loc);
+
+static inline bool indexFileExists(const string& fname) {
+    IndexFileLoc loc;
+    return locateIndexFile(fname, loc);
+}
+
+/**
+ * Open index file 'fname' for reading, positioned at its first byte;
+ * NULL if it can't be found or opened.
+ */
+extern FILE* openIndexFile(const string& fname, IndexFileLoc& loc);
+extern bool openIndexFile(const string& fname, ifstream& in, IndexFileLoc& loc);
+
+#ifdef BOWTIE_MM
+/**
+ * Map the bytes of an index file read-only and shared, given a
+ * descriptor open on loc.path; returns (void*)-1 on failure.
+ */
+extern char* mmapIndexFile(const IndexFileLoc& loc, int fd);
+#endif
+
+/**
+ * Write the files of index 'base' that exist to the pack 'pack'.
+ */
+extern void writeIndexPack(const string& base, const string& pack, bool verbose);
+
+/**
+ * Verify the checksums of all sections of 'pack'; returns false and
+ * names the bad ones on stderr if there are any.
+ */
+extern bool checkIndexPack(const string& pack, bool verbose);
+
+#endif /*INDEX_PACK_H_*/
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of HISAT 2.
+ *
+ * HISAT 2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HISAT 2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HISAT 2.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MATCH_RUN_H_
+#define MATCH_RUN_H_
+
+#include <stddef.h>
+#include <emmintrin.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/**
+ * Helpers for the ungapped read-vs-reference walks in GenomeHit.  Both
+ * sequences are arrays of 2-bit nucleotide codes with 4 for N.  Each
+ * returns the length of the run of positions, starting at the given
+ * ones, where the reference and read characters agree and the read
+ * character is not an N; i.e. the number of positions the caller can
+ * skip before it has to look at an edit.  At most 'n' positions are
+ * examined and no byte outside of them is read.
+ */
+
+/**
+ * Scan rf[0], rf[1], ... against rd[0], rd[1], ...
+ */
+static inline size_t matchRunFw(const char* rf, const char* rd, size_t n) {
+	size_t i = 0;
+#ifdef __AVX2__
+	const __m256i vn32 = _mm256_set1_epi8(4);
+	for(; i + 32 <= n; i += 32) {
+		__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rf + i));
+		__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rd + i));
+		__m256i eq = _mm256_andnot_si256(_mm256_cmpeq_epi8(b, vn32), _mm256_cmpeq_epi8(a, b));
+		unsigned int m = ~(unsigned int)_mm256_movemask_epi8(eq);
+		if(m != 0) return i + __builtin_ctz(m);
+	}
+#endif
+	const __m128i vn = _mm_set1_epi8(4);
+	for(; i + 16 <= n; i += 16) {
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rf + i));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rd + i));
+		__m128i eq = _mm_andnot_si128(_mm_cmpeq_epi8(b, vn), _mm_cmpeq_epi8(a, b));
+		unsigned int m = ~(unsigned int)_mm_movemask_epi8(eq) & 0xffff;
+		if(m != 0) return i + __builtin_ctz(m);
+	}
+	for(; i < n; i++) {
+		if(rf[i] != rd[i] || rd[i] == 4) break;
+	}
+	return i;
+}
+
+/**
+ * Scan rf[0], rf[-1], ... against rd[0], rd[-1], ...
+ */
+static inline size_t matchRunBw(const char* rf, const char* rd, size_t n) {
+	size_t i = 0;
+#ifdef __AVX2__
+	const __m256i vn32 = _mm256_set1_epi8(4);
+	for(; i + 32 <= n; i += 32) {
+		__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rf - i - 31));
+		__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rd - i - 31));
+		__m256i eq = _mm256_andnot_si256(_mm256_cmpeq_epi8(b, vn32), _mm256_cmpeq_epi8(a, b));
+		unsigned int m = ~(unsigned int)_mm256_movemask_epi8(eq);
+		// bit 31 is position -i
+		if(m != 0) return i + __builtin_clz(m);
+	}
+#endif
+	const __m128i vn = _mm_set1_epi8(4);
+	for(; i + 16 <= n; i += 16) {
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rf - i - 15));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rd - i - 15));
+		__m128i eq = _mm_andnot_si128(_mm_cmpeq_epi8(b, vn), _mm_cmpeq_epi8(a, b));
+		unsigned int m = ~(unsigned int)_mm_movemask_epi8(eq) & 0xffff;
+		// bit 15 is position -i
+		if(m != 0) return i + __builtin_clz(m) - 16;
+	}
+	for(; i < n; i++) {
+		if(rf[-(ptrdiff_t)i] != rd[-(ptrdiff_t)i] || rd[-(ptrdiff_t)i] == 4) break;
+	}
+	return i;
+}
+
+#endif /*MATCH_RUN_H_*/
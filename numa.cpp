@@ -0,0 +1,145 @@
+/*
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of HISAT 2.
+ *
+ * HISAT 2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HISAT 2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HISAT 2.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#ifdef __linux__
+#include <dirent.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+#include "numa.h"
+
+using namespace std;
+
+#ifdef __linux__
+
+// From <numaif.h>, which comes with libnuma rather than the C library
+static const int NUMA_MPOL_DEFAULT    = 0;
+static const int NUMA_MPOL_INTERLEAVE = 3;
+static const int NUMA_MAX_NODES       = 1024;
+
+/**
+ * Parse a kernel CPU list such as "0-3,8-11".
+ */
+static void parseCpuList(const string& list, EList<int>& cpus) {
+    const char* p = list.c_str();
+    while(*p != '\0') {
+        char* end;
+        long lo = strtol(p, &end, 10);
+        if(end == p) break;
+        long hi = lo;
+        p = end;
+        if(*p == '-') {
+            hi = strtol(p + 1, &end, 10);
+            p = end;
+        }
+        for(long c = lo; c <= hi; c++) cpus.push_back((int)c);
+        if(*p == ',') p++;
+        else break;
+    }
+}
+
+bool numaNodes(EList<NumaNode>& nodes) {
+    nodes.clear();
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return false;
+    DIR* dir = opendir("/sys/devices/system/node");
+    if(dir == NULL) return false;
+    EList<int> ids;
+    struct dirent* ent;
+    while((ent = readdir(dir)) != NULL) {
+        int id;
+        char tail;
+        if(sscanf(ent->d_name, "node%d%c", &id, &tail) == 1 && id < NUMA_MAX_NODES) {
+            ids.push_back(id);
+        }
+    }
+    closedir(dir);
+    ids.sort();
+    for(size_t i = 0; i < ids.size(); i++) {
+        ostringstream fname;
+        fname << "/sys/devices/system/node/node" << ids[i] << "/cpulist";
+        ifstream in(fname.str().c_str());
+        string list;
+        getline(in, list);
+        EList<int> cpus;
+        parseCpuList(list, cpus);
+        nodes.expand();
+        nodes.back().id = ids[i];
+        nodes.back().cpus.clear();
+        for(size_t c = 0; c < cpus.size(); c++) {
+            if(cpus[c] < CPU_SETSIZE && CPU_ISSET(cpus[c], &allowed)) {
+                nodes.back().cpus.push_back(cpus[c]);
+            }
+        }
+        // Memory-only nodes, and nodes we may not run on, get no threads
+        if(nodes.back().cpus.empty()) nodes.pop_back();
+    }
+    return !nodes.empty();
+}
+
+bool numaInterleave(const EList<NumaNode>& nodes) {
+    const size_t bits = sizeof(unsigned long) * 8;
+    unsigned long mask[NUMA_MAX_NODES / (sizeof(unsigned long) * 8)];
+    memset(mask, 0, sizeof(mask));
+    for(size_t i = 0; i < nodes.size(); i++) {
+        mask[nodes[i].id / bits] |= 1ul << (nodes[i].id % bits);
+    }
+    // The kernel reads one bit fewer than it is told to
+    return syscall(SYS_set_mempolicy, NUMA_MPOL_INTERLEAVE, mask, (unsigned long)NUMA_MAX_NODES + 1) == 0;
+}
+
+void numaLocal() {
+    syscall(SYS_set_mempolicy, NUMA_MPOL_DEFAULT, NULL, 0ul);
+}
+
+bool numaBindThread(const NumaNode& node) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(size_t i = 0; i < node.cpus.size(); i++) {
+        CPU_SET(node.cpus[i], &set);
+    }
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+#else
+
+bool numaNodes(EList<NumaNode>& nodes) {
+    nodes.clear();
+    return false;
+}
+
+bool numaInterleave(const EList<NumaNode>& nodes) {
+    return false;
+}
+
+void numaLocal() { }
+
+bool numaBindThread(const NumaNode& node) {
+    return false;
+}
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of HISAT 2.
+ *
+ * HISAT 2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HISAT 2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HISAT 2.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NUMA_H_
+#define NUMA_H_
+
+#include "ds.h"
+
+/**
+ * NUMA placement for the aligner (hisat2 --numa).  Left to itself the
+ * kernel puts each page of the index on the memory node of the thread
+ * that first touches it, i.e. of the loading thread, so alignment
+ * threads on every other node do their LF steps through remote memory.
+ *
+ * numaInterleave() makes the calling thread, and threads it starts from
+ * then on, spread the pages they allocate round-robin over the nodes;
+ * numaLocal() goes back to local allocation.  numaBindThread() pins the
+ * calling thread to the CPUs of one node.
+ *
+ * Only Linux has these; elsewhere numaNodes() fails and the others do
+ * nothing.
+ */
+struct NumaNode {
+    int        id;   // node number, as in /sys/devices/system/node/node<id>
+    EList<int> cpus; // CPUs of the node this process may run on
+};
+
+/**
+ * Find the memory nodes that have CPUs this process may run on, in
+ * order of node number; false if the topology can't be read.
+ */
+extern bool numaNodes(EList<NumaNode>& nodes);
+
+extern bool numaInterleave(const EList<NumaNode>& nodes);
+extern void numaLocal();
+extern bool numaBindThread(const NumaNode& node);
+
+#endif /*NUMA_H_*/
@@ -188,6 +188,18 @@ enum {
     ARG_REPEAT,
     ARG_NO_REPEAT_INDEX,
     ARG_READ_LENGTHS,
+    ARG_DEEP_FTAB,
+    ARG_PACKED_OFFS,
+    ARG_LAZY_LOCAL_INDEX,
+    ARG_LOCAL_INDEX_MEM,
+    ARG_SERVER,
+    ARG_CONNECT,
+    ARG_DUP_CACHE,
+    ARG_PLAN_SKIP,
+    ARG_READ_BUDGET,
+    ARG_SLOW_READS,
+    ARG_REPEAT_CACHE,
+    ARG_NUMA,
     BASE_CHANGE    // --base-change
 };
 
@@ -528,6 +528,12 @@ public:
         isPlanA = false;
 	}
 
+	void planA(){
+	    buf1_.planA();
+        buf2_.planA();
+        isPlanA = true;
+	}
+
 	/**
 	 * Read the next read pair.
 	 */
@@ -2,8 +2,9 @@
 #define PROCESSOR_SUPPORT_H_
 
 // Utility class ProcessorSupport provides POPCNTenabled() to determine
-// processor support for POPCNT instruction. It uses CPUID to
-// retrieve the processor capabilities.
+// processor support for POPCNT instruction, and AVX2enabled() to determine
+// whether the 256-bit dynamic programming kernels can be used. It uses CPUID
+// to retrieve the processor capabilities.
 // for Intel ICC compiler __cpuid() is an intrinsic 
 // for Microsoft compiler __cpuid() is provided by #include <intrin.h>
 // for GCC compiler __get_cpuid() is provided by #include <cpuid.h>
@@ -64,6 +65,47 @@ public:
     }
 
 #endif // POPCNT_CAPABILITY
+
+#ifdef AVX2_CAPABILITY
+
+public:
+    bool AVX2enabled()
+    {
+    // AVX2 is usable when CPUID.07H:EBX.AVX2[bit 5] = 1 and the OS saves the
+    // YMM registers on a context switch, i.e. CPUID.01H:ECX.OSXSAVE[bit 27]
+    // = 1 and XCR0 has both the SSE (bit 1) and AVX (bit 2) state bits set.
+    // See section 14.7.1 of the manual cited above.
+
+    regs_t regs;
+
+    try {
+#if defined(USING_MSC_COMPILER)
+        __cpuid((int *) &regs, 0x1);
+        if( !( (regs.ECX & BIT(27)) && (regs.ECX & BIT(28)) ) ) return false;
+        if( (_xgetbv(0) & 0x6) != 0x6 ) return false;
+        __cpuidex((int *) &regs, 0x7, 0);
+#elif defined(USING_INTEL_COMPILER)
+        return _may_i_use_cpu_feature(_FEATURE_AVX2) != 0;
+#elif defined(USING_GCC_COMPILER)
+        if(!__get_cpuid(0x1, &regs.EAX, &regs.EBX, &regs.ECX, &regs.EDX)) return false;
+        if( !( (regs.ECX & BIT(27)) && (regs.ECX & BIT(28)) ) ) return false;
+        unsigned int xcr0_lo, xcr0_hi;
+        __asm__ __volatile__ ("xgetbv" : "=a" (xcr0_lo), "=d" (xcr0_hi) : "c" (0));
+        if( (xcr0_lo & 0x6) != 0x6 ) return false;
+        if(__get_cpuid_max(0, NULL) < 0x7) return false;
+        __cpuid_count(0x7, 0, regs.EAX, regs.EBX, regs.ECX, regs.EDX);
+#else
+        return false;
+#endif
+        if( !(regs.EBX & BIT(5)) ) return false;
+    }
+    catch (int e) {
+        return false;
+    }
+    return true;
+    }
+
+#endif // AVX2_CAPABILITY
 };
 
 #endif /*PROCESSOR_SUPPORT_H_*/
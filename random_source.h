@@ -37,20 +37,22 @@ public:
 	static const uint32_t DEFUALT_C = 1013904223;
 
 	RandomSource() :
-		a(DEFUALT_A), c(DEFUALT_C), inited_(false) { }
+		a(DEFUALT_A), c(DEFUALT_C), inited_(false), draws_(0) { }
 	RandomSource(uint32_t _last) :
-		a(DEFUALT_A), c(DEFUALT_C), last(_last), inited_(true) { }
+		a(DEFUALT_A), c(DEFUALT_C), last(_last), inited_(true), draws_(0) { }
 	RandomSource(uint32_t _a, uint32_t _c) :
-		a(_a), c(_c), inited_(false) { }
+		a(_a), c(_c), inited_(false), draws_(0) { }
 
 	void init(uint32_t seed = 0) {
 		last = seed;
 		inited_ = true;
 		lastOff = 30;
+		draws_ = 0;
 	}
 
 	uint32_t nextU32() {
 		assert(inited_);
+		draws_++;
 		uint32_t ret;
 		last = a * last + c;
 		ret = last >> 16;
@@ -85,6 +87,7 @@ public:
 	 */
 	uint32_t nextU2() {
 		assert(inited_);
+		draws_++;
 		if(lastOff > 30) {
 			nextU32();
 		}
@@ -98,6 +101,7 @@ public:
 	 */
 	bool nextBool() {
 		assert(inited_);
+		draws_++;
 		if(lastOff > 31) {
 			nextU32();
 		}
@@ -141,12 +145,16 @@ public:
 	uint32_t currentC() const { return c; }
 	uint32_t currentLast() const { return last; }
 
+	/// Number of values drawn since init(); tells whether anything drew
+	uint64_t draws() const { return draws_; }
+
 private:
 	uint32_t a;
 	uint32_t c;
 	uint32_t last;
 	uint32_t lastOff;
 	bool inited_;
+	uint64_t draws_;
 };
 
 #else
@@ -174,6 +182,7 @@ public:
 		state_[0] = 0;
 		p_ = 0;
 		inited_ = false;
+		draws_ = 0;
 	}
 	
 	virtual ~RandomSource() { }
@@ -194,6 +203,7 @@ public:
 	 */
 	inline uint32_t nextU32() {
 		assert(inited_);
+		draws_++;
 		if(p_ == n) {
 			gen_state(); // new state vector needed
 		}
@@ -214,6 +224,9 @@ public:
 		assert(inited_);
 		return (float)nextU32() / (float)0xffffffff;
 	}
+
+	/// Number of values drawn since init(); tells whether anything drew
+	uint64_t draws() const { return draws_; }
 	
 protected: // used by derived classes, otherwise not accessible; use the ()-operator
 
@@ -224,6 +237,7 @@ protected: // used by derived classes, otherwise not accessible; use the ()-oper
 	int p_; // position in state array
 	
 	bool inited_; // true if init function has been called
+	uint64_t draws_; // values drawn since init
 	
 	// private functions used to generate the pseudo random numbers
 	uint32_t twiddle(uint32_t u, uint32_t v) {
@@ -99,7 +99,7 @@ struct Read {
 
         if(name.length()>0){
             ns_ = 0;
-            swap(patFw, patFw1);
+            patFw.swap(patFw1);
             //patFw = patFw1;
             name.insert('*', 0);
             plan = 'B';
@@ -108,6 +108,19 @@ struct Read {
 
     }
 
+    // undo planB(); go back to patFw for alignment
+    void planA(){
+
+        if(plan == 'B'){
+            ns_ = 0;
+            patFw.swap(patFw1);
+            name.remove(0);
+            plan = 'A';
+            finalize();
+        }
+
+    }
+
     bool isPlanA(){
 	    if (plan == 'A')
 	        return true;
@@ -472,6 +485,8 @@ struct PerReadMetrics {
 		nUgFail = nUgFailStreak = nUgLastSucc =
 		nEeFail = nEeFailStreak = nEeLastSucc =
 		nFilt = 0;
+		nWork = 0;
+		workExceeded = false;
 		nFtabs = 0;
 		nRedSkip = 0;
 		nRedFail = 0;
@@ -548,6 +563,9 @@ struct PerReadMetrics {
 	
 	uint64_t nFilt;         // # mates filtered
 	
+	uint64_t nWork;         // work units spent aligning (see --read-budget)
+	bool     workExceeded;  // search stopped early, out of work budget
+	
 	TAlScore bestLtMinscMate1; // best invalid score observed for mate 1
 	TAlScore bestLtMinscMate2; // best invalid score observed for mate 2
 	
@@ -0,0 +1,363 @@
+/*
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of HISAT 2.
+ *
+ * HISAT 2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HISAT 2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HISAT 2.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef READ_CACHE_H_
+#define READ_CACHE_H_
+
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include "ds.h"
+#include "read.h"
+#include "threading.h"
+#include "aligner_result.h"
+#include "aln_sink.h"
+
+/**
+ * Cache of the alignments found for reads (or pairs), shared by all
+ * threads and used to skip the search for exact duplicates.
+ *
+ * A read is looked up by everything the search depends on: the plan and
+ * the (converted) sequence of each mate, the qualities if the scoring
+ * scheme uses them, the trimming and the filter outcome.  What is
+ * cached is the outcome of the search as seen by AlnSinkWrap: the
+ * alignments it was handed and the order in which they came.  On a hit
+ * those are handed to the duplicate's AlnSinkWrap again, so the
+ * reporting state, the choice of what to print, MAPQ and the records
+ * themselves are all worked out anew for the duplicate with its own
+ * name, qualities and read id.
+ *
+ * The search also depends on the splice sites earlier reads added to the
+ * SpliceSiteDB.  An entry records how many changes the database had seen
+ * when the search started and is only used while that is still the
+ * number, i.e. while the duplicate would see the very same splice sites.
+ *
+ * The per-read random source is seeded from the name and qualities, so
+ * the caller only inserts reads whose search drew nothing from it: the
+ * search then went as it would for any duplicate and left the source as
+ * the duplicate's sink will find it.
+ *
+ * The cache is split into shards, each with its own lock, map and LRU
+ * list, so threads rarely contend.  Each shard holds at most its share
+ * of the byte budget and evicts least recently used entries to stay
+ * below it.
+ */
+class ReadResultCache {
+
+	enum {
+		NUM_SHARDS = 64, // power of 2
+		NUM_LISTS = 4    // paired mate 1, paired mate 2, unpaired mate 1, unpaired mate 2
+	};
+
+	struct Entry {
+		uint64_t      hash;
+		uint64_t      ssChanges; // SpliceSiteDB::numChanges() the search saw
+		char          plan;
+		bool          paired;
+		bool          quals;
+		bool          filt[2];
+		int           trim5[2];
+		int           trim3[2];
+		BTDnaString   seq[2];
+		BTString      qual[2];
+		EList<AlnRes> rs[NUM_LISTS];
+		EList<int>    order;  // AlnSinkWrap::reportOrder()
+		size_t        bytes;  // memory charged to the entry
+		Entry*        prev;   // more recently used neighbour
+		Entry*        next;   // less recently used neighbour
+	};
+
+	struct Shard {
+		Shard() : head(NULL), tail(NULL), bytes(0),
+		          lookups(0), hits(0), inserts(0), evictions(0) { }
+
+		~Shard() {
+			// entries give their edit lists back to 'edits'
+			while(head != NULL) {
+				Entry* e = head;
+				head = head->next;
+				delete e;
+			}
+		}
+
+		MUTEX_T                      lock;
+		std::map<uint64_t, Entry*>   index;
+		Entry*                       head;  // most recently used
+		Entry*                       tail;  // least recently used
+		size_t                       bytes;
+		LinkedEList<EList<Edit> >    edits; // storage for cached edit lists
+		uint64_t                     lookups;
+		uint64_t                     hits;
+		uint64_t                     inserts;
+		uint64_t                     evictions;
+	};
+
+public:
+
+	/**
+	 * Replay buffers, one set per thread.  The alignments copied out of
+	 * the cache live here while they are reported to the sink.
+	 */
+	struct Scratch {
+		EList<AlnRes> rs[NUM_LISTS];
+		EList<int>    order;
+	};
+
+	ReadResultCache(uint64_t bytes) : shardBytes_((size_t)(bytes / NUM_SHARDS)) { }
+
+	/**
+	 * If the read or pair is cached, report its alignments to 'sink',
+	 * which must have been given the read with nextRead() and nothing
+	 * else, and return true.  'raw_edits' is the edit-list pool of the
+	 * calling thread's aligner, the one the sink's alignments come from.
+	 */
+	template <typename index_t>
+	bool replay(
+		const Read*                rd1,
+		const Read*                rd2,
+		bool                       filt1,
+		bool                       filt2,
+		bool                       quals,
+		uint64_t                   ssChanges,
+		TReadId                    rdid,
+		AlnSinkWrap<index_t>&      sink,
+		LinkedEList<EList<Edit> >& raw_edits,
+		Scratch&                   scratch)
+	{
+		assert(sink.empty());
+		const uint64_t h = hashRead(rd1, rd2, filt1, filt2, quals);
+		Shard& sh = shards_[h & (NUM_SHARDS - 1)];
+		{
+			ThreadSafe ts(&sh.lock);
+			sh.lookups++;
+			std::map<uint64_t, Entry*>::iterator it = sh.index.find(h);
+			if(it == sh.index.end()) return false;
+			Entry* e = it->second;
+			if(!matches(*e, rd1, rd2, filt1, filt2, quals)) return false;
+			if(e->ssChanges != ssChanges) return false;
+			sh.hits++;
+			unlink(sh, e);
+			pushFront(sh, e);
+			for(size_t k = 0; k < NUM_LISTS; k++) {
+				scratch.rs[k].resize(e->rs[k].size());
+				for(size_t i = 0; i < e->rs[k].size(); i++) {
+					scratch.rs[k][i].copyFrom(e->rs[k][i], &raw_edits);
+					scratch.rs[k][i].setReadID(rdid);
+				}
+			}
+			scratch.order = e->order;
+		}
+		size_t ip = 0, iu1 = 0, iu2 = 0;
+		for(size_t i = 0; i < scratch.order.size(); i++) {
+			switch(scratch.order[i]) {
+				case AlnSinkWrap<index_t>::REPORTED_PAIR:
+					sink.report(0, &scratch.rs[0][ip], &scratch.rs[1][ip]);
+					ip++;
+					break;
+				case AlnSinkWrap<index_t>::REPORTED_UNP1:
+					sink.report(0, &scratch.rs[2][iu1++], NULL);
+					break;
+				default:
+					sink.report(0, NULL, &scratch.rs[3][iu2++]);
+					break;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * Remember what the search reported to 'sink' for the read or pair.
+	 * Must be called before AlnSinkWrap::finishRead(), which rearranges
+	 * the alignments.  'ssChanges' is SpliceSiteDB::numChanges() from
+	 * before the search.
+	 */
+	template <typename index_t>
+	void insert(
+		const Read*                 rd1,
+		const Read*                 rd2,
+		bool                        filt1,
+		bool                        filt2,
+		bool                        quals,
+		uint64_t                    ssChanges,
+		const AlnSinkWrap<index_t>& sink)
+	{
+		const EList<AlnRes>* lists[NUM_LISTS];
+		sink.getPair(lists[0], lists[1]);
+		sink.getUnp1(lists[2]);
+		sink.getUnp2(lists[3]);
+		size_t bytes = sizeof(Entry) + sizeof(int) * sink.reportOrder().size();
+		const Read* rds[2] = { rd1, rd2 };
+		for(size_t m = 0; m < 2; m++) {
+			if(rds[m] == NULL) continue;
+			bytes += rds[m]->patFw.length();
+			if(quals) bytes += rds[m]->qual.length();
+		}
+		for(size_t k = 0; k < NUM_LISTS; k++) {
+			for(size_t i = 0; i < lists[k]->size(); i++) {
+				const AlnRes& res = (*lists[k])[i];
+				bytes += sizeof(AlnRes) + 2 * sizeof(EList<Edit>) +
+				         (res.ned().size() + res.aed().size()) * sizeof(Edit);
+			}
+		}
+		if(bytes > shardBytes_) return;
+		const uint64_t h = hashRead(rd1, rd2, filt1, filt2, quals);
+		Shard& sh = shards_[h & (NUM_SHARDS - 1)];
+		ThreadSafe ts(&sh.lock);
+		std::map<uint64_t, Entry*>::iterator it = sh.index.find(h);
+		if(it != sh.index.end()) {
+			// Another thread got here first, or the hash collides with
+			// a different read; either way keep the newer one
+			remove(sh, it->second);
+		}
+		while(sh.tail != NULL && sh.bytes + bytes > shardBytes_) {
+			remove(sh, sh.tail);
+			sh.evictions++;
+		}
+		Entry* e = new Entry();
+		e->hash = h;
+		e->ssChanges = ssChanges;
+		e->plan = rd1 != NULL ? rd1->plan : rd2->plan;
+		e->paired = rd1 != NULL && rd2 != NULL;
+		e->quals = quals;
+		e->filt[0] = filt1;
+		e->filt[1] = filt2;
+		for(size_t m = 0; m < 2; m++) {
+			e->trim5[m] = e->trim3[m] = 0;
+			if(rds[m] == NULL) continue;
+			e->trim5[m] = rds[m]->trimmed5;
+			e->trim3[m] = rds[m]->trimmed3;
+			e->seq[m] = rds[m]->patFw;
+			if(quals) e->qual[m] = rds[m]->qual;
+		}
+		for(size_t k = 0; k < NUM_LISTS; k++) {
+			e->rs[k].resize(lists[k]->size());
+			for(size_t i = 0; i < lists[k]->size(); i++) {
+				e->rs[k][i].copyFrom((*lists[k])[i], &sh.edits);
+			}
+		}
+		e->order = sink.reportOrder();
+		e->bytes = bytes;
+		sh.index[h] = e;
+		pushFront(sh, e);
+		sh.bytes += bytes;
+		sh.inserts++;
+	}
+
+	/**
+	 * Print how often the cache was consulted and how often it could
+	 * stand in for the search.  Each plan of a read is looked up
+	 * separately.
+	 */
+	void printSumm(std::ostream& out) const {
+		uint64_t lookups = 0, hits = 0, inserts = 0, evictions = 0;
+		for(size_t i = 0; i < NUM_SHARDS; i++) {
+			lookups += shards_[i].lookups;
+			hits += shards_[i].hits;
+			inserts += shards_[i].inserts;
+			evictions += shards_[i].evictions;
+		}
+		out << "Duplicate-read cache: " << lookups << " lookups, " << hits << " hits (";
+		if(lookups > 0) {
+			out << std::fixed << std::setprecision(2) << (100.0 * hits / lookups) << "%";
+		} else {
+			out << "0.00%";
+		}
+		out << "), " << inserts << " inserts, " << evictions << " evictions" << std::endl;
+	}
+
+private:
+
+	static uint64_t hashRead(
+		const Read* rd1,
+		const Read* rd2,
+		bool        filt1,
+		bool        filt2,
+		bool        quals)
+	{
+		uint64_t h = 0xcbf29ce484222325ULL; // FNV-1a
+		const Read* rds[2] = { rd1, rd2 };
+		for(size_t m = 0; m < 2; m++) {
+			h = (h ^ (uint64_t)(rds[m] == NULL ? 0xff : (m == 0 ? filt1 : filt2))) * 0x100000001b3ULL;
+			if(rds[m] == NULL) continue;
+			const Read& rd = *rds[m];
+			h = (h ^ (uint64_t)rd.plan) * 0x100000001b3ULL;
+			h = (h ^ (uint64_t)rd.patFw.length()) * 0x100000001b3ULL;
+			for(size_t i = 0; i < rd.patFw.length(); i++) {
+				h = (h ^ (uint64_t)rd.patFw[i]) * 0x100000001b3ULL;
+			}
+			if(quals) {
+				for(size_t i = 0; i < rd.qual.length(); i++) {
+					h = (h ^ (uint64_t)rd.qual[i]) * 0x100000001b3ULL;
+				}
+			}
+		}
+		return h;
+	}
+
+	static bool matches(
+		const Entry& e,
+		const Read*  rd1,
+		const Read*  rd2,
+		bool         filt1,
+		bool         filt2,
+		bool         quals)
+	{
+		if(e.paired != (rd1 != NULL && rd2 != NULL) || e.quals != quals) return false;
+		if(e.plan != (rd1 != NULL ? rd1->plan : rd2->plan)) return false;
+		if(e.filt[0] != filt1 || e.filt[1] != filt2) return false;
+		const Read* rds[2] = { rd1, rd2 };
+		for(size_t m = 0; m < 2; m++) {
+			if(rds[m] == NULL) {
+				if(!e.seq[m].empty()) return false;
+				continue;
+			}
+			if(e.trim5[m] != rds[m]->trimmed5 || e.trim3[m] != rds[m]->trimmed3) return false;
+			if(!sstr_eq(e.seq[m], rds[m]->patFw)) return false;
+			if(quals && !sstr_eq(e.qual[m], rds[m]->qual)) return false;
+		}
+		return true;
+	}
+
+	static void unlink(Shard& sh, Entry* e) {
+		if(e->prev != NULL) e->prev->next = e->next; else sh.head = e->next;
+		if(e->next != NULL) e->next->prev = e->prev; else sh.tail = e->prev;
+		e->prev = e->next = NULL;
+	}
+
+	static void pushFront(Shard& sh, Entry* e) {
+		e->prev = NULL;
+		e->next = sh.head;
+		if(sh.head != NULL) sh.head->prev = e;
+		sh.head = e;
+		if(sh.tail == NULL) sh.tail = e;
+	}
+
+	static void remove(Shard& sh, Entry* e) {
+		unlink(sh, e);
+		sh.index.erase(e->hash);
+		assert_geq(sh.bytes, e->bytes);
+		sh.bytes -= e->bytes;
+		delete e;
+	}
+
+	size_t shardBytes_;
+	Shard  shards_[NUM_SHARDS];
+};
+
+#endif /*READ_CACHE_H_*/
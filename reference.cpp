@@ -21,6 +21,7 @@
 #include <string.h>
 #include "reference.h"
 #include "mem_ids.h"
+#include "index_pack.h"
 
 using namespace std;
 
@@ -52,7 +53,8 @@ BitPairReference::BitPairReference(
 	string s4 = in + ".4." + gfm_ext;
 	
 	FILE *f3, *f4;
-	if((f3 = fopen(s3.c_str(), "rb")) == NULL) {
+	IndexFileLoc loc3, loc4;
+	if((f3 = openIndexFile(s3, loc3)) == NULL) {
 	    cerr << "Could not open reference-string index file " << s3 << " for reading." << endl;
 		cerr << "This is most likely because your index was built with an older version" << endl
 		<< "(<= 0.9.8.1) of bowtie-build.  Please re-run bowtie-build to generate a new" << endl
@@ -60,7 +62,7 @@ BitPairReference::BitPairReference(
 		loaded_ = false;
 		return;
 	}
-    if((f4 = fopen(s4.c_str(), "rb"))  == NULL) {
+    if((f4 = openIndexFile(s4, loc4))  == NULL) {
         cerr << "Could not open reference-string index file " << s4 << " for reading." << endl;
 		loaded_ = false;
 		return;
@@ -72,14 +74,7 @@ BitPairReference::BitPairReference(
 			cerr << "  Memory-mapping reference index file " << s4.c_str() << ": ";
 			logTime(cerr);
 		}
-		struct stat sbuf;
-		if (stat(s4.c_str(), &sbuf) == -1) {
-			perror("stat");
-			cerr << "Error: Could not stat index file " << s4.c_str() << " prior to memory-mapping" << endl;
-			throw 1;
-		}
-		mmFile = (char*)mmap((void *)0, (size_t)sbuf.st_size,
-				     PROT_READ, MAP_SHARED, fileno(f4), 0);
+		mmFile = mmapIndexFile(loc4, fileno(f4));
 		if(mmFile == (void *)(-1) || mmFile == NULL) {
 			perror("mmap");
 			cerr << "Error: Could not memory-map the index file " << s4.c_str() << endl;
@@ -87,7 +82,7 @@ BitPairReference::BitPairReference(
 		}
 		if(mmSweep) {
 			TIndexOff sum = 0;
-			for(off_t i = 0; i < sbuf.st_size; i += 1024) {
+			for(uint64_t i = 0; i < loc4.len; i += 1024) {
 				sum += (TIndexOff) mmFile[i];
 			}
 			if(startVerbose) {
@@ -193,7 +188,8 @@ BitPairReference::BitPairReference(
 #ifdef BOWTIE_MM
 		buf_ = (uint8_t*)mmFile;
 		if(sanity_) {
-			FILE *ftmp = fopen(s4.c_str(), "rb");
+			IndexFileLoc loctmp;
+			FILE *ftmp = openIndexFile(s4, loctmp);
 			sanityBuf_ = new uint8_t[cumsz >> 2];
 			size_t ret = fread(sanityBuf_, 1, cumsz >> 2, ftmp);
 			if(ret != (cumsz >> 2)) {
@@ -228,7 +224,7 @@ BitPairReference::BitPairReference(
 		}
 		if(shmemLeader) {
 			// Open the bitpair-encoded reference file
-			FILE *f4 = fopen(s4.c_str(), "rb");
+			FILE *f4 = openIndexFile(s4, loc4);
 			if(f4 == NULL) {
 				cerr << "Could not open reference-string index file " << s4.c_str() << " for reading." << endl;
 				cerr << "This is most likely because your index was built with an older version" << endl
@@ -248,7 +244,7 @@ BitPairReference::BitPairReference(
                 // Make sure there's no more
                 char c;
                 ret = fread(&c, 1, 1, f4);
-                assert_eq(0, ret); // should have failed
+                assert(loc4.packed || ret == 0); // should have failed
             } else {
                 TIndexOffU buf_pos = 0;
                 uint8_t four_buf = 0, four_buf2 = 0;
@@ -265,7 +261,7 @@ BitPairReference::BitPairReference(
                     assert_eq(cur_len2 & 3, 0);
                     uint8_t *buf2_ = new uint8_t[cur_len2 >> 2];
                     // Read sequences selectively
-                    fseek(f4, (seq_pos - left_pad) >> 2, SEEK_SET);
+                    fseeko(f4, (off_t)(loc4.off + ((seq_pos - left_pad) >> 2)), SEEK_SET);
                     size_t ret = fread(buf2_, 1, cur_len2 >> 2, f4);
                     // Didn't read all of it?
                     if(ret != (cur_len2 >> 2)) {
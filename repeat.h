@@ -24,7 +24,9 @@
 #include <fstream>
 #include <limits>
 #include <map>
+#include <iomanip>
 #include "assert_helpers.h"
+#include "threading.h"
 #include "word_io.h"
 #include "mem_ids.h"
 #include "ref_coord.h"
@@ -186,12 +188,323 @@ public:
     EList<RepeatCoord<index_t> >   positions;
 };
 
+/**
+ * Cache of which instances of a repeat carry an allele covering a given
+ * stretch of the repeat sequence, shared by all threads.
+ *
+ * RepeatDB::construct() already resolves every instance of a repeat to
+ * its genomic coordinates, but each lookup still has to go through all
+ * of them and drop those whose allele doesn't cover the stretch of the
+ * repeat a read hit.  For families with many instances (Alu, L1) that
+ * is the same filtering read after read.  An entry keeps the result,
+ * the indexes into Repeat::positions of the instances to use, keyed by
+ * the repeat and the set of alleles that cover the stretch, so reads
+ * hitting the same part of a repeat share it.
+ *
+ * Entries are built on first use and kept in per-shard LRU lists within
+ * a byte budget.  An entry handed out by acquire() is pinned until it is
+ * given back with release() and is not evicted in the meantime.
+ */
+template <typename index_t>
+class RepeatPositionCache {
+
+    enum {
+        NUM_SHARDS = 16 // power of 2
+    };
+
+public:
+
+    struct Entry {
+        uint64_t       hash;
+        index_t        repeatIdx; // index into RepeatDB::repeats()
+        EList<index_t> alleles;   // IDs of the alleles covering the stretch
+        EList<index_t> sel;       // indexes into the repeat's positions
+        size_t         bytes;     // memory charged to the entry
+        uint32_t       refs;      // # acquire() calls not yet released
+        Entry*         prev;      // more recently used neighbour
+        Entry*         next;      // less recently used neighbour
+    };
+
+private:
+
+    struct Shard {
+        Shard() : head(NULL), tail(NULL), bytes(0),
+                  lookups(0), hits(0), inserts(0), evictions(0) { }
+        
+        ~Shard() {
+            while(head != NULL) {
+                Entry* e = head;
+                head = head->next;
+                delete e;
+            }
+        }
+        
+        MUTEX_T                    lock;
+        std::map<uint64_t, Entry*> index;
+        Entry*                     head;  // most recently used
+        Entry*                     tail;  // least recently used
+        size_t                     bytes;
+        uint64_t                   lookups;
+        uint64_t                   hits;
+        uint64_t                   inserts;
+        uint64_t                   evictions;
+    };
+
+public:
+
+    RepeatPositionCache(uint64_t bytes) : shardBytes_((size_t)(bytes / NUM_SHARDS)) { }
+    
+    /**
+     * Return the entry for the instances of 'repeat' (repeats()[repeatIdx])
+     * whose allele is one of 'alleles', a sorted list of allele IDs,
+     * building it if needed.  Return NULL if it doesn't fit in the cache.
+     */
+    const Entry* acquire(
+                         index_t                 repeatIdx,
+                         const Repeat<index_t>&  repeat,
+                         const EList<index_t>&   alleles)
+    {
+        uint64_t h = 0xcbf29ce484222325ULL; // FNV-1a
+        h = (h ^ (uint64_t)repeatIdx) * 0x100000001b3ULL;
+        for(size_t i = 0; i < alleles.size(); i++) {
+            h = (h ^ (uint64_t)alleles[i]) * 0x100000001b3ULL;
+        }
+        Shard& sh = shards_[h & (NUM_SHARDS - 1)];
+        {
+            ThreadSafe ts(&sh.lock);
+            sh.lookups++;
+            typename std::map<uint64_t, Entry*>::iterator it = sh.index.find(h);
+            if(it != sh.index.end() && matches(*it->second, repeatIdx, alleles)) {
+                Entry* e = it->second;
+                sh.hits++;
+                e->refs++;
+                unlink(sh, e);
+                pushFront(sh, e);
+                return e;
+            }
+        }
+        
+        // Build the entry without holding the lock
+        Entry* e = new Entry();
+        e->hash = h;
+        e->repeatIdx = repeatIdx;
+        e->alleles = alleles;
+        e->refs = 1;
+        e->prev = e->next = NULL;
+        EList<bool> use;
+        use.resizeExact(repeat.alleles.size());
+        use.fill(false);
+        for(size_t i = 0; i < alleles.size(); i++) {
+            use[alleles[i]] = true;
+        }
+        const EList<RepeatCoord<index_t> >& positions = repeat.positions;
+        for(index_t p = 0; p < positions.size(); p++) {
+            if(use[positions[p].alleleID]) {
+                e->sel.push_back(p);
+            }
+        }
+        e->bytes = sizeof(Entry) +
+                   sizeof(index_t) * (e->alleles.capacity() + e->sel.capacity());
+        if(e->bytes > shardBytes_) {
+            delete e;
+            return NULL;
+        }
+        
+        ThreadSafe ts(&sh.lock);
+        typename std::map<uint64_t, Entry*>::iterator it = sh.index.find(h);
+        if(it != sh.index.end()) {
+            Entry* old = it->second;
+            if(matches(*old, repeatIdx, alleles)) {
+                // Another thread built it in the meantime
+                delete e;
+                old->refs++;
+                return old;
+            }
+            if(old->refs > 0) {
+                // Hash collision with an entry in use; leave it be
+                delete e;
+                return NULL;
+            }
+            remove(sh, old);
+        }
+        for(Entry* victim = sh.tail; victim != NULL && sh.bytes + e->bytes > shardBytes_; ) {
+            Entry* prev = victim->prev;
+            if(victim->refs == 0) {
+                remove(sh, victim);
+                sh.evictions++;
+            }
+            victim = prev;
+        }
+        sh.index[h] = e;
+        pushFront(sh, e);
+        sh.bytes += e->bytes;
+        sh.inserts++;
+        return e;
+    }
+    
+    /**
+     * Give back an entry returned by acquire().
+     */
+    void release(const Entry* e) {
+        Shard& sh = shards_[e->hash & (NUM_SHARDS - 1)];
+        ThreadSafe ts(&sh.lock);
+        assert_gt(e->refs, 0);
+        const_cast<Entry*>(e)->refs--;
+    }
+    
+    /**
+     * Print how often the cache was consulted and how often it held the
+     * instances asked for.
+     */
+    void printSumm(std::ostream& out, const char* name) const {
+        uint64_t lookups = 0, hits = 0, inserts = 0, evictions = 0;
+        for(size_t i = 0; i < NUM_SHARDS; i++) {
+            lookups += shards_[i].lookups;
+            hits += shards_[i].hits;
+            inserts += shards_[i].inserts;
+            evictions += shards_[i].evictions;
+        }
+        out << name << ": " << lookups << " lookups, " << hits << " hits (";
+        if(lookups > 0) {
+            out << std::fixed << std::setprecision(2) << (100.0 * hits / lookups) << "%";
+        } else {
+            out << "0.00%";
+        }
+        out << "), " << inserts << " inserts, " << evictions << " evictions" << std::endl;
+    }
+
+private:
+
+    static bool matches(const Entry& e, index_t repeatIdx, const EList<index_t>& alleles) {
+        if(e.repeatIdx != repeatIdx || e.alleles.size() != alleles.size()) return false;
+        for(size_t i = 0; i < alleles.size(); i++) {
+            if(e.alleles[i] != alleles[i]) return false;
+        }
+        return true;
+    }
+    
+    static void unlink(Shard& sh, Entry* e) {
+        if(e->prev != NULL) e->prev->next = e->next; else sh.head = e->next;
+        if(e->next != NULL) e->next->prev = e->prev; else sh.tail = e->prev;
+        e->prev = e->next = NULL;
+    }
+    
+    static void pushFront(Shard& sh, Entry* e) {
+        e->prev = NULL;
+        e->next = sh.head;
+        if(sh.head != NULL) sh.head->prev = e;
+        sh.head = e;
+        if(sh.tail == NULL) sh.tail = e;
+    }
+    
+    static void remove(Shard& sh, Entry* e) {
+        unlink(sh, e);
+        sh.index.erase(e->hash);
+        sh.bytes -= e->bytes;
+        delete e;
+    }
+    
+    size_t shardBytes_; // byte budget of each shard
+    Shard  shards_[NUM_SHARDS];
+};
+
+/**
+ * The instances of a repeat to consider for a stretch [adjLeft, adjRight)
+ * of its sequence: those whose allele covers it.  Walks a cached
+ * selection when there is one and otherwise checks each instance's
+ * allele.  Gives the cache entry back when it goes out of scope.
+ */
+template <typename index_t>
+class RepeatPositions {
+public:
+    RepeatPositions(
+                    const Repeat<index_t>& repeat,
+                    index_t                adjLeft,
+                    index_t                adjRight) :
+    _positions(repeat.positions),
+    _alleles(repeat.alleles),
+    _adjLeft(adjLeft),
+    _adjRight(adjRight),
+    _all(false),
+    _cache(NULL),
+    _entry(NULL) { }
+    
+    ~RepeatPositions() {
+        if(_entry != NULL) _cache->release(_entry);
+    }
+    
+    /**
+     * Every instance's allele covers the stretch; skip the checks.
+     */
+    void useAll() { _all = true; }
+    
+    /**
+     * Only walk the instances in 'entry' from now on.
+     */
+    void use(RepeatPositionCache<index_t>* cache, const typename RepeatPositionCache<index_t>::Entry* entry) {
+        _cache = cache;
+        _entry = entry;
+    }
+    
+    index_t size() const {
+        return (index_t)(_entry != NULL ? _entry->sel.size() : _positions.size());
+    }
+    
+    const RepeatCoord<index_t>& operator[](index_t i) const {
+        return _positions[_entry != NULL ? _entry->sel[i] : i];
+    }
+    
+    /**
+     * Return true iff the i-th instance's allele covers the stretch.
+     */
+    bool compatible(index_t i) const {
+        if(_all || _entry != NULL) return true;
+        assert_lt(_positions[i].alleleID, _alleles.size());
+        return _alleles[_positions[i].alleleID].compatible(_adjLeft, _adjRight);
+    }
+    
+    /**
+     * Return the first i with (*this)[i].joinedOff >= joinedOff.
+     */
+    index_t lowerBound(index_t joinedOff) const {
+        index_t lo = 0, hi = size();
+        while(lo < hi) {
+            index_t mid = lo + (hi - lo) / 2;
+            if((*this)[mid].joinedOff < joinedOff) lo = mid + 1;
+            else                                   hi = mid;
+        }
+        return lo;
+    }
+    
+private:
+    const EList<RepeatCoord<index_t> >&                 _positions;
+    const EList<RepeatAllele<index_t> >&                _alleles;
+    index_t                                             _adjLeft;
+    index_t                                             _adjRight;
+    bool                                                _all;
+    RepeatPositionCache<index_t>*                       _cache;
+    const typename RepeatPositionCache<index_t>::Entry* _entry;
+};
+
 template <typename index_t>
 class RepeatDB {
 public:
-    RepeatDB() {}
+    RepeatDB() : _positionCache(NULL) {}
     
-    virtual ~RepeatDB() {}
+    virtual ~RepeatDB() {
+        delete _positionCache;
+    }
+    
+    /**
+     * Keep up to 'bytes' worth of per-allele instance selections for
+     * reuse across reads; see RepeatPositionCache.
+     */
+    void enablePositionCache(uint64_t bytes) {
+        delete _positionCache;
+        _positionCache = new RepeatPositionCache<index_t>(bytes);
+    }
+    
+    const RepeatPositionCache<index_t>* positionCache() const { return _positionCache; }
     
     bool empty() const { return _repeats.size() == 0; }
     
@@ -392,18 +705,16 @@ public:
         index_t repeatIdx_ = repeatMap[repeatIdx].second;
         assert_lt(repeatIdx_, _repeats.size());
         
-        const EList<RepeatAllele<index_t> >& alleles = _repeats[repeatIdx_].alleles;
         index_t adjLeft = left, adjRight = right;
         if(repeatIdx > 0) {
             adjLeft -= repeatMap[repeatIdx-1].first;
             adjRight -= repeatMap[repeatIdx-1].first;
         }
-        const EList<RepeatCoord<index_t> >& positions = _repeats[repeatIdx_].positions;
+        RepeatPositions<index_t> positions(_repeats[repeatIdx_], adjLeft, adjRight);
+        selectPositions(repeatIdx_, adjLeft, adjRight, positions);
         for(index_t p = 0; p < positions.size(); p++) {
             const RepeatCoord<index_t>& position = positions[p];
-            assert_lt(position.alleleID, alleles.size());
-            const RepeatAllele<index_t>& allele = alleles[position.alleleID];
-            if(!allele.compatible(adjLeft, adjRight))
+            if(!positions.compatible(p))
                 continue;
             
             near_positions.expand();
@@ -452,17 +763,15 @@ public:
         index_t repeatIdx_ = repeatMap[repeatIdx].second;
         assert_lt(repeatIdx_, _repeats.size());
         
-        const EList<RepeatAllele<index_t> >& alleles = _repeats[repeatIdx_].alleles;
         index_t adjLeft = left, adjRight = right;
         if(repeatIdx > 0) {
             adjLeft -= repeatMap[repeatIdx-1].first;
             adjRight -= repeatMap[repeatIdx-1].first;
         }
-        const EList<RepeatCoord<index_t> >& positions = _repeats[repeatIdx_].positions;
+        RepeatPositions<index_t> positions(_repeats[repeatIdx_], adjLeft, adjRight);
+        selectPositions(repeatIdx_, adjLeft, adjRight, positions);
         
-        RepeatCoord<index_t> cmp;
-        cmp.joinedOff = (anchor_left >= dist ? anchor_left - dist : 0);
-        index_t p = positions.bsearchLoBound(cmp);
+        index_t p = positions.lowerBound(anchor_left >= dist ? anchor_left - dist : 0);
         for(; p < positions.size(); p++) {
             const RepeatCoord<index_t>& position = positions[p];
             index_t pos = positions[p].joinedOff + adjLeft;
@@ -471,9 +780,7 @@ public:
             if(anchor_right + dist < pos)
                 break;
             
-            assert_lt(position.alleleID, alleles.size());
-            const RepeatAllele<index_t>& allele = alleles[position.alleleID];
-            if(!allele.compatible(adjLeft, adjRight))
+            if(!positions.compatible(p))
                 continue;
             
             near_positions.expand();
@@ -523,7 +830,6 @@ public:
             return false;
         index_t repeatIdx_ = repeatMap[repeatIdx].second;
         assert_lt(repeatIdx_, _repeats.size());
-        const EList<RepeatAllele<index_t> >& alleles = _repeats[repeatIdx_].alleles;
         index_t adjLeft = left, adjRight = right;
         if(repeatIdx > 0) {
             adjLeft -= repeatMap[repeatIdx-1].first;
@@ -540,19 +846,19 @@ public:
             return false;
         index_t repeatIdx2_ = repeatMap2[repeatIdx2].second;
         assert_lt(repeatIdx2_, _repeats.size());
-        const EList<RepeatAllele<index_t> >& alleles2 = _repeats[repeatIdx2_].alleles;
         index_t adjLeft2 = left2, adjRight2 = right2;
         if(repeatIdx2 > 0) {
             adjLeft2 -= repeatMap2[repeatIdx2-1].first;
             adjRight2 -= repeatMap2[repeatIdx2-1].first;
         }
         
-        const EList<RepeatCoord<index_t> >& positions = _repeats[repeatIdx_].positions;
-        const EList<RepeatCoord<index_t> >& positions2 = _repeats[repeatIdx2_].positions;
+        RepeatPositions<index_t> positions(_repeats[repeatIdx_], adjLeft, adjRight);
+        selectPositions(repeatIdx_, adjLeft, adjRight, positions);
+        RepeatPositions<index_t> positions2(_repeats[repeatIdx2_], adjLeft2, adjRight2);
+        selectPositions(repeatIdx2_, adjLeft2, adjRight2, positions2);
         index_t jsave = 0;
         for(index_t i = 0; i < positions.size(); i++) {
-            const RepeatAllele<index_t>& allele = alleles[positions[i].alleleID];
-            if(!allele.compatible(adjLeft, adjRight))
+            if(!positions.compatible(i))
                 continue;
             index_t i_pos = positions[i].joinedOff + adjLeft;
             for(index_t j = jsave; j < positions2.size(); j++) {
@@ -564,8 +870,7 @@ public:
                 if(i_pos + dist < j_pos)
                     break;
                 
-                const RepeatAllele<index_t>& allele2 = alleles2[positions2[j].alleleID];
-                if(!allele2.compatible(adjLeft2, adjRight2))
+                if(!positions2.compatible(j))
                     continue;
             
                 common_positions.expand();
@@ -604,6 +909,35 @@ public:
     }
     
 private:
+    /**
+     * Narrow 'positions' down to the instances whose allele covers
+     * [adjLeft, adjRight) of repeats()[repeatIdx] using the position
+     * cache, if there is one.
+     */
+    void selectPositions(
+                         index_t                   repeatIdx,
+                         index_t                   adjLeft,
+                         index_t                   adjRight,
+                         RepeatPositions<index_t>& positions) const
+    {
+        if(_positionCache == NULL)
+            return;
+        const Repeat<index_t>& repeat = _repeats[repeatIdx];
+        EList<index_t> alleles;
+        for(index_t a = 0; a < repeat.alleles.size(); a++) {
+            if(repeat.alleles[a].compatible(adjLeft, adjRight))
+                alleles.push_back(a);
+        }
+        if(alleles.size() == repeat.alleles.size()) {
+            positions.useAll();
+            return;
+        }
+        const typename RepeatPositionCache<index_t>::Entry* e =
+            _positionCache->acquire(repeatIdx, repeat, alleles);
+        if(e != NULL)
+            positions.use(_positionCache, e);
+    }
+    
     pair<index_t, index_t> get_alt_range(const ALTDB<index_t>& altdb,
                                          index_t left,
                                          index_t right) const {
@@ -621,6 +955,8 @@ private:
 private:
     EList<Repeat<index_t> >         _repeats;
     ELList<pair<index_t, index_t> > _repeatMap; // pos to repeat id
+    
+    RepeatPositionCache<index_t>*   _positionCache; // NULL unless enablePositionCache() was called
 };
 
 #endif /*ifndef REPEAT_H_*/
@@ -23,6 +23,7 @@
 #include <algorithm>
 #include <cmath>
 #include "timer.h"
+#include "threading.h"
 #include "aligner_sw.h"
 #include "aligner_result.h"
 #include "scoring.h"
@@ -3168,16 +3169,301 @@ RepeatBuilder<TStr>::RepeatBuilder(TStr& s,
                                    const EList<RefRecord>& szs,
                                    const EList<string>& ref_names,
                                    bool forward_only,
-                                   const string& filename) :
+                                   const string& filename,
+                                   int nthreads) :
 s_(s),
 coordHelper_(s.length(), forward_only ? s.length() : s.length() / 2, szs, ref_names),
 forward_only_(forward_only),
 filename_(filename),
-forward_length_(forward_only ? s.length() : s.length() / 2)
+forward_length_(forward_only ? s.length() : s.length() / 2),
+nthreads_(max(nthreads, 1)),
+job_rp_(NULL),
+job_sa_(NULL),
+job_lo_(0),
+job_hi_(0),
+job_bases_(NULL),
+job_kmer_table_(NULL),
+job_seqs_(NULL),
+job_interval_(1),
+job_items_(0)
 {
 	cerr << "RepeatBuilder: " << filename_ << endl;
 }
 
+template<typename TStr>
+static void repeatJob_worker(void* vp)
+{
+    RB_ThreadParam<TStr>* p = (RB_ThreadParam<TStr>*)vp;
+    p->builder->doJob(p->job, p->tid, p->nthreads);
+}
+
+/**
+ * Run a job on nthreads_ threads and wait for it to finish.  Each thread
+ * writes only its own items' results, so what a job computes doesn't
+ * depend on the number of threads.
+ */
+template<typename TStr>
+void RepeatBuilder<TStr>::runJob(int job)
+{
+    EList<RB_ThreadParam<TStr> > tparams;
+    tparams.resizeExact(nthreads_);
+    for(size_t i = 0; i < tparams.size(); i++) {
+        tparams[i].builder = this;
+        tparams[i].job = job;
+        tparams[i].tid = i;
+        tparams[i].nthreads = tparams.size();
+    }
+    if(tparams.size() == 1) {
+        repeatJob_worker<TStr>((void*)&tparams[0]);
+        return;
+    }
+    AutoArray<tthread::thread*> threads(tparams.size());
+    for(size_t i = 0; i < tparams.size(); i++) {
+        threads[i] = new tthread::thread(repeatJob_worker<TStr>, (void*)&tparams[i]);
+    }
+    for(size_t i = 0; i < tparams.size(); i++) {
+        threads[i]->join();
+        delete threads[i];
+    }
+}
+
+template<typename TStr>
+void RepeatBuilder<TStr>::doJob(int job, size_t tid, size_t nthreads)
+{
+    assert(job_rp_ != NULL);
+    const RepeatParameter& rp = *job_rp_;
+    // CoordHelper caches its last lookups, so each thread needs its own
+    CoordHelper coordHelper(coordHelper_);
+    switch(job) {
+        case RB_JOB_SUBSA: {
+            // A contiguous share of the window, so that the previous valid
+            // suffix is usually the one just checked
+            const BitPackedArray& sa = *job_sa_;
+            const TIndexOffU seed_len = subSA_.seed_len();
+            // Whether a seed matches the previous one only matters when
+            // seeds are grouped
+            const bool need_same = subSA_.seed_count() > 1;
+            size_t lo = job_lo_ + (job_hi_ - job_lo_) * tid / nthreads;
+            size_t hi = job_lo_ + (job_hi_ - job_lo_) * (tid + 1) / nthreads;
+            bool has_prev = false;
+            TIndexOffU prev = 0;
+            for(size_t i = lo; i > 0 && !has_prev;) {
+                i--;
+                TIndexOffU saElt = sa[i];
+                if(saElt < s_.length() && saElt + seed_len <= coordHelper.getEnd(saElt)) {
+                    has_prev = true;
+                    prev = saElt;
+                }
+            }
+            for(size_t i = lo; i < hi; i++) {
+                TIndexOffU saElt = sa[i];
+                uint8_t flags = 0;
+                if(saElt < s_.length() && saElt + seed_len <= coordHelper.getEnd(saElt)) {
+                    flags = 1;
+                    if(need_same && has_prev && isSameSequenceUpto(s_, coordHelper, prev, saElt, seed_len)) {
+                        flags |= 2;
+                    }
+                    has_prev = true;
+                    prev = saElt;
+                }
+                job_flags_[i - job_lo_] = flags;
+            }
+            break;
+        }
+        case RB_JOB_INIT:
+            for(size_t i = tid; i < job_bases_->size(); i += nthreads) {
+                job_repeats_[i]->init(rp,
+                                      s_,
+                                      coordHelper,
+                                      subSA_,
+                                      (*job_bases_)[i]);
+            }
+            break;
+        case RB_JOB_KMER: {
+            // bit 0: counted, bit 1: repeat, bit 2: estimated to be a repeat
+            string query, rc_query;
+            EList<pair<uint64_t, size_t> > minimizers;
+            for(size_t k = tid; k < job_items_; k += nthreads) {
+                size_t i = k * job_interval_;
+                job_results_[k] = 0;
+                if(coordHelper.getEnd(i) != coordHelper.getEnd(i + rp.min_repeat_len))
+                    continue;
+                query = getString(s_, i, rp.min_repeat_len);
+                rc_query = reverseComplement(query);
+                TIndexOffU idx = subSA_.find_repeat_idx(s_, query);
+                bool repeat = (idx < subSA_.getRepeatIndex().size());
+                bool est_repeat = job_kmer_table_->isRepeat(query,
+                                                            rc_query,
+                                                            minimizers);
+                job_results_[k] = 1 | (repeat ? 2 : 0) | (est_repeat ? 4 : 0);
+            }
+            break;
+        }
+        case RB_JOB_ALIGN: {
+            // Four results per item: forward alignments, reverse-complement
+            // alignments, whether the reverse complement was a repeat, and
+            // whether the seed was found exactly once
+            const EList<string>& seqs = *job_seqs_;
+            const EList<TIndexOffU>& test_repeat_index = subSA_.getRepeatIndex();
+            ELList<RB_Alignment> position2D; EList<RB_Alignment> alignments;
+            EList<pair<uint64_t, size_t> > minimizers;
+            string query, query2, rc_query, rc_query2;
+            for(size_t k = tid; k < job_items_; k += nthreads) {
+                size_t i = k * job_interval_;
+                size_t* res = &job_results_[4 * k];
+                res[0] = res[1] = res[2] = res[3] = 0;
+                TIndexOffU saElt_idx = test_repeat_index[i];
+                TIndexOffU saElt = subSA_[saElt_idx];
+                query = getString(s_, saElt, rp.min_repeat_len);
+                query2 = query;
+                
+                // introduce three mismatches into a query when the query is at lest 100-bp
+                if(rp.min_repeat_len >= 100) {
+                    const size_t mid_pos1 = (size_t)(rp.min_repeat_len * 0.1);
+                    if(query2[mid_pos1] == 'A') {
+                        query2[mid_pos1] = 'C';
+                    } else {
+                        query2[mid_pos1] = 'A';
+                    }
+                    const size_t mid_pos2 = (size_t)(rp.min_repeat_len * 0.5);
+                    if(query2[mid_pos2] == 'C') {
+                        query2[mid_pos2] = 'G';
+                    } else {
+                        query2[mid_pos2] = 'C';
+                    }
+                    const size_t mid_pos3 = (size_t)(rp.min_repeat_len * 0.9);
+                    if(query2[mid_pos3] == 'G') {
+                        query2[mid_pos3] = 'T';
+                    } else {
+                        query2[mid_pos3] = 'G';
+                    }
+                }
+                
+                size_t found = 0;
+                if(job_kmer_table_->isRepeat(query2, minimizers)) {
+                    job_kmer_table_->findAlignments(query2,
+                                                    minimizers,
+                                                    position2D,
+                                                    alignments);
+                    res[0] = alignments.size();
+                    TIndexOffU baseoff = 0;
+                    for(size_t s = 0; s < seqs.size(); s++) {
+                        int spos = seqs[s].find(query);
+                        if(spos != string::npos) {
+                            for(size_t a = 0; a < alignments.size(); a++) {
+                                if(alignments[a].pos == baseoff + spos) {
+                                    found++;
+                                }
+                            }
+                        }
+                        baseoff += seqs[s].length();
+                    }
+                    
+                    assert_leq(found, 1);
+                }
+                
+                rc_query = reverseComplement(query);
+                rc_query2 = reverseComplement(query2);
+                size_t rc_found = 0;
+                if(job_kmer_table_->isRepeat(rc_query2, minimizers)) {
+                    job_kmer_table_->findAlignments(rc_query2,
+                                                    minimizers,
+                                                    position2D,
+                                                    alignments);
+                    res[1] = alignments.size();
+                    res[2] = 1;
+                    
+                    TIndexOffU baseoff = 0;
+                    for(size_t s = 0; s < seqs.size(); s++) {
+                        int spos = seqs[s].find(rc_query);
+                        if(spos != string::npos) {
+                            for(size_t a = 0; a < alignments.size(); a++) {
+                                if(alignments[a].pos == baseoff + spos) {
+                                    rc_found++;
+                                }
+                            }
+                        }
+                        baseoff += seqs[s].length();
+                    }
+                    assert_leq(rc_found, 1);
+                }
+                
+                res[3] = (found + rc_found == 1 ? 1 : 0);
+            }
+            break;
+        }
+        case RB_JOB_SANITY: {
+            // Two results per item: hits of the seed and of its reverse
+            // complement
+            const EList<TIndexOffU>& test_repeat_index = subSA_.getRepeatIndex();
+            string query, rc_query, seq;
+            for(size_t k = tid; k < job_items_; k += nthreads) {
+                size_t i = k * job_interval_;
+                TIndexOffU saElt_idx = test_repeat_index[i];
+#ifndef NDEBUG
+                TIndexOffU saElt_idx_end = (i + 1 < test_repeat_index.size() ? test_repeat_index[i+1] : subSA_.size());
+                for(size_t j = saElt_idx; j < saElt_idx_end; j++) {
+                    if(j > saElt_idx) {
+                        TIndexOffU lcp_len = getLCP(s_,
+                                                    coordHelper,
+                                                    subSA_[saElt_idx],
+                                                    subSA_[j],
+                                                    rp.min_repeat_len);
+                        assert_eq(lcp_len, rp.min_repeat_len);
+                    }
+                    
+                    TIndexOffU saElt = subSA_[j];
+                    TIndexOffU start = coordHelper.getStart(saElt);
+                    TIndexOffU start2 = coordHelper.getStart(saElt + rp.min_repeat_len - 1);
+                    assert_eq(start, start2);
+                }
+#endif
+                TIndexOffU saElt = subSA_[saElt_idx];
+                getString(s_, saElt, rp.min_repeat_len, query);
+                
+                size_t count = 0, rc_count = 0;
+                rc_query = reverse_complement(query);
+                for(map<size_t, RB_Repeat*>::iterator it = repeat_map_.begin(); it != repeat_map_.end(); it++) {
+                    RB_Repeat& repeat = *(it->second);
+                    int pos = repeat.consensus().find(query);
+                    if(pos != string::npos) {
+                        for(size_t s = 0; s < repeat.seeds().size(); s++) {
+                            SeedExt& seed = repeat.seeds()[s];
+                            seed.getExtendedSeedSequence(s_, seq);
+                            if(seq.find(query) != string::npos)
+                                count++;
+                        }
+                    }
+                    pos = repeat.consensus().find(rc_query);
+                    if(pos != string::npos) {
+                        for(size_t s = 0; s < repeat.seeds().size(); s++) {
+                            SeedExt& seed = repeat.seeds()[s];
+                            seed.getExtendedSeedSequence(s_, seq);
+                            if(seq.find(rc_query) != string::npos)
+                                rc_count++;
+                        }
+                    }
+                }
+                job_results_[2 * k] = count;
+                job_results_[2 * k + 1] = rc_count;
+            }
+            break;
+        }
+        case RB_JOB_SNPS:
+            for(size_t i = tid; i < job_repeats_.size(); i += nthreads) {
+                RB_Repeat& repeat = *job_repeats_[i];
+                if(!repeat.satisfy(rp))
+                    continue;
+                
+                // for each repeats
+                repeat.generateSNPs(rp, s_, i);
+            }
+            break;
+        default:
+            assert(false);
+    }
+}
+
 template<typename TStr>
 RepeatBuilder<TStr>::~RepeatBuilder()
 {
@@ -3229,21 +3515,42 @@ void RepeatBuilder<TStr>::readSA(const RepeatParameter &rp,
 
     subSA_.init(s_.length() + 1, rp.min_repeat_len, rp.repeat_count);
 
-    for(size_t i = 0; i < sa.size(); i++) {
-        TIndexOffU saElt = sa[i];
-        count++;
+    // With several threads, check the seeds against the reference a window
+    // at a time on all of them, then group them in order; one thread checks
+    // each seed as it groups it
+    const bool parallel = nthreads_ > 1;
+    const size_t window = parallel ? (16 << 20) : sa.size();
+    job_rp_ = &rp;
+    job_sa_ = &sa;
+    if(parallel) job_flags_.resizeExact(min(window, sa.size()));
+    bool last = false;
+    for(job_lo_ = 0; job_lo_ < sa.size() && !last; job_lo_ = job_hi_) {
+        job_hi_ = min(job_lo_ + window, sa.size());
+        if(parallel) runJob(RB_JOB_SUBSA);
+        for(size_t i = job_lo_; i < job_hi_; i++) {
+            TIndexOffU saElt = sa[i];
+            count++;
 
-        if(count && (count % 10000000 == 0)) {
-            cerr << "RB count " << count << endl;
-        }
+            if(count && (count % 10000000 == 0)) {
+                cerr << "RB count " << count << endl;
+            }
 
-        if(saElt == s_.length()) {
-            assert_eq(count, s_.length() + 1);
-            break;
-        }
+            if(saElt == s_.length()) {
+                assert_eq(count, s_.length() + 1);
+                last = true;
+                break;
+            }
 
-        subSA_.push_back(s_, coordHelper_, saElt, count == s_.length());
+            if(parallel) {
+                uint8_t flags = job_flags_[i - job_lo_];
+                subSA_.push_back(s_, saElt, (flags & 1) != 0, (flags & 2) != 0, count == s_.length());
+            } else {
+                subSA_.push_back(s_, coordHelper_, saElt, count == s_.length());
+            }
+        }
     }
+    job_sa_ = NULL;
+    job_flags_.nullify();
 
     cerr << "subSA size: " << endl;
     subSA_.dump();
@@ -3268,21 +3575,30 @@ void RepeatBuilder<TStr>::build(const RepeatParameter& rp)
     swaligner_.init_dyn(rp);
 
     RB_RepeatManager* repeat_manager = new RB_RepeatManager;
+    job_rp_ = &rp;
     
     EList<RB_RepeatBase> repeatBases;
     subSA_.buildRepeatBase(s_,
                            coordHelper_,
                            rp.max_repeat_len,
-                           repeatBases);
+                           repeatBases,
+                           nthreads_);
     
-    size_t repeat_id = 0;
+    // Repeat IDs follow the order of the repeat bases, whichever thread
+    // extends them
+    job_bases_ = &repeatBases;
+    job_repeats_.resizeExact(repeatBases.size());
     for(size_t i = 0; i < repeatBases.size(); i++) {
-        addRepeatGroup(rp,
-                       repeat_id,
-                       *repeat_manager,
-                       repeatBases[i],
-                       fp);
+        job_repeats_[i] = new RB_Repeat;
+        job_repeats_[i]->repeat_id(i);
     }
+    runJob(RB_JOB_INIT);
+    for(size_t i = 0; i < job_repeats_.size(); i++) {
+        assert(repeat_map_.find(job_repeats_[i]->repeat_id()) == repeat_map_.end());
+        repeat_map_[job_repeats_[i]->repeat_id()] = job_repeats_[i];
+    }
+    job_repeats_.clear();
+    job_bases_ = NULL;
     
     {
         // Build and test minimizer-based k-mer table
@@ -3303,21 +3619,20 @@ void RepeatBuilder<TStr>::build(const RepeatParameter& rp)
         kmer_table.dump(cerr);
         cerr << endl;
         
-        string query, rc_query;
-        EList<pair<uint64_t, size_t> > minimizers;
+        job_kmer_table_ = &kmer_table;
+        job_seqs_ = &seqs;
+        
         size_t total = 0, num_repeat = 0, correct = 0, false_positive = 0, false_negative = 0;
-        for(size_t i = 0; i + rp.min_repeat_len <= forward_length_; i += 1000) {
-            if(coordHelper_.getEnd(i) != coordHelper_.getEnd(i + rp.min_repeat_len))
+        job_interval_ = 1000;
+        job_items_ = (forward_length_ >= rp.min_repeat_len ? (forward_length_ - rp.min_repeat_len) / job_interval_ + 1 : 0);
+        job_results_.resizeExact(job_items_);
+        runJob(RB_JOB_KMER);
+        for(size_t j = 0; j < job_items_; j++) {
+            size_t res = job_results_[j];
+            if(!(res & 1))
                 continue;
-            query = getString(s_, i, rp.min_repeat_len);
-            rc_query = reverseComplement(query);
-            
-            TIndexOffU idx = subSA_.find_repeat_idx(s_, query);
-            const EList<TIndexOffU>& test_repeat_index = subSA_.getRepeatIndex();
-            bool repeat = (idx < test_repeat_index.size());
-            bool est_repeat = kmer_table.isRepeat(query,
-                                                  rc_query,
-                                                  minimizers);
+            bool repeat = (res & 2) != 0;
+            bool est_repeat = (res & 4) != 0;
             
             total++;
             if(repeat) num_repeat++;
@@ -3340,7 +3655,6 @@ void RepeatBuilder<TStr>::build(const RepeatParameter& rp)
         cerr << "false negative: " << false_negative << endl;
         cerr << endl;
         
-        ELList<RB_Alignment> position2D; EList<RB_Alignment> alignments;
         size_t repeat_total = 0, repeat_aligned = 0;
         const EList<TIndexOffU>& test_repeat_index = subSA_.getRepeatIndex();
         size_t interval = 1;
@@ -3348,97 +3662,30 @@ void RepeatBuilder<TStr>::build(const RepeatParameter& rp)
             interval = test_repeat_index.size() / 1000;
         }
         size_t total_alignments = 0, max_alignments = 0;
-        string query2, rc_query2;
-        for(size_t i = 0; i < test_repeat_index.size(); i += interval) {
+        job_interval_ = interval;
+        job_items_ = (test_repeat_index.size() + interval - 1) / interval;
+        job_results_.resizeExact(4 * job_items_);
+        runJob(RB_JOB_ALIGN);
+        for(size_t j = 0; j < job_items_; j++) {
+            size_t i = j * interval;
             TIndexOffU saElt_idx = test_repeat_index[i];
             TIndexOffU saElt_idx_end = (i + 1 < test_repeat_index.size() ? test_repeat_index[i+1] : subSA_.size());
             TIndexOffU saElt_size = saElt_idx_end - saElt_idx;
-            TIndexOffU saElt = subSA_[saElt_idx];
-            query = getString(s_, saElt, rp.min_repeat_len);
-            query2 = query;
-            
-            // introduce three mismatches into a query when the query is at lest 100-bp
-            if(rp.min_repeat_len >= 100) {
-                const size_t mid_pos1 = (size_t)(rp.min_repeat_len * 0.1);
-                if(query2[mid_pos1] == 'A') {
-                    query2[mid_pos1] = 'C';
-                } else {
-                    query2[mid_pos1] = 'A';
-                }
-                const size_t mid_pos2 = (size_t)(rp.min_repeat_len * 0.5);
-                if(query2[mid_pos2] == 'C') {
-                    query2[mid_pos2] = 'G';
-                } else {
-                    query2[mid_pos2] = 'C';
-                }
-                const size_t mid_pos3 = (size_t)(rp.min_repeat_len * 0.9);
-                if(query2[mid_pos3] == 'G') {
-                    query2[mid_pos3] = 'T';
-                } else {
-                    query2[mid_pos3] = 'G';
-                }
-            }
+            const size_t* res = &job_results_[4 * j];
             
             repeat_total += saElt_size;
-            
-            size_t found = 0;
-            size_t cur_alignments = 0;
-            if(kmer_table.isRepeat(query2, minimizers)) {
-                kmer_table.findAlignments(query2,
-                                          minimizers,
-                                          position2D,
-                                          alignments);
-                total_alignments += (alignments.size() * saElt_size);
-                cur_alignments = alignments.size();
-                TIndexOffU baseoff = 0;
-                for(size_t s = 0; s < seqs.size(); s++) {
-                    int spos = seqs[s].find(query);
-                    if(spos != string::npos) {
-                        for(size_t a = 0; a < alignments.size(); a++) {
-                            if(alignments[a].pos == baseoff + spos) {
-                                found++;
-                            }
-                        }
-                    }
-                    baseoff += seqs[s].length();
-                }
-                
-                assert_leq(found, 1);
-            }
-        
-            rc_query = reverseComplement(query);
-            rc_query2 = reverseComplement(query2);
-            size_t rc_found = 0;
-            if(kmer_table.isRepeat(rc_query2, minimizers)) {
-                kmer_table.findAlignments(rc_query2,
-                                          minimizers,
-                                          position2D,
-                                          alignments);
-                total_alignments += (alignments.size() * saElt_size);
-                cur_alignments += alignments.size();
-                if(cur_alignments > max_alignments) {
-                    max_alignments = cur_alignments;
-                }
-                
-                TIndexOffU baseoff = 0;
-                for(size_t s = 0; s < seqs.size(); s++) {
-                    int spos = seqs[s].find(rc_query);
-                    if(spos != string::npos) {
-                        for(size_t a = 0; a < alignments.size(); a++) {
-                            if(alignments[a].pos == baseoff + spos) {
-                                rc_found++;
-                            }
-                        }
-                    }
-                    baseoff += seqs[s].length();
-                }
-                assert_leq(rc_found, 1);
+            total_alignments += (res[0] * saElt_size);
+            total_alignments += (res[1] * saElt_size);
+            if(res[2] && res[0] + res[1] > max_alignments) {
+                max_alignments = res[0] + res[1];
             }
-
-            if(found + rc_found == 1) {
+            if(res[3]) {
                 repeat_aligned += saElt_size;
             }
         }
+        job_results_.clear();
+        job_kmer_table_ = NULL;
+        job_seqs_ = NULL;
 
         cerr << "num repeats: " << repeat_total << endl;
         cerr << "repeat aligned using minimizers: " << repeat_aligned << endl;
@@ -3508,80 +3755,38 @@ void RepeatBuilder<TStr>::build(const RepeatParameter& rp)
     
     const bool sanity_check = true;
     if(sanity_check) {
-        EList<pair<size_t, size_t> > kmer_table;
         string query;
         size_t total = 0, match = 0;
-        EList<TIndexOffU> positions;
         const EList<TIndexOffU>& test_repeat_index = subSA_.getRepeatIndex();
         size_t interval = 1;
         if(test_repeat_index.size() >= 10000) {
             interval = test_repeat_index.size() / 10000;
         }
-        for(size_t i = 0; i < test_repeat_index.size(); i += interval) {
+        job_interval_ = interval;
+        job_items_ = (test_repeat_index.size() + interval - 1) / interval;
+        job_results_.resizeExact(2 * job_items_);
+        runJob(RB_JOB_SANITY);
+        for(size_t j = 0; j < job_items_; j++) {
+            size_t i = j * interval;
             TIndexOffU saElt_idx = test_repeat_index[i];
             TIndexOffU saElt_idx_end = (i + 1 < test_repeat_index.size() ? test_repeat_index[i+1] : subSA_.size());
-            positions.clear();
-            for(size_t j = saElt_idx; j < saElt_idx_end; j++) {
-                positions.push_back(subSA_[j]);
-#ifndef NDEBUG
-                if(j > saElt_idx) {
-                    TIndexOffU lcp_len = getLCP(s_,
-                                                coordHelper_,
-                                                positions[0],
-                                                positions.back(),
-                                                rp.min_repeat_len);
-                    assert_eq(lcp_len, rp.min_repeat_len);
-                }
-                
-                TIndexOffU saElt = subSA_[j];
-                TIndexOffU start = coordHelper_.getStart(saElt);
-                TIndexOffU start2 = coordHelper_.getStart(saElt + rp.min_repeat_len - 1);
-                assert_eq(start, start2);
-#endif
-            }
-            
-            TIndexOffU saElt = subSA_[saElt_idx];
             size_t true_count = saElt_idx_end - saElt_idx;
-            getString(s_, saElt, rp.min_repeat_len, query);
+            size_t count = job_results_[2 * j], rc_count = job_results_[2 * j + 1];
             total++;
             
-            size_t count = 0, rc_count = 0;
-            string rc_query = reverse_complement(query);
-            for(map<size_t, RB_Repeat*>::iterator it = repeat_map_.begin(); it != repeat_map_.end(); it++) {
-                RB_Repeat& repeat = *(it->second);
-                int pos = repeat.consensus().find(query);
-                if(pos != string::npos) {
-                    for(size_t s = 0; s < repeat.seeds().size(); s++) {
-                        SeedExt& seed = repeat.seeds()[s];
-                        string seq;
-                        seed.getExtendedSeedSequence(s_, seq);
-                        if(seq.find(query) != string::npos)
-                            count++;
-                    }
-                }
-                pos = repeat.consensus().find(rc_query);
-                if(pos != string::npos) {
-                    for(size_t s = 0; s < repeat.seeds().size(); s++) {
-                        SeedExt& seed = repeat.seeds()[s];
-                        string seq;
-                        seed.getExtendedSeedSequence(s_, seq);
-                        if(seq.find(rc_query) != string::npos)
-                            rc_count++;
-                    }
-                }
-            }
-            
             if(count == true_count || rc_count == true_count) {
                 match++;
             } else if(total - match <= 10) {
+                getString(s_, subSA_[saElt_idx], rp.min_repeat_len, query);
                 cerr << "   query: " << query << endl;
-                cerr << "rc_query: " << rc_query << endl;
+                cerr << "rc_query: " << reverse_complement(query) << endl;
                 cerr << "true count: " << true_count << endl;
                 cerr << "found count: " << count << endl;
                 cerr << "rc found count: " << rc_count << endl;
                 cerr << endl;
             }
         }
+        job_results_.clear();
         
         cerr << "RepeatBuilder: sanity check: " << match << " passed (out of " << total << ")" << endl << endl;
     }
@@ -4030,15 +4235,13 @@ void RepeatBuilder<TStr>::saveRepeats(const RepeatParameter &rp)
         mode |= ios_base::trunc;
     }
     // Generate SNPs
-    size_t i = 0;
-    for(map<size_t, RB_Repeat*>::iterator it = repeat_map_.begin(); it != repeat_map_.end(); it++, i++) {
-        RB_Repeat& repeat = *(it->second);
-        if(!repeat.satisfy(rp))
-            continue;
-
-        // for each repeats
-        repeat.generateSNPs(rp, s_, i);
+    job_rp_ = &rp;
+    job_repeats_.clear();
+    for(map<size_t, RB_Repeat*>::iterator it = repeat_map_.begin(); it != repeat_map_.end(); it++) {
+        job_repeats_.push_back(it->second);
     }
+    runJob(RB_JOB_SNPS);
+    job_repeats_.clear();
 
     // save snp, consensus sequenuce, info
     string snp_fname = filename_ + ".rep.snp";
@@ -4051,7 +4254,7 @@ void RepeatBuilder<TStr>::saveRepeats(const RepeatParameter &rp)
 
     const string repName = "rep" + to_string(rp.min_repeat_len) + "-" + to_string(rp.max_repeat_len);
     
-    i = 0;
+    size_t i = 0;
     TIndexOffU consensus_baseoff = 0;
     TIndexOffU snp_id_base = 0;
     TIndexOffU hapl_id_base = 0;
@@ -4266,7 +4469,28 @@ void RB_SubSA::push_back(const TStr& s,
                          TIndexOffU saElt,
                          bool lastInput)
 {
-    if(saElt + seed_len() <= coordHelper.getEnd(saElt)) {
+    bool valid = (saElt + seed_len() <= coordHelper.getEnd(saElt));
+    bool same = false;
+    if(valid && seed_count_ > 1 && !temp_suffixes_.empty()) {
+        // calculate common prefix length between two text.
+        //   text1 is started from the previous valid suffix and text2 is started from saElt
+        same = isSameSequenceUpto(s,
+                                  coordHelper,
+                                  temp_suffixes_.back(),
+                                  saElt,
+                                  seed_len_);
+    }
+    push_back(s, saElt, valid, same, lastInput);
+}
+
+template<typename TStr>
+void RB_SubSA::push_back(const TStr& s,
+                         TIndexOffU saElt,
+                         bool valid,
+                         bool same,
+                         bool lastInput)
+{
+    if(valid) {
         if(seed_count_ == 1) {
             repeat_list_.push_back(saElt);
         } else {
@@ -4277,16 +4501,6 @@ void RB_SubSA::push_back(const TStr& s,
                 return;
             }
             
-            TIndexOffU prev_saElt = temp_suffixes_.back();
-            
-            // calculate common prefix length between two text.
-            //   text1 is started from prev_saElt and text2 is started from saElt
-            bool same = isSameSequenceUpto(s,
-                                           coordHelper,
-                                           prev_saElt,
-                                           saElt,
-                                           seed_len_);
-            
             if(same) {
                 temp_suffixes_.push_back(saElt);
             }
@@ -4402,11 +4616,40 @@ bool RB_SubSA::isDone(TIndexOffU off, TIndexOffU len) const
     return true;
 }
 
+/**
+ * Mark the seed groups tid, tid + nthreads, ... whose seeds are mostly on
+ * the sense strand.
+ */
+void RB_SubSA::markSenseDominant(CoordHelper& coordHelper,
+                                 EList<uint8_t>& senseDominant,
+                                 size_t tid,
+                                 size_t nthreads) const
+{
+    EList<TIndexOffU> positions;
+    for(size_t i = tid; i < repeat_index_.size(); i += nthreads) {
+        TIndexOffU begin = repeat_index_[i];
+        TIndexOffU end = (i + 1 < repeat_index_.size() ? repeat_index_[i+1] : repeat_list_.size());
+        assert_lt(begin, end);
+        positions.clear();
+        for(size_t j = begin; j < end; j++) positions.push_back(repeat_list_[j]);
+        
+        if(isSenseDominant(coordHelper, positions, seed_len_))
+            senseDominant[i] = 1;
+    }
+}
+
+static void senseDominant_worker(void* vp)
+{
+    RB_SenseParam* p = (RB_SenseParam*)vp;
+    p->subSA->markSenseDominant(*p->coordHelper, *p->senseDominant, p->tid, p->nthreads);
+}
+
 template<typename TStr>
 void RB_SubSA::buildRepeatBase(const TStr& s,
                                CoordHelper& coordHelper,
                                const size_t max_len,
-                               EList<RB_RepeatBase>& repeatBases)
+                               EList<RB_RepeatBase>& repeatBases,
+                               int nthreads)
 {
     if(repeat_index_.empty())
         return;
@@ -4416,21 +4659,41 @@ void RB_SubSA::buildRepeatBase(const TStr& s,
     EList<uint8_t> senseDominant;
     senseDominant.resizeExact(repeat_index_.size());
     senseDominant.fillZero();
+    {
+        // isSenseDominant() only reads the lengths kept by coordHelper, so
+        // it can be shared
+        EList<RB_SenseParam> tparams;
+        tparams.resizeExact(max(nthreads, 1));
+        for(size_t i = 0; i < tparams.size(); i++) {
+            tparams[i].subSA = this;
+            tparams[i].coordHelper = &coordHelper;
+            tparams[i].senseDominant = &senseDominant;
+            tparams[i].tid = i;
+            tparams[i].nthreads = tparams.size();
+        }
+        if(tparams.size() == 1) {
+            senseDominant_worker((void*)&tparams[0]);
+        } else {
+            AutoArray<tthread::thread*> threads(tparams.size());
+            for(size_t i = 0; i < tparams.size(); i++) {
+                threads[i] = new tthread::thread(senseDominant_worker, (void*)&tparams[i]);
+            }
+            for(size_t i = 0; i < tparams.size(); i++) {
+                threads[i]->join();
+                delete threads[i];
+            }
+        }
+    }
     
     EList<size_t> repeatStack;
     EList<pair<TIndexOffU, TIndexOffU> > size_table;
     size_table.reserveExact(repeat_index_.size() / 2 + 1);
     for(size_t i = 0; i < repeat_index_.size(); i++) {
-        TIndexOffU begin = repeat_index_[i];
-        TIndexOffU end = (i + 1 < repeat_index_.size() ? repeat_index_[i+1] : repeat_list_.size());
-        assert_lt(begin, end);
-        EList<TIndexOffU> positions; positions.reserveExact(end - begin);
-        for(size_t j = begin; j < end; j++) positions.push_back(repeat_list_[j]);
-        
-        if(!isSenseDominant(coordHelper, positions, seed_len_))
+        if(!senseDominant[i])
             continue;
         
-        senseDominant[i] = 1;
+        TIndexOffU begin = repeat_index_[i];
+        TIndexOffU end = (i + 1 < repeat_index_.size() ? repeat_index_[i+1] : repeat_list_.size());
         size_table.expand();
         size_table.back().first = end - begin;
         size_table.back().second = i;
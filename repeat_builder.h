@@ -762,6 +762,16 @@ private:
     RandomSource rnd_;
 };
 
+class RB_SubSA;
+
+struct RB_SenseParam {
+    const RB_SubSA* subSA;
+    CoordHelper*    coordHelper;
+    EList<uint8_t>* senseDominant;
+    size_t          tid;
+    size_t          nthreads;
+};
+
 // SA Subset
 class RB_SubSA {
 public:
@@ -781,6 +791,16 @@ public:
                    TIndexOffU saElt,
                    bool lastInput = false);
 
+    // As above, with the checks against the reference already done:
+    // 'valid' iff a seed fits at saElt and 'same' iff its seed equals
+    // that of the previous valid suffix
+    template<typename TStr>
+    void push_back(const TStr& s,
+                   TIndexOffU saElt,
+                   bool valid,
+                   bool same,
+                   bool lastInput);
+
     inline TIndexOffU seed_len() const { return seed_len_; }
     inline TIndexOffU seed_count() const { return seed_count_; }
 
@@ -825,7 +845,13 @@ public:
     void buildRepeatBase(const TStr& s,
                          CoordHelper& coordHelper,
                          const size_t max_len,
-                         EList<RB_RepeatBase>& repeatBases);
+                         EList<RB_RepeatBase>& repeatBases,
+                         int nthreads = 1);
+
+    void markSenseDominant(CoordHelper& coordHelper,
+                           EList<uint8_t>& senseDominant,
+                           size_t tid,
+                           size_t nthreads) const;
 
 private:
     TIndexOffU sa_size_;
@@ -840,6 +866,17 @@ private:
 };
 
 
+class RB_KmerTable;
+template<typename TStr> class RepeatBuilder;
+
+template<typename TStr>
+struct RB_ThreadParam {
+    RepeatBuilder<TStr>* builder;
+    int                  job;
+    size_t               tid;
+    size_t               nthreads;
+};
+
 // find and write repeats
 template<typename TStr>
 class RepeatBuilder {
@@ -849,9 +886,22 @@ public:
                   const EList<RefRecord>& szs,
                   const EList<string>& ref_names,
                   bool forward_only,
-                  const string& filename);
+                  const string& filename,
+                  int nthreads = 1);
     ~RepeatBuilder();
 
+    // Parts of build() shared out among threads; see runJob()
+    enum {
+        RB_JOB_SUBSA = 0,  // check seeds of an SA window against the reference
+        RB_JOB_INIT,       // gather and extend the seeds of each repeat base
+        RB_JOB_KMER,       // test the minimizer table on reference positions
+        RB_JOB_ALIGN,      // test minimizer alignment of seed groups
+        RB_JOB_SANITY,     // count each sampled seed group's hits in the repeats
+        RB_JOB_SNPS        // generate each repeat's SNPs
+    };
+
+    void doJob(int job, size_t tid, size_t nthreads);
+
 
 public:
     void readSA(const RepeatParameter& rp,
@@ -933,6 +983,8 @@ private:
                            const EList<SeedExt>& seeds,
                            EList<SeedHP>& haplo_list);
 
+    void runJob(int job);
+
 private:
     const int output_width = 60;
     
@@ -953,6 +1005,22 @@ private:
     EList<string> consensus_all_;
     ELList<SeedExt> seeds_;
     map<size_t, RB_Repeat*> repeat_map_;
+
+    int nthreads_;
+
+    // Inputs and outputs of the job being run
+    const RepeatParameter*      job_rp_;
+    const BitPackedArray*       job_sa_;
+    size_t                      job_lo_;       // SA window [job_lo_, job_hi_)
+    size_t                      job_hi_;
+    const EList<RB_RepeatBase>* job_bases_;
+    EList<RB_Repeat*>           job_repeats_;
+    const RB_KmerTable*         job_kmer_table_;
+    const EList<string>*        job_seqs_;
+    size_t                      job_interval_; // sampling interval
+    size_t                      job_items_;    // number of items sampled
+    EList<size_t>               job_results_;  // per item
+    EList<uint8_t>              job_flags_;    // per SA window element: 1 valid, 2 same as previous
 };
 
 
@@ -368,7 +368,8 @@ public:
          int32_t overrideOffRate = -1,
          bool verbose = false,
          bool passMemExc = false,
-         bool sanityCheck = false);
+         bool sanityCheck = false,
+         size_t pathGraphMem = 0);
     
 	RFM() {
         clearLocalRFMs();
@@ -495,6 +496,8 @@ public:
 	FILE                        *_in2;    // input fd for secondary index file
 	string                      _in1Str;
 	string                      _in2Str;
+	IndexFileLoc                _in1Loc;
+	IndexFileLoc                _in2Loc;
 	
 	char                        *mmFile1_;
 	char                        *mmFile2_;
@@ -655,7 +658,8 @@ RFM<index_t>::RFM(
                   int32_t overrideOffRate,
                   bool verbose,
                   bool passMemExc,
-                  bool sanityCheck) :
+                  bool sanityCheck,
+                  size_t pathGraphMem) :
     GFM<index_t>(s,
                  packed,
                  needEntireReverse,
@@ -686,7 +690,8 @@ RFM<index_t>::RFM(
                  overrideOffRate,
                  verbose,
                  passMemExc,
-                 sanityCheck),
+                 sanityCheck,
+                 pathGraphMem),
     _in1(NULL),
     _in2(NULL)
 {
@@ -969,13 +974,13 @@ void RFM<index_t>::readIntoMemory(
         // Initialize our primary and secondary input-stream fields
 		if(_in1 != NULL) fclose(_in1);
 		if(this->_verbose || startVerbose) cerr << "Opening \"" << _in1Str.c_str() << "\"" << endl;
-		if((_in1 = fopen(_in1Str.c_str(), "rb")) == NULL) {
+		if((_in1 = openIndexFile(_in1Str, _in1Loc)) == NULL) {
 			cerr << "Could not open index file " << _in1Str.c_str() << endl;
 		}
 		if(loadSASamp) {
 			if(_in2 != NULL) fclose(_in2);
 			if(this->_verbose || startVerbose) cerr << "Opening \"" << _in2Str.c_str() << "\"" << endl;
-			if((_in2 = fopen(_in2Str.c_str(), "rb")) == NULL) {
+			if((_in2 = openIndexFile(_in2Str, _in2Loc)) == NULL) {
 				cerr << "Could not open index file " << _in2Str.c_str() << endl;
 			}
 		}
@@ -987,20 +992,14 @@ void RFM<index_t>::readIntoMemory(
 #ifdef BOWTIE_MM
 		if(this->_useMm /*&& !justHeader*/) {
 			const char *names[] = {_in1Str.c_str(), _in2Str.c_str()};
+			const IndexFileLoc *locs[] = {&_in1Loc, &_in2Loc};
             int fds[] = { fileno(_in1), fileno(_in2) };
 			for(int i = 0; i < (loadSASamp ? 2 : 1); i++) {
 				if(this->_verbose || startVerbose) {
 					cerr << "  ¯ " << (i+1) << ": ";
 					logTime(cerr);
 				}
-				struct stat sbuf;
-				if (stat(names[i], &sbuf) == -1) {
-					perror("stat");
-					cerr << "Error: Could not stat index file " << names[i] << " prior to memory-mapping" << endl;
-					throw 1;
-				}
-                mmFile[i] = (char*)mmap((void *)0, (size_t)sbuf.st_size,
-										PROT_READ, MAP_SHARED, fds[(size_t)i], 0);
+                mmFile[i] = mmapIndexFile(*locs[i], fds[(size_t)i]);
 				if(mmFile[i] == (void *)(-1)) {
 					perror("mmap");
 					cerr << "Error: Could not memory-map the index file " << names[i] << endl;
@@ -1008,7 +1007,7 @@ void RFM<index_t>::readIntoMemory(
 				}
 				if(mmSweep) {
 					int sum = 0;
-					for(off_t j = 0; j < sbuf.st_size; j += 1024) {
+					for(uint64_t j = 0; j < locs[i]->len; j += 1024) {
 						sum += (int) mmFile[i][j];
 					}
 					if(startVerbose) {
@@ -1089,8 +1088,8 @@ void RFM<index_t>::readIntoMemory(
         if(!this->_readIncluded[i])
             continue;
         if(i > 0) {
-            fseek(_in1, _localRFMFilePos[i-1].first, SEEK_SET);
-            fseek(_in2, _localRFMFilePos[i-1].second, SEEK_SET);
+            fseeko(_in1, (off_t)_in1Loc.off + _localRFMFilePos[i-1].first, SEEK_SET);
+            fseeko(_in2, (off_t)_in2Loc.off + _localRFMFilePos[i-1].second, SEEK_SET);
         }
 		LocalRFM<index_t> *localRFM = new LocalRFM<index_t>(base,
                                                             NULL,
@@ -1121,16 +1120,11 @@ void RFM<index_t>::readIntoMemory(
 		_localRFMs.push_back(localRFM);
 	}
     
-    fseek(_in1, _localRFMFilePos.back().first, SEEK_SET);
-    fseek(_in2, _localRFMFilePos.back().second, SEEK_SET);
+    fseeko(_in1, (off_t)_in1Loc.off + _localRFMFilePos.back().first, SEEK_SET);
+    fseeko(_in2, (off_t)_in2Loc.off + _localRFMFilePos.back().second, SEEK_SET);
 		
-#ifdef BOWTIE_MM
-    fseek(_in1, 0, SEEK_SET);
-	fseek(_in2, 0, SEEK_SET);
-#else
-	rewind(_in1);
-    rewind(_in2);
-#endif
+    fseeko(_in1, (off_t)_in1Loc.off, SEEK_SET);
+	fseeko(_in2, (off_t)_in2Loc.off, SEEK_SET);
 }
 
 #endif /*RFM_H_*/
@@ -0,0 +1,217 @@
+/*
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of HISAT 2.
+ *
+ * HISAT 2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HISAT 2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HISAT 2.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SAIS_H_
+#define SAIS_H_
+
+#include <stdint.h>
+#include <limits>
+#include <algorithm>
+#include "assert_helpers.h"
+#include "ds.h"
+
+/**
+ * Linear-time suffix array construction by induced sorting (SA-IS; Nong,
+ * Zhang and Chan, "Two efficient algorithms for linear time suffix array
+ * construction", 2011).
+ *
+ * The text is anything with operator[] returning a character in [0, K);
+ * its last character must be a sentinel that is unique and smaller than
+ * all others.  SA must hold n elements; the reduced problem is solved in
+ * place in SA.  Besides SA this takes a type bit per character per level
+ * (under 2 bits per character in all) and one bucket array at a time.  A
+ * level's bucket array is freed before recursing, and the reduced
+ * problem's goes in the unused middle of SA when it fits there; otherwise
+ * it is allocated, and since a reduced problem has at most n/2 characters
+ * and names, that is at most n/2 elements.
+ */
+
+template <typename TIdx>
+class SaisTypes {
+public:
+	explicit SaisTypes(TIdx n) {
+		_bits.resizeExact((n + 63) / 64);
+		_bits.fillZero();
+	}
+	bool s(TIdx i) const { return (_bits[i >> 6] >> (i & 63)) & 1; }
+	void setS(TIdx i) { _bits[i >> 6] |= ((uint64_t)1 << (i & 63)); }
+	bool lms(TIdx i) const { return i > 0 && s(i) && !s(i - 1); }
+private:
+	EList<uint64_t> _bits;
+};
+
+template <typename TText, typename TIdx>
+static void saisBuckets(const TText& t, TIdx n, TIdx K, TIdx* bkt, bool end) {
+	std::fill(bkt, bkt + K, (TIdx)0);
+	for(TIdx i = 0; i < n; i++) bkt[t[i]]++;
+	TIdx sum = 0;
+	for(TIdx c = 0; c < K; c++) {
+		sum += bkt[c];
+		bkt[c] = end ? sum : sum - bkt[c];
+	}
+}
+
+template <typename TText, typename TIdx>
+static void saisInduce(const TText& t, TIdx* SA, TIdx n, TIdx K, const SaisTypes<TIdx>& types, TIdx* bkt) {
+	const TIdx EMPTY = std::numeric_limits<TIdx>::max();
+	// L-type suffixes, left to right from bucket heads
+	saisBuckets(t, n, K, bkt, false);
+	for(TIdx i = 0; i < n; i++) {
+		if(SA[i] == EMPTY || SA[i] == 0) continue;
+		TIdx j = SA[i] - 1;
+		if(!types.s(j)) SA[bkt[t[j]]++] = j;
+	}
+	// S-type suffixes, right to left from bucket tails
+	saisBuckets(t, n, K, bkt, true);
+	for(TIdx i = n; i-- > 0;) {
+		if(SA[i] == EMPTY || SA[i] == 0) continue;
+		TIdx j = SA[i] - 1;
+		if(types.s(j)) SA[--bkt[t[j]]] = j;
+	}
+}
+
+/**
+ * 'spare' points to 'nspare' elements the caller isn't using, where the
+ * bucket array goes if it fits.
+ */
+template <typename TText, typename TIdx>
+static void saisCore(const TText& t, TIdx* SA, TIdx n, TIdx K, TIdx* spare = NULL, TIdx nspare = 0) {
+	const TIdx EMPTY = std::numeric_limits<TIdx>::max();
+	assert_gt(n, 0);
+	if(n == 1) {
+		SA[0] = 0;
+		return;
+	}
+
+	// Classify suffixes; the sentinel is S-type
+	SaisTypes<TIdx> types(n);
+	types.setS(n - 1);
+	for(TIdx i = n - 1; i-- > 0;) {
+		if(t[i] < t[i + 1] || (t[i] == t[i + 1] && types.s(i + 1))) {
+			types.setS(i);
+		}
+	}
+
+	// Stage 1: sort LMS substrings by inducing from their buckets' tails
+	EList<TIdx> bktList;
+	TIdx* bkt = spare;
+	if(K > nspare) {
+		bktList.resizeExact(K);
+		bkt = bktList.ptr();
+	}
+	saisBuckets(t, n, K, bkt, true);
+	for(TIdx i = 0; i < n; i++) SA[i] = EMPTY;
+	for(TIdx i = 1; i < n; i++) {
+		if(types.lms(i)) SA[--bkt[t[i]]] = i;
+	}
+	saisInduce(t, SA, n, K, types, bkt);
+
+	// Compact the sorted LMS substrings into the front of SA
+	TIdx n1 = 0;
+	for(TIdx i = 0; i < n; i++) {
+		if(types.lms(SA[i])) SA[n1++] = SA[i];
+	}
+
+	// Name them; equal substrings get equal names.  Names go to
+	// SA[n1 + pos/2], which can't collide as LMS positions are >= 2 apart
+	for(TIdx i = n1; i < n; i++) SA[i] = EMPTY;
+	TIdx name = 0, prev = EMPTY;
+	for(TIdx i = 0; i < n1; i++) {
+		TIdx pos = SA[i];
+		bool diff = (prev == EMPTY);
+		for(TIdx d = 0; !diff; d++) {
+			if(t[pos + d] != t[prev + d] || types.s(pos + d) != types.s(prev + d)) {
+				diff = true;
+			} else if(d > 0 && (types.lms(pos + d) || types.lms(prev + d))) {
+				break;
+			}
+		}
+		if(diff) {
+			name++;
+			prev = pos;
+		}
+		SA[n1 + pos / 2] = name - 1;
+	}
+	for(TIdx i = n, j = n; i-- > n1;) {
+		if(SA[i] != EMPTY) SA[--j] = SA[i];
+	}
+
+	// Stage 2: sort the reduced string, recursing only if names repeat
+	TIdx* s1 = SA + n - n1;
+	if(name < n1) {
+		// Our buckets are rebuilt after; don't hold them through the recursion
+		{ EList<TIdx> drop; drop.xfer(bktList); }
+		saisCore<const TIdx*, TIdx>(s1, SA, n1, name, SA + n1, n - 2 * n1);
+		if(K > nspare) {
+			bktList.resizeExact(K);
+			bkt = bktList.ptr();
+		}
+	} else {
+		for(TIdx i = 0; i < n1; i++) SA[s1[i]] = i;
+	}
+
+	// Stage 3: put the LMS suffixes, now in order, at their buckets' tails
+	// and induce the rest
+	for(TIdx i = 1, j = 0; i < n; i++) {
+		if(types.lms(i)) s1[j++] = i;
+	}
+	for(TIdx i = 0; i < n1; i++) SA[i] = s1[SA[i]];
+	for(TIdx i = n1; i < n; i++) SA[i] = EMPTY;
+	saisBuckets(t, n, K, bkt, true);
+	for(TIdx i = n1; i-- > 0;) {
+		TIdx j = SA[i];
+		SA[i] = EMPTY;
+		SA[--bkt[t[j]]] = j;
+	}
+	saisInduce(t, SA, n, K, types, bkt);
+}
+
+/**
+ * A DNA text seen through a virtual sentinel, with the alphabet reversed:
+ * character c reads as 4 - c and position len() reads as 0.
+ */
+template <typename TStr>
+class SaisText {
+public:
+	explicit SaisText(const TStr& s) : _s(s), _len(s.length()) {}
+	int operator[](size_t i) const { return i < _len ? 4 - (int)_s[i] : 0; }
+private:
+	const TStr& _s;
+	size_t      _len;
+};
+
+/**
+ * Fill 'sa' with the suffix array of 's' (characters 0-3), including the
+ * empty suffix; i.e. sa has s.length()+1 elements.  As in the blockwise
+ * builders, the end of the text compares greater than any character, so
+ * the empty suffix comes last and a suffix comes after its extensions.
+ * SA-IS wants the opposite, a smallest sentinel, but with the alphabet
+ * reversed as well every comparison flips, so that order is just this
+ * one backwards.
+ */
+template <typename TStr, typename TIdx>
+void saisSuffixArray(const TStr& s, EList<TIdx>& sa) {
+	const TIdx n = (TIdx)s.length() + 1;
+	sa.resizeExact(n);
+	SaisText<TStr> t(s);
+	saisCore<SaisText<TStr>, TIdx>(t, sa.ptr(), n, 5);
+	std::reverse(sa.begin(), sa.end());
+}
+
+#endif /*SAIS_H_*/
@@ -777,6 +777,13 @@ const
             o.append("NA");
         }
     }
+    if(prm.workExceeded) {
+        // ZW:i: Work units spent before the search ran out of budget
+        WRITE_SEP();
+        itoa10<uint64_t>(prm.nWork, buf);
+        o.append("ZW:i:");
+        o.append(buf);
+    }
     if(!rgs_.empty()) {
         WRITE_SEP();
         o.append(rgs_.c_str());
@@ -1099,6 +1106,13 @@ const
         // YM:i: Read was repetitive when aligned unpaired?
         first = flags.printYF(o, first) && first;
     }
+    if(prm.workExceeded) {
+        // ZW:i: Work units spent before the search ran out of budget
+        WRITE_SEP();
+        itoa10<uint64_t>(prm.nWork, buf);
+        o.append("ZW:i:");
+        o.append(buf);
+    }
     if(!rgs_.empty()) {
         WRITE_SEP();
         o.append(rgs_.c_str());
@@ -130,7 +130,9 @@ _numRefs(refs.numRefs()),
 _write(write),
 _read(read),
 _threadSafe(threadSafe),
-_empty(true)
+_empty(true),
+_numChanges(0),
+_lastChangeReadId(0)
 {
     for(size_t r = 0; r < refnames.size(); r++) {
         const string& refname = refnames[r];
@@ -254,6 +256,7 @@ bool SpliceSiteDB::addSpliceSite(
                             _spliceSites[ref].back()._rightext = rightAnchorLen;
                             _spliceSites[ref].back()._editdist = editdist;
                             _spliceSites[ref].back()._numreads = 1;
+                            noteChange(rd.rdid);
                             assert(cur != NULL);
                             cur->payload = (uint32_t)_spliceSites[ref].size() - 1;
                             
@@ -275,6 +278,7 @@ bool SpliceSiteDB::addSpliceSite(
                             _spliceSites[ref][cur->payload]._numreads += 1;
                             if(rd.rdid < _spliceSites[ref][cur->payload]._readid) {
                                 _spliceSites[ref][cur->payload]._readid = rd.rdid;
+                                noteChange(rd.rdid);
                             }
                         }
                     }
@@ -316,6 +320,7 @@ bool SpliceSiteDB::addSpliceSite(
                 _spliceSites[ref].back()._rightext = rightAnchorLen;
                 _spliceSites[ref].back()._editdist = editdist;
                 _spliceSites[ref].back()._numreads = 1;
+                noteChange(rd.rdid);
                 assert(cur != NULL);
                 cur->payload = (uint32_t)_spliceSites[ref].size() - 1;
                 
@@ -337,6 +342,7 @@ bool SpliceSiteDB::addSpliceSite(
                 _spliceSites[ref][cur->payload]._numreads += 1;
                 if(rd.rdid < _spliceSites[ref][cur->payload]._readid) {
                     _spliceSites[ref][cur->payload]._readid = rd.rdid;
+                    noteChange(rd.rdid);
                 }
             }
         }
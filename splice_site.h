@@ -546,6 +546,14 @@ public:
     bool write() const { return _write; }
     bool read() const { return _read; }
     
+    /**
+     * Number of times a read added a splice site or made one visible to
+     * earlier read ids, and the largest id of such a read.  Alignments
+     * only depend on the splice sites found so far through these two.
+     */
+    uint64_t numChanges() const { return __atomic_load_n(&_numChanges, __ATOMIC_ACQUIRE); }
+    uint64_t lastChangeReadId() const { return __atomic_load_n(&_lastChangeReadId, __ATOMIC_RELAXED); }
+    
     bool getSpliceSite(SpliceSite& ss) const;
     void getLeftSpliceSites(uint32_t ref, uint32_t left, uint32_t range, EList<SpliceSite>& spliceSites) const;
     void getRightSpliceSites(uint32_t ref, uint32_t right, uint32_t range, EList<SpliceSite>& spliceSites) const;
@@ -585,6 +593,13 @@ private:
                     EList<SpliceSite>& ss_list,
                     const SpliceSite* ss = NULL);
     
+    void noteChange(uint64_t rdid) {
+        uint64_t last = __atomic_load_n(&_lastChangeReadId, __ATOMIC_RELAXED);
+        while(rdid > last &&
+              !__atomic_compare_exchange_n(&_lastChangeReadId, &last, rdid, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) { }
+        __atomic_fetch_add(&_numChanges, 1, __ATOMIC_RELEASE);
+    }
+    
 private:
     uint64_t                            _numRefs;
     EList<string>                       _refnames;
@@ -608,6 +623,8 @@ private:
     BTDnaString                         acceptorstr;
     
     bool                                _empty;
+    uint64_t                            _numChanges;
+    uint64_t                            _lastChangeReadId;
     
     EList<Exon>                         _exons;
 };
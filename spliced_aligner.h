@@ -102,6 +102,12 @@ public:
                                AlnSinkWrap<index_t>&            sink,
                                bool                             alignMate = false,
                                index_t                          dep = 0);
+
+protected:
+
+    // (ref, ref offset) of the seed-extension DP problems already filled
+    // for the current read and strand in hybridSearch
+    EList<pair<index_t, index_t> > _dpProblems;
 };
 
 
@@ -247,6 +253,12 @@ void SplicedAligner<index_t, local_index_t>::hybridSearch(
     this->_genomeHits_done.resize(this->_genomeHits.size());
     this->_genomeHits_done.fill(false);
 
+    // The query profile only depends on the read and strand, so the aligner
+    // is initialized with the read once, on the first DP problem, and every
+    // later problem reuses the profile built for it
+    bool dpReadInited = false;
+    _dpProblems.clear();
+
     for(size_t hi = 0; hi < this->_genomeHits.size(); hi++) {
         index_t hj = 0;
         for(; hj < this->_genomeHits.size(); hj++) {
@@ -291,21 +303,40 @@ void SplicedAligner<index_t, local_index_t>::hybridSearch(
         
         if(rp.bowtie2_dp == 2 || (rp.bowtie2_dp == 1 && maxsc < this->_minsc[rdi])) {
             const Read& rd = *this->_rds[rdi];
-            // Initialize the aligner with a new read
-            swa.initRead(rd.patFw,    // fw version of query
-                         rd.patRc,    // rc version of query
-                         rd.qual,     // fw version of qualities
-                         rd.qualRev,  // rc version of qualities
-                         0,           // off of first char in 'rd' to consider
-                         rd.length(), // off of last char (excl) in 'rd' to consider
-                         sc);         // scoring scheme
-            
             bool found = genomeHit.len() >= rd.length();
+            index_t refoff = genomeHit.refoff() > genomeHit.rdoff() ? genomeHit.refoff() - genomeHit.rdoff() :  0;
             if(!found) {
+                // Hits anchored at the same diagonal frame the same rectangle,
+                // whose fill and extension have already been done
+                pair<index_t, index_t> problem(genomeHit.ref(), refoff);
+                bool dup = false;
+                for(size_t pi = 0; pi < _dpProblems.size(); pi++) {
+                    if(_dpProblems[pi] == problem) {
+                        dup = true;
+                        break;
+                    }
+                }
+                if(dup) {
+                    him.dpextdups++;
+                    this->_genomeHits_done[hj] = true;
+                    continue;
+                }
+                _dpProblems.push_back(problem);
+                him.dpextatts++;
+                if(!dpReadInited) {
+                    // Initialize the aligner with a new read
+                    swa.initRead(rd.patFw,    // fw version of query
+                                 rd.patRc,    // rc version of query
+                                 rd.qual,     // fw version of qualities
+                                 rd.qualRev,  // rc version of qualities
+                                 0,           // off of first char in 'rd' to consider
+                                 rd.length(), // off of last char (excl) in 'rd' to consider
+                                 sc);         // scoring scheme
+                    dpReadInited = true;
+                }
                 DynProgFramer dpframe(false);  // trimToRef
                 size_t tlen = ref.approxLen(genomeHit.ref());
                 size_t readGaps = 10, refGaps = 10, nceil = 0, maxhalf = 10;
-                index_t refoff = genomeHit.refoff() > genomeHit.rdoff() ? genomeHit.refoff() - genomeHit.rdoff() :  0;
                 DPRect rect;
                 dpframe.frameSeedExtensionRect(refoff,         // ref offset implied by seed hit assuming no gaps
                                                rd.length(),    // length of read sequence used in DP table
@@ -450,6 +481,7 @@ int64_t SplicedAligner<index_t, local_index_t>::hybridSearch_recur(
 
     if(hit.score() + cushion < this->_minsc[rdi]) return maxsc;
     if(dep >= 128) return maxsc;
+    if(this->overBudget(swa, him)) return maxsc;
     
     // if it's already examined, just return
     if(hitoff == hit.rdoff() - hit.trim5() && hitlen == hit.len() + hit.trim5() + hit.trim3()) {
@@ -224,13 +224,14 @@ private:
 		}
 		__m128i* tmp = last_alloc_;
 		size_t tmpint = (size_t)tmp;
-		// Align it!
-		if((tmpint & 0xf) != 0) {
-			tmpint += 15;
-			tmpint &= (~0xf);
+		// Align it!  32 bytes, so that pairs of __m128i's can also be loaded
+		// as aligned 256-bit vectors
+		if((tmpint & 0x1f) != 0) {
+			tmpint += 31;
+			tmpint &= (~0x1f);
 			tmp = reinterpret_cast<__m128i*>(tmpint);
 		}
-		assert_eq(0, (tmpint & 0xf)); // should be 16-byte aligned
+		assert_eq(0, (tmpint & 0x1f)); // should be 32-byte aligned
 		assert(tmp != NULL);
 		gMemTally.add(cat_, sz);
 		return tmp;
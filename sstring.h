@@ -1764,6 +1764,17 @@ public:
 		return *this;
 	}
 
+	/**
+	 * Exchange contents with another SStringExpandable by swapping
+	 * buffers, so that neither side allocates.
+	 */
+	void swap(SStringExpandable<T,S,M>& o) {
+		std::swap(cs_, o.cs_);
+		std::swap(printcs_, o.printcs_);
+		std::swap(len_, o.len_);
+		std::swap(sz_, o.sz_);
+	}
+
 	/**
 	 * Assignment from a std::basic_string
 	 */